@@ -1,5 +1,6 @@
 #include "mainloop.h"
 #include "ext/pathmax.h"
+#include "ext/portable_time.h"
 #include <csignal>
 
 #include <regex>
@@ -35,6 +36,7 @@
 #define MODULES_DIRECTORY "modules/"
 
 #include <libcaercpp/libcaer.hpp>
+#include <libcaer/events/special.h>
 using namespace libcaer::log;
 
 struct OrderedInput {
@@ -74,6 +76,18 @@ struct OrderedInput {
 	}
 };
 
+// Correlation between the device timestamps of an input module and host
+// monotonic time, both in microseconds: hostTime = timestamp + offset.
+struct TimeCorrelation {
+	bool valid;
+	int64_t offset;
+	// Minimum offset seen in the current epoch, becomes the new offset at the
+	// end of the epoch. This lets the estimate follow clock drift both ways.
+	int64_t epochMinOffset;
+	int64_t epochStart;
+	int64_t lastTimestamp;
+};
+
 struct ModuleInfo {
 	// Module identification.
 	int16_t id;
@@ -91,6 +105,8 @@ struct ModuleInfo {
 	caerModuleInfo libraryInfo;
 	// Module runtime data.
 	caerModuleData runtimeData;
+	// Device to host time correlation (input modules only).
+	TimeCorrelation timeCorrelation;
 
 	ModuleInfo() :
 			id(-1),
@@ -99,7 +115,8 @@ struct ModuleInfo {
 			library(),
 			libraryHandle(),
 			libraryInfo(nullptr),
-			runtimeData(nullptr) {
+			runtimeData(nullptr),
+			timeCorrelation() {
 	}
 
 	ModuleInfo(int16_t i, const std::string &n, sshsNode c, const std::string &l) :
@@ -109,7 +126,8 @@ struct ModuleInfo {
 			library(l),
 			libraryHandle(),
 			libraryInfo(nullptr),
-			runtimeData(nullptr) {
+			runtimeData(nullptr),
+			timeCorrelation() {
 	}
 };
 
@@ -1354,6 +1372,76 @@ static size_t getMaximumInputNumber() {
 	return (maxSize);
 }
 
+// Length of a time correlation epoch, in microseconds.
+#define TIME_CORRELATION_EPOCH 1000000
+
+static void updateTimeCorrelation(ModuleInfo &m, caerEventPacketContainer out) {
+	TimeCorrelation &tc = m.timeCorrelation;
+
+	// Find the newest event timestamp this input module just produced.
+	int64_t lastTimestamp = -1;
+
+	for (int32_t i = 0; i < caerEventPacketContainerGetEventPacketsNumber(out); i++) {
+		caerEventPacketHeaderConst packet = caerEventPacketContainerGetEventPacketConst(out, i);
+		if (packet == nullptr || caerEventPacketHeaderGetEventNumber(packet) == 0) {
+			continue;
+		}
+
+		// TS_RESET: timestamps restart, the old correlation is meaningless.
+		// Its own timestamp is not a real device time, so skip the packet.
+		if ((caerEventPacketHeaderGetEventType(packet) == SPECIAL_EVENT)
+			&& (caerSpecialEventPacketFindEventByTypeConst((caerSpecialEventPacketConst) packet, TIMESTAMP_RESET)
+				!= nullptr)) {
+			tc.valid = false;
+			continue;
+		}
+
+		const void *lastEvent = caerGenericEventGetEvent(packet, caerEventPacketHeaderGetEventNumber(packet) - 1);
+		int64_t timestamp = caerGenericEventGetTimestamp64(lastEvent, packet);
+
+		if (timestamp > lastTimestamp) {
+			lastTimestamp = timestamp;
+		}
+	}
+
+	if (lastTimestamp < 0) {
+		return;
+	}
+
+	struct timespec currentTime;
+	portable_clock_gettime_monotonic(&currentTime);
+
+	int64_t hostTime = (I64T(currentTime.tv_sec) * 1000000LL) + I64T(currentTime.tv_nsec / 1000);
+	int64_t offset = hostTime - lastTimestamp;
+
+	if ((!tc.valid) || (lastTimestamp < tc.lastTimestamp)) {
+		// First data, or timestamps went back (device restarted): re-anchor.
+		tc.valid = true;
+		tc.offset = offset;
+		tc.epochMinOffset = offset;
+		tc.epochStart = hostTime;
+	}
+	else {
+		// The smallest offset belongs to the data that reached us fastest,
+		// which is the closest to the true clock offset. Take it right away.
+		if (offset < tc.offset) {
+			tc.offset = offset;
+		}
+
+		if (offset < tc.epochMinOffset) {
+			tc.epochMinOffset = offset;
+		}
+
+		if ((hostTime - tc.epochStart) >= TIME_CORRELATION_EPOCH) {
+			tc.offset = tc.epochMinOffset;
+			tc.epochMinOffset = offset;
+			tc.epochStart = hostTime;
+		}
+	}
+
+	tc.lastTimestamp = lastTimestamp;
+}
+
 static void runModules(caerEventPacketContainer in) {
 	// Run through all modules in order.
 	for (const auto &m : glMainloopData.globalExecution) {
@@ -1401,6 +1489,11 @@ static void runModules(caerEventPacketContainer in) {
 		caerModuleSM(m.get().libraryInfo->functions, m.get().runtimeData, m.get().libraryInfo->memSize,
 			(idx > 0) ? (in) : (nullptr), (m.get().outputs.size() > 0) ? (&out) : (nullptr));
 
+		// Correlate device and host time as data enters the pipeline.
+		if ((out != nullptr) && (m.get().libraryInfo->type == CAER_MODULE_INPUT)) {
+			updateTimeCorrelation(m.get(), out);
+		}
+
 		// Parse possible output container.
 		if (out != nullptr) {
 			caerModuleLog(m.get().runtimeData, CAER_LOG_DEBUG, "Module Output: got %" PRIi32 " packets.",
@@ -2079,6 +2172,19 @@ sshsNode caerMainloopGetModuleNode(int16_t sourceID) {
 	return (moduleData->moduleNode);
 }
 
+bool caerMainloopGetSourceTimeOffset(int16_t sourceID, int64_t *timeOffset) {
+	const ModuleInfo &m = glMainloopData.modules.at(sourceID);
+
+	// Only input modules correlate their timestamps with host time.
+	if ((m.libraryInfo == nullptr) || (m.libraryInfo->type != CAER_MODULE_INPUT) || (!m.timeCorrelation.valid)) {
+		return (false);
+	}
+
+	*timeOffset = m.timeCorrelation.offset;
+
+	return (true);
+}
+
 void caerMainloopResetInputs(int16_t sourceID) {
 	for (auto &m : glMainloopData.globalExecution) {
 		if (m.get().libraryInfo->type == CAER_MODULE_INPUT) {
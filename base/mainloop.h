@@ -30,6 +30,11 @@ sshsNode caerMainloopGetSourceInfo(int16_t sourceID) CAER_SYMBOL_EXPORT;
 void *caerMainloopGetSourceState(int16_t sourceID) CAER_SYMBOL_EXPORT;
 sshsNode caerMainloopGetModuleNode(int16_t sourceID) CAER_SYMBOL_EXPORT;
 
+// Offset in us to add to an input source's 64-bit event timestamps to get host
+// monotonic time, as seen when the data entered the mainloop. Only call from
+// the mainloop thread (module Run/Reset).
+bool caerMainloopGetSourceTimeOffset(int16_t sourceID, int64_t *timeOffset) CAER_SYMBOL_EXPORT;
+
 void caerMainloopResetInputs(int16_t sourceID) CAER_SYMBOL_EXPORT;
 void caerMainloopResetOutputs(int16_t sourceID) CAER_SYMBOL_EXPORT;
 void caerMainloopResetProcessors(int16_t sourceID) CAER_SYMBOL_EXPORT;
@@ -0,0 +1,412 @@
+#include "main.h"
+#include "base/mainloop.h"
+#include "base/module.h"
+
+#include <libcaer/events/polarity.h>
+#include <libcaer/events/frame.h>
+
+#include <math.h>
+
+// Time surface values are kept relative to a reference time, and rebased
+// (decayed) whenever a new event lies this many decay constants past it.
+#define ACCUMULATOR_TIME_SURFACE_REBASE 32
+
+enum accumulator_representation {
+	ACCUMULATOR_HISTOGRAM, ACCUMULATOR_TIME_SURFACE,
+};
+
+enum accumulator_trigger {
+	ACCUMULATOR_TRIGGER_PACKET, ACCUMULATOR_TRIGGER_EVENT_COUNT, ACCUMULATOR_TRIGGER_TIME_WINDOW,
+};
+
+/**
+ * Accumulates polarity events into grayscale frames, with the middle gray
+ * value (32768) meaning no activity:
+ * - histogram: signed event count per pixel (ON +1, OFF -1) since the last
+ *   frame, histogramRange events map to full white/black.
+ * - time surface: exponentially decaying value of the last event per pixel,
+ *   signed by its polarity, with decay constant timeSurfaceDecay.
+ * Frames are emitted once per input packet, every sliceEvents events, or every
+ * sliceTime µs of event time.
+ *
+ * Events are scattered into preallocated per-pixel buffers. All work on whole
+ * buffers (conversion to pixels, clearing, decay) is done in simple dense
+ * loops, that the compiler vectorizes.
+ * To avoid one exponential per pixel, the time surface stores each event's
+ * value relative to a common reference time (exp((ts - ref) / tau)), so that
+ * decaying the whole surface to a later time is one multiplication per pixel.
+ */
+struct Accumulator_state {
+	int16_t sizeX;
+	int16_t sizeY;
+	size_t pixelsNumber;
+	enum accumulator_representation representation;
+	enum accumulator_trigger trigger;
+	int32_t histogramRange;
+	float timeSurfaceDecay;
+	int32_t sliceEvents;
+	int32_t sliceTime;
+	int32_t *histogram;
+	float *timeSurface;
+	int64_t timeSurfaceReference;
+	int64_t sliceStart;
+	int32_t sliceEventsNumber;
+};
+
+typedef struct Accumulator_state *AccumulatorState;
+
+static void caerAccumulatorConfigInit(sshsNode moduleNode);
+static bool caerAccumulatorInit(caerModuleData moduleData);
+static void caerAccumulatorRun(caerModuleData moduleData, caerEventPacketContainer in, caerEventPacketContainer *out);
+static void caerAccumulatorConfig(caerModuleData moduleData);
+static void caerAccumulatorExit(caerModuleData moduleData);
+static void caerAccumulatorReset(caerModuleData moduleData, int16_t resetCallSourceID);
+static void timeSurfaceDecayTo(AccumulatorState state, int64_t timestamp);
+static caerFrameEventPacket frameEmit(caerModuleData moduleData, caerFrameEventPacket frames, int32_t *framesNumber,
+	int32_t tsOverflow, int64_t timestamp);
+static void accumulatorClear(AccumulatorState state);
+
+static const struct caer_module_functions AccumulatorFunctions = { .moduleConfigInit = &caerAccumulatorConfigInit,
+	.moduleInit = &caerAccumulatorInit, .moduleRun = &caerAccumulatorRun, .moduleConfig = &caerAccumulatorConfig,
+	.moduleExit = &caerAccumulatorExit, .moduleReset = &caerAccumulatorReset };
+
+static const struct caer_event_stream_in AccumulatorInputs[] = { { .type = POLARITY_EVENT, .number = 1, .readOnly =
+	true } };
+
+static const struct caer_event_stream_out AccumulatorOutputs[] = { { .type = FRAME_EVENT } };
+
+static const struct caer_module_info AccumulatorInfo = { .version = 1, .name = "Accumulator", .description =
+	"Accumulates polarity events into frames (event histograms or time surfaces).", .type = CAER_MODULE_PROCESSOR,
+	.memSize = sizeof(struct Accumulator_state), .functions = &AccumulatorFunctions, .inputStreams = AccumulatorInputs,
+	.inputStreamsSize = CAER_EVENT_STREAM_IN_SIZE(AccumulatorInputs), .outputStreams = AccumulatorOutputs,
+	.outputStreamsSize = CAER_EVENT_STREAM_OUT_SIZE(AccumulatorOutputs), };
+
+caerModuleInfo caerModuleGetInfo(void) {
+	return (&AccumulatorInfo);
+}
+
+static void caerAccumulatorConfigInit(sshsNode moduleNode) {
+	sshsNodeCreateString(moduleNode, "representation", "histogram", 9, 11, SSHS_FLAGS_NORMAL,
+		"How to represent events in frames: signed event-count histogram or exponentially decaying time surface.");
+	sshsNodeCreateAttributeListOptions(moduleNode, "representation", SSHS_STRING, "histogram,timeSurface", false);
+	sshsNodeCreateString(moduleNode, "trigger", "packet", 6, 10, SSHS_FLAGS_NORMAL,
+		"When to emit a frame: for every input packet, every sliceEvents events or every sliceTime µs.");
+	sshsNodeCreateAttributeListOptions(moduleNode, "trigger", SSHS_STRING, "packet,eventCount,timeWindow", false);
+	sshsNodeCreateInt(moduleNode, "histogramRange", 5, 1, 32767, SSHS_FLAGS_NORMAL,
+		"Histogram: number of events at a pixel that maps to full white (ON) or black (OFF).");
+	sshsNodeCreateInt(moduleNode, "timeSurfaceDecay", 30000, 1, 10000000, SSHS_FLAGS_NORMAL,
+		"Time surface: exponential decay time constant in µs.");
+	sshsNodeCreateInt(moduleNode, "sliceEvents", 10000, 1, INT32_MAX, SSHS_FLAGS_NORMAL,
+		"Emit a frame every this many events (eventCount trigger).");
+	sshsNodeCreateInt(moduleNode, "sliceTime", 33333, 1, INT32_MAX, SSHS_FLAGS_NORMAL,
+		"Emit a frame every this many µs (timeWindow trigger).");
+}
+
+static bool caerAccumulatorInit(caerModuleData moduleData) {
+	// Wait for input to be ready. All inputs, once they are up and running, will
+	// have a valid sourceInfo node to query, especially if dealing with data.
+	int16_t *inputs = caerMainloopGetModuleInputIDs(moduleData->moduleID, NULL);
+	if (inputs == NULL) {
+		return (false);
+	}
+
+	int16_t sourceID = inputs[0];
+	free(inputs);
+
+	AccumulatorState state = moduleData->moduleState;
+
+	// Allocate buffers using info from sourceInfo.
+	sshsNode sourceInfoSource = caerMainloopGetSourceInfo(sourceID);
+	if (sourceInfoSource == NULL) {
+		return (false);
+	}
+
+	state->sizeX = sshsNodeGetShort(sourceInfoSource, "polaritySizeX");
+	state->sizeY = sshsNodeGetShort(sourceInfoSource, "polaritySizeY");
+	state->pixelsNumber = (size_t) state->sizeX * (size_t) state->sizeY;
+
+	state->histogram = calloc(state->pixelsNumber, sizeof(int32_t));
+	if (state->histogram == NULL) {
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for histogram.");
+		return (false);
+	}
+
+	state->timeSurface = calloc(state->pixelsNumber, sizeof(float));
+	if (state->timeSurface == NULL) {
+		free(state->histogram);
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for timeSurface.");
+		return (false);
+	}
+
+	sshsNode sourceInfoNode = sshsGetRelativeNode(moduleData->moduleNode, "sourceInfo/");
+	sshsNodeCreateShort(sourceInfoNode, "frameSizeX", state->sizeX, 1, INT16_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Output frame width.");
+	sshsNodeCreateShort(sourceInfoNode, "frameSizeY", state->sizeY, 1, INT16_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Output frame height.");
+	sshsNodeCreateShort(sourceInfoNode, "dataSizeX", state->sizeX, 1, INT16_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Output data width.");
+	sshsNodeCreateShort(sourceInfoNode, "dataSizeY", state->sizeY, 1, INT16_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Output data height.");
+
+	// Initialize configuration.
+	caerAccumulatorConfig(moduleData);
+
+	// Add config listeners last, to avoid having them dangling if Init doesn't succeed.
+	sshsNodeAddAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
+
+	// Nothing that can fail here.
+	return (true);
+}
+
+static void caerAccumulatorRun(caerModuleData moduleData, caerEventPacketContainer in, caerEventPacketContainer *out) {
+	caerPolarityEventPacketConst polarity =
+		(caerPolarityEventPacketConst) caerEventPacketContainerFindEventPacketByTypeConst(in, POLARITY_EVENT);
+
+	// Only process packets with content.
+	if (polarity == NULL) {
+		return;
+	}
+
+	AccumulatorState state = moduleData->moduleState;
+
+	int32_t tsOverflow = caerEventPacketHeaderGetEventTSOverflow(&polarity->packetHeader);
+	int16_t sizeX = state->sizeX;
+	float timeSurfaceRebase = state->timeSurfaceDecay * ACCUMULATOR_TIME_SURFACE_REBASE;
+
+	caerFrameEventPacket frames = NULL;
+	int32_t framesNumber = 0;
+	int64_t lastTimestamp = -1;
+
+	CAER_POLARITY_CONST_ITERATOR_VALID_START(polarity)
+		int64_t timestamp = caerPolarityEventGetTimestamp64(caerPolarityIteratorElement, polarity);
+
+		if (state->sliceStart < 0) {
+			state->sliceStart = timestamp;
+		}
+
+		// Time window: emit frame for the window that just ended, skip empty ones.
+		if (state->trigger == ACCUMULATOR_TRIGGER_TIME_WINDOW && (timestamp - state->sliceStart) >= state->sliceTime) {
+			int64_t sliceEnd = state->sliceStart + state->sliceTime;
+
+			frames = frameEmit(moduleData, frames, &framesNumber, tsOverflow, sliceEnd);
+
+			state->sliceStart = sliceEnd + (((timestamp - sliceEnd) / state->sliceTime) * state->sliceTime);
+		}
+
+		size_t pixel = ((size_t) caerPolarityEventGetY(caerPolarityIteratorElement) * (size_t) sizeX)
+			+ caerPolarityEventGetX(caerPolarityIteratorElement);
+		bool polarityON = caerPolarityEventGetPolarity(caerPolarityIteratorElement);
+
+		if (state->representation == ACCUMULATOR_HISTOGRAM) {
+			state->histogram[pixel] += (polarityON) ? (1) : (-1);
+		}
+		else {
+			float timeDifference = (float) (timestamp - state->timeSurfaceReference);
+
+			if (timeDifference > timeSurfaceRebase) {
+				timeSurfaceDecayTo(state, timestamp);
+				timeDifference = 0;
+			}
+
+			float value = expf(timeDifference / state->timeSurfaceDecay);
+
+			state->timeSurface[pixel] = (polarityON) ? (value) : (-value);
+		}
+
+		lastTimestamp = timestamp;
+
+		if (state->trigger == ACCUMULATOR_TRIGGER_EVENT_COUNT && ++state->sliceEventsNumber >= state->sliceEvents) {
+			frames = frameEmit(moduleData, frames, &framesNumber, tsOverflow, timestamp);
+
+			state->sliceEventsNumber = 0;
+			state->sliceStart = -1;
+		}
+	CAER_POLARITY_ITERATOR_VALID_END
+
+	if (state->trigger == ACCUMULATOR_TRIGGER_PACKET && lastTimestamp >= 0) {
+		frames = frameEmit(moduleData, frames, &framesNumber, tsOverflow, lastTimestamp);
+
+		state->sliceStart = -1;
+	}
+
+	// If something did happen, make a packet container and return the result.
+	// Also remember to put this new container up for freeing at loop end.
+	if (frames != NULL) {
+		*out = caerEventPacketContainerAllocate(1);
+		if (*out == NULL) {
+			free(frames);
+			return;
+		}
+
+		caerEventPacketContainerSetEventPacket(*out, 0, (caerEventPacketHeader) frames);
+	}
+}
+
+/**
+ * Decay the whole time surface to the given time, making it the new reference.
+ */
+static void timeSurfaceDecayTo(AccumulatorState state, int64_t timestamp) {
+	float decay = expf(-(float) (timestamp - state->timeSurfaceReference) / state->timeSurfaceDecay);
+	float *timeSurface = state->timeSurface;
+
+	for (size_t i = 0; i < state->pixelsNumber; i++) {
+		timeSurface[i] *= decay;
+	}
+
+	state->timeSurfaceReference = timestamp;
+}
+
+/**
+ * Add a frame covering the current slice up to the given time to the frames
+ * packet, allocating or growing it as needed, and start a new slice.
+ * Returns the (possibly moved) frames packet.
+ */
+static caerFrameEventPacket frameEmit(caerModuleData moduleData, caerFrameEventPacket frames, int32_t *framesNumber,
+	int32_t tsOverflow, int64_t timestamp) {
+	AccumulatorState state = moduleData->moduleState;
+
+	if (frames == NULL) {
+		frames = caerFrameEventPacketAllocate(1, moduleData->moduleID, tsOverflow, state->sizeX, state->sizeY,
+			GRAYSCALE);
+		if (frames == NULL) {
+			caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate frame packet.");
+			return (NULL);
+		}
+	}
+	else if (*framesNumber == caerEventPacketHeaderGetEventCapacity(&frames->packetHeader)) {
+		caerFrameEventPacket grownFrames = (caerFrameEventPacket) caerEventPacketGrow(
+			(caerEventPacketHeader) frames, 2 * (*framesNumber));
+		if (grownFrames == NULL) {
+			caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to grow frame packet, frame dropped.");
+			return (frames);
+		}
+
+		frames = grownFrames;
+	}
+
+	caerFrameEvent frame = caerFrameEventPacketGetEvent(frames, *framesNumber);
+	uint16_t *pixels = caerFrameEventGetPixelArrayUnsafe(frame);
+
+	// Frame timestamps are relative to the packet's overflow, like the events.
+	int64_t overflowStart = I64T(tsOverflow) << TS_OVERFLOW_SHIFT;
+	int64_t sliceStart = (state->sliceStart > overflowStart) ? (state->sliceStart) : (overflowStart);
+
+	caerFrameEventSetLengthXLengthYChannelNumber(frame, state->sizeX, state->sizeY, GRAYSCALE, frames);
+	caerFrameEventSetTSStartOfFrame(frame, I32T(sliceStart - overflowStart));
+	caerFrameEventSetTSStartOfExposure(frame, I32T(sliceStart - overflowStart));
+	caerFrameEventSetTSEndOfExposure(frame, I32T(timestamp - overflowStart));
+	caerFrameEventSetTSEndOfFrame(frame, I32T(timestamp - overflowStart));
+
+	if (state->representation == ACCUMULATOR_HISTOGRAM) {
+		const int32_t *histogram = state->histogram;
+		int32_t range = state->histogramRange;
+		int32_t scale = 32767 / range;
+
+		for (size_t i = 0; i < state->pixelsNumber; i++) {
+			// Saturate the count before scaling, so large counts can't overflow.
+			int32_t value = histogram[i];
+
+			value = (value > range) ? (range) : (value);
+			value = (value < -range) ? (-range) : (value);
+
+			pixels[i] = U16T((value * scale) + 32768);
+		}
+
+		// Histograms count events since the last frame.
+		memset(state->histogram, 0, state->pixelsNumber * sizeof(int32_t));
+	}
+	else {
+		timeSurfaceDecayTo(state, timestamp);
+
+		const float *timeSurface = state->timeSurface;
+
+		for (size_t i = 0; i < state->pixelsNumber; i++) {
+			int32_t value = (int32_t) (timeSurface[i] * 32767.0f);
+
+			value = (value > 32767) ? (32767) : (value);
+			value = (value < -32767) ? (-32767) : (value);
+
+			pixels[i] = U16T(value + 32768);
+		}
+	}
+
+	caerFrameEventValidate(frame, frames);
+
+	(*framesNumber)++;
+
+	state->sliceStart = timestamp;
+
+	return (frames);
+}
+
+static void accumulatorClear(AccumulatorState state) {
+	memset(state->histogram, 0, state->pixelsNumber * sizeof(int32_t));
+	memset(state->timeSurface, 0, state->pixelsNumber * sizeof(float));
+	state->timeSurfaceReference = 0;
+	state->sliceStart = -1;
+	state->sliceEventsNumber = 0;
+}
+
+static void caerAccumulatorConfig(caerModuleData moduleData) {
+	caerModuleConfigUpdateReset(moduleData);
+
+	AccumulatorState state = moduleData->moduleState;
+
+	char *representation = sshsNodeGetString(moduleData->moduleNode, "representation");
+
+	if (caerStrEquals(representation, "timeSurface")) {
+		state->representation = ACCUMULATOR_TIME_SURFACE;
+	}
+	else {
+		state->representation = ACCUMULATOR_HISTOGRAM;
+	}
+
+	free(representation);
+
+	char *trigger = sshsNodeGetString(moduleData->moduleNode, "trigger");
+
+	if (caerStrEquals(trigger, "eventCount")) {
+		state->trigger = ACCUMULATOR_TRIGGER_EVENT_COUNT;
+	}
+	else if (caerStrEquals(trigger, "timeWindow")) {
+		state->trigger = ACCUMULATOR_TRIGGER_TIME_WINDOW;
+	}
+	else {
+		state->trigger = ACCUMULATOR_TRIGGER_PACKET;
+	}
+
+	free(trigger);
+
+	state->histogramRange = sshsNodeGetInt(moduleData->moduleNode, "histogramRange");
+	int32_t timeSurfaceDecay = sshsNodeGetInt(moduleData->moduleNode, "timeSurfaceDecay");
+	state->timeSurfaceDecay = (float) timeSurfaceDecay;
+	state->sliceEvents = sshsNodeGetInt(moduleData->moduleNode, "sliceEvents");
+	state->sliceTime = sshsNodeGetInt(moduleData->moduleNode, "sliceTime");
+
+	// Start from scratch with the new settings.
+	accumulatorClear(state);
+}
+
+static void caerAccumulatorExit(caerModuleData moduleData) {
+	// Remove listener, which can reference invalid memory in userData.
+	sshsNodeRemoveAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
+
+	AccumulatorState state = moduleData->moduleState;
+
+	// Ensure buffers are freed.
+	free(state->histogram);
+	free(state->timeSurface);
+
+	sshsNode sourceInfoNode = sshsGetRelativeNode(moduleData->moduleNode, "sourceInfo/");
+	sshsNodeClearSubTree(sourceInfoNode, true);
+}
+
+static void caerAccumulatorReset(caerModuleData moduleData, int16_t resetCallSourceID) {
+	UNUSED_ARGUMENT(resetCallSourceID);
+
+	AccumulatorState state = moduleData->moduleState;
+
+	// Timestamps start over, so does accumulation.
+	accumulatorClear(state);
+}
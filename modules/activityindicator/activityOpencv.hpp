@@ -23,7 +23,8 @@ class OpenCV {
 private:
 
 public:
-	void generate(activityLevel status, int activeNum, caerFrameEvent *single_frame, int sizeX, int sizeY, bool showEvents);
+	void generate(activityLevel status, int activeNum, uint8_t *canvas, caerFrameEvent frame, int sizeX, int sizeY,
+		bool showEvents);
 };
 
 #endif
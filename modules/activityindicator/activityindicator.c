@@ -8,283 +8,324 @@
 #include "activityindicator.h"
 #include "base/mainloop.h"
 #include "base/module.h"
-#include "ext/buffers.h"
-#include "math.h"
 #include "wrapper.h"
 
+#include <libcaer/events/polarity.h>
+#include <libcaer/events/frame.h>
+
+/**
+ * Activity is measured over consecutive windows of measuringTime µs: a pixel
+ * is active if it gets more than activeThreshold events in a window, and the
+ * number of active pixels decides the activity level.
+ *
+ * Per-pixel counts live in a flat row-major array, together with the index of
+ * the window they belong to. Counts from an older window are stale and get
+ * restarted on the next event at that pixel, so closing a window is O(1) and
+ * the active-pixel count is kept up to date as events arrive.
+ */
+struct AI_pixel {
+	uint32_t window;
+	uint32_t count;
+};
 
 struct AI_state {
-	int64_t LastUpdateTime;
-	int measuringTime ;
+	int16_t sizeX;
+	int16_t sizeY;
+	size_t pixelsNumber;
+	int measuringTime;
 	int activeThreshold;
 	int low;
 	int median;
 	int high;
+	int renderInterval;
+	bool showEvents;
+	struct AI_pixel *pixels;
+	uint32_t window;
+	int64_t windowStart;
+	int windowActiveNum;
 	int activeNum;
 	activityLevel areaActivity;
-	simple2DBufferLong spikeCountMap;
-	simple2DBufferInt activeCountMap;
+	// Events since the last rendered frame, 8-bit row-major, RGB if showEvents.
+	uint8_t *canvas;
+	int64_t renderStart;
 	struct OpenCV* cpp_class;
-	bool showEvents;
+	sshsNode statusNode;
 };
 
 typedef struct AI_state *AIState;
 
-int64_t maxLastTime = 0;
-
+static void caerActivityIndicatorConfigInit(sshsNode moduleNode);
 static bool caerActivityIndicatorInit(caerModuleData moduleData);
-static void caerActivityIndicatorRun(caerModuleData moduleData, size_t argsNumber, va_list args);
+static void caerActivityIndicatorRun(caerModuleData moduleData, caerEventPacketContainer in,
+	caerEventPacketContainer *out);
 static void caerActivityIndicatorConfig(caerModuleData moduleData);
 static void caerActivityIndicatorExit(caerModuleData moduleData);
-static void caerActivityIndicatorReset(caerModuleData moduleData, uint16_t resetCallSourceID);
-static bool allocateSpikeCountMap(AIState state, int16_t sourceID);
-static bool allocateActiveCountMap(AIState state, int16_t sourceID);
+static void caerActivityIndicatorReset(caerModuleData moduleData, int16_t resetCallSourceID);
+static void windowClose(AIState state);
+static caerFrameEventPacket frameRender(caerModuleData moduleData, int32_t tsOverflow, int64_t timestamp);
+static void activityClear(AIState state);
+
+static const struct caer_module_functions ActivityIndicatorFunctions = { .moduleConfigInit =
+	&caerActivityIndicatorConfigInit, .moduleInit = &caerActivityIndicatorInit, .moduleRun = &caerActivityIndicatorRun,
+	.moduleConfig = &caerActivityIndicatorConfig, .moduleExit = &caerActivityIndicatorExit, .moduleReset =
+		&caerActivityIndicatorReset };
+
+static const struct caer_event_stream_in ActivityIndicatorInputs[] = { { .type = POLARITY_EVENT, .number = 1,
+	.readOnly = true } };
+
+static const struct caer_event_stream_out ActivityIndicatorOutputs[] = { { .type = FRAME_EVENT } };
+
+static const struct caer_module_info ActivityIndicatorInfo = { .version = 1, .name = "ActivityIndicator",
+	.description = "Classifies scene activity by the number of active pixels.", .type = CAER_MODULE_PROCESSOR,
+	.memSize = sizeof(struct AI_state), .functions = &ActivityIndicatorFunctions, .inputStreams =
+		ActivityIndicatorInputs, .inputStreamsSize = CAER_EVENT_STREAM_IN_SIZE(ActivityIndicatorInputs),
+	.outputStreams = ActivityIndicatorOutputs, .outputStreamsSize = CAER_EVENT_STREAM_OUT_SIZE(
+		ActivityIndicatorOutputs), };
+
+caerModuleInfo caerModuleGetInfo(void) {
+	return (&ActivityIndicatorInfo);
+}
 
-static struct caer_module_functions caerActivityIndicatorFunctions = { .moduleInit = &caerActivityIndicatorInit, .moduleRun = &caerActivityIndicatorRun, .moduleConfig = &caerActivityIndicatorConfig, .moduleExit = &caerActivityIndicatorExit, .moduleReset = &caerActivityIndicatorReset };
+static char activityLevelNames[][9] = { "Very low", "Low", "Median", "High" };
+
+static void caerActivityIndicatorConfigInit(sshsNode moduleNode) {
+	sshsNodeCreateInt(moduleNode, "measuringTime", 500000, 1, INT32_MAX, SSHS_FLAGS_NORMAL,
+		"Length of an activity measurement window, in µs.");
+	sshsNodeCreateInt(moduleNode, "activeThreshold", 20, 0, INT32_MAX, SSHS_FLAGS_NORMAL,
+		"A pixel is active if it gets more than this many events in a window.");
+	sshsNodeCreateInt(moduleNode, "low", 100, 0, INT32_MAX, SSHS_FLAGS_NORMAL,
+		"Active pixels at or above which activity is low (below is very low).");
+	sshsNodeCreateInt(moduleNode, "median", 1000, 0, INT32_MAX, SSHS_FLAGS_NORMAL,
+		"Active pixels at or above which activity is median.");
+	sshsNodeCreateInt(moduleNode, "high", 4000, 0, INT32_MAX, SSHS_FLAGS_NORMAL,
+		"Active pixels at or above which activity is high.");
+	sshsNodeCreateInt(moduleNode, "renderInterval", 33333, 1, INT32_MAX, SSHS_FLAGS_NORMAL,
+		"Emit an output frame every this many µs.");
+	sshsNodeCreateBool(moduleNode, "showEvents", true, SSHS_FLAGS_NORMAL,
+		"Draw the events since the last frame under the activity level.");
+}
+
+static bool caerActivityIndicatorInit(caerModuleData moduleData) {
+	// Wait for input to be ready. All inputs, once they are up and running, will
+	// have a valid sourceInfo node to query, especially if dealing with data.
+	int16_t *inputs = caerMainloopGetModuleInputIDs(moduleData->moduleID, NULL);
+	if (inputs == NULL) {
+		return (false);
+	}
 
-AResults caerActivityIndicator(uint16_t moduleID, caerPolarityEventPacket polarity, caerFrameEventPacket frame) {
+	int16_t sourceID = inputs[0];
+	free(inputs);
 
-	AResults number = malloc(sizeof(struct activity_results));
-	caerMainloopFreeAfterLoop(&free, number);
-	number->activityValue = -1;
-	strcpy(number->stringValue,"");
+	AIState state = moduleData->moduleState;
 
-	caerModuleData moduleData = caerMainloopFindModule(moduleID, "ActivityIndicator", CAER_MODULE_PROCESSOR);
-	if (moduleData == NULL) {
-		return(number);
+	// Allocate maps using info from sourceInfo.
+	sshsNode sourceInfoSource = caerMainloopGetSourceInfo(sourceID);
+	if (sourceInfoSource == NULL) {
+		return (false);
 	}
-	caerModuleSM(&caerActivityIndicatorFunctions, moduleData, sizeof(struct AI_state), 3, polarity, frame, number);
 
-	return(number);
-}
+	state->sizeX = sshsNodeGetShort(sourceInfoSource, "polaritySizeX");
+	state->sizeY = sshsNodeGetShort(sourceInfoSource, "polaritySizeY");
+	state->pixelsNumber = (size_t) state->sizeX * (size_t) state->sizeY;
 
-static bool caerActivityIndicatorInit(caerModuleData moduleData) {
-	sshsNodePutIntIfAbsent(moduleData->moduleNode, "measuringTime", 500000);
-	sshsNodePutIntIfAbsent(moduleData->moduleNode, "activeThreshold", 20);
-	sshsNodePutIntIfAbsent(moduleData->moduleNode, "low", 100);
-	sshsNodePutIntIfAbsent(moduleData->moduleNode, "median", 1000);
-	sshsNodePutIntIfAbsent(moduleData->moduleNode, "high", 4000);
-	sshsNodePutBoolIfAbsent(moduleData->moduleNode, "showEvents", true);
+	state->pixels = calloc(state->pixelsNumber, sizeof(struct AI_pixel));
+	if (state->pixels == NULL) {
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for pixel counts.");
+		return (false);
+	}
 
-	AIState state = moduleData->moduleState;
+	// Always sized for RGB, showEvents can change at runtime.
+	state->canvas = calloc(state->pixelsNumber * RGB, sizeof(uint8_t));
+	if (state->canvas == NULL) {
+		free(state->pixels);
 
-	state->measuringTime = sshsNodeGetInt(moduleData->moduleNode, "measuringTime");
-	state->activeThreshold = sshsNodeGetInt(moduleData->moduleNode, "activeThreshold");
-	state->low = sshsNodeGetInt(moduleData->moduleNode, "low");
-	state->median = sshsNodeGetInt(moduleData->moduleNode, "median");
-	state->high = sshsNodeGetInt(moduleData->moduleNode, "high");
-	state->showEvents = sshsNodeGetBool(moduleData->moduleNode, "showEvents");
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for canvas.");
+		return (false);
+	}
 
-	state->LastUpdateTime = 0;
-	state->activeNum = 0;
 	state->cpp_class = newOpenCV();
 
+	sshsNode sourceInfoNode = sshsGetRelativeNode(moduleData->moduleNode, "sourceInfo/");
+	sshsNodeCreateShort(sourceInfoNode, "frameSizeX", state->sizeX, 1, INT16_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Output frame width.");
+	sshsNodeCreateShort(sourceInfoNode, "frameSizeY", state->sizeY, 1, INT16_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Output frame height.");
+	sshsNodeCreateShort(sourceInfoNode, "dataSizeX", state->sizeX, 1, INT16_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Output data width.");
+	sshsNodeCreateShort(sourceInfoNode, "dataSizeY", state->sizeY, 1, INT16_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Output data height.");
+
+	// Result of the last completed window.
+	state->statusNode = sshsGetRelativeNode(moduleData->moduleNode, "status/");
+
+	sshsNodeCreateInt(state->statusNode, "activeNum", 0, 0, INT32_MAX, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Number of active pixels in the last window.");
+	sshsNodeCreateAttributePollTime(state->statusNode, "activeNum", SSHS_INT, 1);
+	sshsNodeCreateString(state->statusNode, "activityLevel", activityLevelNames[Verylow], 0, 32,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Activity level of the last window.");
+	sshsNodeCreateAttributePollTime(state->statusNode, "activityLevel", SSHS_STRING, 1);
+
+	// Initialize configuration.
+	caerActivityIndicatorConfig(moduleData);
+
 	// Add config listeners last, to avoid having them dangling if Init doesn't succeed.
 	sshsNodeAddAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
 
 	// Nothing that can fail here.
 	return (true);
 }
-static void caerActivityIndicatorRun(caerModuleData moduleData, size_t argsNumber, va_list args) {
-	UNUSED_ARGUMENT(argsNumber);
 
-	caerPolarityEventPacket polarity = va_arg(args, caerPolarityEventPacket);
-	caerFrameEventPacket *frame = va_arg(args, caerFrameEventPacket*);
-	AResults results = va_arg(args, AResults);
+static void caerActivityIndicatorRun(caerModuleData moduleData, caerEventPacketContainer in,
+	caerEventPacketContainer *out) {
+	caerPolarityEventPacketConst polarity =
+		(caerPolarityEventPacketConst) caerEventPacketContainerFindEventPacketByTypeConst(in, POLARITY_EVENT);
 
-	//Only process packets with content.
+	// Only process packets with content.
 	if (polarity == NULL) {
 		return;
 	}
 
 	AIState state = moduleData->moduleState;
 
-	int16_t sourceID = caerEventPacketHeaderGetEventSource(&polarity->packetHeader);
-	sshsNode sourceInfoNodeCA = caerMainloopGetSourceInfo((uint16_t)sourceID);
-	sshsNode sourceInfoNode = sshsGetRelativeNode(moduleData->moduleNode, "sourceInfo/");
-	if (!sshsNodeAttributeExists(sourceInfoNode, "dataSizeX", SSHS_SHORT)) {
-		sshsNodePutShort(sourceInfoNode, "dataSizeX", sshsNodeGetShort(sourceInfoNodeCA, "dvsSizeX"));
-		sshsNodePutShort(sourceInfoNode, "dataSizeY", sshsNodeGetShort(sourceInfoNodeCA, "dvsSizeY"));
-	}
-	int16_t sizeX = sshsNodeGetShort(sourceInfoNode, "dataSizeX");
-	int16_t sizeY = sshsNodeGetShort(sourceInfoNode, "dataSizeY");
-
-	// If the map is not allocated yet, do it.
-	if (state->spikeCountMap == NULL) {
-		if (!allocateSpikeCountMap(state, caerEventPacketHeaderGetEventSource(&polarity->packetHeader))) {
-			// Failed to allocate memory, nothing to do.
-			caerLog(CAER_LOG_ERROR, moduleData->moduleSubSystemString, "Failed to allocate memory for spikeCountMap.");
-			return;
+	int16_t sizeX = state->sizeX;
+	uint32_t activeCount = U32T(state->activeThreshold) + 1;
+	int64_t lastTimestamp = -1;
+
+	CAER_POLARITY_CONST_ITERATOR_VALID_START(polarity)
+		int64_t timestamp = caerPolarityEventGetTimestamp64(caerPolarityIteratorElement, polarity);
+
+		if (state->windowStart < 0) {
+			state->windowStart = timestamp;
+			state->renderStart = timestamp;
 		}
-	}
-	if (state->activeCountMap == NULL) {
-		if (!allocateActiveCountMap(state, caerEventPacketHeaderGetEventSource(&polarity->packetHeader))) {
-			// Failed to allocate memory, nothing to do.
-			caerLog(CAER_LOG_ERROR, moduleData->moduleSubSystemString, "Failed to allocate memory for activeCountMap.");
-			return;
+
+		if ((timestamp - state->windowStart) > state->measuringTime) {
+			windowClose(state);
+
+			state->windowStart = timestamp;
+		}
+
+		size_t pixelIndex = ((size_t) caerPolarityEventGetY(caerPolarityIteratorElement) * (size_t) sizeX)
+			+ caerPolarityEventGetX(caerPolarityIteratorElement);
+		struct AI_pixel *pixel = &state->pixels[pixelIndex];
+
+		// Count left over from an older window, start over.
+		if (pixel->window != state->window) {
+			pixel->window = state->window;
+			pixel->count = 0;
+		}
+
+		// Count a pixel only once, when it crosses the threshold.
+		if (++pixel->count == activeCount) {
+			state->windowActiveNum++;
 		}
-	}
 
-	// reset last time of one packet
-	maxLastTime = 0;
+		if (state->showEvents) {
+			uint8_t *color = &state->canvas[pixelIndex * RGB];
+			bool polarityON = caerPolarityEventGetPolarity(caerPolarityIteratorElement);
 
-	//Iterate over events
-	CAER_POLARITY_ITERATOR_VALID_START(polarity)
+			color[0] = (polarityON) ? (0) : (UINT8_MAX); // red
+			color[1] = (polarityON) ? (UINT8_MAX) : (0); // green
+			color[2] = 0; // blue
+		}
 
-	// Get values on which to operate.
-	int64_t ts = caerPolarityEventGetTimestamp64(caerPolarityIteratorElement, polarity);
-	uint16_t x = caerPolarityEventGetX(caerPolarityIteratorElement);
-	uint16_t y = caerPolarityEventGetY(caerPolarityIteratorElement);
+		lastTimestamp = timestamp;
+	CAER_POLARITY_ITERATOR_VALID_END
 
-	if ((caerPolarityIteratorElement == NULL)){
-		continue;
+	// Render on its own cadence, independent of packet and window sizes.
+	if ((lastTimestamp < 0) || ((lastTimestamp - state->renderStart) < state->renderInterval)) {
+		return;
 	}
-	if ((x > sizeX) || (y > sizeY)) {
-		continue;
+
+	caerFrameEventPacket frame = frameRender(moduleData,
+		caerEventPacketHeaderGetEventTSOverflow(&polarity->packetHeader), lastTimestamp);
+	if (frame == NULL) {
+		return;
 	}
-	if (maxLastTime < caerPolarityEventGetTimestamp64(caerPolarityIteratorElement, polarity)){
-		maxLastTime = caerPolarityEventGetTimestamp64(caerPolarityIteratorElement, polarity);
+
+	*out = caerEventPacketContainerAllocate(1);
+	if (*out == NULL) {
+		free(frame);
+		return;
 	}
 
-	state->spikeCountMap->buffer2d[x][y] += 1;
+	caerEventPacketContainerSetEventPacket(*out, 0, (caerEventPacketHeader) frame);
+}
 
-	CAER_POLARITY_ITERATOR_VALID_END
+static void windowClose(AIState state) {
+	state->activeNum = state->windowActiveNum;
+	state->windowActiveNum = 0;
 
-	// check time to update status
-	if ((maxLastTime - state->LastUpdateTime) > state->measuringTime){
-		// reset active number
-		state->activeNum = 0;
-		//checkThreshold and updateActivity
-		for (size_t x = 0; x < sizeX; x++) {
-			for (size_t y = 0; y < sizeY; y++) {
-				if (state->spikeCountMap->buffer2d[x][y] > state->activeThreshold) {
-					state->activeCountMap->buffer2d[x][y] = 1;
-					state->activeNum++;
-				}
-				else{
-					state->activeCountMap->buffer2d[x][y] = 0;
-				}
-				//reset spike count map
-				state->spikeCountMap->buffer2d[x][y] = 0;
-			}
-		}
-		state->LastUpdateTime = maxLastTime;
+	// Invalidates all per-pixel counts at once.
+	state->window++;
 
-		if (state->activeNum < state->low){
-			state->areaActivity = Verylow;
-			//caerLog(CAER_LOG_NOTICE, __func__, "   Very low, activeNum: %d", state->activeNum);
-			strcpy(results->stringValue, "Very low");
-		}
-		else if (state->activeNum < state->median){
-			state->areaActivity = low;
-			//caerLog(CAER_LOG_NOTICE, __func__, "  Low, activeNum: %d", state->activeNum);
-			strcpy(results->stringValue, "Low");
-		}
-		else if (state->activeNum < state->high){
-			state->areaActivity = median;
-			//caerLog(CAER_LOG_NOTICE, __func__, "   Median, activeNum: %d", state->activeNum);
-			strcpy(results->stringValue, "Median");
-		}
-		else {
-			state->areaActivity = high;
-			//caerLog(CAER_LOG_NOTICE, __func__, "   High, activeNum: %d", state->activeNum);
-			strcpy(results->stringValue, "High");
-		}
-		//printf("real number %d\n", state->activeNum);
-		results->activityValue = state->activeNum;
+	if (state->activeNum < state->low) {
+		state->areaActivity = Verylow;
 	}
-
-	int16_t channelNum = 1;
-	if (state->showEvents){
-		channelNum = 3;
+	else if (state->activeNum < state->median) {
+		state->areaActivity = low;
 	}
-	*frame = caerFrameEventPacketAllocate(1, I16T(moduleData->moduleID), 0, sizeX, sizeY, channelNum);
-	caerMainloopFreeAfterLoop(&free, *frame);
-	if (*frame != NULL) {
-		caerFrameEvent singleplot = caerFrameEventPacketGetEvent(*frame, 0);
-		//add info to the frame
-		caerFrameEventSetLengthXLengthYChannelNumber(singleplot, sizeX, sizeY, channelNum, *frame);
-		if (state->showEvents){
-			CAER_POLARITY_ITERATOR_VALID_START(polarity)
-				int xxx = caerPolarityEventGetX(caerPolarityIteratorElement);
-				int yyy = caerPolarityEventGetY(caerPolarityIteratorElement);
-				int pol = caerPolarityEventGetPolarity(caerPolarityIteratorElement);
-				int address = 3 * (yyy * sizeX + xxx);
-				if (pol == 0) {
-					singleplot->pixels[address] = 65000; // red
-					singleplot->pixels[address + 1] = 1; // green
-					singleplot->pixels[address + 2] = 1; // blue
-				}
-				else {
-					singleplot->pixels[address] = 1; //65000; // red
-					singleplot->pixels[address + 1] = 65000; // green
-					singleplot->pixels[address + 2] = 1; // blue
-				}
-			CAER_POLARITY_ITERATOR_VALID_END
-		}
-		//add OpenCV info to the frame
-		OpenCV_generate(state->cpp_class, state->areaActivity, state->activeNum, &singleplot, sizeX, sizeY, state->showEvents);
-		//validate frame
-		if (singleplot != NULL) {
-			caerFrameEventValidate(singleplot, *frame);
-		}
-		else {
-			*frame = NULL;
-		}
+	else if (state->activeNum < state->high) {
+		state->areaActivity = median;
+	}
+	else {
+		state->areaActivity = high;
 	}
+
+	sshsNodeUpdateReadOnlyAttribute(state->statusNode, "activeNum", SSHS_INT,
+		(union sshs_node_attr_value) { .iint = state->activeNum });
+	sshsNodeUpdateReadOnlyAttribute(state->statusNode, "activityLevel", SSHS_STRING,
+		(union sshs_node_attr_value) { .string = activityLevelNames[state->areaActivity] });
 }
 
+static caerFrameEventPacket frameRender(caerModuleData moduleData, int32_t tsOverflow, int64_t timestamp) {
+	AIState state = moduleData->moduleState;
 
-static bool allocateSpikeCountMap(AIState state, int16_t sourceID) {
-	// Get size information from source.
-	sshsNode sourceInfoNode = caerMainloopGetSourceInfo(U16T(sourceID));
-	if (sourceInfoNode == NULL) {
-		// This should never happen, but we handle it gracefully.
-		caerLog(CAER_LOG_ERROR, __func__, "Failed to get source info to allocate map.");
-		return (false);
+	enum caer_frame_event_color_channels channels = (state->showEvents) ? (RGB) : (GRAYSCALE);
+
+	caerFrameEventPacket frames = caerFrameEventPacketAllocate(1, moduleData->moduleID, tsOverflow, state->sizeX,
+		state->sizeY, channels);
+	if (frames == NULL) {
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate frame packet.");
+		return (NULL);
 	}
 
-	int16_t sizeX = sshsNodeGetShort(sourceInfoNode, "dataSizeX");
-	int16_t sizeY = sshsNodeGetShort(sourceInfoNode, "dataSizeY");
+	caerFrameEvent frame = caerFrameEventPacketGetEvent(frames, 0);
 
-	state->spikeCountMap = simple2DBufferInitLong((size_t) sizeX, (size_t) sizeY);
-	if (state->spikeCountMap == NULL) {
-		return (false);
-	}
+	// Frame timestamps are relative to the packet's overflow, like the events.
+	int64_t overflowStart = I64T(tsOverflow) << TS_OVERFLOW_SHIFT;
+	int64_t renderStart = (state->renderStart > overflowStart) ? (state->renderStart) : (overflowStart);
 
-	for (size_t x = 0; x < sizeX; x++) {
-		for (size_t y = 0; y < sizeY; y++) {
-			state->spikeCountMap->buffer2d[x][y] = 0; // init to zero
-		}
-	}
+	caerFrameEventSetLengthXLengthYChannelNumber(frame, state->sizeX, state->sizeY, channels, frames);
+	caerFrameEventSetTSStartOfFrame(frame, I32T(renderStart - overflowStart));
+	caerFrameEventSetTSStartOfExposure(frame, I32T(renderStart - overflowStart));
+	caerFrameEventSetTSEndOfExposure(frame, I32T(timestamp - overflowStart));
+	caerFrameEventSetTSEndOfFrame(frame, I32T(timestamp - overflowStart));
 
-	return (true);
-}
+	// Add OpenCV info to the frame.
+	OpenCV_generate(state->cpp_class, state->areaActivity, state->activeNum, state->canvas, frame, state->sizeX,
+		state->sizeY, state->showEvents);
 
-static bool allocateActiveCountMap(AIState state, int16_t sourceID) {
-	// Get size information from source.
-	sshsNode sourceInfoNode = caerMainloopGetSourceInfo(U16T(sourceID));
-	if (sourceInfoNode == NULL) {
-		// This should never happen, but we handle it gracefully.
-		caerLog(CAER_LOG_ERROR, __func__, "Failed to get source info to allocate map.");
-		return (false);
-	}
+	caerFrameEventValidate(frame, frames);
 
-	int16_t sizeX = sshsNodeGetShort(sourceInfoNode, "dataSizeX");
-	int16_t sizeY = sshsNodeGetShort(sourceInfoNode, "dataSizeY");
+	// Next frame only shows the events from now on.
+	memset(state->canvas, 0, state->pixelsNumber * (size_t) channels);
+	state->renderStart = timestamp;
 
-	state->activeCountMap = simple2DBufferInitInt((size_t) sizeX, (size_t) sizeY);
-	if (state->activeCountMap == NULL) {
-		return (false);
-	}
+	return (frames);
+}
 
-	for (size_t x = 0; x < sizeX; x++) {
-		for (size_t y = 0; y < sizeY; y++) {
-			state->activeCountMap->buffer2d[x][y] = 0; // init to zero
-		}
-	}
+static void activityClear(AIState state) {
+	memset(state->pixels, 0, state->pixelsNumber * sizeof(struct AI_pixel));
+	memset(state->canvas, 0, state->pixelsNumber * RGB);
 
-	return (true);
+	// Window 0 is what cleared pixels belong to, so start past it.
+	state->window = 1;
+	state->windowStart = -1;
+	state->windowActiveNum = 0;
+	state->activeNum = 0;
+	state->areaActivity = Verylow;
+	state->renderStart = -1;
 }
 
 static void caerActivityIndicatorConfig(caerModuleData moduleData) {
@@ -297,7 +338,11 @@ static void caerActivityIndicatorConfig(caerModuleData moduleData) {
 	state->low = sshsNodeGetInt(moduleData->moduleNode, "low");
 	state->median = sshsNodeGetInt(moduleData->moduleNode, "median");
 	state->high = sshsNodeGetInt(moduleData->moduleNode, "high");
+	state->renderInterval = sshsNodeGetInt(moduleData->moduleNode, "renderInterval");
 	state->showEvents = sshsNodeGetBool(moduleData->moduleNode, "showEvents");
+
+	// Start from scratch with the new settings.
+	activityClear(state);
 }
 
 static void caerActivityIndicatorExit(caerModuleData moduleData) {
@@ -307,17 +352,21 @@ static void caerActivityIndicatorExit(caerModuleData moduleData) {
 	AIState state = moduleData->moduleState;
 
 	// Ensure maps are freed.
-	simple2DBufferResetLong(state->spikeCountMap);
-	simple2DBufferResetInt(state->activeCountMap);
+	free(state->pixels);
+	free(state->canvas);
 	deleteOpenCV(state->cpp_class);
+
+	sshsNode sourceInfoNode = sshsGetRelativeNode(moduleData->moduleNode, "sourceInfo/");
+	sshsNodeClearSubTree(sourceInfoNode, true);
+
+	sshsNodeClearSubTree(state->statusNode, true);
 }
 
-static void caerActivityIndicatorReset(caerModuleData moduleData, uint16_t resetCallSourceID) {
+static void caerActivityIndicatorReset(caerModuleData moduleData, int16_t resetCallSourceID) {
 	UNUSED_ARGUMENT(resetCallSourceID);
 
 	AIState state = moduleData->moduleState;
 
-	// Reset maps to all zeros (startup state).
-	simple2DBufferResetLong(state->spikeCountMap);
-	simple2DBufferResetInt(state->activeCountMap);
+	// Timestamps start over, so does measurement.
+	activityClear(state);
 }
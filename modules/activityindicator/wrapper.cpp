@@ -10,8 +10,9 @@ OpenCV* newOpenCV() {
 	return new OpenCV();
 }
 
-void OpenCV_generate(OpenCV* v, activityLevel status, int activeNum, caerFrameEvent *singleframe, int sizeX, int sizeY, bool showEvents){
-	v->generate(status, activeNum, singleframe, sizeX, sizeY, showEvents);
+void OpenCV_generate(OpenCV* v, activityLevel status, int activeNum, uint8_t *canvas, caerFrameEvent frame, int sizeX,
+	int sizeY, bool showEvents) {
+	v->generate(status, activeNum, canvas, frame, sizeX, sizeY, showEvents);
 }
 
 void deleteOpenCV(OpenCV* v) {
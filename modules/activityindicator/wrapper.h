@@ -4,6 +4,7 @@
 #ifndef __WRAPPER_H
 #define __WRAPPER_H
 #include <stdint.h>
+#include <stdbool.h>
 #include <libcaer/events/frame.h>
 #include "modules/activityindicator/activityindicator.h"
 
@@ -15,7 +16,8 @@ typedef struct OpenCV OpenCV;
 
 OpenCV* newOpenCV();
 
-void OpenCV_generate(OpenCV* v, activityLevel status, int activeNum, caerFrameEvent *singleframe, int sizeX, int sizeY, bool showEvents);
+void OpenCV_generate(OpenCV* v, activityLevel status, int activeNum, uint8_t *canvas, caerFrameEvent frame, int sizeX,
+	int sizeY, bool showEvents);
 
 void deleteOpenCV(OpenCV* v);
 
@@ -1,18 +1,65 @@
 #include "main.h"
 #include "base/mainloop.h"
 #include "base/module.h"
-#include "ext/buffers.h"
+
+#include "modules/misc/timestamp_rebase.h"
+#include "modules/misc/worker_threads.h"
 
 #include <libcaer/events/polarity.h>
 
+// Events are processed in blocks: decode all of them first, then filter.
+#define BAFILTER_BLOCK_SIZE 256
+// Parallel filtering: maximum number of bands (threads), and minimum packet size
+// for which it is used. Smaller packets are not worth the synchronization.
+#define BAFILTER_MAX_THREADS 32
+#define BAFILTER_PARALLEL_MIN_EVENTS 4096
+// Per-event arrays, not counting the bands' event lists.
+#define BAFILTER_EVENT_ARRAYS 4
+
+typedef struct BAFilter_state *BAFilterState;
+
+/**
+ * Parallel filtering splits the map into horizontal bands, one per thread.
+ * Each band owns a range of map rows and is the only one to ever write them.
+ * An event updates its own row and the rows directly above and below, so a band
+ * gets, in packet order, all events on its own rows plus those on the row just
+ * outside each of its edges (halo). Halo events only update the band's own rows,
+ * and own events are filtered exactly like in the serial case: every band sees
+ * the complete, ordered history of its rows, so results are bit-identical.
+ */
+struct BAFilter_band {
+	/// Map rows owned by this band: [rowStart, rowEnd).
+	size_t rowStart;
+	size_t rowEnd;
+	/// Indexes of the events to process, in packet order.
+	int32_t *events;
+	size_t eventsSize;
+};
+
 struct BAFilter_state {
-	simple2DBufferLong timestampMap;
+	/// Last event timestamps, relative to timestampBase (0 means never).
+	/// Row-major, with a border of one pixel on each side, so that all eight
+	/// neighbors of any pixel can be updated without bounds checks.
+	int32_t *timestampMap;
+	size_t timestampMapStride;
+	size_t timestampMapSize;
+	int64_t timestampBase;
 	int32_t deltaT;
 	int8_t subSampleBy;
+	int32_t threads;
+	/// Parallel filtering: bands, map row to band lookup, and per-packet decoded events.
+	/// Band 0 is processed by the mainloop thread, all others by their own worker thread.
+	struct BAFilter_band *bands;
+	size_t bandsNumber;
+	size_t *rowBand;
+	size_t *eventMapIndex;
+	int32_t *eventTimestamp;
+	bool *eventValid;
+	bool *eventSupported;
+	size_t eventCapacity;
+	struct caer_worker_threads workers;
 };
 
-typedef struct BAFilter_state *BAFilterState;
-
 static void caerBackgroundActivityFilterConfigInit(sshsNode moduleNode);
 static bool caerBackgroundActivityFilterInit(caerModuleData moduleData);
 static void caerBackgroundActivityFilterRun(caerModuleData moduleData, caerEventPacketContainer in,
@@ -20,6 +67,14 @@ static void caerBackgroundActivityFilterRun(caerModuleData moduleData, caerEvent
 static void caerBackgroundActivityFilterConfig(caerModuleData moduleData);
 static void caerBackgroundActivityFilterExit(caerModuleData moduleData);
 static void caerBackgroundActivityFilterReset(caerModuleData moduleData, int16_t resetCallSourceID);
+static void filterSerial(BAFilterState state, caerPolarityEventPacket polarity, int32_t eventNumber);
+static void filterParallel(BAFilterState state, caerPolarityEventPacket polarity, int32_t eventNumber);
+static void filterBands(BAFilterState state);
+static void filterBand(BAFilterState state, struct BAFilter_band *band);
+static void bandWork(void *statePtr, size_t band);
+static bool bandsStart(caerModuleData moduleData, int32_t threads);
+static void bandsStop(BAFilterState state);
+static bool eventsReserve(BAFilterState state, size_t eventNumber);
 
 static const struct caer_module_functions BAFilterFunctions = { .moduleConfigInit =
 	&caerBackgroundActivityFilterConfigInit, .moduleInit = &caerBackgroundActivityFilterInit, .moduleRun =
@@ -43,6 +98,8 @@ static void caerBackgroundActivityFilterConfigInit(sshsNode moduleNode) {
 		"Maximum time difference in µs for events to be considered correlated and not be filtered out.");
 	sshsNodeCreateByte(moduleNode, "subSampleBy", 0, 0, 20, SSHS_FLAGS_NORMAL,
 		"Sub-sample event addresses by shifting right by this amount.");
+	sshsNodeCreateInt(moduleNode, "threads", 1, 1, BAFILTER_MAX_THREADS, SSHS_FLAGS_NORMAL,
+		"Number of threads to filter with, each one handling a horizontal band of the sensor. 1 means serial filtering.");
 }
 
 static bool caerBackgroundActivityFilterInit(caerModuleData moduleData) {
@@ -67,7 +124,11 @@ static bool caerBackgroundActivityFilterInit(caerModuleData moduleData) {
 	int16_t sizeX = sshsNodeGetShort(sourceInfo, "polaritySizeX");
 	int16_t sizeY = sshsNodeGetShort(sourceInfo, "polaritySizeY");
 
-	state->timestampMap = simple2DBufferInitLong((size_t) sizeX, (size_t) sizeY);
+	state->timestampMapStride = (size_t) sizeX + 2;
+	state->timestampMapSize = state->timestampMapStride * ((size_t) sizeY + 2);
+	state->timestampBase = 0;
+
+	state->timestampMap = calloc(state->timestampMapSize, sizeof(int32_t));
 	if (state->timestampMap == NULL) {
 		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for timestampMap.");
 		return (false);
@@ -96,58 +157,358 @@ static void caerBackgroundActivityFilterRun(caerModuleData moduleData, caerEvent
 
 	BAFilterState state = moduleData->moduleState;
 
-	// Iterate over events and filter out ones that are not supported by other
-	// events within a certain region in the specified timeframe.
-	CAER_POLARITY_ITERATOR_VALID_START(polarity)
-		// Get values on which to operate.
-		int64_t ts = caerPolarityEventGetTimestamp64(caerPolarityIteratorElement, polarity);
-		uint16_t x = caerPolarityEventGetX(caerPolarityIteratorElement);
-		uint16_t y = caerPolarityEventGetY(caerPolarityIteratorElement);
+	int32_t eventNumber = caerEventPacketHeaderGetEventNumber(&polarity->packetHeader);
+
+	if (state->bandsNumber > 1 && eventNumber >= BAFILTER_PARALLEL_MIN_EVENTS
+		&& eventsReserve(state, (size_t) eventNumber)) {
+		filterParallel(state, polarity, eventNumber);
+	}
+	else {
+		filterSerial(state, polarity, eventNumber);
+	}
+}
+
+/**
+ * Decode a block of events into map positions (and rows) and timestamps, and
+ * rebase the map if needed to fit all of them. The block ends early if its
+ * timestamps would not fit the map together, returns its actual size.
+ */
+static inline int32_t decodeBlock(BAFilterState state, caerPolarityEventPacket polarity, int32_t blockStart,
+	int32_t blockSize, size_t *mapRow, size_t *mapIndex, int64_t *timestamp, bool *isValid) {
+	size_t stride = state->timestampMapStride;
+
+	int64_t minTimestamp = INT64_MAX;
+	int64_t maxTimestamp = INT64_MIN;
+
+	for (int32_t i = 0; i < blockSize; i++) {
+		caerPolarityEventConst event = caerPolarityEventPacketGetEventConst(polarity, blockStart + i);
+
+		// Apply sub-sampling. Plus one for the border.
+		size_t x = (size_t) (caerPolarityEventGetX(event) >> state->subSampleBy) + 1;
+		size_t y = (size_t) (caerPolarityEventGetY(event) >> state->subSampleBy) + 1;
+
+		mapRow[i] = y;
+		mapIndex[i] = (y * stride) + x;
+		timestamp[i] = caerPolarityEventGetTimestamp64(event, polarity);
+		isValid[i] = caerPolarityEventIsValid(event);
+
+		if (i > 0 && !caerTimestampRebaseFits(minTimestamp, maxTimestamp, timestamp[i])) {
+			blockSize = i;
+			break;
+		}
+
+		minTimestamp = (timestamp[i] < minTimestamp) ? (timestamp[i]) : (minTimestamp);
+		maxTimestamp = (timestamp[i] > maxTimestamp) ? (timestamp[i]) : (maxTimestamp);
+	}
+
+	// Keep relative timestamps in range, so they fit into the 32bit map.
+	if (caerTimestampRebaseNeeded(state->timestampBase, minTimestamp, maxTimestamp)) {
+		// In parallel mode, all events decoded so far must be filtered with the old base first.
+		filterBands(state);
+
+		int32_t shift = caerTimestampRebase(&state->timestampBase, maxTimestamp);
+
+		caerTimestampMapRebase(state->timestampMap, state->timestampMapSize, shift);
+	}
+
+	return (blockSize);
+}
+
+static void filterSerial(BAFilterState state, caerPolarityEventPacket polarity, int32_t eventNumber) {
+	size_t stride = state->timestampMapStride;
+
+	size_t mapRow[BAFILTER_BLOCK_SIZE];
+	size_t mapIndex[BAFILTER_BLOCK_SIZE];
+	int64_t timestamp[BAFILTER_BLOCK_SIZE];
+	int32_t relativeTimestamp[BAFILTER_BLOCK_SIZE];
+	bool isValid[BAFILTER_BLOCK_SIZE];
+	bool isSupported[BAFILTER_BLOCK_SIZE];
+
+	for (int32_t blockStart = 0, blockSize = 0; blockStart < eventNumber; blockStart += blockSize) {
+		blockSize = eventNumber - blockStart;
+		if (blockSize > BAFILTER_BLOCK_SIZE) {
+			blockSize = BAFILTER_BLOCK_SIZE;
+		}
+
+		// First decode all events of the block into map positions and timestamps.
+		blockSize = decodeBlock(state, polarity, blockStart, blockSize, mapRow, mapIndex, timestamp, isValid);
 
-		// Apply sub-sampling.
-		x = U16T(x >> state->subSampleBy);
-		y = U16T(y >> state->subSampleBy);
+		for (int32_t i = 0; i < blockSize; i++) {
+			relativeTimestamp[i] = I32T(timestamp[i] - state->timestampBase);
+		}
 
-		// Get value from map.
-		int64_t lastTS = state->timestampMap->buffer2d[x][y];
+		// Then filter events in order, as each one updates the map for the following ones.
+		// Events that are not supported by other events within a certain region in the
+		// specified timeframe are filtered out.
+		for (int32_t i = 0; i < blockSize; i++) {
+			if (!isValid[i]) {
+				continue;
+			}
+
+			int32_t *center = state->timestampMap + mapIndex[i];
+			int32_t lastTS = *center;
+			int32_t ts = relativeTimestamp[i];
+
+			isSupported[i] = ((ts - lastTS) < state->deltaT) & (lastTS != 0);
+
+			// Update neighboring region: rows above and below are contiguous.
+			int32_t *above = center - stride;
+			int32_t *below = center + stride;
+
+			above[-1] = ts;
+			above[0] = ts;
+			above[1] = ts;
+			center[-1] = ts;
+			center[1] = ts;
+			below[-1] = ts;
+			below[0] = ts;
+			below[1] = ts;
+		}
 
-		if ((I64T(ts - lastTS) >= I64T(state->deltaT)) || (lastTS == 0)) {
-			// Filter out invalid.
-			caerPolarityEventInvalidate(caerPolarityIteratorElement, polarity);
+		// Finally filter out invalid.
+		for (int32_t i = 0; i < blockSize; i++) {
+			if (isValid[i] && !isSupported[i]) {
+				caerPolarityEventInvalidate(caerPolarityEventPacketGetEvent(polarity, blockStart + i), polarity);
+			}
 		}
+	}
+}
 
-		// Update neighboring region.
-		size_t sizeMaxX = (state->timestampMap->sizeX - 1);
-		size_t sizeMaxY = (state->timestampMap->sizeY - 1);
+static void filterParallel(BAFilterState state, caerPolarityEventPacket polarity, int32_t eventNumber) {
+	size_t mapRow[BAFILTER_BLOCK_SIZE];
+	int64_t timestamp[BAFILTER_BLOCK_SIZE];
 
-		if (x > 0) {
-			state->timestampMap->buffer2d[x - 1][y] = ts;
+	for (int32_t blockStart = 0, blockSize = 0; blockStart < eventNumber; blockStart += blockSize) {
+		blockSize = eventNumber - blockStart;
+		if (blockSize > BAFILTER_BLOCK_SIZE) {
+			blockSize = BAFILTER_BLOCK_SIZE;
 		}
-		if (x < sizeMaxX) {
-			state->timestampMap->buffer2d[x + 1][y] = ts;
+
+		blockSize = decodeBlock(state, polarity, blockStart, blockSize, mapRow, state->eventMapIndex + blockStart,
+			timestamp, state->eventValid + blockStart);
+
+		// Assign valid events to the bands owning their row and, if on the edge
+		// of a band, also to the neighboring band as halo.
+		for (int32_t i = 0; i < blockSize; i++) {
+			int32_t event = blockStart + i;
+
+			state->eventTimestamp[event] = I32T(timestamp[i] - state->timestampBase);
+
+			if (!state->eventValid[event]) {
+				continue;
+			}
+
+			size_t b = state->rowBand[mapRow[i]];
+			struct BAFilter_band *band = &state->bands[b];
+
+			band->events[band->eventsSize++] = event;
+
+			if (b > 0 && mapRow[i] == band->rowStart) {
+				band[-1].events[band[-1].eventsSize++] = event;
+			}
+
+			if ((b + 1) < state->bandsNumber && (mapRow[i] + 1) == band->rowEnd) {
+				band[1].events[band[1].eventsSize++] = event;
+			}
 		}
+	}
+
+	filterBands(state);
+
+	// Finally filter out invalid.
+	for (int32_t i = 0; i < eventNumber; i++) {
+		if (state->eventValid[i] && !state->eventSupported[i]) {
+			caerPolarityEventInvalidate(caerPolarityEventPacketGetEvent(polarity, i), polarity);
+		}
+	}
+}
+
+/**
+ * Filter all events assigned to the bands so far, in parallel, and wait for
+ * all bands to be done. Does nothing if no events are pending.
+ */
+static void filterBands(BAFilterState state) {
+	size_t eventsPending = 0;
+
+	for (size_t b = 0; b < state->bandsNumber; b++) {
+		eventsPending += state->bands[b].eventsSize;
+	}
+
+	if (eventsPending == 0) {
+		return;
+	}
+
+	// Band 0 is taken care of by the mainloop thread meanwhile.
+	caerWorkerThreadsRun(&state->workers);
+
+	for (size_t b = 0; b < state->bandsNumber; b++) {
+		state->bands[b].eventsSize = 0;
+	}
+}
+
+static void filterBand(BAFilterState state, struct BAFilter_band *band) {
+	int32_t *timestampMap = state->timestampMap;
+	size_t stride = state->timestampMapStride;
+
+	// Map index range owned by this band.
+	size_t ownedStart = band->rowStart * stride;
+	size_t ownedEnd = band->rowEnd * stride;
+
+	for (size_t e = 0; e < band->eventsSize; e++) {
+		int32_t event = band->events[e];
+
+		size_t index = state->eventMapIndex[event];
+		int32_t ts = state->eventTimestamp[event];
+
+		int32_t *center = timestampMap + index;
+		int32_t *above = center - stride;
+		int32_t *below = center + stride;
 
-		if (y > 0) {
-			state->timestampMap->buffer2d[x][y - 1] = ts;
+		// Fast path: event and all its neighbors inside this band.
+		if ((index - stride) >= ownedStart && (index + stride) < ownedEnd) {
+			int32_t lastTS = *center;
+
+			state->eventSupported[event] = ((ts - lastTS) < state->deltaT) & (lastTS != 0);
+
+			above[-1] = ts;
+			above[0] = ts;
+			above[1] = ts;
+			center[-1] = ts;
+			center[1] = ts;
+			below[-1] = ts;
+			below[0] = ts;
+			below[1] = ts;
+
+			continue;
 		}
-		if (y < sizeMaxY) {
-			state->timestampMap->buffer2d[x][y + 1] = ts;
+
+		// Event on the edge of this band or halo: only touch own rows.
+		if ((index - stride) >= ownedStart && (index - stride) < ownedEnd) {
+			above[-1] = ts;
+			above[0] = ts;
+			above[1] = ts;
 		}
 
-		if (x > 0 && y > 0) {
-			state->timestampMap->buffer2d[x - 1][y - 1] = ts;
+		if (index >= ownedStart && index < ownedEnd) {
+			int32_t lastTS = *center;
+
+			state->eventSupported[event] = ((ts - lastTS) < state->deltaT) & (lastTS != 0);
+
+			center[-1] = ts;
+			center[1] = ts;
 		}
-		if (x < sizeMaxX && y < sizeMaxY) {
-			state->timestampMap->buffer2d[x + 1][y + 1] = ts;
+
+		if ((index + stride) >= ownedStart && (index + stride) < ownedEnd) {
+			below[-1] = ts;
+			below[0] = ts;
+			below[1] = ts;
 		}
+	}
+}
+
+static void bandWork(void *statePtr, size_t band) {
+	BAFilterState state = statePtr;
+
+	filterBand(state, &state->bands[band]);
+}
+
+/**
+ * Split the map into bands of equal height and start one thread per band,
+ * except band 0. On failure, filtering falls back to serial.
+ */
+static bool bandsStart(caerModuleData moduleData, int32_t threads) {
+	BAFilterState state = moduleData->moduleState;
+
+	size_t mapRows = state->timestampMapSize / state->timestampMapStride;
+
+	// Rows actually used after sub-sampling, without the border.
+	size_t usedRows = (((mapRows - 3) >> state->subSampleBy) + 1);
+	size_t bandsNumber = ((size_t) threads < usedRows) ? ((size_t) threads) : (usedRows);
+
+	if (bandsNumber <= 1) {
+		return (true);
+	}
+
+	state->bands = calloc(bandsNumber, sizeof(struct BAFilter_band));
+	state->rowBand = calloc(mapRows, sizeof(size_t));
+	if (state->bands == NULL || state->rowBand == NULL) {
+		free(state->bands);
+		state->bands = NULL;
+		free(state->rowBand);
+		state->rowBand = NULL;
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for bands, filtering serially.");
+		return (false);
+	}
+
+	// The first and last band also own the border rows, and the last one any
+	// rows unused due to sub-sampling.
+	for (size_t b = 0; b < bandsNumber; b++) {
+		struct BAFilter_band *band = &state->bands[b];
+
+		band->rowStart = (b == 0) ? (0) : (1 + ((b * usedRows) / bandsNumber));
+		band->rowEnd = (b == (bandsNumber - 1)) ? (mapRows) : (1 + (((b + 1) * usedRows) / bandsNumber));
 
-		if (x > 0 && y < sizeMaxY) {
-			state->timestampMap->buffer2d[x - 1][y + 1] = ts;
+		for (size_t row = band->rowStart; row < band->rowEnd; row++) {
+			state->rowBand[row] = b;
 		}
-		if (x < sizeMaxX && y > 0) {
-			state->timestampMap->buffer2d[x + 1][y - 1] = ts;
+	}
+
+	state->bandsNumber = bandsNumber;
+
+	if (!caerWorkerThreadsStart(&state->workers, bandsNumber, &bandWork, state, "BAFilterBand")) {
+		bandsStop(state);
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to start band threads, filtering serially.");
+		return (false);
+	}
+
+	return (true);
+}
+
+static void bandsStop(BAFilterState state) {
+	caerWorkerThreadsStop(&state->workers);
+
+	if (state->bands != NULL) {
+		for (size_t b = 0; b < state->bandsNumber; b++) {
+			free(state->bands[b].events);
 		}
-	CAER_POLARITY_ITERATOR_VALID_END
+	}
+
+	free(state->bands);
+	state->bands = NULL;
+	state->bandsNumber = 0;
+
+	free(state->rowBand);
+	state->rowBand = NULL;
+
+	free(state->eventMapIndex);
+	state->eventMapIndex = NULL;
+	free(state->eventTimestamp);
+	state->eventTimestamp = NULL;
+	free(state->eventValid);
+	state->eventValid = NULL;
+	free(state->eventSupported);
+	state->eventSupported = NULL;
+	state->eventCapacity = 0;
+}
+
+/**
+ * Ensure per-event memory for parallel filtering can hold the given number of
+ * events. Every event is assigned to at most one halo per band, so each band
+ * needs the same capacity. On failure, the packet is filtered serially.
+ */
+static bool eventsReserve(BAFilterState state, size_t eventNumber) {
+	struct caer_worker_array arrays[BAFILTER_EVENT_ARRAYS + BAFILTER_MAX_THREADS] = { { &state->eventMapIndex,
+		sizeof(size_t) }, { &state->eventTimestamp, sizeof(int32_t) }, { &state->eventValid, sizeof(bool) }, {
+		&state->eventSupported, sizeof(bool) } };
+
+	for (size_t b = 0; b < state->bandsNumber; b++) {
+		arrays[BAFILTER_EVENT_ARRAYS + b] = (struct caer_worker_array ) { &state->bands[b].events, sizeof(int32_t) };
+	}
+
+	return (caerWorkerArraysReserve(&state->eventCapacity, eventNumber, arrays,
+		BAFILTER_EVENT_ARRAYS + state->bandsNumber));
 }
 
 static void caerBackgroundActivityFilterConfig(caerModuleData moduleData) {
@@ -155,8 +516,21 @@ static void caerBackgroundActivityFilterConfig(caerModuleData moduleData) {
 
 	BAFilterState state = moduleData->moduleState;
 
+	int8_t subSampleBy = sshsNodeGetByte(moduleData->moduleNode, "subSampleBy");
+	int32_t threads = sshsNodeGetInt(moduleData->moduleNode, "threads");
+
 	state->deltaT = sshsNodeGetInt(moduleData->moduleNode, "deltaT");
-	state->subSampleBy = sshsNodeGetByte(moduleData->moduleNode, "subSampleBy");
+
+	// Bands depend on the used map rows, so rebuild them on sub-sampling changes too.
+	// Config changes are applied between packets, so the band threads are idle.
+	if (subSampleBy != state->subSampleBy || threads != state->threads) {
+		bandsStop(state);
+
+		state->subSampleBy = subSampleBy;
+		state->threads = threads;
+
+		bandsStart(moduleData, threads);
+	}
 }
 
 static void caerBackgroundActivityFilterExit(caerModuleData moduleData) {
@@ -165,8 +539,11 @@ static void caerBackgroundActivityFilterExit(caerModuleData moduleData) {
 
 	BAFilterState state = moduleData->moduleState;
 
+	// Stop band threads, if any.
+	bandsStop(state);
+
 	// Ensure map is freed.
-	simple2DBufferFreeLong(state->timestampMap);
+	free(state->timestampMap);
 }
 
 static void caerBackgroundActivityFilterReset(caerModuleData moduleData, int16_t resetCallSourceID) {
@@ -175,5 +552,6 @@ static void caerBackgroundActivityFilterReset(caerModuleData moduleData, int16_t
 	BAFilterState state = moduleData->moduleState;
 
 	// Reset timestamp map to all zeros (startup state).
-	simple2DBufferResetLong(state->timestampMap);
+	memset(state->timestampMap, 0, state->timestampMapSize * sizeof(int32_t));
+	state->timestampBase = 0;
 }
@@ -378,35 +378,63 @@ bool Calibration::loadUndistortMatrices(void) {
 			Matx33d::eye(), undistortCameraMatrix);
 	}
 
-	// Convert undistortEventOutputMap to integer from float for faster calculations later on.
-	undistortEventMap.clear();
-	undistortEventMap.reserve(settings->imageWidth * settings->imageHeigth);
+	// Pack undistortEventOutputMap into the integer LUT, deciding validity once here
+	// instead of for every event later on.
+	int32_t width = I32T(settings->imageWidth);
+	int32_t height = I32T(settings->imageHeigth);
+
+	undistortEventLUT.resize(undistortEventOutputMap.size());
 
 	for (size_t i = 0; i < undistortEventOutputMap.size(); i++) {
-		undistortEventMap.push_back(undistortEventOutputMap.at(i));
+		// Input points were pixel centers, so flooring gets back the pixel address.
+		int32_t x = cvFloor(undistortEventOutputMap[i].x);
+		int32_t y = cvFloor(undistortEventOutputMap[i].y);
+
+		if (x < 0 || x >= width || y < 0 || y >= height) {
+			undistortEventLUT[i] = CAMCALIB_UNDISTORT_INVALID;
+		}
+		else {
+			undistortEventLUT[i] = (U32T(y) << 16) | U32T(x);
+		}
 	}
 
+	// Preallocate frame scratch space, so undistortFrame() doesn't have to.
+	undistortFrameScratch.create(imageSize, CV_16UC1);
+
 	return (true);
 }
 
-void Calibration::undistortEvent(caerPolarityEvent polarity, caerPolarityEventPacket polarityPacket) {
-	if (polarity == NULL || !caerPolarityEventIsValid(polarity) || polarityPacket == NULL) {
+void Calibration::undistortEvents(caerPolarityEventPacket polarityPacket) {
+	if (polarityPacket == NULL || undistortEventLUT.empty()) {
 		return;
 	}
 
-	// Get new coordinates at which event shall be remapped.
-	size_t mapIdx = (caerPolarityEventGetY(polarity) * settings->imageWidth) + caerPolarityEventGetX(polarity);
-	Point2i eventUndistort = undistortEventMap.at(mapIdx);
+	const uint32_t *lut = undistortEventLUT.data();
+	uint32_t width = settings->imageWidth;
+	uint32_t height = settings->imageHeigth;
 
-	// Check that new coordinates are still within view boundary. If not, keep old ones and invalidate event.
-	if (eventUndistort.x < 0 || eventUndistort.x >= (int) settings->imageWidth || eventUndistort.y < 0
-		|| eventUndistort.y >= (int) settings->imageHeigth) {
-		caerPolarityEventInvalidate(polarity, polarityPacket);
-	}
-	else {
-		// Else use new, remapped coordinates.
-		caerPolarityEventSetX(polarity, eventUndistort.x);
-		caerPolarityEventSetY(polarity, eventUndistort.y);
+	int32_t eventNumber = caerEventPacketHeaderGetEventNumber(&polarityPacket->packetHeader);
+
+	for (int32_t i = 0; i < eventNumber; i++) {
+		caerPolarityEvent polarity = caerPolarityEventPacketGetEvent(polarityPacket, i);
+
+		if (!caerPolarityEventIsValid(polarity)) {
+			continue;
+		}
+
+		uint32_t x = caerPolarityEventGetX(polarity);
+		uint32_t y = caerPolarityEventGetY(polarity);
+
+		// Addresses outside the calibrated area have no mapping either.
+		uint32_t undistort = (x < width && y < height) ? (lut[(y * width) + x]) : (CAMCALIB_UNDISTORT_INVALID);
+
+		if (undistort == CAMCALIB_UNDISTORT_INVALID) {
+			caerPolarityEventInvalidate(polarity, polarityPacket);
+		}
+		else {
+			caerPolarityEventSetX(polarity, U16T(undistort));
+			caerPolarityEventSetY(polarity, U16T(undistort >> 16));
+		}
 	}
 }
 
@@ -416,8 +444,33 @@ void Calibration::undistortFrame(caerFrameEvent frame) {
 	}
 
 	Size frameSize(caerFrameEventGetLengthX(frame), caerFrameEventGetLengthY(frame));
+
+	// remap() would silently reallocate the output if the sizes don't match.
+	if (frameSize != undistortRemap1.size()) {
+		return;
+	}
+
 	Mat view(frameSize, CV_16UC(caerFrameEventGetChannelNumber(frame)), caerFrameEventGetPixelArrayUnsafe(frame));
-	Mat inputView = view.clone();
 
-	remap(inputView, view, undistortRemap1, undistortRemap2, INTER_CUBIC, BORDER_CONSTANT);
+	// copyTo() only reallocates the scratch buffer if size or channels change.
+	view.copyTo(undistortFrameScratch);
+
+	int interpolation;
+
+	switch (settings->frameInterpolation) {
+		case CAMCALIB_INTERPOLATION_NEAREST:
+			interpolation = INTER_NEAREST;
+			break;
+
+		case CAMCALIB_INTERPOLATION_CUBIC:
+			interpolation = INTER_CUBIC;
+			break;
+
+		case CAMCALIB_INTERPOLATION_LINEAR:
+		default:
+			interpolation = INTER_LINEAR;
+			break;
+	}
+
+	remap(undistortFrameScratch, view, undistortRemap1, undistortRemap2, interpolation, BORDER_CONSTANT);
 }
@@ -15,6 +15,8 @@
 #include <opencv2/imgproc.hpp>
 #include <opencv2/calib3d.hpp>
 
+#define CAMCALIB_UNDISTORT_INVALID UINT32_MAX
+
 using namespace cv;
 using namespace std;
 
@@ -28,7 +30,7 @@ public:
 	bool runCalibrationAndSave(double *totalAvgError);
 
 	bool loadUndistortMatrices(void);
-	void undistortEvent(caerPolarityEvent polarity, caerPolarityEventPacket polarityPacket);
+	void undistortEvents(caerPolarityEventPacket polarityPacket);
 	void undistortFrame(caerFrameEvent frame);
 
 private:
@@ -40,9 +42,12 @@ private:
 	Mat cameraMatrix;
 	Mat distCoeffs;
 
-	vector<Point2i> undistortEventMap;
+	// Undistorted address of each pixel, packed as two int16 (x low, y high).
+	// Pixels that fall outside the image after undistortion hold CAMCALIB_UNDISTORT_INVALID.
+	vector<uint32_t> undistortEventLUT;
 	Mat undistortRemap1;
 	Mat undistortRemap2;
+	Mat undistortFrameScratch;
 
 	double computeReprojectionErrors(const vector<vector<Point3f> >& objectPoints,
 		const vector<vector<Point2f> >& imagePoints, const vector<Mat>& rvecs, const vector<Mat>& tvecs,
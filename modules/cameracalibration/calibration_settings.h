@@ -2,6 +2,9 @@
 #define CALIBRATION_SETTINGS_H_
 
 enum CameraCalibrationPattern { CAMCALIB_CHESSBOARD, CAMCALIB_CIRCLES_GRID, CAMCALIB_ASYMMETRIC_CIRCLES_GRID };
+enum CameraCalibrationInterpolation {
+	CAMCALIB_INTERPOLATION_NEAREST, CAMCALIB_INTERPOLATION_LINEAR, CAMCALIB_INTERPOLATION_CUBIC
+};
 
 struct CameraCalibrationSettings_struct {
 	bool doCalibration;
@@ -20,6 +23,7 @@ struct CameraCalibrationSettings_struct {
 	bool doUndistortion;
 	char *loadFileName;
 	bool fitAllPixels;
+	enum CameraCalibrationInterpolation frameInterpolation;
 	uint32_t imageWidth;
 	uint32_t imageHeigth;
 };
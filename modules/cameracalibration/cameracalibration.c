@@ -2,6 +2,7 @@
 #include "base/mainloop.h"
 #include "base/module.h"
 #include "ext/pathmax.h"
+#include "ext/c11threads_posix.h"
 
 #include "calibration_settings.h"
 #include "calibration_wrapper.h"
@@ -9,13 +10,35 @@
 #include <libcaer/events/polarity.h>
 #include <libcaer/events/frame.h>
 
+#include <float.h>
+#include <stdatomic.h>
+
 struct CameraCalibrationState_struct {
 	struct CameraCalibrationSettings_struct settings; // Struct containing all settings (shared)
 	struct Calibration *cpp_class; // Pointer to cpp_class_object
 	uint64_t lastFrameTimestamp;
-	size_t lastFoundPoints;
-	bool calibrationCompleted;
+	// Undistortion has its own C++ object and copy of the settings, only used by
+	// the mainloop, so it runs without holding settingsLock.
+	struct CameraCalibrationSettings_struct undistortSettings;
+	struct Calibration *undistortClass;
+	bool undistortSettingsChanged;
 	bool calibrationLoaded;
+	// Pattern detection and calibration run on their own thread, fed with frame copies.
+	// Only the latest frame is used, so a single slot holds the next one to process.
+	_Atomic caerFrameEvent pendingFrame;
+	thrd_t calibrationThread;
+	bool calibrationThreadJoinable;
+	atomic_bool calibrationRunning;
+	// Settings are shared with the calibration thread. While it runs, it applies
+	// changes itself, so the mainloop never waits on a detection or solve.
+	mtx_t settingsLock;
+	atomic_bool settingsChanged;
+	// Wakes the calibration thread up for a new frame, new settings or to stop.
+	cnd_t calibrationWake;
+	atomic_bool calibrationCompleted;
+	atomic_bool calibrationUpdated;
+	atomic_uint_fast64_t framesDropped;
+	sshsNode statusNode;
 };
 
 typedef struct CameraCalibrationState_struct *CameraCalibrationState;
@@ -26,6 +49,12 @@ static void caerCameraCalibrationRun(caerModuleData moduleData, caerEventPacketC
 static void caerCameraCalibrationConfig(caerModuleData moduleData);
 static void caerCameraCalibrationExit(caerModuleData moduleData);
 static void updateSettings(caerModuleData moduleData);
+static void settingsApply(caerModuleData moduleData);
+static void undistortSettingsUpdate(caerModuleData moduleData);
+static void frameSubmit(CameraCalibrationState state, caerFrameEventPacketConst frame, caerFrameEventConst frameEvent);
+static bool calibrationThreadStart(caerModuleData moduleData);
+static void calibrationThreadStop(CameraCalibrationState state);
+static void statusReset(CameraCalibrationState state);
 
 static const struct caer_module_functions CameraCalibrationFunctions = { .moduleInit = &caerCameraCalibrationInit,
 	.moduleRun = &caerCameraCalibrationRun, .moduleConfig = &caerCameraCalibrationConfig, .moduleExit =
@@ -103,6 +132,10 @@ static bool caerCameraCalibrationInit(caerModuleData moduleData) {
 		"The name of the file from which to load the calibration settings for undistortion.");
 	sshsNodeCreateBool(moduleData->moduleNode, "fitAllPixels", false, SSHS_FLAGS_NORMAL,
 		"Whether to fit all the input pixels (black borders) or maximize the image, at the cost of loosing some pixels.");
+	sshsNodeCreateString(moduleData->moduleNode, "frameInterpolation", "cubic", 5, 7, SSHS_FLAGS_NORMAL,
+		"Interpolation used when undistorting frames, cubic is the smoothest but also the slowest.");
+	sshsNodeCreateAttributeListOptions(moduleData->moduleNode, "frameInterpolation", SSHS_STRING, "nearest,linear,cubic",
+		false);
 
 	// Update all settings.
 	sshsNode sourceInfo = caerMainloopGetSourceInfo(sourceID);
@@ -121,6 +154,61 @@ static bool caerCameraCalibrationInit(caerModuleData moduleData) {
 		return (false);
 	}
 
+	// Its settings are copied over with the first packet.
+	state->undistortClass = calibration_init(&state->undistortSettings);
+	if (state->undistortClass == NULL) {
+		calibration_destroy(state->cpp_class);
+		return (false);
+	}
+
+	state->undistortSettingsChanged = true;
+
+	atomic_store(&state->pendingFrame, NULL);
+	atomic_store(&state->settingsChanged, false);
+
+	if (mtx_init(&state->settingsLock, mtx_plain) != thrd_success) {
+		calibration_destroy(state->undistortClass);
+		calibration_destroy(state->cpp_class);
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to initialize settings lock.");
+		return (false);
+	}
+
+	if (cnd_init(&state->calibrationWake) != thrd_success) {
+		mtx_destroy(&state->settingsLock);
+		calibration_destroy(state->undistortClass);
+		calibration_destroy(state->cpp_class);
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to initialize calibration thread condition.");
+		return (false);
+	}
+
+	// Calibration progress is published here by the calibration thread.
+	state->statusNode = sshsGetRelativeNode(moduleData->moduleNode, "status/");
+
+	sshsNodeCreateInt(state->statusNode, "foundPoints", 0, 0, INT32_MAX, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Number of point sets found so far for calibration.");
+	sshsNodeCreateAttributePollTime(state->statusNode, "foundPoints", SSHS_INT, 1);
+	sshsNodeCreateLong(state->statusNode, "framesDropped", 0, 0, INT64_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Number of frames skipped for pattern detection because newer ones were already available.");
+	sshsNodeCreateAttributePollTime(state->statusNode, "framesDropped", SSHS_LONG, 1);
+	sshsNodeCreateBool(state->statusNode, "calibrationCompleted", false, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Whether calibration succeeded and was saved to file.");
+	sshsNodeCreateAttributePollTime(state->statusNode, "calibrationCompleted", SSHS_BOOL, 1);
+	sshsNodeCreateFloat(state->statusNode, "totalAvgError", 0, 0, FLT_MAX, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Total average reprojection error (in pixels) of the last calibration attempt.");
+	sshsNodeCreateAttributePollTime(state->statusNode, "totalAvgError", SSHS_FLOAT, 1);
+
+	if (state->settings.doCalibration && !calibrationThreadStart(moduleData)) {
+		cnd_destroy(&state->calibrationWake);
+		mtx_destroy(&state->settingsLock);
+		calibration_destroy(state->undistortClass);
+		calibration_destroy(state->cpp_class);
+		sshsNodeClearSubTree(state->statusNode, true);
+		return (false);
+	}
+
 	// Add config listeners last, to avoid having them dangling if Init doesn't succeed.
 	sshsNodeAddAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
 
@@ -167,6 +255,21 @@ static void updateSettings(caerModuleData moduleData) {
 
 	free(calibPattern);
 
+	// Parse frame interpolation string.
+	char *frameInterpolation = sshsNodeGetString(moduleData->moduleNode, "frameInterpolation");
+
+	if (caerStrEquals(frameInterpolation, "nearest")) {
+		state->settings.frameInterpolation = CAMCALIB_INTERPOLATION_NEAREST;
+	}
+	else if (caerStrEquals(frameInterpolation, "cubic")) {
+		state->settings.frameInterpolation = CAMCALIB_INTERPOLATION_CUBIC;
+	}
+	else {
+		state->settings.frameInterpolation = CAMCALIB_INTERPOLATION_LINEAR;
+	}
+
+	free(frameInterpolation);
+
 	// Get file strings.
 	state->settings.saveFileName = sshsNodeGetString(moduleData->moduleNode, "saveFileName");
 	state->settings.loadFileName = sshsNodeGetString(moduleData->moduleNode, "loadFileName");
@@ -177,6 +280,36 @@ static void caerCameraCalibrationConfig(caerModuleData moduleData) {
 
 	CameraCalibrationState state = moduleData->moduleState;
 
+	mtx_lock(&state->settingsLock);
+
+	// The calibration thread works with the settings and the C++ class. A detection or
+	// solve in progress can take long, so don't wait for it: the thread applies the new
+	// settings itself before its next frame, and exits if calibration got disabled.
+	if (atomic_load(&state->calibrationRunning)) {
+		atomic_store(&state->settingsChanged, true);
+		cnd_signal(&state->calibrationWake);
+
+		mtx_unlock(&state->settingsLock);
+		return;
+	}
+
+	settingsApply(moduleData);
+
+	mtx_unlock(&state->settingsLock);
+
+	if (state->settings.doCalibration) {
+		calibrationThreadStart(moduleData);
+	}
+}
+
+/**
+ * Reload all settings and restart calibration from scratch. Call with settingsLock
+ * held, from the mainloop while the calibration thread is stopped, or from the
+ * calibration thread itself.
+ */
+static void settingsApply(caerModuleData moduleData) {
+	CameraCalibrationState state = moduleData->moduleState;
+
 	// Free filename strings, get reloaded in next step.
 	free(state->settings.saveFileName);
 	free(state->settings.loadFileName);
@@ -189,8 +322,35 @@ static void caerCameraCalibrationConfig(caerModuleData moduleData) {
 
 	// Reset calibration status after any config change.
 	state->lastFrameTimestamp = 0;
-	state->lastFoundPoints = 0;
-	state->calibrationCompleted = false;
+	state->undistortSettingsChanged = true;
+
+	statusReset(state);
+}
+
+/**
+ * Copy the current settings for undistortion, and reload the calibration with
+ * them. Call with settingsLock held, from the mainloop.
+ */
+static void undistortSettingsUpdate(caerModuleData moduleData) {
+	CameraCalibrationState state = moduleData->moduleState;
+
+	free(state->undistortSettings.loadFileName);
+
+	state->undistortSettings = state->settings;
+	state->undistortSettings.saveFileName = NULL;
+
+	// The settings' file names are freed on the next change, so keep a copy.
+	state->undistortSettings.loadFileName = malloc(strlen(state->settings.loadFileName) + 1);
+	if (state->undistortSettings.loadFileName == NULL) {
+		state->undistortSettings.doUndistortion = false;
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for undistortion settings.");
+	}
+	else {
+		strcpy(state->undistortSettings.loadFileName, state->settings.loadFileName);
+	}
+
+	state->undistortSettingsChanged = false;
 	state->calibrationLoaded = false;
 }
 
@@ -200,10 +360,21 @@ static void caerCameraCalibrationExit(caerModuleData moduleData) {
 
 	CameraCalibrationState state = moduleData->moduleState;
 
+	calibrationThreadStop(state);
+
+	free(atomic_exchange(&state->pendingFrame, NULL));
+
+	cnd_destroy(&state->calibrationWake);
+	mtx_destroy(&state->settingsLock);
+
+	calibration_destroy(state->undistortClass);
 	calibration_destroy(state->cpp_class);
 
+	sshsNodeClearSubTree(state->statusNode, true);
+
 	free(state->settings.saveFileName);
 	free(state->settings.loadFileName);
+	free(state->undistortSettings.loadFileName);
 }
 
 static void caerCameraCalibrationRun(caerModuleData moduleData, caerEventPacketContainer in,
@@ -216,51 +387,220 @@ static void caerCameraCalibrationRun(caerModuleData moduleData, caerEventPacketC
 
 	CameraCalibrationState state = moduleData->moduleState;
 
-	// Calibration is done only using frames.
-	if (state->settings.doCalibration && !state->calibrationCompleted && frame != NULL) {
+	// Only hold the lock to hand frames to the calibration thread and to pick up
+	// new settings. The calibration thread only holds it briefly, to apply them.
+	mtx_lock(&state->settingsLock);
+
+	// Calibration is done only using frames, on the calibration thread. Hand it a copy
+	// of a frame whenever enough time has passed since the last one.
+	if (atomic_load_explicit(&state->calibrationRunning, memory_order_relaxed)
+		&& !atomic_load_explicit(&state->calibrationCompleted, memory_order_relaxed) && frame != NULL) {
 		CAER_FRAME_ITERATOR_VALID_START(frame)
-		// Only work on new frames if enough time has passed between this and the last used one.
 			uint64_t currTimestamp = U64T(caerFrameEventGetTSStartOfFrame64(caerFrameIteratorElement, frame));
 
-			// If enough time has passed, try to add a new point set.
 			if ((currTimestamp - state->lastFrameTimestamp) >= state->settings.captureDelay) {
 				state->lastFrameTimestamp = currTimestamp;
 
-				bool foundPoint = calibration_findNewPoints(state->cpp_class, caerFrameIteratorElement);
-				caerModuleLog(moduleData, CAER_LOG_WARNING, "Searching for new point set, result = %d.", foundPoint);
-			}CAER_FRAME_ITERATOR_VALID_END
+				frameSubmit(state, frame, caerFrameIteratorElement);
+			}
+		CAER_FRAME_ITERATOR_VALID_END
+	}
 
-		// If enough points have been found in this round, try doing calibration.
-		size_t foundPoints = calibration_foundPoints(state->cpp_class);
+	if (state->undistortSettingsChanged) {
+		undistortSettingsUpdate(moduleData);
+	}
 
-		if (foundPoints >= state->settings.minNumberOfPoints && foundPoints > state->lastFoundPoints) {
-			state->lastFoundPoints = foundPoints;
+	mtx_unlock(&state->settingsLock);
 
-			double totalAvgError;
-			state->calibrationCompleted = calibration_runCalibrationAndSave(state->cpp_class, &totalAvgError);
-			caerModuleLog(moduleData, CAER_LOG_WARNING, "Executing calibration, result = %d, error = %f.",
-				state->calibrationCompleted, totalAvgError);
-		}
+	// A fresh calibration was just saved, load it for undistortion.
+	if (atomic_exchange_explicit(&state->calibrationUpdated, false, memory_order_relaxed)) {
+		state->calibrationLoaded = false;
 	}
 
 	// At this point we always try to load the calibration settings for undistortion.
 	// Maybe they just got created or exist from a previous run.
-	if (state->settings.doUndistortion && !state->calibrationLoaded) {
-		state->calibrationLoaded = calibration_loadUndistortMatrices(state->cpp_class);
+	if (state->undistortSettings.doUndistortion && !state->calibrationLoaded) {
+		state->calibrationLoaded = calibration_loadUndistortMatrices(state->undistortClass);
 	}
 
 	// Undistortion can be applied to both frames and events.
-	if (state->settings.doUndistortion && state->calibrationLoaded) {
+	if (state->undistortSettings.doUndistortion && state->calibrationLoaded) {
 		if (frame != NULL) {
 			CAER_FRAME_ITERATOR_VALID_START(frame)
-				calibration_undistortFrame(state->cpp_class, caerFrameIteratorElement);
+				calibration_undistortFrame(state->undistortClass, caerFrameIteratorElement);
 			CAER_FRAME_ITERATOR_VALID_END
 		}
 
+		// Events go through the LUT packet-wise, one call for the whole packet.
 		if (polarity != NULL) {
-			CAER_POLARITY_ITERATOR_VALID_START(polarity)
-				calibration_undistortEvent(state->cpp_class, caerPolarityIteratorElement, polarity);
-			CAER_POLARITY_ITERATOR_VALID_END
+			calibration_undistortEvents(state->undistortClass, polarity);
 		}
 	}
 }
+
+/**
+ * Hand a frame copy to the calibration thread. Call with settingsLock held.
+ */
+static void frameSubmit(CameraCalibrationState state, caerFrameEventPacketConst frame, caerFrameEventConst frameEvent) {
+	size_t frameSize = (size_t) caerEventPacketHeaderGetEventSize(&frame->packetHeader);
+
+	caerFrameEvent frameCopy = malloc(frameSize);
+	if (frameCopy == NULL) {
+		return;
+	}
+
+	memcpy(frameCopy, frameEvent, frameSize);
+
+	// Replace the frame still waiting, if any: the newest one is always the most useful.
+	caerFrameEvent oldFrame = atomic_exchange_explicit(&state->pendingFrame, frameCopy, memory_order_acq_rel);
+
+	if (oldFrame != NULL) {
+		free(oldFrame);
+
+		atomic_fetch_add_explicit(&state->framesDropped, 1, memory_order_relaxed);
+	}
+
+	cnd_signal(&state->calibrationWake);
+}
+
+static int calibrationThread(void *moduleDataPtr) {
+	caerModuleData moduleData = moduleDataPtr;
+	CameraCalibrationState state = moduleData->moduleState;
+
+	thrd_set_name("CameraCalibration");
+
+	size_t lastFoundPoints = 0;
+
+	mtx_lock(&state->settingsLock);
+
+	while (true) {
+		// Frames arrive at most every captureDelay, and none at all once calibration
+		// is completed, so wait for one, for new settings or for the stop signal.
+		while (atomic_load_explicit(&state->calibrationRunning, memory_order_relaxed)
+			&& !atomic_load_explicit(&state->settingsChanged, memory_order_relaxed)
+			&& atomic_load_explicit(&state->pendingFrame, memory_order_relaxed) == NULL) {
+			cnd_wait(&state->calibrationWake, &state->settingsLock);
+		}
+
+		if (!atomic_load_explicit(&state->calibrationRunning, memory_order_relaxed)) {
+			break;
+		}
+
+		// Apply new settings between frames, see caerCameraCalibrationConfig().
+		if (atomic_load_explicit(&state->settingsChanged, memory_order_relaxed)) {
+			atomic_store(&state->settingsChanged, false);
+
+			settingsApply(moduleData);
+			lastFoundPoints = 0;
+
+			if (!state->settings.doCalibration) {
+				// Decided under the lock, so Config either sees the thread running or not.
+				atomic_store(&state->calibrationRunning, false);
+				break;
+			}
+		}
+
+		caerFrameEvent frameCopy = atomic_exchange_explicit(&state->pendingFrame, NULL, memory_order_acq_rel);
+
+		if (frameCopy == NULL) {
+			continue;
+		}
+
+		// Only this thread changes the settings while it runs, so it can use them unlocked.
+		mtx_unlock(&state->settingsLock);
+
+		bool foundPoint = calibration_findNewPoints(state->cpp_class, frameCopy);
+		caerModuleLog(moduleData, CAER_LOG_WARNING, "Searching for new point set, result = %d.", foundPoint);
+
+		free(frameCopy);
+
+		// If enough points have been found in this round, try doing calibration.
+		size_t foundPoints = calibration_foundPoints(state->cpp_class);
+
+		sshsNodeUpdateReadOnlyAttribute(state->statusNode, "foundPoints", SSHS_INT,
+			(union sshs_node_attr_value) { .iint = I32T(foundPoints) });
+		sshsNodeUpdateReadOnlyAttribute(state->statusNode, "framesDropped", SSHS_LONG,
+			(union sshs_node_attr_value) { .ilong = I64T(
+				atomic_load_explicit(&state->framesDropped, memory_order_relaxed)) });
+
+		if (foundPoints >= state->settings.minNumberOfPoints && foundPoints > lastFoundPoints) {
+			lastFoundPoints = foundPoints;
+
+			double totalAvgError;
+			bool calibrationCompleted = calibration_runCalibrationAndSave(state->cpp_class, &totalAvgError);
+			caerModuleLog(moduleData, CAER_LOG_WARNING, "Executing calibration, result = %d, error = %f.",
+				calibrationCompleted, totalAvgError);
+
+			sshsNodeUpdateReadOnlyAttribute(state->statusNode, "totalAvgError", SSHS_FLOAT,
+				(union sshs_node_attr_value) { .ffloat = (float) totalAvgError });
+			sshsNodeUpdateReadOnlyAttribute(state->statusNode, "calibrationCompleted", SSHS_BOOL,
+				(union sshs_node_attr_value) { .boolean = calibrationCompleted });
+
+			if (calibrationCompleted) {
+				atomic_store_explicit(&state->calibrationCompleted, true, memory_order_relaxed);
+				atomic_store_explicit(&state->calibrationUpdated, true, memory_order_relaxed);
+			}
+		}
+
+		mtx_lock(&state->settingsLock);
+	}
+
+	mtx_unlock(&state->settingsLock);
+
+	return (thrd_success);
+}
+
+static bool calibrationThreadStart(caerModuleData moduleData) {
+	CameraCalibrationState state = moduleData->moduleState;
+
+	// A thread that exited on its own (calibration disabled) is already done, so this doesn't wait.
+	if (state->calibrationThreadJoinable) {
+		thrd_join(state->calibrationThread, NULL);
+		state->calibrationThreadJoinable = false;
+	}
+
+	atomic_store(&state->calibrationRunning, true);
+
+	if (thrd_create(&state->calibrationThread, &calibrationThread, moduleData) != thrd_success) {
+		atomic_store(&state->calibrationRunning, false);
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to start calibration thread.");
+		return (false);
+	}
+
+	state->calibrationThreadJoinable = true;
+
+	return (true);
+}
+
+static void calibrationThreadStop(CameraCalibrationState state) {
+	mtx_lock(&state->settingsLock);
+	atomic_store(&state->calibrationRunning, false);
+	cnd_signal(&state->calibrationWake);
+	mtx_unlock(&state->settingsLock);
+
+	if (state->calibrationThreadJoinable) {
+		thrd_join(state->calibrationThread, NULL);
+		state->calibrationThreadJoinable = false;
+	}
+}
+
+/**
+ * Clear calibration progress. Call with settingsLock held, see settingsApply().
+ */
+static void statusReset(CameraCalibrationState state) {
+	free(atomic_exchange(&state->pendingFrame, NULL));
+
+	atomic_store(&state->calibrationCompleted, false);
+	atomic_store(&state->calibrationUpdated, false);
+	atomic_store(&state->framesDropped, 0);
+
+	sshsNodeUpdateReadOnlyAttribute(state->statusNode, "foundPoints", SSHS_INT,
+		(union sshs_node_attr_value) { .iint = 0 });
+	sshsNodeUpdateReadOnlyAttribute(state->statusNode, "framesDropped", SSHS_LONG,
+		(union sshs_node_attr_value) { .ilong = 0 });
+	sshsNodeUpdateReadOnlyAttribute(state->statusNode, "calibrationCompleted", SSHS_BOOL,
+		(union sshs_node_attr_value) { .boolean = false });
+	sshsNodeUpdateReadOnlyAttribute(state->statusNode, "totalAvgError", SSHS_FLOAT,
+		(union sshs_node_attr_value) { .ffloat = 0 });
+}
@@ -0,0 +1,752 @@
+#include "main.h"
+#include "base/mainloop.h"
+#include "base/module.h"
+
+#include "ext/c11threads_posix.h"
+#include "ext/portable_time.h"
+#include "modules/misc/timestamp_rebase.h"
+
+#include <libcaer/events/polarity.h>
+#include <libcaer/events/point2d.h>
+
+#include <math.h>
+
+// Events are decoded in blocks, checking for rebases once per block.
+#define CORNERDETECTOR_BLOCK_SIZE 256
+// eFAST rings (radius 3 and 4) and the arc lengths that make a corner on them.
+#define CORNERDETECTOR_INNER_RING 16
+#define CORNERDETECTOR_INNER_MIN_ARC 3
+#define CORNERDETECTOR_INNER_MAX_ARC 6
+#define CORNERDETECTOR_OUTER_RING 20
+#define CORNERDETECTOR_OUTER_MIN_ARC 4
+#define CORNERDETECTOR_OUTER_MAX_ARC 8
+// Events closer than this to the sensor edge are never corners.
+#define CORNERDETECTOR_BORDER 4
+// Harris: 9x9 patch, gradients on its inner 7x7 pixels.
+#define CORNERDETECTOR_PATCH_SIZE 9
+#define CORNERDETECTOR_GRADIENT_SIZE 7
+#define CORNERDETECTOR_HARRIS_K 0.04f
+// Benchmark results are logged this often, in seconds.
+#define CORNERDETECTOR_BENCHMARK_INTERVAL 5
+
+static const int8_t innerRingXY[CORNERDETECTOR_INNER_RING][2] = { { 0, 3 }, { 1, 3 }, { 2, 2 }, { 3, 1 }, { 3, 0 },
+	{ 3, -1 }, { 2, -2 }, { 1, -3 }, { 0, -3 }, { -1, -3 }, { -2, -2 }, { -3, -1 }, { -3, 0 }, { -3, 1 }, { -2, 2 },
+	{ -1, 3 } };
+
+static const int8_t outerRingXY[CORNERDETECTOR_OUTER_RING][2] = { { 0, 4 }, { 1, 4 }, { 2, 3 }, { 3, 2 }, { 4, 1 },
+	{ 4, 0 }, { 4, -1 }, { 3, -2 }, { 2, -3 }, { 1, -4 }, { 0, -4 }, { -1, -4 }, { -2, -3 }, { -3, -2 }, { -4, -1 },
+	{ -4, 0 }, { -4, 1 }, { -3, 2 }, { -2, 3 }, { -1, 4 } };
+
+/**
+ * A corner found by eFAST. With Harris refinement enabled, it also carries a
+ * copy of the surface around it, so that the Harris thread can score it while
+ * the mainloop thread keeps updating the surface.
+ */
+struct CornerDetector_candidate {
+	uint16_t x;
+	uint16_t y;
+	uint8_t polarity;
+	bool isCorner;
+	int32_t timestamp;
+	int32_t relativeTimestamp;
+	int32_t patch[CORNERDETECTOR_PATCH_SIZE * CORNERDETECTOR_PATCH_SIZE];
+};
+
+/**
+ * Event-based corner detection (eFAST): every event updates a per-polarity
+ * surface of active events, and is a corner if, on both a circle of radius 3
+ * and one of radius 4 around it, the most recent pixels form a contiguous arc
+ * of 3 to 6 (resp. 4 to 8) pixels.
+ * Optionally, corners are refined by a Harris score computed on the pixels
+ * active within harrisWindow around them (eHarris), on a separate thread, that
+ * works through the corners of a packet while eFAST is still running on it.
+ * Corners are output as POINT2D events, type is the polarity.
+ */
+struct CornerDetector_state {
+	int16_t sizeX;
+	int16_t sizeY;
+	/// Last event timestamps (OFF, ON), relative to timestampBase (0 means never). Row-major.
+	int32_t *surface[2];
+	size_t surfaceSize;
+	int64_t timestampBase;
+	/// Ring and patch pixel offsets from the center pixel in the surfaces.
+	int32_t innerRing[CORNERDETECTOR_INNER_RING];
+	int32_t outerRing[CORNERDETECTOR_OUTER_RING];
+	int32_t patchRows[CORNERDETECTOR_PATCH_SIZE];
+	/// Gaussian weights for the Harris structure tensor.
+	float harrisWeights[CORNERDETECTOR_GRADIENT_SIZE * CORNERDETECTOR_GRADIENT_SIZE];
+	bool harris;
+	float harrisThreshold;
+	int32_t harrisWindow;
+	/// Corners of the current packet, in packet order. Candidate number n is at
+	/// index n - candidatesStart. The mainloop thread publishes new candidates by
+	/// raising candidatesProduced, the Harris thread marks them done by raising
+	/// candidatesProcessed. Both only ever grow, and are protected by harrisLock
+	/// while the Harris thread is running.
+	struct CornerDetector_candidate *candidates;
+	size_t candidatesCapacity;
+	uint_fast64_t candidatesStart;
+	uint_fast64_t candidatesProduced;
+	uint_fast64_t candidatesProcessed;
+	thrd_t harrisThread;
+	bool harrisRunning;
+	mtx_t harrisLock;
+	/// Signalled when new candidates are published (or on stop), and when all
+	/// published candidates are processed.
+	cnd_t candidatesAvailable;
+	cnd_t candidatesDone;
+	/// Benchmark: accumulated processing time (ns), events and corners.
+	bool benchmark;
+	uint64_t benchmarkTime;
+	uint64_t benchmarkEvents;
+	uint64_t benchmarkCorners;
+	struct timespec benchmarkLastLog;
+};
+
+typedef struct CornerDetector_state *CornerDetectorState;
+
+static void caerCornerDetectorConfigInit(sshsNode moduleNode);
+static bool caerCornerDetectorInit(caerModuleData moduleData);
+static void caerCornerDetectorRun(caerModuleData moduleData, caerEventPacketContainer in,
+	caerEventPacketContainer *out);
+static void caerCornerDetectorConfig(caerModuleData moduleData);
+static void caerCornerDetectorExit(caerModuleData moduleData);
+static void caerCornerDetectorReset(caerModuleData moduleData, int16_t resetCallSourceID);
+static float harrisScore(CornerDetectorState state, const struct CornerDetector_candidate *candidate);
+static int harrisThread(void *statePtr);
+static bool harrisStart(caerModuleData moduleData);
+static void harrisStop(CornerDetectorState state);
+static void candidatesPublish(CornerDetectorState state, uint_fast64_t produced);
+static void candidatesWait(CornerDetectorState state);
+static bool candidatesGrow(CornerDetectorState state, uint_fast64_t produced);
+static void surfacesRebase(CornerDetectorState state, int64_t maxTimestamp);
+static void benchmarkUpdate(caerModuleData moduleData, const struct timespec *start, size_t events, size_t corners);
+
+static const struct caer_module_functions CornerDetectorFunctions = { .moduleConfigInit =
+	&caerCornerDetectorConfigInit, .moduleInit = &caerCornerDetectorInit, .moduleRun = &caerCornerDetectorRun,
+	.moduleConfig = &caerCornerDetectorConfig, .moduleExit = &caerCornerDetectorExit, .moduleReset =
+		&caerCornerDetectorReset };
+
+static const struct caer_event_stream_in CornerDetectorInputs[] = { { .type = POLARITY_EVENT, .number = 1, .readOnly =
+	true } };
+
+static const struct caer_event_stream_out CornerDetectorOutputs[] = { { .type = POINT2D_EVENT } };
+
+static const struct caer_module_info CornerDetectorInfo = { .version = 1, .name = "CornerDetector", .description =
+	"Detects corners in polarity events (eFAST, optional Harris refinement).", .type = CAER_MODULE_PROCESSOR, .memSize =
+	sizeof(struct CornerDetector_state), .functions = &CornerDetectorFunctions, .inputStreams = CornerDetectorInputs,
+	.inputStreamsSize = CAER_EVENT_STREAM_IN_SIZE(CornerDetectorInputs), .outputStreams = CornerDetectorOutputs,
+	.outputStreamsSize = CAER_EVENT_STREAM_OUT_SIZE(CornerDetectorOutputs), };
+
+caerModuleInfo caerModuleGetInfo(void) {
+	return (&CornerDetectorInfo);
+}
+
+static void caerCornerDetectorConfigInit(sshsNode moduleNode) {
+	sshsNodeCreateBool(moduleNode, "harris", false, SSHS_FLAGS_NORMAL,
+		"Refine eFAST corners with a Harris score, computed on a separate thread.");
+	sshsNodeCreateFloat(moduleNode, "harrisThreshold", 2, 0, 100, SSHS_FLAGS_NORMAL,
+		"Minimum Harris score for an eFAST corner to be kept. Edges score below zero, an ideal corner about 9.");
+	sshsNodeCreateInt(moduleNode, "harrisWindow", 50000, 1, 10000000, SSHS_FLAGS_NORMAL,
+		"Pixels with an event at most this many µs before the corner are active for the Harris score.");
+	sshsNodeCreateBool(moduleNode, "benchmark", false, SSHS_FLAGS_NORMAL,
+		"Measure processing time and periodically log the achieved event rate.");
+}
+
+static bool caerCornerDetectorInit(caerModuleData moduleData) {
+	// Wait for input to be ready. All inputs, once they are up and running, will
+	// have a valid sourceInfo node to query, especially if dealing with data.
+	int16_t *inputs = caerMainloopGetModuleInputIDs(moduleData->moduleID, NULL);
+	if (inputs == NULL) {
+		return (false);
+	}
+
+	int16_t sourceID = inputs[0];
+	free(inputs);
+
+	CornerDetectorState state = moduleData->moduleState;
+
+	// Allocate surfaces using info from sourceInfo.
+	sshsNode sourceInfoSource = caerMainloopGetSourceInfo(sourceID);
+	if (sourceInfoSource == NULL) {
+		return (false);
+	}
+
+	state->sizeX = sshsNodeGetShort(sourceInfoSource, "polaritySizeX");
+	state->sizeY = sshsNodeGetShort(sourceInfoSource, "polaritySizeY");
+	state->surfaceSize = (size_t) state->sizeX * (size_t) state->sizeY;
+
+	state->surface[0] = calloc(state->surfaceSize, sizeof(int32_t));
+	state->surface[1] = calloc(state->surfaceSize, sizeof(int32_t));
+	if (state->surface[0] == NULL || state->surface[1] == NULL) {
+		free(state->surface[0]);
+		free(state->surface[1]);
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for surfaces.");
+		return (false);
+	}
+
+	for (size_t i = 0; i < CORNERDETECTOR_INNER_RING; i++) {
+		state->innerRing[i] = (innerRingXY[i][1] * state->sizeX) + innerRingXY[i][0];
+	}
+
+	for (size_t i = 0; i < CORNERDETECTOR_OUTER_RING; i++) {
+		state->outerRing[i] = (outerRingXY[i][1] * state->sizeX) + outerRingXY[i][0];
+	}
+
+	for (int32_t i = 0; i < CORNERDETECTOR_PATCH_SIZE; i++) {
+		state->patchRows[i] = ((i - (CORNERDETECTOR_PATCH_SIZE / 2)) * state->sizeX) - (CORNERDETECTOR_PATCH_SIZE / 2);
+	}
+
+	// Gaussian with sigma 2 over the gradient pixels, normalized to sum up to one.
+	float weightsSum = 0;
+
+	for (int32_t y = 0; y < CORNERDETECTOR_GRADIENT_SIZE; y++) {
+		for (int32_t x = 0; x < CORNERDETECTOR_GRADIENT_SIZE; x++) {
+			int32_t dx = x - (CORNERDETECTOR_GRADIENT_SIZE / 2);
+			int32_t dy = y - (CORNERDETECTOR_GRADIENT_SIZE / 2);
+
+			float weight = expf(-(float) ((dx * dx) + (dy * dy)) / (2.0f * 2.0f * 2.0f));
+
+			state->harrisWeights[(y * CORNERDETECTOR_GRADIENT_SIZE) + x] = weight;
+			weightsSum += weight;
+		}
+	}
+
+	for (size_t i = 0; i < (CORNERDETECTOR_GRADIENT_SIZE * CORNERDETECTOR_GRADIENT_SIZE); i++) {
+		state->harrisWeights[i] /= weightsSum;
+	}
+
+	// Initialize configuration, this also starts the Harris thread if needed.
+	caerCornerDetectorConfig(moduleData);
+
+	sshsNode sourceInfoNode = sshsGetRelativeNode(moduleData->moduleNode, "sourceInfo/");
+	sshsNodeCreateShort(sourceInfoNode, "dataSizeX", state->sizeX, 1, INT16_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Output data width.");
+	sshsNodeCreateShort(sourceInfoNode, "dataSizeY", state->sizeY, 1, INT16_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Output data height.");
+
+	// Add config listeners last, to avoid having them dangling if Init doesn't succeed.
+	sshsNodeAddAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
+
+	// Nothing that can fail here.
+	return (true);
+}
+
+/**
+ * eFAST test on one ring: is there a contiguous arc of minArc to maxArc pixels,
+ * all more recent than every other pixel of the ring?
+ * Such an arc, if any, is exactly the set of pixels at least as recent as its
+ * oldest pixel k. So for every ring pixel k, count how many pixels are at least
+ * as recent, and how often going around the ring crosses between those and the
+ * others: an arc means exactly two crossings. Each count is a branchless
+ * reduction over the whole ring, which vectorizes.
+ */
+static inline bool ringTest(const int32_t *center, const int32_t *ring, int32_t ringSize, int32_t minArc,
+	int32_t maxArc) {
+	int32_t values[CORNERDETECTOR_OUTER_RING];
+	int32_t previousValues[CORNERDETECTOR_OUTER_RING];
+
+	for (int32_t i = 0; i < ringSize; i++) {
+		values[i] = center[ring[i]];
+	}
+
+	previousValues[0] = values[ringSize - 1];
+
+	for (int32_t i = 1; i < ringSize; i++) {
+		previousValues[i] = values[i - 1];
+	}
+
+	int32_t isArc = 0;
+
+	for (int32_t k = 0; k < ringSize; k++) {
+		int32_t oldest = values[k];
+		int32_t count = 0;
+		int32_t crossings = 0;
+
+		for (int32_t i = 0; i < ringSize; i++) {
+			int32_t newer = (values[i] >= oldest);
+
+			count += newer;
+			crossings += newer ^ (previousValues[i] >= oldest);
+		}
+
+		isArc |= (count >= minArc) & (count <= maxArc) & (crossings == 2);
+	}
+
+	return (isArc);
+}
+
+static void caerCornerDetectorRun(caerModuleData moduleData, caerEventPacketContainer in,
+	caerEventPacketContainer *out) {
+	caerPolarityEventPacketConst polarity =
+		(caerPolarityEventPacketConst) caerEventPacketContainerFindEventPacketByTypeConst(in, POLARITY_EVENT);
+
+	// Only process packets with content.
+	if (polarity == NULL) {
+		return;
+	}
+
+	CornerDetectorState state = moduleData->moduleState;
+
+	int32_t eventNumber = caerEventPacketHeaderGetEventNumber(&polarity->packetHeader);
+
+	struct timespec benchmarkStart;
+	if (state->benchmark) {
+		portable_clock_gettime_monotonic(&benchmarkStart);
+	}
+
+	uint_fast64_t produced = state->candidatesProduced;
+	state->candidatesStart = produced;
+
+	int32_t sizeX = state->sizeX;
+	int32_t sizeY = state->sizeY;
+	int64_t timestamp[CORNERDETECTOR_BLOCK_SIZE];
+
+	for (int32_t blockStart = 0, blockSize = 0; blockStart < eventNumber; blockStart += blockSize) {
+		blockSize = eventNumber - blockStart;
+		if (blockSize > CORNERDETECTOR_BLOCK_SIZE) {
+			blockSize = CORNERDETECTOR_BLOCK_SIZE;
+		}
+
+		int64_t minTimestamp = INT64_MAX;
+		int64_t maxTimestamp = INT64_MIN;
+
+		for (int32_t i = 0; i < blockSize; i++) {
+			timestamp[i] = caerPolarityEventGetTimestamp64(
+				caerPolarityEventPacketGetEventConst(polarity, blockStart + i), polarity);
+
+			// End the block early if its timestamps would not fit the surfaces together.
+			if (i > 0 && !caerTimestampRebaseFits(minTimestamp, maxTimestamp, timestamp[i])) {
+				blockSize = i;
+				break;
+			}
+
+			minTimestamp = (timestamp[i] < minTimestamp) ? (timestamp[i]) : (minTimestamp);
+			maxTimestamp = (timestamp[i] > maxTimestamp) ? (timestamp[i]) : (maxTimestamp);
+		}
+
+		// Keep relative timestamps in range, so they fit into the 32bit surfaces.
+		// The Harris thread only works on copies, so no need to wait for it.
+		if (caerTimestampRebaseNeeded(state->timestampBase, minTimestamp, maxTimestamp)) {
+			surfacesRebase(state, maxTimestamp);
+		}
+
+		for (int32_t i = 0; i < blockSize; i++) {
+			caerPolarityEventConst event = caerPolarityEventPacketGetEventConst(polarity, blockStart + i);
+
+			if (!caerPolarityEventIsValid(event)) {
+				continue;
+			}
+
+			int32_t x = caerPolarityEventGetX(event);
+			int32_t y = caerPolarityEventGetY(event);
+			bool polarityON = caerPolarityEventGetPolarity(event);
+			int32_t ts = I32T(timestamp[i] - state->timestampBase);
+
+			int32_t *center = state->surface[polarityON] + ((size_t) y * (size_t) sizeX) + (size_t) x;
+			*center = ts;
+
+			if (x < CORNERDETECTOR_BORDER || x >= (sizeX - CORNERDETECTOR_BORDER) || y < CORNERDETECTOR_BORDER
+				|| y >= (sizeY - CORNERDETECTOR_BORDER)) {
+				continue;
+			}
+
+			if (!ringTest(center, state->innerRing, CORNERDETECTOR_INNER_RING, CORNERDETECTOR_INNER_MIN_ARC,
+				CORNERDETECTOR_INNER_MAX_ARC)
+				|| !ringTest(center, state->outerRing, CORNERDETECTOR_OUTER_RING, CORNERDETECTOR_OUTER_MIN_ARC,
+					CORNERDETECTOR_OUTER_MAX_ARC)) {
+				continue;
+			}
+
+			if ((size_t) (produced - state->candidatesStart) == state->candidatesCapacity
+				&& !candidatesGrow(state, produced)) {
+				caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for corners, corner dropped.");
+				continue;
+			}
+
+			struct CornerDetector_candidate *candidate = &state->candidates[produced - state->candidatesStart];
+
+			candidate->x = U16T(x);
+			candidate->y = U16T(y);
+			candidate->polarity = polarityON;
+			candidate->isCorner = true;
+			candidate->timestamp = caerPolarityEventGetTimestamp(event);
+			candidate->relativeTimestamp = ts;
+
+			if (state->harris) {
+				for (size_t row = 0; row < CORNERDETECTOR_PATCH_SIZE; row++) {
+					memcpy(&candidate->patch[row * CORNERDETECTOR_PATCH_SIZE], center + state->patchRows[row],
+						CORNERDETECTOR_PATCH_SIZE * sizeof(int32_t));
+				}
+			}
+
+			produced++;
+		}
+
+		// Hand the block's candidates to the Harris thread, which scores them
+		// while eFAST runs on the next block.
+		if (state->harris) {
+			candidatesPublish(state, produced);
+		}
+	}
+
+	if (state->harris) {
+		candidatesWait(state);
+	}
+	else {
+		state->candidatesProcessed = produced;
+		state->candidatesProduced = produced;
+	}
+
+	size_t candidatesNumber = (size_t) (produced - state->candidatesStart);
+	int32_t cornersNumber = 0;
+
+	for (size_t i = 0; i < candidatesNumber; i++) {
+		cornersNumber += state->candidates[i].isCorner;
+	}
+
+	if (state->benchmark) {
+		benchmarkUpdate(moduleData, &benchmarkStart, (size_t) eventNumber, (size_t) cornersNumber);
+	}
+
+	if (cornersNumber == 0) {
+		return;
+	}
+
+	caerPoint2DEventPacket corners = caerPoint2DEventPacketAllocate(cornersNumber, moduleData->moduleID,
+		caerEventPacketHeaderGetEventTSOverflow(&polarity->packetHeader));
+	if (corners == NULL) {
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate corner packet.");
+		return;
+	}
+
+	int32_t cornersPosition = 0;
+
+	for (size_t i = 0; i < candidatesNumber; i++) {
+		const struct CornerDetector_candidate *candidate = &state->candidates[i];
+
+		if (!candidate->isCorner) {
+			continue;
+		}
+
+		caerPoint2DEvent corner = caerPoint2DEventPacketGetEvent(corners, cornersPosition++);
+
+		caerPoint2DEventSetX(corner, candidate->x);
+		caerPoint2DEventSetY(corner, candidate->y);
+		caerPoint2DEventSetType(corner, candidate->polarity);
+		caerPoint2DEventSetTimestamp(corner, candidate->timestamp);
+		caerPoint2DEventValidate(corner, corners);
+	}
+
+	// Make a packet container and return the result.
+	// Also remember to put this new container up for freeing at loop end.
+	*out = caerEventPacketContainerAllocate(1);
+	if (*out == NULL) {
+		free(corners);
+		return;
+	}
+
+	caerEventPacketContainerSetEventPacket(*out, 0, (caerEventPacketHeader) corners);
+}
+
+/**
+ * Harris score of a candidate: on the binary patch of pixels active within
+ * harrisWindow before it, compute Sobel gradients and their Gaussian-weighted
+ * structure tensor M, then score det(M) - k * trace(M)^2.
+ */
+static float harrisScore(CornerDetectorState state, const struct CornerDetector_candidate *candidate) {
+	int32_t active[CORNERDETECTOR_PATCH_SIZE * CORNERDETECTOR_PATCH_SIZE];
+
+	for (size_t i = 0; i < (CORNERDETECTOR_PATCH_SIZE * CORNERDETECTOR_PATCH_SIZE); i++) {
+		int32_t lastTS = candidate->patch[i];
+
+		active[i] = (lastTS != 0) & (U32T(candidate->relativeTimestamp - lastTS) < U32T(state->harrisWindow));
+	}
+
+	float mxx = 0, mxy = 0, myy = 0;
+
+	for (size_t y = 0; y < CORNERDETECTOR_GRADIENT_SIZE; y++) {
+		const int32_t *above = &active[(y * CORNERDETECTOR_PATCH_SIZE) + 1];
+		const int32_t *row = above + CORNERDETECTOR_PATCH_SIZE;
+		const int32_t *below = row + CORNERDETECTOR_PATCH_SIZE;
+		const float *weights = &state->harrisWeights[y * CORNERDETECTOR_GRADIENT_SIZE];
+
+		for (size_t x = 0; x < CORNERDETECTOR_GRADIENT_SIZE; x++) {
+			float gx = (float) ((above[x + 1] + (2 * row[x + 1]) + below[x + 1])
+				- (above[x - 1] + (2 * row[x - 1]) + below[x - 1]));
+			float gy = (float) ((below[x - 1] + (2 * below[x]) + below[x + 1])
+				- (above[x - 1] + (2 * above[x]) + above[x + 1]));
+
+			mxx += weights[x] * gx * gx;
+			mxy += weights[x] * gx * gy;
+			myy += weights[x] * gy * gy;
+		}
+	}
+
+	float trace = mxx + myy;
+
+	return (((mxx * myy) - (mxy * mxy)) - (CORNERDETECTOR_HARRIS_K * trace * trace));
+}
+
+static int harrisThread(void *statePtr) {
+	CornerDetectorState state = statePtr;
+
+	thrd_set_name("CornerDetectorHarris");
+
+	mtx_lock(&state->harrisLock);
+
+	while (true) {
+		while (state->harrisRunning && state->candidatesProcessed == state->candidatesProduced) {
+			cnd_wait(&state->candidatesAvailable, &state->harrisLock);
+		}
+
+		if (!state->harrisRunning) {
+			break;
+		}
+
+		uint_fast64_t processed = state->candidatesProcessed;
+		uint_fast64_t produced = state->candidatesProduced;
+
+		// Published candidates are not touched by the mainloop thread anymore.
+		mtx_unlock(&state->harrisLock);
+
+		for (; processed != produced; processed++) {
+			struct CornerDetector_candidate *candidate = &state->candidates[processed - state->candidatesStart];
+
+			candidate->isCorner = (harrisScore(state, candidate) >= state->harrisThreshold);
+		}
+
+		mtx_lock(&state->harrisLock);
+
+		state->candidatesProcessed = processed;
+
+		if (state->candidatesProcessed == state->candidatesProduced) {
+			cnd_signal(&state->candidatesDone);
+		}
+	}
+
+	mtx_unlock(&state->harrisLock);
+
+	return (thrd_success);
+}
+
+static bool harrisStart(caerModuleData moduleData) {
+	CornerDetectorState state = moduleData->moduleState;
+
+	if (mtx_init(&state->harrisLock, mtx_plain) != thrd_success) {
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to initialize Harris thread lock.");
+		return (false);
+	}
+
+	if (cnd_init(&state->candidatesAvailable) != thrd_success) {
+		mtx_destroy(&state->harrisLock);
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to initialize Harris thread condition.");
+		return (false);
+	}
+
+	if (cnd_init(&state->candidatesDone) != thrd_success) {
+		cnd_destroy(&state->candidatesAvailable);
+		mtx_destroy(&state->harrisLock);
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to initialize Harris thread condition.");
+		return (false);
+	}
+
+	state->harrisRunning = true;
+
+	if (thrd_create(&state->harrisThread, &harrisThread, state) != thrd_success) {
+		state->harrisRunning = false;
+
+		cnd_destroy(&state->candidatesDone);
+		cnd_destroy(&state->candidatesAvailable);
+		mtx_destroy(&state->harrisLock);
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to start Harris thread.");
+		return (false);
+	}
+
+	return (true);
+}
+
+static void harrisStop(CornerDetectorState state) {
+	if (!state->harrisRunning) {
+		return;
+	}
+
+	mtx_lock(&state->harrisLock);
+	state->harrisRunning = false;
+	cnd_signal(&state->candidatesAvailable);
+	mtx_unlock(&state->harrisLock);
+
+	thrd_join(state->harrisThread, NULL);
+
+	cnd_destroy(&state->candidatesDone);
+	cnd_destroy(&state->candidatesAvailable);
+	mtx_destroy(&state->harrisLock);
+}
+
+/**
+ * Hand all candidates up to produced to the Harris thread.
+ */
+static void candidatesPublish(CornerDetectorState state, uint_fast64_t produced) {
+	// Only the mainloop thread changes candidatesProduced.
+	if (produced == state->candidatesProduced) {
+		return;
+	}
+
+	mtx_lock(&state->harrisLock);
+	state->candidatesProduced = produced;
+	cnd_signal(&state->candidatesAvailable);
+	mtx_unlock(&state->harrisLock);
+}
+
+/**
+ * Wait for the Harris thread to be done with all published candidates.
+ */
+static void candidatesWait(CornerDetectorState state) {
+	mtx_lock(&state->harrisLock);
+
+	while (state->candidatesProcessed != state->candidatesProduced) {
+		cnd_wait(&state->candidatesDone, &state->harrisLock);
+	}
+
+	mtx_unlock(&state->harrisLock);
+}
+
+/**
+ * Double the candidate memory. The Harris thread must be done with all
+ * candidates produced so far before they can be moved.
+ */
+static bool candidatesGrow(CornerDetectorState state, uint_fast64_t produced) {
+	if (state->harris) {
+		candidatesPublish(state, produced);
+		candidatesWait(state);
+	}
+
+	size_t newCapacity =
+		(state->candidatesCapacity == 0) ? (CORNERDETECTOR_BLOCK_SIZE) : (2 * state->candidatesCapacity);
+
+	struct CornerDetector_candidate *candidates = realloc(state->candidates,
+		newCapacity * sizeof(struct CornerDetector_candidate));
+	if (candidates == NULL) {
+		return (false);
+	}
+
+	state->candidates = candidates;
+	state->candidatesCapacity = newCapacity;
+
+	return (true);
+}
+
+/**
+ * Move the timestamp base, so that timestamps up to maxTimestamp can be stored
+ * relative to it in the 32bit surfaces, see timestamp_rebase.h. Timestamps
+ * dropping out are also older than all others for eFAST, so they behave
+ * exactly like no timestamp at all (0) there too.
+ */
+static void surfacesRebase(CornerDetectorState state, int64_t maxTimestamp) {
+	int32_t shift = caerTimestampRebase(&state->timestampBase, maxTimestamp);
+
+	caerTimestampMapRebase(state->surface[0], state->surfaceSize, shift);
+	caerTimestampMapRebase(state->surface[1], state->surfaceSize, shift);
+}
+
+/**
+ * Add a packet's processing time to the benchmark, and log the results every
+ * CORNERDETECTOR_BENCHMARK_INTERVAL seconds.
+ */
+static void benchmarkUpdate(caerModuleData moduleData, const struct timespec *start, size_t events, size_t corners) {
+	CornerDetectorState state = moduleData->moduleState;
+
+	struct timespec end;
+	portable_clock_gettime_monotonic(&end);
+
+	state->benchmarkTime += (U64T(end.tv_sec - start->tv_sec) * 1000000000ULL) + U64T(end.tv_nsec)
+		- U64T(start->tv_nsec);
+	state->benchmarkEvents += events;
+	state->benchmarkCorners += corners;
+
+	if ((end.tv_sec - state->benchmarkLastLog.tv_sec) < CORNERDETECTOR_BENCHMARK_INTERVAL) {
+		return;
+	}
+
+	if (state->benchmarkEvents > 0 && state->benchmarkTime > 0) {
+		caerModuleLog(moduleData, CAER_LOG_INFO,
+			"Benchmark: %" PRIu64 " events in %.3f ms, %.1f ns/event (%.2f Mevt/s), %" PRIu64 " corners.",
+			state->benchmarkEvents, (double) state->benchmarkTime / (double) 1.0e6f,
+			(double) state->benchmarkTime / (double) state->benchmarkEvents,
+			((double) state->benchmarkEvents * (double) 1.0e3f) / (double) state->benchmarkTime, state->benchmarkCorners);
+	}
+
+	state->benchmarkTime = 0;
+	state->benchmarkEvents = 0;
+	state->benchmarkCorners = 0;
+	state->benchmarkLastLog = end;
+}
+
+static void caerCornerDetectorConfig(caerModuleData moduleData) {
+	caerModuleConfigUpdateReset(moduleData);
+
+	CornerDetectorState state = moduleData->moduleState;
+
+	// Config changes are applied between packets, so the Harris thread is idle.
+	state->harrisThreshold = sshsNodeGetFloat(moduleData->moduleNode, "harrisThreshold");
+	state->harrisWindow = sshsNodeGetInt(moduleData->moduleNode, "harrisWindow");
+
+	bool harris = sshsNodeGetBool(moduleData->moduleNode, "harris");
+
+	if (harris && !state->harris) {
+		if (!harrisStart(moduleData)) {
+			harris = false;
+			sshsNodePutBool(moduleData->moduleNode, "harris", false);
+		}
+	}
+	else if (!harris && state->harris) {
+		harrisStop(state);
+	}
+
+	state->harris = harris;
+
+	bool benchmark = sshsNodeGetBool(moduleData->moduleNode, "benchmark");
+
+	// Start a fresh measurement when enabled.
+	if (benchmark && !state->benchmark) {
+		state->benchmarkTime = 0;
+		state->benchmarkEvents = 0;
+		state->benchmarkCorners = 0;
+		portable_clock_gettime_monotonic(&state->benchmarkLastLog);
+	}
+
+	state->benchmark = benchmark;
+}
+
+static void caerCornerDetectorExit(caerModuleData moduleData) {
+	// Remove listener, which can reference invalid memory in userData.
+	sshsNodeRemoveAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
+
+	CornerDetectorState state = moduleData->moduleState;
+
+	// Stop Harris thread, if running.
+	harrisStop(state);
+
+	// Ensure memory is freed.
+	free(state->surface[0]);
+	free(state->surface[1]);
+	free(state->candidates);
+
+	sshsNode sourceInfoNode = sshsGetRelativeNode(moduleData->moduleNode, "sourceInfo/");
+	sshsNodeClearSubTree(sourceInfoNode, true);
+}
+
+static void caerCornerDetectorReset(caerModuleData moduleData, int16_t resetCallSourceID) {
+	UNUSED_ARGUMENT(resetCallSourceID);
+
+	CornerDetectorState state = moduleData->moduleState;
+
+	// Reset surfaces to all zeros (startup state).
+	memset(state->surface[0], 0, state->surfaceSize * sizeof(int32_t));
+	memset(state->surface[1], 0, state->surfaceSize * sizeof(int32_t));
+	state->timestampBase = 0;
+}
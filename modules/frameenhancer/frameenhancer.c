@@ -2,22 +2,78 @@
 #include "base/mainloop.h"
 #include "base/module.h"
 
+#include "modules/misc/worker_threads.h"
+
 #include <libcaer/events/frame.h>
 #include <libcaer/frame_utils.h>
 
+#include <stdatomic.h>
+
+// Maximum number of threads to process frames with.
+#define FRAMEENHANCER_MAX_THREADS 16
+// Mirrored border around the scratch copies of a frame, so that the demosaic
+// kernels can read two pixels in any direction without bounds checks.
+#define FRAMEENHANCER_BORDER 2
+
+typedef struct FrameEnhancer_state *FrameEnhancerState;
+
+/**
+ * One frame to enhance. Output frames are either new ones in the output
+ * packet, or the same as the input, when only the contrast is done here.
+ */
+struct FrameEnhancer_task {
+	caerFrameEventConst in;
+	caerFrameEvent out;
+	bool demosaic;
+};
+
+/**
+ * Frames of a packet are distributed over workers, worker 0 is the mainloop
+ * thread, all others run their own thread. Each has its own scratch memory
+ * for the demosaic kernels, big enough for the largest possible frame.
+ */
+struct FrameEnhancer_worker {
+	FrameEnhancerState state;
+	/// Input frame with mirrored border.
+	uint16_t *input;
+	/// Interpolated green channel, same layout as input.
+	uint16_t *green;
+	/// Interpolated red and blue of one row.
+	uint16_t *rows;
+};
+
 struct FrameEnhancer_state {
+	int16_t sizeX;
+	int16_t sizeY;
 	bool doDemosaic;
+	bool nativeDemosaic;
+	bool demosaicEdgeAware;
 	enum caer_frame_utils_demosaic_types demosaicType;
 	bool doContrast;
+	bool nativeContrast;
 	enum caer_frame_utils_contrast_types contrastType;
+	int32_t threads;
+	struct FrameEnhancer_task *tasks;
+	size_t tasksNumber;
+	size_t tasksCapacity;
+	struct FrameEnhancer_worker *workers;
+	size_t workersNumber;
+	/// All workers take tasks until none are left.
+	atomic_size_t tasksNext;
+	struct caer_worker_threads workerThreads;
 };
 
-typedef struct FrameEnhancer_state *FrameEnhancerState;
-
 static bool caerFrameEnhancerInit(caerModuleData moduleData);
 static void caerFrameEnhancerRun(caerModuleData moduleData, caerEventPacketContainer in, caerEventPacketContainer *out);
 static void caerFrameEnhancerConfig(caerModuleData moduleData);
 static void caerFrameEnhancerExit(caerModuleData moduleData);
+static caerFrameEventPacket outputAllocate(caerModuleData moduleData, caerFrameEventPacketConst frame);
+static bool tasksReserve(FrameEnhancerState state, size_t tasksNumber);
+static void enhanceFrames(FrameEnhancerState state);
+static void enhanceTasks(FrameEnhancerState state, struct FrameEnhancer_worker *worker);
+static void workerWork(void *statePtr, size_t worker);
+static bool workersStart(caerModuleData moduleData, int32_t threads);
+static void workersStop(FrameEnhancerState state);
 
 static const struct caer_module_functions FrameEnhancerFunctions = { .moduleInit = &caerFrameEnhancerInit, .moduleRun =
 	&caerFrameEnhancerRun, .moduleConfig = &caerFrameEnhancerConfig, .moduleExit = &caerFrameEnhancerExit };
@@ -53,25 +109,42 @@ static bool caerFrameEnhancerInit(caerModuleData moduleData) {
 	sshsNodeCreateBool(moduleData->moduleNode, "doContrast", false, SSHS_FLAGS_NORMAL,
 		"Do contrast enhancement on frame.");
 
+	// The edge_aware, bilinear and normalization algorithms are implemented here,
+	// directly on the 16 bit pixels, the others are provided by libcaer.
 #if defined(LIBCAER_HAVE_OPENCV) && LIBCAER_HAVE_OPENCV == 1
-	sshsNodeCreateString(moduleData->moduleNode, "demosaicType", "opencv_edge_aware", 8, 17, SSHS_FLAGS_NORMAL,
+	sshsNodeCreateString(moduleData->moduleNode, "demosaicType", "edge_aware", 8, 17, SSHS_FLAGS_NORMAL,
 		"Demoisaicing (color interpolation) algorithm to apply.");
 	sshsNodeCreateAttributeListOptions(moduleData->moduleNode, "demosaicType", SSHS_STRING,
-		"opencv_edge_aware,opencv_normal,standard", false);
-	sshsNodeCreateString(moduleData->moduleNode, "contrastType", "opencv_normalization", 8, 29, SSHS_FLAGS_NORMAL,
+		"edge_aware,bilinear,opencv_edge_aware,opencv_normal,standard", false);
+	sshsNodeCreateString(moduleData->moduleNode, "contrastType", "normalization", 8, 29, SSHS_FLAGS_NORMAL,
 		"Contrast enhancement algorithm to apply.");
 	sshsNodeCreateAttributeListOptions(moduleData->moduleNode, "contrastType", SSHS_STRING,
-		"opencv_normalization,opencv_histogram_equalization,opencv_clahe,standard", false);
+		"normalization,opencv_normalization,opencv_histogram_equalization,opencv_clahe,standard", false);
 #else
-	// Only standard algorithms are available here, so we force those and make it read-only.
-	sshsNodeRemoveAttribute(moduleData->moduleNode, "demosaicType", SSHS_STRING);
-	sshsNodeCreateString(moduleData->moduleNode, "demosaicType", "standard", 8, 8,
-		SSHS_FLAGS_READ_ONLY, "Demoisaicing (color interpolation) algorithm to apply.");
-	sshsNodeRemoveAttribute(moduleData->moduleNode, "contrastType", SSHS_STRING);
-	sshsNodeCreateString(moduleData->moduleNode, "contrastType", "standard", 8, 8,
-		SSHS_FLAGS_READ_ONLY, "Contrast enhancement algorithm to apply.");
+	// Previous versions forced the standard algorithms here and made them read-only. Remove those
+	// persisted attributes, so the native algorithms become selectable.
+	if (sshsNodeAttributeExists(moduleData->moduleNode, "demosaicType", SSHS_STRING)
+		&& (sshsNodeGetAttributeFlags(moduleData->moduleNode, "demosaicType", SSHS_STRING) & SSHS_FLAGS_READ_ONLY)) {
+		sshsNodeRemoveAttribute(moduleData->moduleNode, "demosaicType", SSHS_STRING);
+	}
+	if (sshsNodeAttributeExists(moduleData->moduleNode, "contrastType", SSHS_STRING)
+		&& (sshsNodeGetAttributeFlags(moduleData->moduleNode, "contrastType", SSHS_STRING) & SSHS_FLAGS_READ_ONLY)) {
+		sshsNodeRemoveAttribute(moduleData->moduleNode, "contrastType", SSHS_STRING);
+	}
+
+	sshsNodeCreateString(moduleData->moduleNode, "demosaicType", "edge_aware", 8, 17, SSHS_FLAGS_NORMAL,
+		"Demoisaicing (color interpolation) algorithm to apply.");
+	sshsNodeCreateAttributeListOptions(moduleData->moduleNode, "demosaicType", SSHS_STRING,
+		"edge_aware,bilinear,standard", false);
+	sshsNodeCreateString(moduleData->moduleNode, "contrastType", "normalization", 8, 29, SSHS_FLAGS_NORMAL,
+		"Contrast enhancement algorithm to apply.");
+	sshsNodeCreateAttributeListOptions(moduleData->moduleNode, "contrastType", SSHS_STRING, "normalization,standard",
+		false);
 #endif
 
+	sshsNodeCreateInt(moduleData->moduleNode, "threads", 1, 1, FRAMEENHANCER_MAX_THREADS, SSHS_FLAGS_NORMAL,
+		"Number of threads to enhance the frames of a packet with, each one taking whole frames. 1 means serial.");
+
 	sshsNode sourceInfoSource = caerMainloopGetSourceInfo(sourceID);
 	if (sourceInfoSource == NULL) {
 		return (false);
@@ -80,6 +153,18 @@ static bool caerFrameEnhancerInit(caerModuleData moduleData) {
 	int16_t sizeX = sshsNodeGetShort(sourceInfoSource, "dataSizeX");
 	int16_t sizeY = sshsNodeGetShort(sourceInfoSource, "dataSizeY");
 
+	FrameEnhancerState state = moduleData->moduleState;
+
+	state->sizeX = sizeX;
+	state->sizeY = sizeY;
+
+	// Initialize configuration, this also sets up the workers.
+	caerFrameEnhancerConfig(moduleData);
+
+	if (state->workersNumber == 0) {
+		return (false);
+	}
+
 	sshsNode sourceInfoNode = sshsGetRelativeNode(moduleData->moduleNode, "sourceInfo/");
 	sshsNodeCreateShort(sourceInfoNode, "frameSizeX", sizeX, 1, 1024, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
 		"Output frame width.");
@@ -90,13 +175,9 @@ static bool caerFrameEnhancerInit(caerModuleData moduleData) {
 	sshsNodeCreateShort(sourceInfoNode, "dataSizeY", sizeY, 1, 1024, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
 		"Output data height.");
 
-	// Initialize configuration.
-	caerFrameEnhancerConfig(moduleData);
-
 	// Add config listeners last, to avoid having them dangling if Init doesn't succeed.
 	sshsNodeAddAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
 
-	// Nothing that can fail here.
 	return (true);
 }
 
@@ -112,15 +193,37 @@ static void caerFrameEnhancerRun(caerModuleData moduleData, caerEventPacketConta
 	FrameEnhancerState state = moduleData->moduleState;
 	caerFrameEventPacket enhancedFrame = NULL;
 
-	if (state->doDemosaic) {
-#if defined(LIBCAER_HAVE_OPENCV) && LIBCAER_HAVE_OPENCV == 1
+	if (state->doDemosaic && !state->nativeDemosaic) {
 		enhancedFrame = caerFrameUtilsDemosaic(frame, state->demosaicType);
-#else
-		enhancedFrame = caerFrameUtilsDemosaic(frame, DEMOSAIC_STANDARD);
-#endif
 	}
 
-	if (state->doContrast) {
+	if ((state->doDemosaic && state->nativeDemosaic) || (state->doContrast && state->nativeContrast)) {
+		if (enhancedFrame == NULL) {
+			// Demosaic (or copy) straight from the input into a new packet.
+			enhancedFrame = outputAllocate(moduleData, frame);
+			if (enhancedFrame == NULL) {
+				return;
+			}
+		}
+		else {
+			// Contrast only, in-place on the frames libcaer just made.
+			if (!tasksReserve(state, (size_t) caerEventPacketHeaderGetEventNumber(&enhancedFrame->packetHeader))) {
+				free(enhancedFrame);
+				return;
+			}
+
+			state->tasksNumber = 0;
+
+			CAER_FRAME_ITERATOR_VALID_START(enhancedFrame)
+				state->tasks[state->tasksNumber++] = (struct FrameEnhancer_task ) { .in =
+						caerFrameIteratorElement, .out = caerFrameIteratorElement, .demosaic = false };
+			CAER_FRAME_ITERATOR_VALID_END
+		}
+
+		enhanceFrames(state);
+	}
+
+	if (state->doContrast && !state->nativeContrast) {
 		// If enhancedFrame doesn't exist yet, make a copy of frame, since
 		// the demosaic operation didn't do it for us.
 		if (enhancedFrame == NULL) {
@@ -131,11 +234,7 @@ static void caerFrameEnhancerRun(caerModuleData moduleData, caerEventPacketConta
 			}
 		}
 
-#if defined(LIBCAER_HAVE_OPENCV) && LIBCAER_HAVE_OPENCV == 1
 		caerFrameUtilsContrast(enhancedFrame, state->contrastType);
-#else
-		caerFrameUtilsContrast(enhancedFrame, CONTRAST_STANDARD);
-#endif
 	}
 
 	// If something did happen, make a packet container and return the result.
@@ -154,6 +253,444 @@ static void caerFrameEnhancerRun(caerModuleData moduleData, caerEventPacketConta
 	}
 }
 
+/**
+ * Whether the native demosaic kernels can handle this frame: a single channel
+ * with a standard Bayer (RGBG) filter, and at least 4x4 pixels for the
+ * mirrored border. Others are just copied.
+ */
+static inline bool demosaicSupported(FrameEnhancerState state, caerFrameEventConst frame) {
+	enum caer_frame_event_color_filter colorFilter = caerFrameEventGetColorFilter(frame);
+
+	return (caerFrameEventGetChannelNumber(frame) == GRAYSCALE
+		&& (colorFilter == RGBG || colorFilter == GRGB || colorFilter == GBGR || colorFilter == BGRG)
+		&& caerFrameEventGetLengthX(frame) >= 4 && caerFrameEventGetLengthX(frame) <= state->sizeX
+		&& caerFrameEventGetLengthY(frame) >= 4 && caerFrameEventGetLengthY(frame) <= state->sizeY);
+}
+
+/**
+ * Allocate the output packet for all valid input frames, and set up the
+ * output frames' metadata and the tasks to fill in their pixels.
+ */
+static caerFrameEventPacket outputAllocate(caerModuleData moduleData, caerFrameEventPacketConst frame) {
+	FrameEnhancerState state = moduleData->moduleState;
+
+	int32_t validNumber = caerEventPacketHeaderGetEventValid(&frame->packetHeader);
+	if (validNumber == 0) {
+		return (NULL);
+	}
+
+	if (!tasksReserve(state, (size_t) validNumber)) {
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for tasks.");
+		return (NULL);
+	}
+
+	int32_t maxLengthX = 1;
+	int32_t maxLengthY = 1;
+	int16_t maxChannels = GRAYSCALE;
+
+	CAER_FRAME_CONST_ITERATOR_VALID_START(frame)
+		bool demosaic = state->doDemosaic && state->nativeDemosaic
+			&& demosaicSupported(state, caerFrameIteratorElement);
+		int16_t channels = (demosaic) ? (RGB) : (I16T(caerFrameEventGetChannelNumber(caerFrameIteratorElement)));
+
+		if (caerFrameEventGetLengthX(caerFrameIteratorElement) > maxLengthX) {
+			maxLengthX = caerFrameEventGetLengthX(caerFrameIteratorElement);
+		}
+		if (caerFrameEventGetLengthY(caerFrameIteratorElement) > maxLengthY) {
+			maxLengthY = caerFrameEventGetLengthY(caerFrameIteratorElement);
+		}
+		if (channels > maxChannels) {
+			maxChannels = channels;
+		}
+	CAER_FRAME_ITERATOR_VALID_END
+
+	caerFrameEventPacket enhancedFrame = caerFrameEventPacketAllocate(validNumber, moduleData->moduleID,
+		caerEventPacketHeaderGetEventTSOverflow(&frame->packetHeader), maxLengthX, maxLengthY, maxChannels);
+	if (enhancedFrame == NULL) {
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate output frame packet.");
+		return (NULL);
+	}
+
+	state->tasksNumber = 0;
+
+	CAER_FRAME_CONST_ITERATOR_VALID_START(frame)
+		caerFrameEvent outFrame = caerFrameEventPacketGetEvent(enhancedFrame, I32T(state->tasksNumber));
+
+		bool demosaic = state->doDemosaic && state->nativeDemosaic
+			&& demosaicSupported(state, caerFrameIteratorElement);
+
+		caerFrameEventSetLengthXLengthYChannelNumber(outFrame, caerFrameEventGetLengthX(caerFrameIteratorElement),
+			caerFrameEventGetLengthY(caerFrameIteratorElement),
+			(demosaic) ? (RGB) : (caerFrameEventGetChannelNumber(caerFrameIteratorElement)), enhancedFrame);
+		caerFrameEventSetColorFilter(outFrame,
+			(demosaic) ? (MONO) : (caerFrameEventGetColorFilter(caerFrameIteratorElement)));
+		caerFrameEventSetROIIdentifier(outFrame, caerFrameEventGetROIIdentifier(caerFrameIteratorElement));
+		caerFrameEventSetPositionX(outFrame, caerFrameEventGetPositionX(caerFrameIteratorElement));
+		caerFrameEventSetPositionY(outFrame, caerFrameEventGetPositionY(caerFrameIteratorElement));
+		caerFrameEventSetTSStartOfFrame(outFrame, caerFrameEventGetTSStartOfFrame(caerFrameIteratorElement));
+		caerFrameEventSetTSEndOfFrame(outFrame, caerFrameEventGetTSEndOfFrame(caerFrameIteratorElement));
+		caerFrameEventSetTSStartOfExposure(outFrame, caerFrameEventGetTSStartOfExposure(caerFrameIteratorElement));
+		caerFrameEventSetTSEndOfExposure(outFrame, caerFrameEventGetTSEndOfExposure(caerFrameIteratorElement));
+		caerFrameEventValidate(outFrame, enhancedFrame);
+
+		state->tasks[state->tasksNumber++] = (struct FrameEnhancer_task ) { .in = caerFrameIteratorElement, .out =
+				outFrame, .demosaic = demosaic };
+	CAER_FRAME_ITERATOR_VALID_END
+
+	return (enhancedFrame);
+}
+
+static bool tasksReserve(FrameEnhancerState state, size_t tasksNumber) {
+	struct caer_worker_array tasks = { &state->tasks, sizeof(struct FrameEnhancer_task) };
+
+	return (caerWorkerArraysReserve(&state->tasksCapacity, tasksNumber, &tasks, 1));
+}
+
+/**
+ * Copy a frame into scratch memory, surrounded by a mirrored border (without
+ * repeating the edge pixels, so the Bayer pattern continues correctly).
+ */
+static void framePad(uint16_t *padded, const uint16_t *pixels, int32_t lengthX, int32_t lengthY) {
+	size_t stride = (size_t) lengthX + (2 * FRAMEENHANCER_BORDER);
+	int32_t endY = lengthY + FRAMEENHANCER_BORDER;
+
+	for (int32_t y = -FRAMEENHANCER_BORDER; y < endY; y++) {
+		int32_t srcY = (y < 0) ? (-y) : ((y >= lengthY) ? ((2 * (lengthY - 1)) - y) : (y));
+
+		uint16_t *row = padded + ((size_t) (y + FRAMEENHANCER_BORDER) * stride) + FRAMEENHANCER_BORDER;
+
+		if (pixels != NULL) {
+			memcpy(row, pixels + ((size_t) srcY * (size_t) lengthX), (size_t) lengthX * sizeof(uint16_t));
+		}
+		else if (srcY != y) {
+			// Pad in place, rows are already in their position.
+			memcpy(row, padded + ((size_t) (srcY + FRAMEENHANCER_BORDER) * stride) + FRAMEENHANCER_BORDER,
+				(size_t) lengthX * sizeof(uint16_t));
+		}
+
+		for (int32_t b = 1; b <= FRAMEENHANCER_BORDER; b++) {
+			row[-b] = row[b];
+			row[lengthX - 1 + b] = row[lengthX - 1 - b];
+		}
+	}
+}
+
+static inline int32_t clampPixel(int32_t value) {
+	value = (value < 0) ? (0) : (value);
+	return ((value > UINT16_MAX) ? (UINT16_MAX) : (value));
+}
+
+static inline int32_t absDiff(int32_t a, int32_t b) {
+	return ((a > b) ? (a - b) : (b - a));
+}
+
+/**
+ * Interpolate green at the red and blue sites of a row as the mean of their
+ * four neighbors. Green sites are copied.
+ * Rows are processed in full, selecting between site types with masks instead
+ * of branches, so the loop vectorizes.
+ */
+static void demosaicGreenRowBilinear(const uint16_t *restrict p, uint16_t *restrict g, int32_t lengthX,
+	int32_t stride, int32_t colorX) {
+	for (int32_t x = 0; x < lengthX; x++) {
+		int32_t self = p[x];
+		int32_t green = (p[x - 1] + p[x + 1] + p[x - stride] + p[x + stride] + 2) >> 2;
+
+		int32_t colorMask = -(((x ^ colorX) & 0x01) == 0);
+
+		g[x] = U16T((green & colorMask) | (self & ~colorMask));
+	}
+}
+
+/**
+ * Interpolate green at the red and blue sites of a row along the direction
+ * with the smaller gradient, with a second-derivative correction from the
+ * site's own color (Hamilton-Adams). Green sites are copied.
+ */
+static void demosaicGreenRowEdgeAware(const uint16_t *restrict p, uint16_t *restrict g, int32_t lengthX,
+	int32_t stride, int32_t colorX) {
+	for (int32_t x = 0; x < lengthX; x++) {
+		int32_t self = p[x];
+
+		int32_t lapH = (2 * self) - p[x - 2] - p[x + 2];
+		int32_t lapV = (2 * self) - p[x - (2 * stride)] - p[x + (2 * stride)];
+
+		int32_t gradH = absDiff(p[x - 1], p[x + 1]) + absDiff(lapH, 0);
+		int32_t gradV = absDiff(p[x - stride], p[x + stride]) + absDiff(lapV, 0);
+
+		// All estimates times 8.
+		int32_t estH = 2 * ((2 * (p[x - 1] + p[x + 1])) + lapH);
+		int32_t estV = 2 * ((2 * (p[x - stride] + p[x + stride])) + lapV);
+		int32_t est = (gradH < gradV) ? (estH) : ((gradV < gradH) ? (estV) : ((estH + estV) >> 1));
+
+		int32_t green = clampPixel((est + 4) >> 3);
+
+		int32_t colorMask = -(((x ^ colorX) & 0x01) == 0);
+
+		g[x] = U16T((green & colorMask) | (self & ~colorMask));
+	}
+}
+
+/**
+ * Interpolate the two non-green colors of a row: rowColor is the one present
+ * on the row (at colorX sites, and left/right of green ones), otherColor the
+ * one on the rows above and below (diagonal to colorX sites, above/below green
+ * ones). Bilinear averages the neighbors of that color, edge-aware their
+ * color difference to green, which is smoother than the colors themselves.
+ */
+static void demosaicColorRow(const uint16_t *restrict p, const uint16_t *restrict g, uint16_t *restrict rowColor,
+	uint16_t *restrict otherColor, int32_t lengthX, int32_t stride, int32_t colorX, bool edgeAware) {
+	// Green is masked out for bilinear, instead of branching on it.
+	int32_t greenMask = -(int32_t) edgeAware;
+
+	for (int32_t x = 0; x < lengthX; x++) {
+		int32_t base = g[x] & greenMask;
+
+#define D(OFFSET) (p[x + (OFFSET)] - (g[x + (OFFSET)] & greenMask))
+		int32_t self = p[x];
+		int32_t horizontal = base + ((D(-1) + D(1) + 1) >> 1);
+		int32_t vertical = base + ((D(-stride) + D(stride) + 1) >> 1);
+		int32_t diagonal = base + ((D(-stride - 1) + D(-stride + 1) + D(stride - 1) + D(stride + 1) + 2) >> 2);
+#undef D
+
+		int32_t colorMask = -(((x ^ colorX) & 0x01) == 0);
+
+		rowColor[x] = U16T(clampPixel((self & colorMask) | (horizontal & ~colorMask)));
+		otherColor[x] = U16T(clampPixel((diagonal & colorMask) | (vertical & ~colorMask)));
+	}
+}
+
+static void demosaicInterleaveRow(uint16_t *restrict out, const uint16_t *restrict red,
+	const uint16_t *restrict green, const uint16_t *restrict blue, int32_t lengthX) {
+	for (int32_t x = 0; x < lengthX; x++) {
+		out[(3 * x) + 0] = red[x];
+		out[(3 * x) + 1] = green[x];
+		out[(3 * x) + 2] = blue[x];
+	}
+}
+
+/**
+ * Demosaic a Bayer frame into RGB, in two passes over the padded input: first
+ * green is completed, then red and blue are interpolated, using the complete
+ * green for edge-aware.
+ */
+static void demosaicFrame(struct FrameEnhancer_worker *worker, caerFrameEventConst in, caerFrameEvent out) {
+	bool edgeAware = worker->state->demosaicEdgeAware;
+	int32_t lengthX = caerFrameEventGetLengthX(in);
+	int32_t lengthY = caerFrameEventGetLengthY(in);
+	int32_t stride = lengthX + (2 * FRAMEENHANCER_BORDER);
+	size_t origin = ((size_t) FRAMEENHANCER_BORDER * (size_t) stride) + FRAMEENHANCER_BORDER;
+
+	framePad(worker->input, caerFrameEventGetPixelArrayUnsafeConst(in), lengthX, lengthY);
+
+	// Position of the red site in frame coordinates. The color filter refers to
+	// the sensor, so ROI frames at odd positions have the pattern shifted.
+	int32_t redX, redY;
+
+	switch (caerFrameEventGetColorFilter(in)) {
+		case RGBG:
+			redX = 0;
+			redY = 0;
+			break;
+
+		case GRGB:
+			redX = 1;
+			redY = 0;
+			break;
+
+		case GBGR:
+			redX = 0;
+			redY = 1;
+			break;
+
+		case BGRG:
+		default:
+			redX = 1;
+			redY = 1;
+			break;
+	}
+
+	redX = (redX ^ caerFrameEventGetPositionX(in)) & 0x01;
+	redY = (redY ^ caerFrameEventGetPositionY(in)) & 0x01;
+
+	for (int32_t y = 0; y < lengthY; y++) {
+		// Red sites on red rows, blue sites on the others, are not green.
+		int32_t colorX = redX ^ ((y ^ redY) & 0x01);
+
+		const uint16_t *input = worker->input + origin + ((size_t) y * (size_t) stride);
+		uint16_t *green = worker->green + origin + ((size_t) y * (size_t) stride);
+
+		if (edgeAware) {
+			demosaicGreenRowEdgeAware(input, green, lengthX, stride, colorX);
+		}
+		else {
+			demosaicGreenRowBilinear(input, green, lengthX, stride, colorX);
+		}
+	}
+
+	framePad(worker->green, NULL, lengthX, lengthY);
+
+	uint16_t *outPixels = caerFrameEventGetPixelArrayUnsafe(out);
+	uint16_t *rowColor = worker->rows;
+	uint16_t *otherColor = worker->rows + worker->state->sizeX;
+
+	for (int32_t y = 0; y < lengthY; y++) {
+		const uint16_t *green = worker->green + origin + ((size_t) y * (size_t) stride);
+
+		bool redRow = (((y ^ redY) & 0x01) == 0);
+		int32_t colorX = redX ^ ((y ^ redY) & 0x01);
+
+		demosaicColorRow(worker->input + origin + ((size_t) y * (size_t) stride), green, rowColor, otherColor,
+			lengthX, stride, colorX, edgeAware);
+
+		demosaicInterleaveRow(outPixels + ((size_t) y * (size_t) lengthX * RGB), (redRow) ? (rowColor) : (otherColor),
+			green, (redRow) ? (otherColor) : (rowColor), lengthX);
+	}
+}
+
+/**
+ * Stretch the frame's pixel values linearly to the full 16 bit range. All
+ * color channels are stretched together, so their balance is kept.
+ */
+static void contrastNormalize(caerFrameEvent frame) {
+	uint16_t *pixels = caerFrameEventGetPixelArrayUnsafe(frame);
+	size_t pixelsNumber = caerFrameEventGetPixelsMaxIndex(frame);
+
+	uint16_t minValue = UINT16_MAX;
+	uint16_t maxValue = 0;
+
+	for (size_t i = 0; i < pixelsNumber; i++) {
+		minValue = (pixels[i] < minValue) ? (pixels[i]) : (minValue);
+		maxValue = (pixels[i] > maxValue) ? (pixels[i]) : (maxValue);
+	}
+
+	if (minValue >= maxValue) {
+		return;
+	}
+
+	float scale = (float) UINT16_MAX / (float) (maxValue - minValue);
+
+	for (size_t i = 0; i < pixelsNumber; i++) {
+		pixels[i] = U16T(((float) (pixels[i] - minValue) * scale) + 0.5f);
+	}
+}
+
+static void enhanceFrame(FrameEnhancerState state, struct FrameEnhancer_worker *worker,
+	const struct FrameEnhancer_task *task) {
+	if (task->demosaic) {
+		demosaicFrame(worker, task->in, task->out);
+	}
+	else if (task->out != task->in) {
+		memcpy(caerFrameEventGetPixelArrayUnsafe(task->out), caerFrameEventGetPixelArrayUnsafeConst(task->in),
+			caerFrameEventGetPixelsSize(task->in));
+	}
+
+	if (state->doContrast && state->nativeContrast) {
+		contrastNormalize(task->out);
+	}
+}
+
+/**
+ * Take tasks until none are left.
+ */
+static void enhanceTasks(FrameEnhancerState state, struct FrameEnhancer_worker *worker) {
+	size_t task;
+
+	while ((task = atomic_fetch_add_explicit(&state->tasksNext, 1, memory_order_relaxed)) < state->tasksNumber) {
+		enhanceFrame(state, worker, &state->tasks[task]);
+	}
+}
+
+/**
+ * Process all tasks, in parallel if there are workers for more than one,
+ * and wait for them to be done.
+ */
+static void enhanceFrames(FrameEnhancerState state) {
+	if (state->tasksNumber == 0) {
+		return;
+	}
+
+	atomic_store_explicit(&state->tasksNext, 0, memory_order_relaxed);
+
+	// Start the worker threads, and take tasks on the mainloop thread meanwhile.
+	// A single task is done right away, without waking up any thread.
+	if (state->tasksNumber > 1) {
+		caerWorkerThreadsRun(&state->workerThreads);
+	}
+	else {
+		enhanceTasks(state, &state->workers[0]);
+	}
+
+	state->tasksNumber = 0;
+}
+
+static void workerWork(void *statePtr, size_t worker) {
+	FrameEnhancerState state = statePtr;
+
+	enhanceTasks(state, &state->workers[worker]);
+}
+
+/**
+ * Allocate the workers' scratch memory and start one thread per worker,
+ * except worker 0. On failure, everything is freed again.
+ */
+static bool workersStart(caerModuleData moduleData, int32_t threads) {
+	FrameEnhancerState state = moduleData->moduleState;
+
+	size_t scratchSize = ((size_t) state->sizeX + (2 * FRAMEENHANCER_BORDER))
+		* ((size_t) state->sizeY + (2 * FRAMEENHANCER_BORDER));
+
+	state->workers = calloc((size_t) threads, sizeof(struct FrameEnhancer_worker));
+	if (state->workers == NULL) {
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for workers.");
+		return (false);
+	}
+
+	state->workersNumber = (size_t) threads;
+
+	for (size_t w = 0; w < state->workersNumber; w++) {
+		struct FrameEnhancer_worker *worker = &state->workers[w];
+
+		worker->state = state;
+
+		worker->input = malloc(scratchSize * sizeof(uint16_t));
+		worker->green = malloc(scratchSize * sizeof(uint16_t));
+		worker->rows = malloc(2 * (size_t) state->sizeX * sizeof(uint16_t));
+		if (worker->input == NULL || worker->green == NULL || worker->rows == NULL) {
+			workersStop(state);
+
+			caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for demosaicing.");
+			return (false);
+		}
+	}
+
+	if (!caerWorkerThreadsStart(&state->workerThreads, state->workersNumber, &workerWork, state,
+		"FrameEnhancerWorker")) {
+		workersStop(state);
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to start worker threads.");
+		return (false);
+	}
+
+	return (true);
+}
+
+static void workersStop(FrameEnhancerState state) {
+	caerWorkerThreadsStop(&state->workerThreads);
+
+	if (state->workers != NULL) {
+		for (size_t w = 0; w < state->workersNumber; w++) {
+			free(state->workers[w].input);
+			free(state->workers[w].green);
+			free(state->workers[w].rows);
+		}
+	}
+
+	free(state->workers);
+	state->workers = NULL;
+	state->workersNumber = 0;
+}
+
 static void caerFrameEnhancerConfig(caerModuleData moduleData) {
 	caerModuleConfigUpdateReset(moduleData);
 
@@ -163,17 +700,28 @@ static void caerFrameEnhancerConfig(caerModuleData moduleData) {
 
 	state->doContrast = sshsNodeGetBool(moduleData->moduleNode, "doContrast");
 
-#if defined(LIBCAER_HAVE_OPENCV) && LIBCAER_HAVE_OPENCV == 1
 	char *demosaicType = sshsNodeGetString(moduleData->moduleNode, "demosaicType");
 
-	if (caerStrEquals(demosaicType, "opencv_normal")) {
+	state->nativeDemosaic = false;
+	state->demosaicEdgeAware = false;
+
+	if (caerStrEquals(demosaicType, "edge_aware")) {
+		state->nativeDemosaic = true;
+		state->demosaicEdgeAware = true;
+	}
+	else if (caerStrEquals(demosaicType, "bilinear")) {
+		state->nativeDemosaic = true;
+	}
+#if defined(LIBCAER_HAVE_OPENCV) && LIBCAER_HAVE_OPENCV == 1
+	else if (caerStrEquals(demosaicType, "opencv_normal")) {
 		state->demosaicType = DEMOSAIC_OPENCV_NORMAL;
 	}
 	else if (caerStrEquals(demosaicType, "opencv_edge_aware")) {
 		state->demosaicType = DEMOSAIC_OPENCV_EDGE_AWARE;
 	}
+#endif
 	else {
-		// Standard, non-OpenCV method.
+		// Standard, libcaer method.
 		state->demosaicType = DEMOSAIC_STANDARD;
 	}
 
@@ -181,7 +729,13 @@ static void caerFrameEnhancerConfig(caerModuleData moduleData) {
 
 	char *contrastType = sshsNodeGetString(moduleData->moduleNode, "contrastType");
 
-	if (caerStrEquals(contrastType, "opencv_normalization")) {
+	state->nativeContrast = false;
+
+	if (caerStrEquals(contrastType, "normalization")) {
+		state->nativeContrast = true;
+	}
+#if defined(LIBCAER_HAVE_OPENCV) && LIBCAER_HAVE_OPENCV == 1
+	else if (caerStrEquals(contrastType, "opencv_normalization")) {
 		state->contrastType = CONTRAST_OPENCV_NORMALIZATION;
 	}
 	else if (caerStrEquals(contrastType, "opencv_histogram_equalization")) {
@@ -190,19 +744,41 @@ static void caerFrameEnhancerConfig(caerModuleData moduleData) {
 	else if (caerStrEquals(contrastType, "opencv_clahe")) {
 		state->contrastType = CONTRAST_OPENCV_CLAHE;
 	}
+#endif
 	else {
-		// Standard, non-OpenCV method.
+		// Standard, libcaer method.
 		state->contrastType = CONTRAST_STANDARD;
 	}
 
 	free(contrastType);
-#endif
+
+	// Config changes are applied between packets, so the worker threads are idle.
+	int32_t threads = sshsNodeGetInt(moduleData->moduleNode, "threads");
+
+	if (threads != state->threads || state->workersNumber == 0) {
+		workersStop(state);
+
+		state->threads = threads;
+
+		if (!workersStart(moduleData, threads) && threads > 1) {
+			caerModuleLog(moduleData, CAER_LOG_WARNING, "Falling back to serial frame enhancement.");
+
+			workersStart(moduleData, 1);
+		}
+	}
 }
 
 static void caerFrameEnhancerExit(caerModuleData moduleData) {
 	// Remove listener, which can reference invalid memory in userData.
 	sshsNodeRemoveAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
 
+	FrameEnhancerState state = moduleData->moduleState;
+
+	// Stop worker threads, if any, and free scratch memory.
+	workersStop(state);
+
+	free(state->tasks);
+
 	sshsNode sourceInfoNode = sshsGetRelativeNode(moduleData->moduleNode, "sourceInfo/");
 	sshsNodeClearSubTree(sourceInfoNode, true);
 }
@@ -1,18 +1,54 @@
 #include "base/mainloop.h"
 #include "base/module.h"
+#include "ext/threads_ext.h"
 
 #include <libcaercpp/events/frame.hpp>
 
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include <atomic>
+#include <thread>
+
 #if !defined(LIBCAER_HAVE_OPENCV) || LIBCAER_HAVE_OPENCV == 0
 #error "FrameStatistics module requires libcaer built with OpenCV support (LIBCAER_HAVE_OPENCV=1)."
 #endif
 
+// Histograms are always computed with at least 4096 bins, so that percentiles
+// stay precise even when only few bins are requested for display.
+#define FRAME_STATISTICS_HISTOGRAM_MIN_BITS 12
+#define FRAME_STATISTICS_HISTOGRAM_MAX_BITS 16
+#define FRAME_STATISTICS_HISTOGRAM_MAX_BINS (1 << FRAME_STATISTICS_HISTOGRAM_MAX_BITS)
+
+// Number of interleaved sub-histograms. Consecutive pixels often fall into the
+// same bin; spreading them over separate count arrays avoids serializing on
+// the store-to-load dependency of incrementing the same counter.
+#define FRAME_STATISTICS_SUB_HISTOGRAMS 4
+
+// Triple-buffer used to hand the latest histogram over to the display thread.
+#define FRAME_STATISTICS_DISPLAY_BUFFERS 3
+#define FRAME_STATISTICS_DISPLAY_INDEX_MASK 0x03
+#define FRAME_STATISTICS_DISPLAY_NEW 0x04
+
+struct frame_statistics_histogram {
+	uint32_t *counts;
+	int32_t bits;
+	int numBins;
+};
+
 struct caer_frame_statistics_state {
 	int numBins;
 	int roiRegion;
+	uint16_t saturationLevel;
+	uint32_t *subHistograms;
+	sshsNode statisticsNode;
+	struct frame_statistics_histogram histograms[FRAME_STATISTICS_DISPLAY_BUFFERS];
+	uint8_t histogramWrite;
+	uint8_t histogramRead;
+	std::atomic_uint_fast8_t histogramExchange;
+	std::atomic_bool displayRunning;
+	std::atomic_bool displayMove;
+	std::thread *displayThread;
 };
 
 typedef struct caer_frame_statistics_state *caerFrameStatisticsState;
@@ -40,6 +76,28 @@ caerModuleInfo caerModuleGetInfo(void) {
 	return (&FrameStatisticsInfo);
 }
 
+static void histogramCompute(uint32_t *subHistograms, size_t binsNumber, int32_t shift, const uint16_t *pixels,
+	size_t pixelsNumber);
+static void histogramMerge(uint32_t *counts, const uint32_t *subHistograms, size_t binsNumber);
+static void pixelsSumSaturated(const uint16_t *pixels, size_t pixelsNumber, uint16_t saturationLevel, uint64_t *sum,
+	uint64_t *saturated);
+static void statisticsUpdate(caerFrameStatisticsState state, const uint32_t *counts, int32_t bits,
+	size_t pixelsNumber, uint64_t sum, uint64_t saturated);
+static void statisticsReset(caerFrameStatisticsState state);
+static bool displayStart(caerModuleData moduleData);
+static void displayStop(caerModuleData moduleData);
+static void displayThread(caerModuleData moduleData);
+
+static inline int32_t histogramBits(int numBins) {
+	int32_t bits = FRAME_STATISTICS_HISTOGRAM_MIN_BITS;
+
+	while ((bits < FRAME_STATISTICS_HISTOGRAM_MAX_BITS) && ((1 << bits) < numBins)) {
+		bits++;
+	}
+
+	return (bits);
+}
+
 static inline void setWindowPosition(sshsNode moduleNode, const char *windowName) {
 	int posX = sshsNodeGetInt(moduleNode, "windowPositionX");
 	int posY = sshsNodeGetInt(moduleNode, "windowPositionY");
@@ -60,19 +118,79 @@ static bool caerFrameStatisticsInit(caerModuleData moduleData) {
 		"Selects which ROI region to display.");
 	state->roiRegion = sshsNodeGetInt(moduleData->moduleNode, "roiRegion");
 
+	sshsNodeCreate(moduleData->moduleNode, "saturationLevel", 64000, 0, UINT16_MAX, SSHS_FLAGS_NORMAL,
+		"Pixel value at or above which a pixel is counted as saturated.");
+	state->saturationLevel = U16T(sshsNodeGetInt(moduleData->moduleNode, "saturationLevel"));
+
+	sshsNodeCreate(moduleData->moduleNode, "showHistogram", true, SSHS_FLAGS_NORMAL,
+		"Show histogram in a separate window.");
+
 	// Restore position of OpenCV window.
 	sshsNodeCreateInt(moduleData->moduleNode, "windowPositionX", 20, 0, UINT16_MAX, SSHS_FLAGS_NORMAL,
 		"Position of window on screen (X coordinate).");
 	sshsNodeCreateInt(moduleData->moduleNode, "windowPositionY", 20, 0, UINT16_MAX, SSHS_FLAGS_NORMAL,
 		"Position of window on screen (Y coordinate).");
 
-	// Add config listeners last, to avoid having them dangling if Init doesn't succeed.
-	sshsNodeAddAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
+	// Summary statistics of the latest frame, for auto-exposure and monitoring.
+	state->statisticsNode = sshsGetRelativeNode(moduleData->moduleNode, "statistics/");
+
+	sshsNodeCreateFloat(state->statisticsNode, "mean", 0, 0, UINT16_MAX, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Mean pixel value.");
+	sshsNodeCreateAttributePollTime(state->statisticsNode, "mean", SSHS_FLOAT, 1);
+	sshsNodeCreateInt(state->statisticsNode, "percentile5", 0, 0, UINT16_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Pixel value below which 5% of pixels lie.");
+	sshsNodeCreateAttributePollTime(state->statisticsNode, "percentile5", SSHS_INT, 1);
+	sshsNodeCreateInt(state->statisticsNode, "median", 0, 0, UINT16_MAX, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Median pixel value.");
+	sshsNodeCreateAttributePollTime(state->statisticsNode, "median", SSHS_INT, 1);
+	sshsNodeCreateInt(state->statisticsNode, "percentile95", 0, 0, UINT16_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Pixel value below which 95% of pixels lie.");
+	sshsNodeCreateAttributePollTime(state->statisticsNode, "percentile95", SSHS_INT, 1);
+	sshsNodeCreateFloat(state->statisticsNode, "saturatedFraction", 0, 0, 1,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Fraction of pixels at or above the saturation level.");
+	sshsNodeCreateAttributePollTime(state->statisticsNode, "saturatedFraction", SSHS_FLOAT, 1);
+
+	// Allocate histogram memory once, for the maximum resolution.
+	state->subHistograms = (uint32_t *) malloc(
+		FRAME_STATISTICS_SUB_HISTOGRAMS * FRAME_STATISTICS_HISTOGRAM_MAX_BINS * sizeof(uint32_t));
+	if (state->subHistograms == nullptr) {
+		sshsNodeClearSubTree(state->statisticsNode, true);
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate histogram memory.");
+		return (false);
+	}
 
-	cv::namedWindow(moduleData->moduleSubSystemString, cv::WindowFlags::WINDOW_AUTOSIZE |
-		cv::WindowFlags::WINDOW_KEEPRATIO | cv::WindowFlags::WINDOW_GUI_EXPANDED);
+	for (size_t i = 0; i < FRAME_STATISTICS_DISPLAY_BUFFERS; i++) {
+		state->histograms[i].counts = (uint32_t *) malloc(FRAME_STATISTICS_HISTOGRAM_MAX_BINS * sizeof(uint32_t));
+		if (state->histograms[i].counts == nullptr) {
+			for (size_t j = 0; j < i; j++) {
+				free(state->histograms[j].counts);
+			}
+			free(state->subHistograms);
+			sshsNodeClearSubTree(state->statisticsNode, true);
+
+			caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate histogram memory.");
+			return (false);
+		}
+	}
 
-	setWindowPosition(moduleData->moduleNode, moduleData->moduleSubSystemString);
+	// Buffer 0 is written by Run(), 1 is ready for exchange, 2 is held by the display.
+	state->histogramWrite = 0;
+	state->histogramExchange.store(1);
+	state->histogramRead = 2;
+
+	if (sshsNodeGetBool(moduleData->moduleNode, "showHistogram") && !displayStart(moduleData)) {
+		for (size_t i = 0; i < FRAME_STATISTICS_DISPLAY_BUFFERS; i++) {
+			free(state->histograms[i].counts);
+		}
+		free(state->subHistograms);
+		sshsNodeClearSubTree(state->statisticsNode, true);
+
+		return (false);
+	}
+
+	// Add config listeners last, to avoid having them dangling if Init doesn't succeed.
+	sshsNodeAddAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
 
 	return (true);
 }
@@ -93,46 +211,67 @@ static void caerFrameStatisticsRun(caerModuleData moduleData, caerEventPacketCon
 
 	caerFrameStatisticsState state = static_cast<caerFrameStatisticsState>(moduleData->moduleState);
 
+	// Only the last valid frame of the selected ROI region matters, both the
+	// statistics and the display always reflect the latest exposure.
+	const libcaer::events::FrameEvent *lastFrame = nullptr;
+
 	for (const auto &frame : frames) {
-		if ((!frame.isValid()) || (frame.getROIIdentifier() != state->roiRegion)) {
-			continue;
+		if (frame.isValid() && (frame.getROIIdentifier() == state->roiRegion)) {
+			lastFrame = &frame;
 		}
+	}
+
+	if (lastFrame == nullptr) {
+		return;
+	}
 
-		const cv::Mat frameOpenCV = frame.getOpenCVMat(false);
+	const uint16_t *pixels = lastFrame->getPixelArrayUnsafe();
+	size_t pixelsNumber = lastFrame->getPixelsMaxIndex();
 
-		// Calculate histogram, full uint16 range.
-		const float range[] = { 0, UINT16_MAX + 1 };
-		const float *histRange = { range };
+	if (pixelsNumber == 0) {
+		return;
+	}
 
-		cv::Mat hist;
-		cv::calcHist(&frameOpenCV, 1, nullptr, cv::Mat(), hist, 1, &state->numBins, &histRange, true, false);
+	int32_t bits = histogramBits(state->numBins);
+	size_t binsNumber = (size_t) 1 << bits;
 
-		// Generate histogram image, with N x N/3 pixels.
-		int hist_w = state->numBins;
-		int hist_h = state->numBins / 3;
+	histogramCompute(state->subHistograms, binsNumber, FRAME_STATISTICS_HISTOGRAM_MAX_BITS - bits, pixels,
+		pixelsNumber);
 
-		cv::Mat histImage(hist_h, hist_w, CV_8UC1, cv::Scalar(0));
+	struct frame_statistics_histogram *histogram = &state->histograms[state->histogramWrite];
 
-		// Normalize the result to [0, histImage.rows].
-		cv::normalize(hist, hist, 0, histImage.rows, cv::NORM_MINMAX, -1, cv::Mat());
+	histogramMerge(histogram->counts, state->subHistograms, binsNumber);
+	histogram->bits = bits;
+	histogram->numBins = state->numBins;
 
-		// Draw the histogram.
-		for (int i = 1; i < state->numBins; i++) {
-			cv::line(histImage, cv::Point(i - 1, hist_h - cvRound(hist.at<float>(i - 1))),
-				cv::Point(i, hist_h - cvRound(hist.at<float>(i))), cv::Scalar(255, 255, 255), 2, 8, 0);
-		}
+	uint64_t sum, saturated;
+	pixelsSumSaturated(pixels, pixelsNumber, state->saturationLevel, &sum, &saturated);
+
+	statisticsUpdate(state, histogram->counts, bits, pixelsNumber, sum, saturated);
 
-		// Simple display, just use OpenCV GUI.
-		cv::imshow(moduleData->moduleSubSystemString, histImage);
-		cv::waitKey(1);
+	// Publish the new histogram to the display thread, taking back whichever
+	// buffer it didn't pick up yet (or already released) for the next write.
+	if (state->displayThread != nullptr) {
+		uint_fast8_t previous = state->histogramExchange.exchange(
+			state->histogramWrite | FRAME_STATISTICS_DISPLAY_NEW, std::memory_order_acq_rel);
+		state->histogramWrite = U8T(previous & FRAME_STATISTICS_DISPLAY_INDEX_MASK);
 	}
 }
 
 static void caerFrameStatisticsExit(caerModuleData moduleData) {
-	cv::destroyWindow(moduleData->moduleSubSystemString);
-
 	// Remove listener, which can reference invalid memory in userData.
 	sshsNodeRemoveAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
+
+	caerFrameStatisticsState state = (caerFrameStatisticsState) moduleData->moduleState;
+
+	displayStop(moduleData);
+
+	for (size_t i = 0; i < FRAME_STATISTICS_DISPLAY_BUFFERS; i++) {
+		free(state->histograms[i].counts);
+	}
+	free(state->subHistograms);
+
+	sshsNodeClearSubTree(state->statisticsNode, true);
 }
 
 static void caerFrameStatisticsConfig(caerModuleData moduleData) {
@@ -140,7 +279,239 @@ static void caerFrameStatisticsConfig(caerModuleData moduleData) {
 
 	caerFrameStatisticsState state = (caerFrameStatisticsState) moduleData->moduleState;
 	state->numBins = sshsNodeGetInt(moduleData->moduleNode, "numBins");
-	state->roiRegion = sshsNodeGetInt(moduleData->moduleNode, "roiRegion");
+	state->saturationLevel = U16T(sshsNodeGetInt(moduleData->moduleNode, "saturationLevel"));
+
+	int roiRegion = sshsNodeGetInt(moduleData->moduleNode, "roiRegion");
+	if (roiRegion != state->roiRegion) {
+		state->roiRegion = roiRegion;
+
+		// Don't keep showing statistics of the previous region.
+		statisticsReset(state);
+	}
+
+	bool showHistogram = sshsNodeGetBool(moduleData->moduleNode, "showHistogram");
+	if (showHistogram && (state->displayThread == nullptr)) {
+		displayStart(moduleData);
+	}
+	else if (!showHistogram && (state->displayThread != nullptr)) {
+		displayStop(moduleData);
+	}
+
+	state->displayMove.store(true);
+}
 
-	setWindowPosition(moduleData->moduleNode, moduleData->moduleSubSystemString);
+static void histogramCompute(uint32_t *subHistograms, size_t binsNumber, int32_t shift, const uint16_t *pixels,
+	size_t pixelsNumber) {
+	uint32_t *hist0 = subHistograms;
+	uint32_t *hist1 = hist0 + binsNumber;
+	uint32_t *hist2 = hist1 + binsNumber;
+	uint32_t *hist3 = hist2 + binsNumber;
+
+	memset(subHistograms, 0, FRAME_STATISTICS_SUB_HISTOGRAMS * binsNumber * sizeof(uint32_t));
+
+	size_t i = 0;
+
+	for (; (i + FRAME_STATISTICS_SUB_HISTOGRAMS) <= pixelsNumber; i += FRAME_STATISTICS_SUB_HISTOGRAMS) {
+		hist0[pixels[i] >> shift]++;
+		hist1[pixels[i + 1] >> shift]++;
+		hist2[pixels[i + 2] >> shift]++;
+		hist3[pixels[i + 3] >> shift]++;
+	}
+
+	for (; i < pixelsNumber; i++) {
+		hist0[pixels[i] >> shift]++;
+	}
+}
+
+static void histogramMerge(uint32_t *counts, const uint32_t *subHistograms, size_t binsNumber) {
+	const uint32_t *hist0 = subHistograms;
+	const uint32_t *hist1 = hist0 + binsNumber;
+	const uint32_t *hist2 = hist1 + binsNumber;
+	const uint32_t *hist3 = hist2 + binsNumber;
+
+	for (size_t i = 0; i < binsNumber; i++) {
+		counts[i] = hist0[i] + hist1[i] + hist2[i] + hist3[i];
+	}
+}
+
+static void pixelsSumSaturated(const uint16_t *pixels, size_t pixelsNumber, uint16_t saturationLevel, uint64_t *sum,
+	uint64_t *saturated) {
+	uint64_t totalSum = 0;
+	uint64_t totalSaturated = 0;
+
+	// Accumulate in 32-bit over blocks that cannot overflow, which keeps the
+	// inner loop in narrow lanes so that it vectorizes well.
+	for (size_t block = 0; block < pixelsNumber; block += UINT16_MAX) {
+		size_t blockEnd = (pixelsNumber - block > UINT16_MAX) ? (block + UINT16_MAX) : (pixelsNumber);
+
+		uint32_t blockSum = 0;
+		uint32_t blockSaturated = 0;
+
+		for (size_t i = block; i < blockEnd; i++) {
+			blockSum += pixels[i];
+			blockSaturated += (pixels[i] >= saturationLevel);
+		}
+
+		totalSum += blockSum;
+		totalSaturated += blockSaturated;
+	}
+
+	*sum = totalSum;
+	*saturated = totalSaturated;
+}
+
+static void statisticsUpdate(caerFrameStatisticsState state, const uint32_t *counts, int32_t bits,
+	size_t pixelsNumber, uint64_t sum, uint64_t saturated) {
+	// Percentiles are the lower edge of the bin in which the cumulative count
+	// reaches the requested fraction of all pixels.
+	const uint64_t targets[3] = { (pixelsNumber * 5 + 99) / 100, (pixelsNumber * 50 + 99) / 100,
+		(pixelsNumber * 95 + 99) / 100 };
+	int32_t percentiles[3] = { 0, 0, 0 };
+
+	int32_t shift = FRAME_STATISTICS_HISTOGRAM_MAX_BITS - bits;
+	size_t binsNumber = (size_t) 1 << bits;
+	uint64_t cumulative = 0;
+	size_t found = 0;
+
+	for (size_t i = 0; (i < binsNumber) && (found < 3); i++) {
+		cumulative += counts[i];
+
+		while ((found < 3) && (cumulative >= targets[found])) {
+			percentiles[found++] = I32T(i << shift);
+		}
+	}
+
+	union sshs_node_attr_value value;
+
+	value.ffloat = (float) ((double) sum / (double) pixelsNumber);
+	sshsNodeUpdateReadOnlyAttribute(state->statisticsNode, "mean", SSHS_FLOAT, value);
+
+	value.iint = percentiles[0];
+	sshsNodeUpdateReadOnlyAttribute(state->statisticsNode, "percentile5", SSHS_INT, value);
+
+	value.iint = percentiles[1];
+	sshsNodeUpdateReadOnlyAttribute(state->statisticsNode, "median", SSHS_INT, value);
+
+	value.iint = percentiles[2];
+	sshsNodeUpdateReadOnlyAttribute(state->statisticsNode, "percentile95", SSHS_INT, value);
+
+	value.ffloat = (float) ((double) saturated / (double) pixelsNumber);
+	sshsNodeUpdateReadOnlyAttribute(state->statisticsNode, "saturatedFraction", SSHS_FLOAT, value);
+}
+
+static void statisticsReset(caerFrameStatisticsState state) {
+	union sshs_node_attr_value value;
+
+	value.ffloat = 0;
+	sshsNodeUpdateReadOnlyAttribute(state->statisticsNode, "mean", SSHS_FLOAT, value);
+	sshsNodeUpdateReadOnlyAttribute(state->statisticsNode, "saturatedFraction", SSHS_FLOAT, value);
+
+	value.iint = 0;
+	sshsNodeUpdateReadOnlyAttribute(state->statisticsNode, "percentile5", SSHS_INT, value);
+	sshsNodeUpdateReadOnlyAttribute(state->statisticsNode, "median", SSHS_INT, value);
+	sshsNodeUpdateReadOnlyAttribute(state->statisticsNode, "percentile95", SSHS_INT, value);
+}
+
+static bool displayStart(caerModuleData moduleData) {
+	caerFrameStatisticsState state = (caerFrameStatisticsState) moduleData->moduleState;
+
+	// Start separate display thread. OpenCV GUI calls, and especially waitKey(),
+	// can block for a long time and must never stall the mainloop.
+	state->displayRunning.store(true);
+	state->displayMove.store(true);
+
+	try {
+		state->displayThread = new std::thread(&displayThread, moduleData);
+	}
+	catch (const std::system_error &ex) {
+		state->displayThread = nullptr;
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to start display thread. Error: '%s' (%d).", ex.what(),
+			ex.code().value());
+		return (false);
+	}
+
+	return (true);
+}
+
+static void displayStop(caerModuleData moduleData) {
+	caerFrameStatisticsState state = (caerFrameStatisticsState) moduleData->moduleState;
+
+	if (state->displayThread == nullptr) {
+		return;
+	}
+
+	// Shut down display thread and wait on it to finish.
+	state->displayRunning.store(false);
+
+	try {
+		state->displayThread->join();
+	}
+	catch (const std::system_error &ex) {
+		// This should never happen!
+		caerModuleLog(moduleData, CAER_LOG_CRITICAL, "Failed to join display thread. Error: '%s' (%d).", ex.what(),
+			ex.code().value());
+	}
+
+	delete state->displayThread;
+	state->displayThread = nullptr;
+}
+
+static void displayThread(caerModuleData moduleData) {
+	caerFrameStatisticsState state = (caerFrameStatisticsState) moduleData->moduleState;
+
+	// Set thread name.
+	thrd_set_name(moduleData->moduleSubSystemString);
+
+	// Window is created, used and destroyed only on this thread.
+	cv::namedWindow(moduleData->moduleSubSystemString, cv::WindowFlags::WINDOW_AUTOSIZE |
+		cv::WindowFlags::WINDOW_KEEPRATIO | cv::WindowFlags::WINDOW_GUI_EXPANDED);
+
+	while (state->displayRunning.load(std::memory_order_relaxed)) {
+		if (state->displayMove.exchange(false)) {
+			setWindowPosition(moduleData->moduleNode, moduleData->moduleSubSystemString);
+		}
+
+		// Only ever draw the latest histogram, older ones were overwritten.
+		if (state->histogramExchange.load(std::memory_order_relaxed) & FRAME_STATISTICS_DISPLAY_NEW) {
+			uint_fast8_t previous = state->histogramExchange.exchange(state->histogramRead,
+				std::memory_order_acq_rel);
+			state->histogramRead = U8T(previous & FRAME_STATISTICS_DISPLAY_INDEX_MASK);
+
+			const struct frame_statistics_histogram *histogram = &state->histograms[state->histogramRead];
+
+			// Reduce the histogram to the requested number of bins.
+			int numBins = histogram->numBins;
+			size_t binsNumber = (size_t) 1 << histogram->bits;
+
+			cv::Mat hist(numBins, 1, CV_32FC1, cv::Scalar(0));
+
+			for (size_t i = 0; i < binsNumber; i++) {
+				hist.at<float>(I32T((i * (size_t) numBins) >> histogram->bits)) += (float) histogram->counts[i];
+			}
+
+			// Generate histogram image, with N x N/3 pixels.
+			int hist_w = numBins;
+			int hist_h = numBins / 3;
+
+			cv::Mat histImage(hist_h, hist_w, CV_8UC1, cv::Scalar(0));
+
+			// Normalize the result to [0, histImage.rows].
+			cv::normalize(hist, hist, 0, histImage.rows, cv::NORM_MINMAX, -1, cv::Mat());
+
+			// Draw the histogram.
+			for (int i = 1; i < numBins; i++) {
+				cv::line(histImage, cv::Point(i - 1, hist_h - cvRound(hist.at<float>(i - 1))),
+					cv::Point(i, hist_h - cvRound(hist.at<float>(i))), cv::Scalar(255, 255, 255), 2, 8, 0);
+			}
+
+			// Simple display, just use OpenCV GUI.
+			cv::imshow(moduleData->moduleSubSystemString, histImage);
+		}
+
+		// Process window events, also paces this loop when no new data arrives.
+		cv::waitKey(10);
+	}
+
+	cv::destroyWindow(moduleData->moduleSubSystemString);
 }
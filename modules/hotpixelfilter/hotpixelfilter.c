@@ -0,0 +1,194 @@
+#include "main.h"
+#include "base/mainloop.h"
+#include "base/module.h"
+#include "ext/pathmax.h"
+#include "modules/misc/hotpixel_mask.h"
+
+#include <libcaer/events/polarity.h>
+
+#include <errno.h>
+
+struct HotPixelFilter_state {
+	struct caer_hotpixel_mask mask;
+	struct caer_hotpixel_learner learner;
+	int32_t learnRate;
+	char *maskFile;
+};
+
+typedef struct HotPixelFilter_state *HotPixelFilterState;
+
+static void caerHotPixelFilterConfigInit(sshsNode moduleNode);
+static bool caerHotPixelFilterInit(caerModuleData moduleData);
+static void caerHotPixelFilterRun(caerModuleData moduleData, caerEventPacketContainer in,
+	caerEventPacketContainer *out);
+static void caerHotPixelFilterConfig(caerModuleData moduleData);
+static void caerHotPixelFilterExit(caerModuleData moduleData);
+static void learnDone(caerModuleData moduleData);
+
+static const struct caer_module_functions HotPixelFilterFunctions = { .moduleConfigInit =
+	&caerHotPixelFilterConfigInit, .moduleInit = &caerHotPixelFilterInit, .moduleRun = &caerHotPixelFilterRun,
+	.moduleConfig = &caerHotPixelFilterConfig, .moduleExit = &caerHotPixelFilterExit, .moduleReset = NULL };
+
+static const struct caer_event_stream_in HotPixelFilterInputs[] = { { .type = POLARITY_EVENT, .number = 1, .readOnly =
+	false } };
+
+static const struct caer_module_info HotPixelFilterInfo = { .version = 1, .name = "HotPixelFilter", .description =
+	"Learns which pixels are hot and filters out their events.", .type = CAER_MODULE_PROCESSOR, .memSize =
+	sizeof(struct HotPixelFilter_state), .functions = &HotPixelFilterFunctions, .inputStreams = HotPixelFilterInputs,
+	.inputStreamsSize = CAER_EVENT_STREAM_IN_SIZE(HotPixelFilterInputs), .outputStreams = NULL, .outputStreamsSize =
+		0, };
+
+caerModuleInfo caerModuleGetInfo(void) {
+	return (&HotPixelFilterInfo);
+}
+
+static void caerHotPixelFilterConfigInit(sshsNode moduleNode) {
+	sshsNodeCreateString(moduleNode, "maskFile", "hotpixelfilter.mask", 1, PATH_MAX, SSHS_FLAGS_NORMAL,
+		"File to load the hot-pixel mask from at startup, and to save it to after learning.");
+	sshsNodeCreateBool(moduleNode, "learn", false, SSHS_FLAGS_NORMAL,
+		"Learn a new hot-pixel mask over the next learnTime ms of events.");
+	sshsNodeCreateInt(moduleNode, "learnTime", 5000, 100, 600000, SSHS_FLAGS_NORMAL,
+		"Duration of the learning window in ms.");
+	sshsNodeCreateInt(moduleNode, "learnRate", 100, 1, 10000000, SSHS_FLAGS_NORMAL,
+		"Pixels with a mean event rate in Hz at or above this during learning are considered hot.");
+}
+
+static bool caerHotPixelFilterInit(caerModuleData moduleData) {
+	// Wait for input to be ready. All inputs, once they are up and running, will
+	// have a valid sourceInfo node to query, especially if dealing with data.
+	int16_t *inputs = caerMainloopGetModuleInputIDs(moduleData->moduleID, NULL);
+	if (inputs == NULL) {
+		return (false);
+	}
+
+	int16_t sourceID = inputs[0];
+	free(inputs);
+
+	HotPixelFilterState state = moduleData->moduleState;
+
+	// Allocate mask using info from sourceInfo.
+	sshsNode sourceInfo = caerMainloopGetSourceInfo(sourceID);
+	if (sourceInfo == NULL) {
+		return (false);
+	}
+
+	if (!caerHotPixelMaskInit(&state->mask, sshsNodeGetShort(sourceInfo, "polaritySizeX"),
+		sshsNodeGetShort(sourceInfo, "polaritySizeY"))) {
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for hot-pixel mask.");
+		return (false);
+	}
+
+	// Never start learning right away, only on explicit request.
+	sshsNodePutBool(moduleData->moduleNode, "learn", false);
+
+	caerHotPixelFilterConfig(moduleData);
+
+	if (caerHotPixelMaskLoad(&state->mask, state->maskFile)) {
+		caerModuleLog(moduleData, CAER_LOG_INFO, "Loaded hot-pixel mask from '%s'.", state->maskFile);
+	}
+	else {
+		caerModuleLog(moduleData, CAER_LOG_WARNING,
+			"No valid hot-pixel mask for this sensor in '%s', no pixels filtered until one is learned.",
+			state->maskFile);
+	}
+
+	// Add config listeners last, to avoid having them dangling if Init doesn't succeed.
+	sshsNodeAddAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
+
+	// Nothing that can fail here.
+	return (true);
+}
+
+static void caerHotPixelFilterRun(caerModuleData moduleData, caerEventPacketContainer in,
+	caerEventPacketContainer *out) {
+	UNUSED_ARGUMENT(out);
+
+	caerPolarityEventPacket polarity = (caerPolarityEventPacket) caerEventPacketContainerFindEventPacketByType(in,
+		POLARITY_EVENT);
+
+	// Only process packets with content.
+	if (polarity == NULL) {
+		return;
+	}
+
+	HotPixelFilterState state = moduleData->moduleState;
+
+	// Learning counts all events, including those of pixels currently masked.
+	if (caerHotPixelLearnerActive(&state->learner)) {
+		CAER_POLARITY_CONST_ITERATOR_VALID_START(polarity)
+			if (caerHotPixelLearnerAdd(&state->learner, &state->mask, caerPolarityEventGetX(caerPolarityIteratorElement),
+				caerPolarityEventGetY(caerPolarityIteratorElement),
+				caerPolarityEventGetTimestamp64(caerPolarityIteratorElement, polarity))) {
+				learnDone(moduleData);
+				break;
+			}
+		CAER_POLARITY_ITERATOR_VALID_END
+	}
+
+	// The mask lookup itself is branchless, only the (rare) hot events take a branch.
+	CAER_POLARITY_ITERATOR_VALID_START(polarity)
+		if (caerHotPixelMaskGet(&state->mask, caerPolarityEventGetX(caerPolarityIteratorElement),
+			caerPolarityEventGetY(caerPolarityIteratorElement))) {
+			caerPolarityEventInvalidate(caerPolarityIteratorElement, polarity);
+		}
+	CAER_POLARITY_ITERATOR_VALID_END
+}
+
+/**
+ * Build the new mask from the learning window and save it.
+ */
+static void learnDone(caerModuleData moduleData) {
+	HotPixelFilterState state = moduleData->moduleState;
+
+	size_t hotPixels = caerHotPixelLearnerFinish(&state->learner, &state->mask, state->learnRate);
+
+	if (caerHotPixelMaskSave(&state->mask, state->maskFile)) {
+		caerModuleLog(moduleData, CAER_LOG_INFO, "Learning done, %zu hot pixels found. Mask saved to '%s'.", hotPixels,
+			state->maskFile);
+	}
+	else {
+		caerModuleLog(moduleData, CAER_LOG_ERROR,
+			"Learning done, %zu hot pixels found. Failed to save mask to '%s'. Error: %d.", hotPixels, state->maskFile,
+			errno);
+	}
+
+	sshsNodePutBool(moduleData->moduleNode, "learn", false);
+}
+
+static void caerHotPixelFilterConfig(caerModuleData moduleData) {
+	caerModuleConfigUpdateReset(moduleData);
+
+	HotPixelFilterState state = moduleData->moduleState;
+
+	state->learnRate = sshsNodeGetInt(moduleData->moduleNode, "learnRate");
+
+	// Only pick up a new file name when not learning, so the mask goes where the user expects.
+	if (!caerHotPixelLearnerActive(&state->learner)) {
+		free(state->maskFile);
+		state->maskFile = sshsNodeGetString(moduleData->moduleNode, "maskFile");
+	}
+
+	// Start learning on request, the window begins with the next event.
+	if (sshsNodeGetBool(moduleData->moduleNode, "learn") && !caerHotPixelLearnerActive(&state->learner)) {
+		if (caerHotPixelLearnerStart(&state->learner, &state->mask,
+			I64T(sshsNodeGetInt(moduleData->moduleNode, "learnTime")) * 1000)) {
+			caerModuleLog(moduleData, CAER_LOG_INFO, "Hot-pixel learning started.");
+		}
+		else {
+			caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for hot-pixel learning.");
+			sshsNodePutBool(moduleData->moduleNode, "learn", false);
+		}
+	}
+}
+
+static void caerHotPixelFilterExit(caerModuleData moduleData) {
+	// Remove listener, which can reference invalid memory in userData.
+	sshsNodeRemoveAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
+
+	HotPixelFilterState state = moduleData->moduleState;
+
+	caerHotPixelLearnerStop(&state->learner);
+	caerHotPixelMaskFree(&state->mask);
+
+	free(state->maskFile);
+}
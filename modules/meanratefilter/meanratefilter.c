@@ -6,26 +6,51 @@
 
 #include "base/mainloop.h"
 #include "base/module.h"
-#include "ext/buffers.h"
 #include "ext/portable_time.h"
 #include "ext/colorjet/colorjet.h"
 #include <time.h>
+#include <math.h>
 #include <libcaer/devices/dynapse.h>
 #include <libcaer/events/spike.h>
 #include <libcaer/events/frame.h> //display
 #include "modules/ini/dynapse_utils.h"
 
+#define MRFILTER_NEURONS_NUMBER (DYNAPSE_X4BOARD_NUMCHIPS * DYNAPSE_CONFIG_NUMCORES * DYNAPSE_CONFIG_NUMNEURONS_CORE)
+
+// Exponentially-weighted rate estimate of one neuron, in Hz. Decay is applied
+// lazily: 'rate' is only valid at 'lastTimestamp' and must be decayed to the
+// time of any later read.
+struct MRFilter_neuron {
+	float rate;
+	int64_t lastTimestamp;
+	// Whether the neuron is in the active list, see MRFilter_state.
+	bool active;
+};
+
 struct MRFilter_state {
 	sshsNode dynapseConfigNode;
-	simple2DBufferFloat frequencyMap;
-	simple2DBufferLong spikeCountMap;
+	// Flat array, indexed by (chip, core, neuron), so each core is contiguous.
+	struct MRFilter_neuron *neurons;
+	// Frame pixel offset for each neuron, to draw the flat array as an image.
+	uint32_t *neuronPixel;
+	// Visible neurons that may be above colorscaleMin in the next frame: those
+	// that spiked since the last one, and those still decaying. All others are
+	// black, which is what new frames start out as, so only these are drawn.
+	uint32_t *activeNeurons;
+	size_t activeNeuronsNumber;
+	int16_t sizeX;
+	int16_t sizeY;
 	int32_t colorscaleMax;
 	int32_t colorscaleMin;
 	float targetFreq;
 	float measureMinTime;
+	float rateTimeConstant;
+	int64_t frameInterval;
 	bool doSetFreq;
 	bool startedMeasure;
 	double measureStartedAt;
+	int64_t lastTimestamp;
+	int64_t lastFrameTimestamp;
 };
 
 typedef struct MRFilter_state *MRFilterState;
@@ -37,6 +62,8 @@ static void caerMeanRateFilterExit(caerModuleData moduleData);
 static void caerMeanRateFilterReset(caerModuleData moduleData, int16_t resetCallSourceID);
 static void generateOutputFrame(caerEventPacketContainer *out, MRFilterState state, int16_t moduleId,
 	int32_t tsOverflow);
+static void adjustBiases(caerModuleData moduleData, MRFilterState state);
+static void activeNeuronsRebuild(MRFilterState state);
 
 static struct caer_module_functions caerMeanRateFilterFunctions = { .moduleInit = &caerMeanRateFilterInit, .moduleRun =
 	&caerMeanRateFilterRun, .moduleConfig = &caerMeanRateFilterConfig, .moduleExit = &caerMeanRateFilterExit,
@@ -56,6 +83,26 @@ caerModuleInfo caerModuleGetInfo(void) {
 	return (&moduleInfo);
 }
 
+static inline size_t neuronIndex(uint16_t x, uint16_t y) {
+	size_t chip = (size_t) (((y / DYNAPSE_CONFIG_YCHIPSIZE) << 1) | (x / DYNAPSE_CONFIG_XCHIPSIZE));
+	size_t core = (size_t) ((((y % DYNAPSE_CONFIG_YCHIPSIZE) / DYNAPSE_CONFIG_NEUROW) << 1)
+		| ((x % DYNAPSE_CONFIG_XCHIPSIZE) / DYNAPSE_CONFIG_NEUCOL));
+	size_t neuron = (size_t) (((y % DYNAPSE_CONFIG_NEUROW) * DYNAPSE_CONFIG_NEUCOL) + (x % DYNAPSE_CONFIG_NEUCOL));
+
+	return ((((chip * DYNAPSE_CONFIG_NUMCORES) + core) * DYNAPSE_CONFIG_NUMNEURONS_CORE) + neuron);
+}
+
+// Rate of a neuron at time 'now', decaying it from its last update.
+static inline float neuronRate(const struct MRFilter_neuron *neuron, int64_t now, float decayPerUs) {
+	int64_t elapsed = now - neuron->lastTimestamp;
+
+	if ((neuron->rate <= 0.0f) || (elapsed <= 0)) {
+		return (neuron->rate);
+	}
+
+	return (neuron->rate * expf(decayPerUs * (float) elapsed));
+}
+
 static bool caerMeanRateFilterInit(caerModuleData moduleData) {
 	MRFilterState state = moduleData->moduleState;
 
@@ -76,7 +123,11 @@ static bool caerMeanRateFilterInit(caerModuleData moduleData) {
 	sshsNodeCreateFloat(moduleData->moduleNode, "targetFreq", 100, 0, 250, SSHS_FLAGS_NORMAL,
 		"Target frequency for neurons.");
 	sshsNodeCreateFloat(moduleData->moduleNode, "measureMinTime", 3, 0.001f, 300, SSHS_FLAGS_NORMAL,
-		"Measure time before updating the mean (in seconds).");
+		"Measure time before updating the biases (in seconds).");
+	sshsNodeCreateFloat(moduleData->moduleNode, "rateTimeConstant", 1, 0.001f, 300, SSHS_FLAGS_NORMAL,
+		"Time constant of the exponentially-weighted rate estimate (in seconds).");
+	sshsNodeCreateInt(moduleData->moduleNode, "frameInterval", 100, 1, 60000, SSHS_FLAGS_NORMAL,
+		"Time between output frames (in ms, based on event timestamps).");
 	sshsNodeCreateBool(moduleData->moduleNode, "doSetFreq", false, SSHS_FLAGS_NORMAL,
 		"Start/Stop changing biases for reaching target frequency.");
 
@@ -85,27 +136,50 @@ static bool caerMeanRateFilterInit(caerModuleData moduleData) {
 		return (false);
 	}
 
-	int16_t sizeX = sshsNodeGetShort(sourceInfoSource, "dataSizeX");
-	int16_t sizeY = sshsNodeGetShort(sourceInfoSource, "dataSizeY");
+	state->sizeX = sshsNodeGetShort(sourceInfoSource, "dataSizeX");
+	state->sizeY = sshsNodeGetShort(sourceInfoSource, "dataSizeY");
 
-	state->frequencyMap = simple2DBufferInitFloat((size_t) sizeX, (size_t) sizeY);
-	if (state->frequencyMap == NULL) {
+	state->neurons = calloc(MRFILTER_NEURONS_NUMBER, sizeof(struct MRFilter_neuron));
+	if (state->neurons == NULL) {
 		return (false);
 	}
 
-	state->spikeCountMap = simple2DBufferInitLong((size_t) sizeX, (size_t) sizeY);
-	if (state->spikeCountMap == NULL) {
+	state->neuronPixel = malloc(MRFILTER_NEURONS_NUMBER * sizeof(uint32_t));
+	if (state->neuronPixel == NULL) {
+		free(state->neurons);
 		return (false);
 	}
 
+	state->activeNeurons = malloc(MRFILTER_NEURONS_NUMBER * sizeof(uint32_t));
+	if (state->activeNeurons == NULL) {
+		free(state->neurons);
+		free(state->neuronPixel);
+		return (false);
+	}
+
+	// Neurons not visible in the output frame are never drawn.
+	for (size_t i = 0; i < MRFILTER_NEURONS_NUMBER; i++) {
+		state->neuronPixel[i] = UINT32_MAX;
+	}
+
+	for (uint16_t y = 0; y < state->sizeY; y++) {
+		for (uint16_t x = 0; x < state->sizeX; x++) {
+			size_t idx = neuronIndex(x, y);
+
+			if (idx < MRFILTER_NEURONS_NUMBER) {
+				state->neuronPixel[idx] = U32T((y * state->sizeX) + x);
+			}
+		}
+	}
+
 	sshsNode sourceInfoNode = sshsGetRelativeNode(moduleData->moduleNode, "sourceInfo/");
-	sshsNodeCreateShort(sourceInfoNode, "frameSizeX", sizeX, 1, 1024, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
-		"Output frame width.");
-	sshsNodeCreateShort(sourceInfoNode, "frameSizeY", sizeY, 1, 1024, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
-		"Output frame height.");
-	sshsNodeCreateShort(sourceInfoNode, "dataSizeX", sizeX, 1, 1024, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+	sshsNodeCreateShort(sourceInfoNode, "frameSizeX", state->sizeX, 1, 1024,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Output frame width.");
+	sshsNodeCreateShort(sourceInfoNode, "frameSizeY", state->sizeY, 1, 1024,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Output frame height.");
+	sshsNodeCreateShort(sourceInfoNode, "dataSizeX", state->sizeX, 1, 1024, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
 		"Output data width.");
-	sshsNodeCreateShort(sourceInfoNode, "dataSizeY", sizeY, 1, 1024, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+	sshsNodeCreateShort(sourceInfoNode, "dataSizeY", state->sizeY, 1, 1024, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
 		"Output data height.");
 
 	caerMeanRateFilterConfig(moduleData);
@@ -130,14 +204,48 @@ static void caerMeanRateFilterRun(caerModuleData moduleData, caerEventPacketCont
 
 	MRFilterState state = moduleData->moduleState;
 
-	// Iterate over events and update count
+	// Each spike adds 1/tau to the rate, which decays with time constant tau:
+	// in steady state this converges to the firing frequency in Hz.
+	float rateIncrement = 1.0f / state->rateTimeConstant;
+	float decayPerUs = -1.0e-6f * rateIncrement;
+
+	// Iterate over events and update only the neurons that spiked.
 	CAER_SPIKE_CONST_ITERATOR_VALID_START(spike)
 		uint16_t x = caerDynapseSpikeEventGetX(caerSpikeIteratorElement);
 		uint16_t y = caerDynapseSpikeEventGetY(caerSpikeIteratorElement);
 
-		state->spikeCountMap->buffer2d[x][y] += 1;
+		if ((x >= state->sizeX) || (y >= state->sizeY)) {
+			continue;
+		}
+
+		size_t idx = neuronIndex(x, y);
+		if (idx >= MRFILTER_NEURONS_NUMBER) {
+			continue;
+		}
+
+		int64_t ts = caerSpikeEventGetTimestamp64(caerSpikeIteratorElement, spike);
+
+		struct MRFilter_neuron *neuron = &state->neurons[idx];
+
+		neuron->rate = neuronRate(neuron, ts, decayPerUs) + rateIncrement;
+		neuron->lastTimestamp = ts;
+
+		if (!neuron->active && (state->neuronPixel[idx] != UINT32_MAX)) {
+			neuron->active = true;
+			state->activeNeurons[state->activeNeuronsNumber++] = U32T(idx);
+		}
+
+		state->lastTimestamp = ts;
 	CAER_SPIKE_ITERATOR_VALID_END
 
+	// Emit a frame on the configured cadence.
+	if ((state->lastTimestamp - state->lastFrameTimestamp) >= state->frameInterval) {
+		state->lastFrameTimestamp = state->lastTimestamp;
+
+		generateOutputFrame(out, state, moduleData->moduleID,
+			caerEventPacketHeaderGetEventTSOverflow(&spike->packetHeader));
+	}
+
 	// if not measuring, let's start
 	if (!state->startedMeasure) {
 		struct timespec tStart;
@@ -155,131 +263,117 @@ static void caerMeanRateFilterRun(caerModuleData moduleData, caerEventPacketCont
 	if ((now - state->measureStartedAt) >= (double) state->measureMinTime) {
 		state->startedMeasure = false;
 
-		// update frequencyMap
-		for (size_t x = 0; x < state->frequencyMap->sizeX; x++) {
-			for (size_t y = 0; y < state->frequencyMap->sizeY; y++) {
-				state->frequencyMap->buffer2d[x][y] = (float) state->spikeCountMap->buffer2d[x][y]
-					/ state->measureMinTime;
-
-				// reset count
-				state->spikeCountMap->buffer2d[x][y] = 0;
-			}
+		// set the biases if asked
+		if (state->doSetFreq) {
+			adjustBiases(moduleData, state);
 		}
+	}
+}
 
-		// Generate output frame, after frequency map has been updated.
-		generateOutputFrame(out, state, moduleData->moduleID,
-			caerEventPacketHeaderGetEventTSOverflow(&spike->packetHeader));
+static void adjustBiases(caerModuleData moduleData, MRFilterState state) {
+	float decayPerUs = -1.0e-6f / state->rateTimeConstant;
 
-		// set the biases if asked
-		if (state->doSetFreq) {
-			// collect data for all chips and cores
-			float sum[DYNAPSE_X4BOARD_NUMCHIPS][DYNAPSE_CONFIG_NUMCORES] = { 0 };
-			float mean[DYNAPSE_X4BOARD_NUMCHIPS][DYNAPSE_CONFIG_NUMCORES] = { 0 };
-			float var[DYNAPSE_X4BOARD_NUMCHIPS][DYNAPSE_CONFIG_NUMCORES] = { 0 };
-
-			// loop over all chips and cores
-			for (size_t chip = 0; chip < DYNAPSE_X4BOARD_NUMCHIPS; chip++) {
-				for (size_t core = 0; core < DYNAPSE_CONFIG_NUMCORES; core++) {
-					float maxFrequency = 0;
-
-					// Calculate X/Y region of interest.
-					size_t startX = ((core & 0x01) * DYNAPSE_CONFIG_NEUCOL)
-						+ ((chip & 0x01) * DYNAPSE_CONFIG_XCHIPSIZE);
-					size_t startY = ((core & 0x02) * DYNAPSE_CONFIG_NEUROW)
-						+ ((chip & 0x02) * DYNAPSE_CONFIG_YCHIPSIZE);
-
-					// get sum for core
-					for (size_t x = startX; x < (startX + DYNAPSE_CONFIG_NEUCOL); x++) {
-						for (size_t y = startY; y < (startY + DYNAPSE_CONFIG_NEUROW); y++) {
-							sum[chip][core] += state->frequencyMap->buffer2d[x][y];
-
-							if (maxFrequency < state->frequencyMap->buffer2d[x][y]) {
-								maxFrequency = state->frequencyMap->buffer2d[x][y];
-							}
-						}
-					}
+	// collect data for all chips and cores
+	float mean[DYNAPSE_X4BOARD_NUMCHIPS][DYNAPSE_CONFIG_NUMCORES] = { 0 };
+	float var[DYNAPSE_X4BOARD_NUMCHIPS][DYNAPSE_CONFIG_NUMCORES] = { 0 };
 
-					// calculate mean
-					mean[chip][core] = sum[chip][core] / (float) DYNAPSE_CONFIG_NUMNEURONS_CORE;
+	// loop over all chips and cores
+	for (size_t chip = 0; chip < DYNAPSE_X4BOARD_NUMCHIPS; chip++) {
+		for (size_t core = 0; core < DYNAPSE_CONFIG_NUMCORES; core++) {
+			// All neurons of a core are contiguous.
+			const struct MRFilter_neuron *coreNeurons = &state->neurons[((chip * DYNAPSE_CONFIG_NUMCORES) + core)
+				* DYNAPSE_CONFIG_NUMNEURONS_CORE];
 
-					// calculate variance
-					for (size_t x = startX; x < (startX + DYNAPSE_CONFIG_NEUCOL); x++) {
-						for (size_t y = startY; y < (startY + DYNAPSE_CONFIG_NEUROW); y++) {
-							float f = state->frequencyMap->buffer2d[x][y] - mean[chip][core];
-							var[chip][core] += f * f;
-						}
-					}
+			float rates[DYNAPSE_CONFIG_NUMNEURONS_CORE];
+			float sum = 0;
+			float maxFrequency = 0;
+
+			// get sum for core
+			for (size_t i = 0; i < DYNAPSE_CONFIG_NUMNEURONS_CORE; i++) {
+				rates[i] = neuronRate(&coreNeurons[i], state->lastTimestamp, decayPerUs);
+				sum += rates[i];
 
-					caerModuleLog(moduleData, CAER_LOG_NOTICE,
-						"mean[%zu][%zu] = %f Hz var[%zu][%zu] = %f maxFrequency %f.", chip, core,
-						(double) mean[chip][core], chip, core, (double) var[chip][core], (double) maxFrequency);
+				if (maxFrequency < rates[i]) {
+					maxFrequency = rates[i];
 				}
 			}
 
-			// now decide how to change the bias setting
-			for (uint8_t chip = 0; chip < DYNAPSE_X4BOARD_NUMCHIPS; chip++) {
-				for (uint8_t core = 0; core < DYNAPSE_CONFIG_NUMCORES; core++) {
-					caerModuleLog(moduleData, CAER_LOG_NOTICE,
-						"mean[%d][%d] = %f Hz var[%d][%d] = %f chipId = %d coreId %d.", chip, core,
-						(double) mean[chip][core], chip, core, (double) var[chip][core], chip, core);
-
-					// current dc settings
-					uint8_t coarseValue;
-					uint8_t fineValue;
-					caerDynapseGetBiasCore(state->dynapseConfigNode, chip, core, "IF_DC_P", &coarseValue, &fineValue,
-						NULL);
-
-					caerModuleLog(moduleData, CAER_LOG_NOTICE, "BIAS U%d C%d_IF_DC_P coarse %d fine %d.", chip, core,
-						coarseValue, fineValue);
-
-					bool changed = false;
-					uint8_t step = 15; // fine step value
-
-					// compare current frequency with target
-					if ((state->targetFreq - mean[chip][core]) > 0) {
-						// we need to increase freq -> increase fine
-						if ((I16T(fineValue) + step) <= UINT8_MAX) {
-							fineValue = U8T(fineValue + step);
-							changed = true;
-						}
-						else {
-							// if we did not reach the max value
-							if (coarseValue != 0) {
-								fineValue = step;
-								coarseValue = U8T(coarseValue - 1); // coarse 0 is max 7 is min
-								changed = true;
-							}
-							else {
-								caerModuleLog(moduleData, CAER_LOG_NOTICE, "Reached Maximum Limit for Bias.");
-							}
-						}
+			// calculate mean
+			mean[chip][core] = sum / (float) DYNAPSE_CONFIG_NUMNEURONS_CORE;
+
+			// calculate variance
+			for (size_t i = 0; i < DYNAPSE_CONFIG_NUMNEURONS_CORE; i++) {
+				float f = rates[i] - mean[chip][core];
+				var[chip][core] += f * f;
+			}
+
+			caerModuleLog(moduleData, CAER_LOG_NOTICE, "mean[%zu][%zu] = %f Hz var[%zu][%zu] = %f maxFrequency %f.",
+				chip, core, (double) mean[chip][core], chip, core, (double) var[chip][core], (double) maxFrequency);
+		}
+	}
+
+	// now decide how to change the bias setting
+	for (uint8_t chip = 0; chip < DYNAPSE_X4BOARD_NUMCHIPS; chip++) {
+		for (uint8_t core = 0; core < DYNAPSE_CONFIG_NUMCORES; core++) {
+			caerModuleLog(moduleData, CAER_LOG_NOTICE,
+				"mean[%d][%d] = %f Hz var[%d][%d] = %f chipId = %d coreId %d.", chip, core,
+				(double) mean[chip][core], chip, core, (double) var[chip][core], chip, core);
+
+			// current dc settings
+			uint8_t coarseValue;
+			uint8_t fineValue;
+			caerDynapseGetBiasCore(state->dynapseConfigNode, chip, core, "IF_DC_P", &coarseValue, &fineValue,
+				NULL);
+
+			caerModuleLog(moduleData, CAER_LOG_NOTICE, "BIAS U%d C%d_IF_DC_P coarse %d fine %d.", chip, core,
+				coarseValue, fineValue);
+
+			bool changed = false;
+			uint8_t step = 15; // fine step value
+
+			// compare current frequency with target
+			if ((state->targetFreq - mean[chip][core]) > 0) {
+				// we need to increase freq -> increase fine
+				if ((I16T(fineValue) + step) <= UINT8_MAX) {
+					fineValue = U8T(fineValue + step);
+					changed = true;
+				}
+				else {
+					// if we did not reach the max value
+					if (coarseValue != 0) {
+						fineValue = step;
+						coarseValue = U8T(coarseValue - 1); // coarse 0 is max 7 is min
+						changed = true;
 					}
-					else if ((state->targetFreq - mean[chip][core]) < 0) {
-						// we need to reduce freq -> decrease fine
-						if ((I16T(fineValue) - step) >= 0) {
-							fineValue = U8T(fineValue - step);
-							changed = true;
-						}
-						else {
-							// if we did not reach the max value
-							if (coarseValue != 7) {
-								fineValue = step;
-								coarseValue = U8T(coarseValue + 1); // coarse 0 is max 7 is min
-								changed = true;
-							}
-							else {
-								caerModuleLog(moduleData, CAER_LOG_NOTICE, "Reached Minimum Limit for Bias.");
-							}
-						}
+					else {
+						caerModuleLog(moduleData, CAER_LOG_NOTICE, "Reached Maximum Limit for Bias.");
 					}
-
-					if (changed) {
-						// send new bias value
-						caerDynapseSetBiasCore(state->dynapseConfigNode, chip, core, "IF_DC_P", coarseValue, fineValue,
-							true);
+				}
+			}
+			else if ((state->targetFreq - mean[chip][core]) < 0) {
+				// we need to reduce freq -> decrease fine
+				if ((I16T(fineValue) - step) >= 0) {
+					fineValue = U8T(fineValue - step);
+					changed = true;
+				}
+				else {
+					// if we did not reach the max value
+					if (coarseValue != 7) {
+						fineValue = step;
+						coarseValue = U8T(coarseValue + 1); // coarse 0 is max 7 is min
+						changed = true;
+					}
+					else {
+						caerModuleLog(moduleData, CAER_LOG_NOTICE, "Reached Minimum Limit for Bias.");
 					}
 				}
 			}
+
+			if (changed) {
+				// send new bias value
+				caerDynapseSetBiasCore(state->dynapseConfigNode, chip, core, "IF_DC_P", coarseValue, fineValue,
+					true);
+			}
 		}
 	}
 }
@@ -293,8 +387,8 @@ static void generateOutputFrame(caerEventPacketContainer *out, MRFilterState sta
 	}
 
 	// Everything that is in the out packet container will be automatically freed after main loop.
-	caerFrameEventPacket frameOut = caerFrameEventPacketAllocate(1, moduleId, tsOverflow,
-		I32T(state->frequencyMap->sizeX), I32T(state->frequencyMap->sizeY), RGB);
+	caerFrameEventPacket frameOut = caerFrameEventPacketAllocate(1, moduleId, tsOverflow, state->sizeX, state->sizeY,
+		RGB);
 	if (frameOut == NULL) {
 		return; // Error.
 	}
@@ -306,20 +400,33 @@ static void generateOutputFrame(caerEventPacketContainer *out, MRFilterState sta
 	// Make image.
 	caerFrameEvent frequencyPlot = caerFrameEventPacketGetEvent(frameOut, 0);
 
-	size_t counter = 0;
-	for (size_t y = 0; y < state->frequencyMap->sizeY; y++) {
-		for (size_t x = 0; x < state->frequencyMap->sizeX; x++) {
-			COLOUR color = GetColour(state->frequencyMap->buffer2d[x][y], state->colorscaleMin, state->colorscaleMax);
-			frequencyPlot->pixels[counter] = U16T(color.r * UINT16_MAX); // red
-			frequencyPlot->pixels[counter + 1] = U16T(color.g * UINT16_MAX); // green
-			frequencyPlot->pixels[counter + 2] = U16T(color.b * UINT16_MAX); // blue
-			counter += RGB;
+	float decayPerUs = -1.0e-6f / state->rateTimeConstant;
+
+	// Decay active rates to the latest timestamp, so all pixels show the same instant.
+	// Neurons that decayed to colorscaleMin or below are black until they spike again.
+	for (size_t i = 0; i < state->activeNeuronsNumber;) {
+		uint32_t idx = state->activeNeurons[i];
+
+		float rate = neuronRate(&state->neurons[idx], state->lastTimestamp, decayPerUs);
+
+		if (rate <= (float) state->colorscaleMin) {
+			state->neurons[idx].active = false;
+			state->activeNeurons[i] = state->activeNeurons[--state->activeNeuronsNumber];
+			continue;
 		}
+
+		i++;
+
+		size_t counter = state->neuronPixel[idx] * RGB;
+
+		COLOUR color = GetColour(rate, state->colorscaleMin, state->colorscaleMax);
+		frequencyPlot->pixels[counter] = U16T(color.r * UINT16_MAX); // red
+		frequencyPlot->pixels[counter + 1] = U16T(color.g * UINT16_MAX); // green
+		frequencyPlot->pixels[counter + 2] = U16T(color.b * UINT16_MAX); // blue
 	}
 
 	// Add info to frame.
-	caerFrameEventSetLengthXLengthYChannelNumber(frequencyPlot, I32T(state->frequencyMap->sizeX),
-		I32T(state->frequencyMap->sizeY), RGB, frameOut);
+	caerFrameEventSetLengthXLengthYChannelNumber(frequencyPlot, state->sizeX, state->sizeY, RGB, frameOut);
 
 	// Validate frame.
 	caerFrameEventValidate(frequencyPlot, frameOut);
@@ -334,8 +441,28 @@ static void caerMeanRateFilterConfig(caerModuleData moduleData) {
 	state->colorscaleMin = sshsNodeGetInt(moduleData->moduleNode, "colorscaleMin");
 	state->targetFreq = sshsNodeGetFloat(moduleData->moduleNode, "targetFreq");
 	state->measureMinTime = sshsNodeGetFloat(moduleData->moduleNode, "measureMinTime");
+	state->rateTimeConstant = sshsNodeGetFloat(moduleData->moduleNode, "rateTimeConstant");
+	state->frameInterval = I64T(sshsNodeGetInt(moduleData->moduleNode, "frameInterval")) * 1000;
 	state->doSetFreq = sshsNodeGetBool(moduleData->moduleNode, "doSetFreq");
 
+	// A lower colorscaleMin can make inactive neurons visible again.
+	activeNeuronsRebuild(state);
+}
+
+/**
+ * Make all visible neurons with any rate left active, the next frame then
+ * drops those that are black.
+ */
+static void activeNeuronsRebuild(MRFilterState state) {
+	state->activeNeuronsNumber = 0;
+
+	for (size_t i = 0; i < MRFILTER_NEURONS_NUMBER; i++) {
+		state->neurons[i].active = (state->neurons[i].rate > 0.0f) && (state->neuronPixel[i] != UINT32_MAX);
+
+		if (state->neurons[i].active) {
+			state->activeNeurons[state->activeNeuronsNumber++] = U32T(i);
+		}
+	}
 }
 
 static void caerMeanRateFilterExit(caerModuleData moduleData) {
@@ -348,8 +475,9 @@ static void caerMeanRateFilterExit(caerModuleData moduleData) {
 	sshsNodeClearSubTree(sourceInfoNode, true);
 
 	// Ensure maps are freed.
-	simple2DBufferFreeFloat(state->frequencyMap);
-	simple2DBufferFreeLong(state->spikeCountMap);
+	free(state->neurons);
+	free(state->neuronPixel);
+	free(state->activeNeurons);
 }
 
 static void caerMeanRateFilterReset(caerModuleData moduleData, int16_t resetCallSourceID) {
@@ -357,7 +485,10 @@ static void caerMeanRateFilterReset(caerModuleData moduleData, int16_t resetCall
 
 	MRFilterState state = moduleData->moduleState;
 
-	// Reset maps to all zeros (startup state).
-	simple2DBufferResetFloat(state->frequencyMap);
-	simple2DBufferResetLong(state->spikeCountMap);
+	// Reset rates to all zeros (startup state).
+	memset(state->neurons, 0, MRFILTER_NEURONS_NUMBER * sizeof(struct MRFilter_neuron));
+	state->activeNeuronsNumber = 0;
+
+	state->lastTimestamp = 0;
+	state->lastFrameTimestamp = 0;
 }
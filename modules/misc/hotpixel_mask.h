@@ -0,0 +1,197 @@
+#ifndef HOTPIXEL_MASK_H_
+#define HOTPIXEL_MASK_H_
+
+#include "main.h"
+
+#include <stdio.h>
+
+/**
+ * Hot-pixel mask: one bit per pixel, row-major, packed into 64bit words, so
+ * that the mask for a whole DAVIS240 fits into 5.4 KB and stays in cache.
+ * A mask is learned by counting the events of every pixel over a window of
+ * event time; pixels whose mean rate over the window reaches a threshold are
+ * marked as hot.
+ *
+ * On disk, a mask is stored as a 16 byte header (magic, version, sizeX, sizeY,
+ * all little-endian) followed by the mask words, little-endian.
+ */
+#define CAER_HOTPIXEL_MASK_MAGIC 0x4D504843 // "CHPM" in little-endian.
+#define CAER_HOTPIXEL_MASK_VERSION 1
+
+struct caer_hotpixel_mask {
+	int16_t sizeX;
+	int16_t sizeY;
+	size_t wordsNumber;
+	uint64_t *words;
+};
+
+struct caer_hotpixel_learner {
+	uint32_t *counts;
+	int64_t startTimestamp;
+	int64_t duration;
+};
+
+static inline bool caerHotPixelMaskInit(struct caer_hotpixel_mask *mask, int16_t sizeX, int16_t sizeY) {
+	mask->sizeX = sizeX;
+	mask->sizeY = sizeY;
+	mask->wordsNumber = (((size_t) sizeX * (size_t) sizeY) + 63) / 64;
+
+	mask->words = calloc(mask->wordsNumber, sizeof(uint64_t));
+
+	return (mask->words != NULL);
+}
+
+static inline void caerHotPixelMaskFree(struct caer_hotpixel_mask *mask) {
+	free(mask->words);
+	mask->words = NULL;
+}
+
+/**
+ * Branchless lookup: returns 1 if the pixel is hot, 0 otherwise.
+ */
+static inline uint64_t caerHotPixelMaskGet(const struct caer_hotpixel_mask *mask, uint16_t x, uint16_t y) {
+	size_t pixel = ((size_t) y * (size_t) mask->sizeX) + x;
+
+	return ((mask->words[pixel >> 6] >> (pixel & 0x3F)) & 0x01);
+}
+
+static inline bool caerHotPixelMaskSave(const struct caer_hotpixel_mask *mask, const char *fileName) {
+	FILE *maskFile = fopen(fileName, "wb");
+	if (maskFile == NULL) {
+		return (false);
+	}
+
+	uint32_t header[4] = { htole32(CAER_HOTPIXEL_MASK_MAGIC), htole32(CAER_HOTPIXEL_MASK_VERSION), htole32(
+		U32T(mask->sizeX)), htole32(U32T(mask->sizeY)) };
+
+	bool success = (fwrite(header, sizeof(header), 1, maskFile) == 1);
+
+	for (size_t i = 0; success && i < mask->wordsNumber; i++) {
+		uint64_t word = htole64(mask->words[i]);
+
+		success = (fwrite(&word, sizeof(word), 1, maskFile) == 1);
+	}
+
+	// Closing can fail too, as data is only guaranteed to be written then.
+	if (fclose(maskFile) != 0) {
+		success = false;
+	}
+
+	return (success);
+}
+
+/**
+ * Load a mask from file. The file must match the mask's size, else
+ * nothing is loaded and false is returned.
+ */
+static inline bool caerHotPixelMaskLoad(struct caer_hotpixel_mask *mask, const char *fileName) {
+	FILE *maskFile = fopen(fileName, "rb");
+	if (maskFile == NULL) {
+		return (false);
+	}
+
+	uint32_t header[4];
+
+	if (fread(header, sizeof(header), 1, maskFile) != 1 || le32toh(header[0]) != CAER_HOTPIXEL_MASK_MAGIC
+		|| le32toh(header[1]) != CAER_HOTPIXEL_MASK_VERSION || le32toh(header[2]) != U32T(mask->sizeX)
+		|| le32toh(header[3]) != U32T(mask->sizeY)) {
+		fclose(maskFile);
+		return (false);
+	}
+
+	uint64_t *words = malloc(mask->wordsNumber * sizeof(uint64_t));
+	if (words == NULL) {
+		fclose(maskFile);
+		return (false);
+	}
+
+	if (fread(words, sizeof(uint64_t), mask->wordsNumber, maskFile) != mask->wordsNumber) {
+		free(words);
+		fclose(maskFile);
+		return (false);
+	}
+
+	fclose(maskFile);
+
+	for (size_t i = 0; i < mask->wordsNumber; i++) {
+		mask->words[i] = le64toh(words[i]);
+	}
+
+	free(words);
+
+	return (true);
+}
+
+/**
+ * Start learning a new mask over the given duration (in µs). The learning
+ * window begins with the first event passed to caerHotPixelLearnerAdd().
+ */
+static inline bool caerHotPixelLearnerStart(struct caer_hotpixel_learner *learner,
+	const struct caer_hotpixel_mask *mask, int64_t duration) {
+	learner->counts = calloc((size_t) mask->sizeX * (size_t) mask->sizeY, sizeof(uint32_t));
+	learner->startTimestamp = -1;
+	learner->duration = duration;
+
+	return (learner->counts != NULL);
+}
+
+static inline bool caerHotPixelLearnerActive(const struct caer_hotpixel_learner *learner) {
+	return (learner->counts != NULL);
+}
+
+/**
+ * Count one event. Returns true once the event lies past the end of the
+ * learning window, the event is then not counted.
+ */
+static inline bool caerHotPixelLearnerAdd(struct caer_hotpixel_learner *learner,
+	const struct caer_hotpixel_mask *mask, uint16_t x, uint16_t y, int64_t timestamp) {
+	if (learner->startTimestamp < 0) {
+		learner->startTimestamp = timestamp;
+	}
+
+	if ((timestamp - learner->startTimestamp) >= learner->duration) {
+		return (true);
+	}
+
+	learner->counts[((size_t) y * (size_t) mask->sizeX) + x]++;
+
+	return (false);
+}
+
+/**
+ * Replace the mask with the pixels whose mean rate (in Hz) over the learning
+ * window reached the given threshold, and stop learning.
+ * Returns the number of hot pixels.
+ */
+static inline size_t caerHotPixelLearnerFinish(struct caer_hotpixel_learner *learner,
+	struct caer_hotpixel_mask *mask, int32_t rateThreshold) {
+	size_t pixels = (size_t) mask->sizeX * (size_t) mask->sizeY;
+	uint64_t countThreshold = (U64T(rateThreshold) * U64T(learner->duration)) / 1000000;
+	size_t hotPixels = 0;
+
+	// Pixels without any event are never hot.
+	if (countThreshold == 0) {
+		countThreshold = 1;
+	}
+
+	memset(mask->words, 0, mask->wordsNumber * sizeof(uint64_t));
+
+	for (size_t i = 0; i < pixels; i++) {
+		uint64_t isHot = (learner->counts[i] >= countThreshold);
+
+		mask->words[i >> 6] |= (isHot << (i & 0x3F));
+		hotPixels += isHot;
+	}
+
+	free(learner->counts);
+	learner->counts = NULL;
+
+	return (hotPixels);
+}
+
+static inline void caerHotPixelLearnerStop(struct caer_hotpixel_learner *learner) {
+	free(learner->counts);
+	learner->counts = NULL;
+}
+
+#endif /* HOTPIXEL_MASK_H_ */
@@ -38,6 +38,7 @@ static int aedat2GetPacket(inputCommonState state, int16_t chipID);
 static int aedat3GetPacket(inputCommonState state, bool isAEDAT30);
 static void aedat30ChangeOrigin(inputCommonState state, caerEventPacketHeader packet);
 static bool decompressTimestampSerialize(inputCommonState state, caerEventPacketHeader packet, size_t packetSize);
+static bool decompressEventDelta(inputCommonState state, caerEventPacketHeader packet, size_t packetSize);
 static bool decompressEventPacket(inputCommonState state, caerEventPacketHeader packet, size_t packetSize);
 static int inputReaderThread(void *stateArg);
 
@@ -422,6 +423,14 @@ static bool parseFileHeader(inputCommonState state) {
 						state->header.formatID |= 0x02;
 					}
 
+					if (strstr(formatString, "DeltaFrames") != NULL) {
+						state->header.formatID |= 0x04;
+					}
+
+					if (strstr(formatString, "DeltaEvents") != NULL) {
+						state->header.formatID |= 0x08;
+					}
+
 					if (!state->header.formatID) {
 						// No valid format found.
 						free(headerLine);
@@ -868,10 +877,158 @@ static void aedat30ChangeOrigin(inputCommonState state, caerEventPacketHeader pa
 	}
 }
 
+static bool decompressFrame(inputCommonState state, caerEventPacketHeader packet, size_t packetSize);
+
+// MSB-first bit reader for DeltaFrames decompression. Reading past the end
+// returns zero bits, this is detected by comparing the consumed bits at the end.
+struct caer_frame_delta_reader {
+	const uint8_t *buffer;
+	size_t position;
+	size_t size;
+	uint64_t bitBuffer;
+	uint32_t bitCount;
+	uint64_t bitsConsumed;
+};
+
+static inline void caerFrameDeltaReadRefill(struct caer_frame_delta_reader *reader) {
+	while (reader->bitCount <= 56) {
+		uint64_t byte = (reader->position < reader->size) ? (reader->buffer[reader->position]) : (0);
+		reader->position++;
+
+		reader->bitBuffer |= byte << (56 - reader->bitCount);
+		reader->bitCount += 8;
+	}
+}
+
+static inline uint32_t caerFrameDeltaReadBits(struct caer_frame_delta_reader *reader, uint32_t bits) {
+	// Up to 32 bits at a time, always after a refill.
+	uint32_t value = (uint32_t) (reader->bitBuffer >> (64 - bits));
+
+	reader->bitBuffer <<= bits;
+	reader->bitCount -= bits;
+	reader->bitsConsumed += bits;
+
+	return (value);
+}
+
+static inline bool caerFrameDeltaReadSample(struct caer_frame_delta_reader *reader,
+	struct caer_frame_delta_context *ctx, int32_t *residual) {
+	caerFrameDeltaReadRefill(reader);
+
+	// Count zeros of unary quotient. A valid stream never has more than LIMIT.
+	uint32_t quotient = (reader->bitBuffer == 0) ? (64) : ((uint32_t) __builtin_clzll(reader->bitBuffer));
+	if (quotient > AEDAT3_FRAME_DELTA_RICE_LIMIT) {
+		return (false);
+	}
+
+	caerFrameDeltaReadBits(reader, quotient + 1);
+
+	uint32_t mapped;
+
+	if (quotient < AEDAT3_FRAME_DELTA_RICE_LIMIT) {
+		uint32_t k = caerFrameDeltaContextGetK(ctx);
+		mapped = (quotient << k);
+
+		if (k > 0) {
+			mapped |= caerFrameDeltaReadBits(reader, k);
+		}
+	}
+	else {
+		mapped = caerFrameDeltaReadBits(reader, AEDAT3_FRAME_DELTA_ESCAPE_BITS);
+	}
+
+	caerFrameDeltaContextUpdate(ctx, mapped);
+
+	// Undo zig-zag mapping.
+	*residual = (int32_t) (mapped >> 1) ^ -(int32_t) (mapped & 0x01);
+
+	return (true);
+}
+
+/**
+ * Decompress one DeltaFrames compressed block into the given pixel array,
+ * see inout_common.h for a description of the format.
+ */
+static bool caerFrameEventDeltaDecompress(const uint8_t *inBuffer, size_t inSize, uint16_t *outBuffer,
+	int32_t xSize, int32_t ySize, enum caer_frame_event_color_channels channels) {
+	size_t rowSamples = (size_t) xSize * channels;
+
+	if (inSize < 1 || inBuffer[0] > 15) {
+		return (false);
+	}
+
+	uint8_t shift = inBuffer[0];
+
+	struct caer_frame_delta_reader reader = { .buffer = inBuffer + 1, .position = 0, .size = inSize - 1, .bitBuffer =
+		0, .bitCount = 0, .bitsConsumed = 0 };
+
+	struct caer_frame_delta_context ctx[4];
+	for (size_t c = 0; c < 4; c++) {
+		caerFrameDeltaContextInit(&ctx[c]);
+	}
+
+	// Reconstruct samples (shifted, native endian) and convert to the in-memory
+	// little-endian frame pixels only once the full row is done, since predictions
+	// need the shifted values of this row (left) and the previous row (up).
+	for (size_t y = 0; y < (size_t) ySize; y++) {
+		uint16_t *row = outBuffer + (y * rowSamples);
+		uint16_t *prevRow = (y == 0) ? (row) : (row - rowSamples);
+		int32_t residual;
+
+		for (size_t c = 0; c < channels; c++) {
+			if (!caerFrameDeltaReadSample(&reader, &ctx[c], &residual)) {
+				return (false);
+			}
+
+			int32_t pred = (y == 0) ? (0) : ((int32_t) prevRow[c]);
+			row[c] = (uint16_t) (pred + residual);
+		}
+
+		size_t c = 0;
+
+		for (size_t i = channels; i < rowSamples; i++) {
+			if (!caerFrameDeltaReadSample(&reader, &ctx[c], &residual)) {
+				return (false);
+			}
+
+			int32_t left = (int32_t) row[i - channels];
+			int32_t pred = left;
+
+			if (y != 0) {
+				pred = caerFrameDeltaPredict(left, (int32_t) prevRow[i], (int32_t) prevRow[i - channels]);
+			}
+
+			row[i] = (uint16_t) (pred + residual);
+
+			if (++c == channels) {
+				c = 0;
+			}
+		}
+
+		// Previous row is not needed for prediction anymore, finalize it.
+		if (y != 0) {
+			for (size_t i = 0; i < rowSamples; i++) {
+				prevRow[i] = htole16((uint16_t) (prevRow[i] << shift));
+			}
+		}
+	}
+
+	// Finalize last row.
+	if (ySize > 0) {
+		uint16_t *lastRow = outBuffer + ((size_t) (ySize - 1) * rowSamples);
+
+		for (size_t i = 0; i < rowSamples; i++) {
+			lastRow[i] = htole16((uint16_t) (lastRow[i] << shift));
+		}
+	}
+
+	// Check that exactly the compressed block was used up (minus padding).
+	return (((reader.bitsConsumed + 7) / 8) == (inSize - 1));
+}
+
 #ifdef ENABLE_INOUT_PNG_COMPRESSION
 
 static void caerLibPNGReadBuffer(png_structp png_ptr, png_bytep data, png_size_t length);
-static bool decompressFramePNG(inputCommonState state, caerEventPacketHeader packet, size_t packetSize);
 
 // Simple structure to store PNG image bytes.
 struct caer_libpng_buffer {
@@ -972,15 +1129,18 @@ static inline bool caerFrameEventPNGDecompress(uint8_t *inBuffer, size_t inSize,
 	return (true);
 }
 
-static bool decompressFramePNG(inputCommonState state, caerEventPacketHeader packet, size_t packetSize) {
-	// We want to avoid allocating new memory for each PNG decompression, and moving around things
+#endif
+
+static bool decompressFrame(inputCommonState state, caerEventPacketHeader packet, size_t packetSize) {
+	// We want to avoid allocating new memory for each frame decompression, and moving around things
 	// to much. So we first go through the compressed header+data blocks, and move them to their
 	// correct position for an in-memory frame packet (so at N*eventSize). Then we decompress the
-	// PNG block and directly copy the results into the space that it was occupying (plus extra for
+	// block and directly copy the results into the space that it was occupying (plus extra for
 	// the uncompressed pixels).
 	// First we go once through the events to know where they are, and where they should go.
-	// Then we do memory move + PNG decompression, starting from the last event (back-side), so as
+	// Then we do memory move + decompression, starting from the last event (back-side), so as
 	// to not overwrite memory we still need and haven't moved yet.
+	// Frames can be compressed with PNG (info bit 31) or with DeltaFrames (info bit 30).
 	int32_t eventSize = caerEventPacketHeaderGetEventSize(packet);
 	int32_t eventNumber = caerEventPacketHeaderGetEventNumber(packet);
 
@@ -988,7 +1148,8 @@ static bool decompressFramePNG(inputCommonState state, caerEventPacketHeader pac
 		size_t offsetDestination;
 		size_t offset;
 		size_t size;
-		bool isCompressed;
+		bool isCompressedPNG;
+		bool isCompressedDelta;
 	} eventMemory[eventNumber];
 
 	size_t currPacketOffset = CAER_EVENT_PACKET_HEADER_SIZE; // Start here, no change to header.
@@ -1003,18 +1164,20 @@ static bool decompressFramePNG(inputCommonState state, caerEventPacketHeader pac
 
 		caerFrameEvent frameEvent = (caerFrameEvent) (((uint8_t *) packet) + currPacketOffset);
 
-		// Bit 31 of info signals if event is PNG-compressed or not.
-		eventMemory[i].isCompressed = GET_NUMBITS32(frameEvent->info, 31, 0x01);
+		// Bit 31 of info signals if event is PNG-compressed or not, bit 30 DeltaFrames.
+		eventMemory[i].isCompressedPNG = GET_NUMBITS32(frameEvent->info, 31, 0x01);
+		eventMemory[i].isCompressedDelta = GET_NUMBITS32(frameEvent->info, AEDAT3_FRAME_DELTA_INFO_BIT, 0x01);
 
-		if (eventMemory[i].isCompressed) {
-			// Clear compression enabled bit.
+		if (eventMemory[i].isCompressedPNG || eventMemory[i].isCompressedDelta) {
+			// Clear compression enabled bits.
 			CLEAR_NUMBITS32(frameEvent->info, 31, 0x01);
+			CLEAR_NUMBITS32(frameEvent->info, AEDAT3_FRAME_DELTA_INFO_BIT, 0x01);
 
 			// Compressed block size is held in an integer right after the header.
-			int32_t pngSize = le32toh(*((int32_t * ) (((uint8_t * ) frameEvent) + frameEventHeaderSize)));
+			int32_t compressedSize = le32toh(*((int32_t * ) (((uint8_t * ) frameEvent) + frameEventHeaderSize)));
 
-			// PNG size is header plus integer plus compressed block size.
-			eventMemory[i].size = frameEventHeaderSize + sizeof(int32_t) + (size_t) pngSize;
+			// Compressed size is header plus integer plus compressed block size.
+			eventMemory[i].size = frameEventHeaderSize + sizeof(int32_t) + (size_t) compressedSize;
 		}
 		else {
 			// Normal size is header plus uncompressed pixels.
@@ -1033,13 +1196,51 @@ static bool decompressFramePNG(inputCommonState state, caerEventPacketHeader pac
 	}
 
 	// Now move memory and decompress in reverse order.
-	for (int32_t i = eventNumber; i >= 0; i--) {
-		// Move memory from compressed position to uncompressed, in-memory position.
-		memmove(((uint8_t *) packet) + eventMemory[i].offsetDestination, ((uint8_t *) packet) + eventMemory[i].offset,
-			eventMemory[i].size);
+	for (int32_t i = eventNumber - 1; i >= 0; i--) {
+		if (eventMemory[i].isCompressedDelta) {
+			// DeltaFrames decompresses directly into the pixel array, which overlaps
+			// with the compressed block, so the block is saved first to scratch memory.
+			size_t deltaBufferSize = eventMemory[i].size - frameEventHeaderSize - sizeof(int32_t);
+
+			if (state->frameDecompressBufferSize < deltaBufferSize) {
+				uint8_t *newBuffer = realloc(state->frameDecompressBuffer, deltaBufferSize);
+				if (newBuffer == NULL) {
+					caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to decompress frame event. "
+						"Memory allocation failure.");
+					return (false);
+				}
+
+				state->frameDecompressBuffer = newBuffer;
+				state->frameDecompressBufferSize = deltaBufferSize;
+			}
+
+			memcpy(state->frameDecompressBuffer,
+				((uint8_t *) packet) + eventMemory[i].offset + frameEventHeaderSize + sizeof(int32_t), deltaBufferSize);
+
+			// Only the header has to be moved.
+			memmove(((uint8_t *) packet) + eventMemory[i].offsetDestination,
+				((uint8_t *) packet) + eventMemory[i].offset, frameEventHeaderSize);
+
+			caerFrameEvent frameEvent = (caerFrameEvent) (((uint8_t *) packet) + eventMemory[i].offsetDestination);
+
+			if (!caerFrameEventDeltaDecompress(state->frameDecompressBuffer, deltaBufferSize,
+				caerFrameEventGetPixelArrayUnsafe(frameEvent), caerFrameEventGetLengthX(frameEvent),
+				caerFrameEventGetLengthY(frameEvent), caerFrameEventGetChannelNumber(frameEvent))) {
+				// Failed to decompress DeltaFrames block.
+				caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to decompress frame event. "
+					"DeltaFrames decompression failure.");
+				return (false);
+			}
+		}
+		else {
+			// Move memory from compressed position to uncompressed, in-memory position.
+			memmove(((uint8_t *) packet) + eventMemory[i].offsetDestination,
+				((uint8_t *) packet) + eventMemory[i].offset, eventMemory[i].size);
+		}
 
 		// If event is PNG-compressed, decompress it now.
-		if (eventMemory[i].isCompressed) {
+		if (eventMemory[i].isCompressedPNG) {
+#ifdef ENABLE_INOUT_PNG_COMPRESSION
 			uint8_t *pngBuffer = ((uint8_t *) packet) + eventMemory[i].offsetDestination + frameEventHeaderSize
 				+ sizeof(int32_t);
 			size_t pngBufferSize = eventMemory[i].size - frameEventHeaderSize - sizeof(int32_t);
@@ -1054,6 +1255,11 @@ static bool decompressFramePNG(inputCommonState state, caerEventPacketHeader pac
 					"PNG decompression failure.");
 				return (false);
 			}
+#else
+			caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to decompress frame event. "
+				"PNG decompression support not available.");
+			return (false);
+#endif
 		}
 
 		// Uncompressed size will always be header + uncompressed pixels.
@@ -1069,8 +1275,6 @@ static bool decompressFramePNG(inputCommonState state, caerEventPacketHeader pac
 	return (true);
 }
 
-#endif
-
 static bool decompressTimestampSerialize(inputCommonState state, caerEventPacketHeader packet, size_t packetSize) {
 	// To decompress this, we have to allocate memory to hold the expanded events. There is
 	// no efficient way to avoid this; working backwards from the last compressed event might
@@ -1182,20 +1386,190 @@ static bool decompressTimestampSerialize(inputCommonState state, caerEventPacket
 	return (true);
 }
 
+/**
+ * Unpack one lane of a DeltaEvents block: fixed-width values, then patch in
+ * the exceptions. The input must have 8 bytes of readable padding after
+ * inSize, so values can always be extracted with a single unaligned load.
+ *
+ * @return bytes consumed from the input, or zero on invalid data.
+ */
+static size_t caerEventDeltaUnpackLane(const uint8_t *inBuffer, size_t inSize, uint32_t *values, size_t valuesNumber,
+	uint32_t width) {
+	if (width == 0) {
+		memset(values, 0, valuesNumber * sizeof(uint32_t));
+		return (0);
+	}
+
+	size_t packedSize = ((valuesNumber * width) + 7) / 8;
+	if (packedSize > inSize) {
+		return (0);
+	}
+
+	uint32_t maxValue = caerEventDeltaMaxValue(width);
+
+	// No data-dependent branches here, so the compiler can vectorize it.
+	for (size_t i = 0; i < valuesNumber; i++) {
+		size_t bitPosition = i * width;
+		uint64_t word;
+
+		memcpy(&word, inBuffer + (bitPosition / 8), sizeof(uint64_t));
+
+		values[i] = (uint32_t) (le64toh(word) >> (bitPosition % 8)) & maxValue;
+	}
+
+	size_t position = packedSize;
+
+	for (size_t i = 0; i < valuesNumber; i++) {
+		if (values[i] != maxValue) {
+			continue;
+		}
+
+		// Exception: read varint and add it on top.
+		uint32_t exception = 0;
+		uint32_t shift = 0;
+		uint8_t byte;
+
+		do {
+			if (position >= inSize || shift > 28) {
+				return (0);
+			}
+
+			byte = inBuffer[position++];
+			exception |= (uint32_t) (byte & 0x7F) << shift;
+			shift += 7;
+		}
+		while (byte & 0x80);
+
+		values[i] += exception;
+	}
+
+	return (position);
+}
+
+static bool decompressEventDelta(inputCommonState state, caerEventPacketHeader packet, size_t packetSize) {
+	struct caer_event_delta_layout layout;
+	int32_t eventNumber = caerEventPacketHeaderGetEventNumber(packet);
+
+	if (!caerEventDeltaGetLayout(caerEventPacketHeaderGetEventType(packet), &layout)
+		|| caerEventPacketHeaderGetEventSize(packet) != 8 || caerEventPacketHeaderGetEventTSOffset(packet) != 4
+		|| packetSize < (CAER_EVENT_PACKET_HEADER_SIZE + sizeof(int32_t))) {
+		caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to decode delta events. "
+			"Unsupported event packet layout.");
+		return (false);
+	}
+
+	// Events are decoded directly into the packet, over the compressed data,
+	// so that is saved first to scratch memory, with padding for the unpacking.
+	size_t inSize = packetSize - CAER_EVENT_PACKET_HEADER_SIZE;
+
+	if (state->eventDecompressBufferSize < (inSize + sizeof(uint64_t))) {
+		uint8_t *newBuffer = realloc(state->eventDecompressBuffer, inSize + sizeof(uint64_t));
+		if (newBuffer == NULL) {
+			caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to decode delta events. "
+				"Memory allocation failure.");
+			return (false);
+		}
+
+		state->eventDecompressBuffer = newBuffer;
+		state->eventDecompressBufferSize = inSize + sizeof(uint64_t);
+	}
+
+	const uint8_t *inBuffer = state->eventDecompressBuffer;
+	memcpy(state->eventDecompressBuffer, ((uint8_t *) packet) + CAER_EVENT_PACKET_HEADER_SIZE, inSize);
+	memset(state->eventDecompressBuffer + inSize, 0, sizeof(uint64_t));
+
+	uint32_t *events = (uint32_t *) (((uint8_t *) packet) + CAER_EVENT_PACKET_HEADER_SIZE);
+
+	uint32_t lastTimestamp;
+	memcpy(&lastTimestamp, inBuffer, sizeof(int32_t));
+	lastTimestamp = le32toh(lastTimestamp);
+
+	uint32_t lastA = 0;
+	uint32_t lastB = 0;
+	uint32_t bMask = (1U << (layout.aShift - layout.bShift)) - 1;
+	uint32_t flagsMask = (1U << layout.bShift) - 1;
+
+	size_t position = sizeof(int32_t);
+
+	uint32_t lanes[AEDAT3_EVENT_DELTA_LANES][AEDAT3_EVENT_DELTA_BLOCK_SIZE];
+
+	for (size_t blockStart = 0; blockStart < (size_t) eventNumber; blockStart += AEDAT3_EVENT_DELTA_BLOCK_SIZE) {
+		size_t blockEvents = (size_t) eventNumber - blockStart;
+		if (blockEvents > AEDAT3_EVENT_DELTA_BLOCK_SIZE) {
+			blockEvents = AEDAT3_EVENT_DELTA_BLOCK_SIZE;
+		}
+
+		if ((position + AEDAT3_EVENT_DELTA_LANES) > inSize) {
+			caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to decode delta events. "
+				"Compressed data ends prematurely.");
+			return (false);
+		}
+
+		uint32_t widths[AEDAT3_EVENT_DELTA_LANES];
+
+		for (size_t l = 0; l < AEDAT3_EVENT_DELTA_LANES; l++) {
+			widths[l] = inBuffer[position++];
+		}
+
+		for (size_t l = 0; l < AEDAT3_EVENT_DELTA_LANES; l++) {
+			if (widths[l] > 32) {
+				caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to decode delta events. "
+					"Invalid lane width %" PRIu32 ".", widths[l]);
+				return (false);
+			}
+
+			size_t laneSize = caerEventDeltaUnpackLane(inBuffer + position, inSize - position, lanes[l], blockEvents,
+				widths[l]);
+			if (laneSize == 0 && widths[l] != 0) {
+				caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to decode delta events. "
+					"Invalid lane data.");
+				return (false);
+			}
+
+			position += laneSize;
+		}
+
+		// Reassemble events by summing up the differences.
+		for (size_t i = 0; i < blockEvents; i++) {
+			lastTimestamp += caerEventDeltaUnZigZag(lanes[0][i]);
+			lastA += caerEventDeltaUnZigZag(lanes[1][i]);
+			lastB += caerEventDeltaUnZigZag(lanes[2][i]);
+
+			uint32_t data = (lastA << layout.aShift) | ((lastB & bMask) << layout.bShift) | (lanes[3][i] & flagsMask);
+
+			events[(blockStart + i) * 2] = htole32(data);
+			events[((blockStart + i) * 2) + 1] = htole32(lastTimestamp);
+		}
+	}
+
+	// Check we really used up all compressed data.
+	if (position != inSize) {
+		caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to decode delta events. "
+			"Length of compressed packet and read data don't match.");
+		return (false);
+	}
+
+	return (true);
+}
+
 static bool decompressEventPacket(inputCommonState state, caerEventPacketHeader packet, size_t packetSize) {
 	bool retVal = false;
 
+	// Data compression technique 4: delta and bit-packing encoding of polarity and spike events.
+	if ((state->header.formatID & 0x08)
+		&& (caerEventPacketHeaderGetEventType(packet) == POLARITY_EVENT
+			|| caerEventPacketHeaderGetEventType(packet) == SPIKE_EVENT)) {
+		retVal = decompressEventDelta(state, packet, packetSize);
+	}
 	// Data compression technique 1: serialized timestamps.
-	if ((state->header.formatID & 0x01) && caerEventPacketHeaderGetEventType(packet) == POLARITY_EVENT) {
+	else if ((state->header.formatID & 0x01) && caerEventPacketHeaderGetEventType(packet) == POLARITY_EVENT) {
 		retVal = decompressTimestampSerialize(state, packet, packetSize);
 	}
 
-#ifdef ENABLE_INOUT_PNG_COMPRESSION
-	// Data compression technique 2: frame PNG compression.
-	if ((state->header.formatID & 0x02) && caerEventPacketHeaderGetEventType(packet) == FRAME_EVENT) {
-		retVal = decompressFramePNG(state, packet, packetSize);
+	// Data compression technique 2 and 3: frame PNG or DeltaFrames compression.
+	if ((state->header.formatID & (0x02 | 0x04)) && caerEventPacketHeaderGetEventType(packet) == FRAME_EVENT) {
+		retVal = decompressFrame(state, packet, packetSize);
 	}
-#endif
 
 	return (retVal);
 }
@@ -2027,6 +2401,9 @@ void caerInputCommonExit(caerModuleData moduleData) {
 	free(state->packets.currPacketData);
 	free(state->packets.currPacket);
 
+	free(state->frameDecompressBuffer);
+	free(state->eventDecompressBuffer);
+
 	// Clear sourceInfo node.
 	sshsNode sourceInfoNode = sshsGetRelativeNode(moduleData->moduleNode, "sourceInfo/");
 	sshsNodeRemoveAllAttributes(sourceInfoNode);
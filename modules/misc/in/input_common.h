@@ -164,6 +164,14 @@ struct input_common_state {
 	size_t dataBufferOffset;
 	/// Flag to signal update to buffer configuration asynchronously.
 	atomic_bool bufferUpdate;
+	/// Scratch memory for DeltaFrames decompression, reused across frames.
+	uint8_t *frameDecompressBuffer;
+	/// Size of DeltaFrames decompression scratch memory.
+	size_t frameDecompressBufferSize;
+	/// Scratch memory for DeltaEvents decompression, reused across packets.
+	uint8_t *eventDecompressBuffer;
+	/// Size of DeltaEvents decompression scratch memory.
+	size_t eventDecompressBufferSize;
 	/// Reference to parent module's original data.
 	caerModuleData parentModule;
 	/// Reference to sourceInfo node (to avoid getting it each time again).
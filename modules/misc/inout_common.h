@@ -3,10 +3,129 @@
 
 #include "main.h"
 #include <libcaer/network.h>
+#include <libcaer/events/polarity.h>
+#include <libcaer/events/spike.h>
 
 static inline void caerGenericEventSetTimestamp(void *eventPtr, caerEventPacketHeaderConst headerPtr, int32_t timestamp) {
 	*((int32_t *) (((uint8_t *) eventPtr) + U64T(caerEventPacketHeaderGetEventTSOffset(headerPtr)))) = htole32(
 		timestamp);
 }
 
+/**
+ * DeltaFrames compression format (Format ID bit 0x04): fast lossless frame
+ * compression. Compressed frames have bit 30 of the frame info field set,
+ * followed by the frame event header, an int32 with the compressed block
+ * length, and the block itself. The block consists of one byte holding the
+ * number of trailing zero bits common to all pixels (shifted out before coding),
+ * followed by a MSB-first bit-stream of adaptive Rice codes, one per sample.
+ * Each sample is predicted from its left, up and up-left neighbors of the same
+ * color channel (LOCO-I median edge detector), the residual is zig-zag mapped
+ * to an unsigned integer and Rice coded, with the Rice parameter adapting to
+ * the recent residual magnitudes of each channel.
+ */
+#define AEDAT3_FRAME_DELTA_INFO_BIT 30
+#define AEDAT3_FRAME_DELTA_RICE_LIMIT 24
+#define AEDAT3_FRAME_DELTA_ESCAPE_BITS 17
+#define AEDAT3_FRAME_DELTA_RESET 64
+
+struct caer_frame_delta_context {
+	uint32_t accumulator;
+	uint32_t count;
+};
+
+static inline void caerFrameDeltaContextInit(struct caer_frame_delta_context *ctx) {
+	ctx->accumulator = 8;
+	ctx->count = 1;
+}
+
+static inline uint32_t caerFrameDeltaContextGetK(const struct caer_frame_delta_context *ctx) {
+	uint32_t k = 0;
+
+	while (((ctx->count << k) < ctx->accumulator) && (k < 16)) {
+		k++;
+	}
+
+	return (k);
+}
+
+static inline void caerFrameDeltaContextUpdate(struct caer_frame_delta_context *ctx, uint32_t mappedResidual) {
+	ctx->accumulator += mappedResidual;
+	ctx->count++;
+
+	if (ctx->count == AEDAT3_FRAME_DELTA_RESET) {
+		ctx->accumulator >>= 1;
+		ctx->count >>= 1;
+	}
+}
+
+static inline int32_t caerFrameDeltaPredict(int32_t left, int32_t up, int32_t upLeft) {
+	int32_t minLU = (left < up) ? (left) : (up);
+	int32_t maxLU = (left < up) ? (up) : (left);
+
+	if (upLeft >= maxLU) {
+		return (minLU);
+	}
+
+	if (upLeft <= minLU) {
+		return (maxLU);
+	}
+
+	return (left + up - upLeft);
+}
+
+/**
+ * DeltaEvents compression format (Format ID bit 0x08): compact encoding of
+ * polarity and spike events. Each event is split into four fields (lanes):
+ * the timestamp difference to the previous event, the differences of the two
+ * address fields to the previous event (X and Y for polarity, neuron ID and
+ * chip/core ID for spike), and the remaining low bits (valid mark, polarity)
+ * as they are. Differences are zig-zag mapped to unsigned integers.
+ * The packet data starts with the first event's timestamp as int32, followed
+ * by blocks of up to AEDAT3_EVENT_DELTA_BLOCK_SIZE events. Each block begins
+ * with one byte per lane giving its bit width, followed by the lanes in order:
+ * the values of all events in the block, bit-packed LSB-first at that width
+ * and padded to a full byte, then the lane exceptions. A packed value with all
+ * width bits set is an exception: the actual value is that maximum plus an
+ * unsigned LEB128 varint taken from the exception list. A width of zero means
+ * all values are zero. This way unpacking a lane is a fixed-width loop without
+ * data-dependent branches, and the rare outliers (row changes, timestamp gaps)
+ * are patched in afterwards.
+ */
+#define AEDAT3_EVENT_DELTA_BLOCK_SIZE 128
+#define AEDAT3_EVENT_DELTA_LANES 4
+
+// Address layout of an event's data field: A above aShift, B between bShift and aShift, flags below bShift.
+struct caer_event_delta_layout {
+	uint32_t aShift;
+	uint32_t bShift;
+};
+
+static inline bool caerEventDeltaGetLayout(int16_t eventType, struct caer_event_delta_layout *layout) {
+	if (eventType == POLARITY_EVENT) {
+		layout->aShift = POLARITY_X_ADDR_SHIFT;
+		layout->bShift = POLARITY_Y_ADDR_SHIFT;
+		return (true);
+	}
+
+	if (eventType == SPIKE_EVENT) {
+		layout->aShift = SPIKE_NEURON_ID_SHIFT;
+		layout->bShift = SPIKE_SOURCE_CORE_ID_SHIFT;
+		return (true);
+	}
+
+	return (false);
+}
+
+static inline uint32_t caerEventDeltaZigZag(uint32_t difference) {
+	return ((difference << 1) ^ (uint32_t) ((int32_t) difference >> 31));
+}
+
+static inline uint32_t caerEventDeltaUnZigZag(uint32_t mapped) {
+	return ((mapped >> 1) ^ (uint32_t) -(int32_t) (mapped & 0x01));
+}
+
+static inline uint32_t caerEventDeltaMaxValue(uint32_t width) {
+	return ((width >= 32) ? (UINT32_MAX) : ((1U << width) - 1));
+}
+
 #endif /* INPUT_OUTPUT_COMMON_H_ */
@@ -28,7 +28,8 @@ caerModuleInfo caerModuleGetInfo(void) {
 }
 
 static char *getUserHomeDirectory(caerModuleData moduleData);
-static char *getFullFilePath(caerModuleData moduleData, const char *directory, const char *prefix);
+static char *getFullFilePath(caerModuleData moduleData, const char *directory, const char *prefix,
+	const char *extension);
 
 // Remember to free strings returned by this.
 static char *getUserHomeDirectory(caerModuleData moduleData) {
@@ -51,7 +52,8 @@ static char *getUserHomeDirectory(caerModuleData moduleData) {
 	return (homeDir);
 }
 
-static char *getFullFilePath(caerModuleData moduleData, const char *directory, const char *prefix) {
+static char *getFullFilePath(caerModuleData moduleData, const char *directory, const char *prefix,
+	const char *extension) {
 	// First get time suffix string.
 	time_t currentTimeEpoch = time(NULL);
 
@@ -82,10 +84,10 @@ static char *getFullFilePath(caerModuleData moduleData, const char *directory, c
 		prefix = DEFAULT_PREFIX;
 	}
 
-	// Assemble together: directory/prefix-time.aedat
-	size_t filePathLength = strlen(directory) + strlen(prefix) + currentTimeStringLength + 9;
+	// Assemble together: directory/prefix-time.extension
+	size_t filePathLength = strlen(directory) + strlen(prefix) + currentTimeStringLength + strlen(extension) + 3;
 	// 1 for the directory/prefix separating slash, 1 for prefix-time separating
-	// dash, 6 for file extension, 1 for terminating NUL byte = +9.
+	// dash, 1 for terminating NUL byte = +3.
 
 	char *filePath = malloc(filePathLength);
 	if (filePath == NULL) {
@@ -93,7 +95,7 @@ static char *getFullFilePath(caerModuleData moduleData, const char *directory, c
 		return (NULL);
 	}
 
-	snprintf(filePath, filePathLength, "%s/%s-%s.aedat", directory, prefix, currentTimeString);
+	snprintf(filePath, filePathLength, "%s/%s-%s%s", directory, prefix, currentTimeString, extension);
 
 	return (filePath);
 }
@@ -117,11 +119,47 @@ static bool caerOutputFileInit(caerModuleData moduleData) {
 	sshsNodeCreateString(moduleData->moduleNode, "prefix", DEFAULT_PREFIX, 1, MAX_PREFIX_LENGTH, SSHS_FLAGS_NORMAL,
 		"Output data files name prefix.");
 
-	// Generate current file name and open it.
+	sshsNodeCreateInt(moduleData->moduleNode, "segmentSize", 0, 0, 1024 * 1024, SSHS_FLAGS_NORMAL,
+		"Start a new file segment after this many MiB have been written (0 to disable).");
+	sshsNodeCreateInt(moduleData->moduleNode, "segmentDuration", 0, 0, INT32_MAX, SSHS_FLAGS_NORMAL,
+		"Start a new file segment after this many seconds of recorded data (0 to disable).");
+
 	char *directory = sshsNodeGetString(moduleData->moduleNode, "directory");
 	char *prefix = sshsNodeGetString(moduleData->moduleNode, "prefix");
 
-	char *filePath = getFullFilePath(moduleData, directory, prefix);
+	int32_t segmentSize = sshsNodeGetInt(moduleData->moduleNode, "segmentSize");
+	int32_t segmentDuration = sshsNodeGetInt(moduleData->moduleNode, "segmentDuration");
+
+	if (segmentSize > 0 || segmentDuration > 0) {
+		// Segmented output: files are opened by the output thread once data arrives,
+		// named directory/prefix-time-NNNN.aedat, plus a directory/prefix-time-index.csv
+		// index file, that maps each segment to the timestamp range it contains.
+		outputCommonState state = moduleData->moduleState;
+
+		state->segmentation.basePath = getFullFilePath(moduleData, directory, prefix, "");
+		free(directory);
+		free(prefix);
+
+		if (state->segmentation.basePath == NULL) {
+			// caerModuleLog() called inside getFullFilePath().
+			return (false);
+		}
+
+		state->segmentation.maxSize = U64T(segmentSize) * 1024 * 1024;
+		state->segmentation.maxDuration = I64T(segmentDuration) * 1000000;
+
+		if (!caerOutputCommonInit(moduleData, -1, NULL)) {
+			free(state->segmentation.basePath);
+			state->segmentation.basePath = NULL;
+
+			return (false);
+		}
+
+		return (true);
+	}
+
+	// Generate current file name and open it.
+	char *filePath = getFullFilePath(moduleData, directory, prefix, ".aedat");
 	free(directory);
 	free(prefix);
 
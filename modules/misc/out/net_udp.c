@@ -28,6 +28,14 @@ static bool caerOutputNetUDPInit(caerModuleData moduleData) {
 		"IPv4 address to connect to (client mode).");
 	sshsNodeCreateInt(moduleData->moduleNode, "portNumber", 6666, 1, UINT16_MAX, SSHS_FLAGS_NORMAL,
 		"Port number to connect to (client mode).");
+	sshsNodeCreateBool(moduleData->moduleNode, "batchDatagrams", false, SSHS_FLAGS_NORMAL,
+		"Pack event packets tightly into datagrams and send them in batches, to reduce system call overhead.");
+	sshsNodeCreateInt(moduleData->moduleNode, "datagramSize", 1472, 512, 65507, SSHS_FLAGS_NORMAL,
+		"Size of a batched datagram in bytes, including the network header (1472 for Ethernet, 8972 for jumbo frames).");
+	sshsNodeCreateInt(moduleData->moduleNode, "batchSize", 32, 1, 1024, SSHS_FLAGS_NORMAL,
+		"Maximum number of datagrams to send together in one batch.");
+	sshsNodeCreateBool(moduleData->moduleNode, "segmentationOffload", true, SSHS_FLAGS_NORMAL,
+		"Use UDP segmentation offload (GSO) for batched datagrams, if available (Linux only).");
 
 	int retVal;
 
@@ -73,6 +81,26 @@ static bool caerOutputNetUDPInit(caerModuleData moduleData) {
 	streams->clients[0] = NULL;
 	streams->server = NULL;
 
+	// Initialize datagram batching.
+	memset(&streams->udpBatch, 0, sizeof(streams->udpBatch));
+
+	if (sshsNodeGetBool(moduleData->moduleNode, "batchDatagrams")) {
+		streams->udpBatch.enabled = true;
+		streams->udpBatch.useGSO = sshsNodeGetBool(moduleData->moduleNode, "segmentationOffload");
+		streams->udpBatch.datagramSize = (size_t) sshsNodeGetInt(moduleData->moduleNode, "datagramSize");
+		streams->udpBatch.maxDatagrams = (size_t) sshsNodeGetInt(moduleData->moduleNode, "batchSize");
+
+		streams->udpBatch.buffer = malloc(streams->udpBatch.maxDatagrams * streams->udpBatch.datagramSize);
+		if (streams->udpBatch.buffer == NULL) {
+			free(udp);
+			free(streams->address);
+			free(streams);
+
+			caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for datagram batch buffer.");
+			return (false);
+		}
+	}
+
 	// Remember address.
 	memcpy(streams->address, &serverAddress, sizeof(struct sockaddr_in));
 
@@ -86,16 +114,29 @@ static bool caerOutputNetUDPInit(caerModuleData moduleData) {
 	// Initialize loop and network handles.
 	retVal = uv_loop_init(&streams->loop);
 	UV_RET_CHECK(retVal, moduleData->moduleSubSystemString, "uv_loop_init",
-		free(udp); free(streams->address); free(streams); return (false));
+		free(udp); free(streams->udpBatch.buffer); free(streams->address); free(streams); return (false));
 
 	retVal = uv_udp_init(&streams->loop, udp);
 	UV_RET_CHECK(retVal, moduleData->moduleSubSystemString, "uv_udp_init",
-		uv_loop_close(&streams->loop); free(udp); free(streams->address); free(streams); return (false));
+		uv_loop_close(&streams->loop); free(udp); free(streams->udpBatch.buffer); free(streams->address); free(streams);
+		return (false));
+
+	if (streams->udpBatch.enabled) {
+		// Batched sends go directly to the socket, so it must exist already.
+		struct sockaddr_in bindAddress;
+		uv_ip4_addr("0.0.0.0", 0, &bindAddress);
+
+		retVal = uv_udp_bind(udp, (const struct sockaddr *) &bindAddress, 0);
+		UV_RET_CHECK(retVal, moduleData->moduleSubSystemString, "uv_udp_bind", libuvCloseLoopHandles(&streams->loop);
+			uv_loop_close(&streams->loop); free(streams->udpBatch.buffer); free(streams->address); free(streams);
+			return (false));
+	}
 
 	// Start.
 	if (!caerOutputCommonInit(moduleData, -1, streams)) {
 		libuvCloseLoopHandles(&streams->loop);
 		uv_loop_close(&streams->loop);
+		free(streams->udpBatch.buffer);
 		free(streams->address);
 		free(streams);
 
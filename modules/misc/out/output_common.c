@@ -66,17 +66,39 @@
  * a sane restriction to impose anyway.
  */
 
+#if defined(OS_LINUX) && OS_LINUX == 1
+// Needed for sendmmsg(), used by batched UDP output.
+#define _GNU_SOURCE 1
+#endif
+
 #include "output_common.h"
 #include "base/mainloop.h"
 #include "ext/portable_misc.h"
 #include "ext/buffers.h"
 #include "ext/nets.h"
+#include "ext/portable_time.h"
+
+#if defined(OS_LINUX) && OS_LINUX == 1
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <errno.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+// Kernel limit on segments per GSO send.
+#define UDP_GSO_MAX_SEGMENTS 64
+#endif
 
 #ifdef ENABLE_INOUT_PNG_COMPRESSION
 #include <png.h>
 #endif
 
 #include <stdatomic.h>
+#include <fcntl.h>
+#include <float.h>
 #include <libcaer/events/common.h>
 #include <libcaer/events/packetContainer.h>
 #include <libcaer/events/frame.h>
@@ -85,6 +107,25 @@
 static void caerOutputCommonConfigListener(sshsNode node, void *userData, enum sshs_node_attribute_events event,
 	const char *changeKey, enum sshs_node_attr_value_type changeType, union sshs_node_attr_value changeValue);
 
+static inline enum output_common_flow_control parseFlowControl(const char *flowControlString) {
+	if (caerStrEquals(flowControlString, "DropOldest")) {
+		return (FLOW_CONTROL_DROP_OLDEST);
+	}
+
+	if (caerStrEquals(flowControlString, "SkipToLatest")) {
+		return (FLOW_CONTROL_SKIP_TO_LATEST);
+	}
+
+	return (FLOW_CONTROL_DROP_NEWEST);
+}
+
+static inline uint64_t statisticsTimeNs(void) {
+	struct timespec currentTime;
+	portable_clock_gettime_monotonic(&currentTime);
+
+	return ((U64T(currentTime.tv_sec) * 1000000000ULL) + U64T(currentTime.tv_nsec));
+}
+
 /**
  * ============================================================================
  * MAIN THREAD
@@ -140,6 +181,8 @@ void caerOutputCommonReset(caerModuleData moduleData, int16_t resetCallSourceID)
 			; // Ensure this goes into the first ring-buffer.
 		}
 
+		atomic_fetch_add_explicit(&state->statistics.compressorRingUsage, 1, memory_order_relaxed);
+
 		// Reset timestamp checking.
 		state->lastTimestamp = 0;
 	}
@@ -304,9 +347,14 @@ static void copyPacketsToTransferRing(outputCommonState state, caerEventPacketCo
 
 		caerEventPacketContainerFree(eventPackets);
 
+		atomic_fetch_add_explicit(&state->statistics.packetsDropped, idx, memory_order_relaxed);
+
 		caerModuleLog(state->parentModule, CAER_LOG_NOTICE,
 			"Failed to put packet's array copy on transfer ring-buffer: full.");
+		return;
 	}
+
+	atomic_fetch_add_explicit(&state->statistics.compressorRingUsage, 1, memory_order_relaxed);
 }
 
 /**
@@ -322,8 +370,16 @@ static int compressorThread(void *stateArg);
 static void orderAndSendEventPackets(outputCommonState state, caerEventPacketContainer currPacketContainer);
 static int packetsFirstTimestampThenTypeCmp(const void *a, const void *b);
 static void sendEventPacket(outputCommonState state, caerEventPacketHeader packet);
+static void segmentContainerStart(outputCommonState state, caerEventPacketContainer packetContainer,
+	size_t packetContainerSize);
+static void segmentContainerEnd(outputCommonState state);
+static void segmentRotate(outputCommonState state);
 static size_t compressEventPacket(outputCommonState state, caerEventPacketHeader packet, size_t packetSize);
 static size_t compressTimestampSerialize(outputCommonState state, caerEventPacketHeader packet);
+static size_t compressEventDelta(outputCommonState state, caerEventPacketHeader packet, size_t packetSize);
+static size_t compressFrameDelta(outputCommonState state, caerEventPacketHeader packet);
+static caerEventPacketContainer compressorRingGet(outputCommonState state);
+static void statisticsUpdate(outputCommonState state);
 
 #ifdef ENABLE_INOUT_PNG_COMPRESSION
 static void caerLibPNGWriteBuffer(png_structp png_ptr, png_bytep data, png_size_t length);
@@ -346,7 +402,11 @@ static int compressorThread(void *stateArg) {
 
 	while (atomic_load_explicit(&state->running, memory_order_relaxed)) {
 		// Get the newest event packet container from the transfer ring-buffer.
-		caerEventPacketContainer currPacketContainer = caerRingBufferGet(state->compressorRing);
+		caerEventPacketContainer currPacketContainer = compressorRingGet(state);
+
+		// Publish live statistics, about once per second.
+		statisticsUpdate(state);
+
 		if (currPacketContainer == NULL) {
 			// There is none, so we can't work on and commit this.
 			// We just sleep here a little and then try again, as we need the data!
@@ -363,10 +423,13 @@ static int compressorThread(void *stateArg) {
 
 	// Handle shutdown, write out all content remaining in the transfer ring-buffer.
 	caerEventPacketContainer packetContainer;
-	while ((packetContainer = caerRingBufferGet(state->compressorRing)) != NULL) {
+	while ((packetContainer = compressorRingGet(state)) != NULL) {
 		orderAndSendEventPackets(state, packetContainer);
 	}
 
+	// Everything is on the output ring-buffer now, the output thread can finish.
+	atomic_store(&state->compressorThreadDone, true);
+
 	return (thrd_success);
 }
 
@@ -377,11 +440,21 @@ static void orderAndSendEventPackets(outputCommonState state, caerEventPacketCon
 	qsort(currPacketContainer->eventPackets, currPacketContainerSize, sizeof(caerEventPacketHeader),
 		&packetsFirstTimestampThenTypeCmp);
 
+	// Segmented file output: segments always start and end on packet container
+	// boundaries, so that each one respects the AEDAT 3.X ordering on its own.
+	if (state->segmentation.basePath != NULL) {
+		segmentContainerStart(state, currPacketContainer, currPacketContainerSize);
+	}
+
 	for (size_t cpIdx = 0; cpIdx < currPacketContainerSize; cpIdx++) {
 		// Send the packets out to the file descriptor.
 		sendEventPacket(state, caerEventPacketContainerGetEventPacket(currPacketContainer, (int32_t) cpIdx));
 	}
 
+	if (state->segmentation.basePath != NULL) {
+		segmentContainerEnd(state);
+	}
+
 	// Free packet container. The individual packets have already been either
 	// freed on error, or have been transferred out.
 	free(currPacketContainer);
@@ -430,13 +503,25 @@ static void sendEventPacket(outputCommonState state, caerEventPacketHeader packe
 	state->statistics.packetsDataSize += (size_t) (caerEventPacketHeaderGetEventNumber(packet)
 		* caerEventPacketHeaderGetEventSize(packet));
 
+	int16_t eventType = caerEventPacketHeaderGetEventType(packet);
+	size_t uncompressedSize = packetSize;
+
 	if (state->formatID != 0) {
+		uint64_t compressionStart = statisticsTimeNs();
+
 		packetSize = compressEventPacket(state, packet, packetSize);
+
+		state->statistics.compressionTime += statisticsTimeNs() - compressionStart;
 	}
 
 	// Statistics support (after compression).
 	state->statistics.dataWritten += packetSize;
 
+	if (eventType >= 0 && eventType < MAX_OUTPUT_STATISTICS_EVENT_TYPES) {
+		state->statistics.typeSizeUncompressed[eventType] += uncompressedSize;
+		state->statistics.typeSizeCompressed[eventType] += packetSize;
+	}
+
 	// Send compressed packet out to output handling thread.
 	// Already format it as a libuv buffer.
 	libuvWriteBuf packetBuffer = malloc(sizeof(*packetBuffer));
@@ -454,6 +539,135 @@ static void sendEventPacket(outputCommonState state, caerEventPacketHeader packe
 		// If the output thread failed, we'd forever block here, if it can't accept
 		// any more data. So we detect that condition and discard remaining packets.
 		if (atomic_load_explicit(&state->outputThreadFailure, memory_order_relaxed)) {
+			free(packetBuffer->freeBuf);
+			free(packetBuffer);
+
+			atomic_fetch_add_explicit(&state->statistics.packetsDropped, 1, memory_order_relaxed);
+			return;
+		}
+
+		// Delay by 500 µs if no change, to avoid a wasteful busy loop.
+		struct timespec retrySleep = { .tv_sec = 0, .tv_nsec = 500000 };
+		thrd_sleep(&retrySleep, NULL);
+	}
+
+	atomic_fetch_add_explicit(&state->statistics.outputRingUsage, 1, memory_order_relaxed);
+
+	// Only packets that actually go out count towards the segment.
+	state->segmentation.current.packetsNumber++;
+	state->segmentation.current.dataWritten += packetSize;
+}
+
+/**
+ * Track the timestamp range of the current file segment, and start a new
+ * segment if one was requested by the previous packet container, or on a
+ * timestamp reset, so that each segment covers a valid timestamp range.
+ * Must be called before sending the packets, as compression can modify the
+ * timestamps stored in them.
+ *
+ * @param state common output state.
+ * @param packetContainer the sorted packet container about to be sent out.
+ * @param packetContainerSize number of packets in the container.
+ */
+static void segmentContainerStart(outputCommonState state, caerEventPacketContainer packetContainer,
+	size_t packetContainerSize) {
+	struct output_common_segment *segment = &state->segmentation.current;
+
+	// Packets are sorted, so the first one has the smallest first timestamp.
+	caerEventPacketHeader firstPacket = caerEventPacketContainerGetEventPacket(packetContainer, 0);
+	int64_t containerFirstTimestamp = caerGenericEventGetTimestamp64(caerGenericEventGetEvent(firstPacket, 0),
+		firstPacket);
+	int64_t containerLastTimestamp = containerFirstTimestamp;
+
+	// The TS_RESET event always comes alone in its own packet container, see
+	// caerOutputCommonReset(). It starts a new segment, in which time restarts
+	// from zero. Its own timestamp is just a placeholder, so it's not used.
+	bool timestampReset = (packetContainerSize == 1)
+		&& (caerEventPacketHeaderGetEventType(firstPacket) == SPECIAL_EVENT)
+		&& (caerSpecialEventPacketFindEventByTypeConst((caerSpecialEventPacketConst) firstPacket, TIMESTAMP_RESET)
+			!= NULL);
+
+	if (timestampReset) {
+		containerFirstTimestamp = 0;
+		containerLastTimestamp = 0;
+	}
+	else {
+		for (size_t cpIdx = 0; cpIdx < packetContainerSize; cpIdx++) {
+			caerEventPacketHeader packet = caerEventPacketContainerGetEventPacket(packetContainer, (int32_t) cpIdx);
+
+			int64_t lastTimestamp = caerGenericEventGetTimestamp64(
+				caerGenericEventGetEvent(packet, caerEventPacketHeaderGetEventNumber(packet) - 1), packet);
+
+			if (lastTimestamp > containerLastTimestamp) {
+				containerLastTimestamp = lastTimestamp;
+			}
+		}
+	}
+
+	if (segment->packetsNumber != 0 && (state->segmentation.rotatePending || timestampReset)) {
+		segmentRotate(state);
+	}
+
+	if (segment->packetsNumber == 0) {
+		segment->firstTimestamp = containerFirstTimestamp;
+		segment->lastTimestamp = containerLastTimestamp;
+	}
+	else if (containerLastTimestamp > segment->lastTimestamp) {
+		segment->lastTimestamp = containerLastTimestamp;
+	}
+}
+
+/**
+ * Check segment limits after a full packet container was sent out. If any
+ * is reached, the rotation happens with the next packet container, so that
+ * no empty segment is ever created at the end of a recording.
+ *
+ * @param state common output state.
+ */
+static void segmentContainerEnd(outputCommonState state) {
+	struct output_common_segment *segment = &state->segmentation.current;
+
+	if ((state->segmentation.maxSize != 0) && (segment->dataWritten >= state->segmentation.maxSize)) {
+		state->segmentation.rotatePending = true;
+	}
+
+	if ((state->segmentation.maxDuration != 0)
+		&& ((segment->lastTimestamp - segment->firstTimestamp) >= state->segmentation.maxDuration)) {
+		state->segmentation.rotatePending = true;
+	}
+}
+
+/**
+ * Close the current segment and start a new one. This is done by sending a
+ * marker buffer (no data, but a copy of the finished segment's information)
+ * to the output thread, which keeps the order with the data packets intact.
+ *
+ * @param state common output state.
+ */
+static void segmentRotate(outputCommonState state) {
+	struct output_common_segment *segment = &state->segmentation.current;
+
+	struct output_common_segment *segmentCopy = malloc(sizeof(*segmentCopy));
+	libuvWriteBuf markerBuffer = malloc(sizeof(*markerBuffer));
+	if (segmentCopy == NULL || markerBuffer == NULL) {
+		free(segmentCopy);
+		free(markerBuffer);
+
+		// Continue writing to the current segment, try again with the next container.
+		caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to allocate memory for segment rotation.");
+		return;
+	}
+
+	*segmentCopy = *segment;
+
+	libuvWriteBufInternalInit(markerBuffer, NULL, 0, segmentCopy);
+
+	// Put marker onto output ring-buffer. Retry until successful.
+	while (!caerRingBufferPut(state->outputRing, markerBuffer)) {
+		if (atomic_load_explicit(&state->outputThreadFailure, memory_order_relaxed)) {
+			free(segmentCopy);
+			free(markerBuffer);
+			markerBuffer = NULL;
 			break;
 		}
 
@@ -461,6 +675,152 @@ static void sendEventPacket(outputCommonState state, caerEventPacketHeader packe
 		struct timespec retrySleep = { .tv_sec = 0, .tv_nsec = 500000 };
 		thrd_sleep(&retrySleep, NULL);
 	}
+
+	if (markerBuffer != NULL) {
+		atomic_fetch_add_explicit(&state->statistics.outputRingUsage, 1, memory_order_relaxed);
+	}
+
+	// Start fresh segment.
+	segment->index++;
+	segment->firstTimestamp = 0;
+	segment->lastTimestamp = 0;
+	segment->packetsNumber = 0;
+	segment->dataWritten = 0;
+
+	state->segmentation.rotatePending = false;
+}
+
+static caerEventPacketContainer compressorRingGet(outputCommonState state) {
+	caerEventPacketContainer packetContainer = caerRingBufferGet(state->compressorRing);
+
+	if (packetContainer != NULL) {
+		atomic_fetch_sub_explicit(&state->statistics.compressorRingUsage, 1, memory_order_relaxed);
+	}
+
+	return (packetContainer);
+}
+
+static const char *statisticsEventTypeName(int16_t eventType) {
+	switch (eventType) {
+		case SPECIAL_EVENT:
+			return ("Special");
+
+		case POLARITY_EVENT:
+			return ("Polarity");
+
+		case FRAME_EVENT:
+			return ("Frame");
+
+		case IMU6_EVENT:
+			return ("IMU6");
+
+		case IMU9_EVENT:
+			return ("IMU9");
+
+		case SPIKE_EVENT:
+			return ("Spike");
+
+		default:
+			return (NULL);
+	}
+}
+
+static inline int32_t statisticsRingUsagePercent(size_t usage, size_t ringSize) {
+	return (I32T((usage * 100) / ringSize));
+}
+
+static inline float statisticsLoadPercent(uint64_t busyTime, uint64_t elapsedTime) {
+	// Busy time can be accounted in the next interval (long writes), so clamp.
+	float load = ((float) busyTime * 100.0f) / (float) elapsedTime;
+
+	return ((load > 100.0f) ? (100.0f) : (load));
+}
+
+/**
+ * Track ring-buffer usage peaks on each call, and publish the live statistics
+ * to SSHS about once per second. Rates and loads refer to the time since the
+ * last update. Only called from the compressor thread.
+ *
+ * @param state common output state.
+ */
+static void statisticsUpdate(outputCommonState state) {
+	struct output_common_statistics *stats = &state->statistics;
+
+	size_t compressorRingUsage = atomic_load_explicit(&stats->compressorRingUsage, memory_order_relaxed);
+	if (compressorRingUsage > stats->compressorRingPeak) {
+		stats->compressorRingPeak = compressorRingUsage;
+	}
+
+	size_t outputRingUsage = atomic_load_explicit(&stats->outputRingUsage, memory_order_relaxed);
+	if (outputRingUsage > stats->outputRingPeak) {
+		stats->outputRingPeak = outputRingUsage;
+	}
+
+	uint64_t currentTime = statisticsTimeNs();
+	uint64_t elapsedTime = currentTime - stats->lastUpdateTime;
+
+	if (elapsedTime < 1000000000ULL) {
+		return;
+	}
+
+	uint64_t outputBytes = atomic_load_explicit(&stats->outputBytes, memory_order_relaxed);
+	uint64_t outputTime = atomic_load_explicit(&stats->outputTime, memory_order_relaxed);
+
+	sshsNodeUpdateReadOnlyAttribute(stats->statsNode, "compressorRingUsage", SSHS_INT,
+		(union sshs_node_attr_value) { .iint = statisticsRingUsagePercent(stats->compressorRingPeak, stats->ringSize) });
+	sshsNodeUpdateReadOnlyAttribute(stats->statsNode, "outputRingUsage", SSHS_INT,
+		(union sshs_node_attr_value) { .iint = statisticsRingUsagePercent(stats->outputRingPeak, stats->ringSize) });
+	sshsNodeUpdateReadOnlyAttribute(stats->statsNode, "packetsDropped", SSHS_LONG,
+		(union sshs_node_attr_value) { .ilong = I64T(atomic_load_explicit(&stats->packetsDropped, memory_order_relaxed)) });
+	sshsNodeUpdateReadOnlyAttribute(stats->statsNode, "bytesWritten", SSHS_LONG,
+		(union sshs_node_attr_value) { .ilong = I64T(outputBytes) });
+	sshsNodeUpdateReadOnlyAttribute(stats->statsNode, "writeThroughput", SSHS_LONG,
+		(union sshs_node_attr_value) { .ilong = I64T(
+			((outputBytes - stats->lastOutputBytes) * 1000000000ULL) / elapsedTime) });
+	sshsNodeUpdateReadOnlyAttribute(stats->statsNode, "compressionLoad", SSHS_FLOAT,
+		(union sshs_node_attr_value) { .ffloat = statisticsLoadPercent(stats->compressionTime, elapsedTime) });
+	sshsNodeUpdateReadOnlyAttribute(stats->statsNode, "outputLoad", SSHS_FLOAT,
+		(union sshs_node_attr_value) { .ffloat = statisticsLoadPercent(outputTime - stats->lastOutputTime,
+			elapsedTime) });
+
+	// Compression ratio per event type, only for types that were seen.
+	for (int16_t type = 0; type < MAX_OUTPUT_STATISTICS_EVENT_TYPES; type++) {
+		if (stats->typeSizeCompressed[type] == 0) {
+			continue;
+		}
+
+		char ratioKey[32];
+		const char *typeName = statisticsEventTypeName(type);
+
+		if (typeName != NULL) {
+			snprintf(ratioKey, 32, "compressionRatio%s", typeName);
+		}
+		else {
+			snprintf(ratioKey, 32, "compressionRatioType%" PRIi16, type);
+		}
+
+		if (!stats->typeAttributeCreated[type]) {
+			sshsNodeCreateFloat(stats->statsNode, ratioKey, 1, 0, FLT_MAX, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+				"Size before compression divided by size after compression, for this event type.");
+			sshsNodeCreateAttributePollTime(stats->statsNode, ratioKey, SSHS_FLOAT, 1);
+			stats->typeAttributeCreated[type] = true;
+		}
+
+		sshsNodeUpdateReadOnlyAttribute(stats->statsNode, ratioKey, SSHS_FLOAT,
+			(union sshs_node_attr_value) { .ffloat = (float) ((double) stats->typeSizeUncompressed[type]
+				/ (double) stats->typeSizeCompressed[type]) });
+
+		stats->typeSizeUncompressed[type] = 0;
+		stats->typeSizeCompressed[type] = 0;
+	}
+
+	// Start new interval.
+	stats->compressorRingPeak = compressorRingUsage;
+	stats->outputRingPeak = outputRingUsage;
+	stats->compressionTime = 0;
+	stats->lastUpdateTime = currentTime;
+	stats->lastOutputBytes = outputBytes;
+	stats->lastOutputTime = outputTime;
 }
 
 /**
@@ -481,15 +841,27 @@ static void sendEventPacket(outputCommonState state, caerEventPacketHeader packe
 static size_t compressEventPacket(outputCommonState state, caerEventPacketHeader packet, size_t packetSize) {
 	size_t compressedSize = packetSize;
 
+	// Data compression technique 4: delta and bit-packing encoding of polarity and spike events.
+	// Takes precedence over timestamp serialization, as it compresses much better.
+	if ((state->formatID & 0x08)
+		&& (caerEventPacketHeaderGetEventType(packet) == POLARITY_EVENT
+			|| caerEventPacketHeaderGetEventType(packet) == SPIKE_EVENT)) {
+		compressedSize = compressEventDelta(state, packet, packetSize);
+	}
 	// Data compression technique 1: serialize timestamps for event types that tend to repeat them a lot.
 	// Currently, this means polarity events.
-	if ((state->formatID & 0x01) && caerEventPacketHeaderGetEventType(packet) == POLARITY_EVENT) {
+	else if ((state->formatID & 0x01) && caerEventPacketHeaderGetEventType(packet) == POLARITY_EVENT) {
 		compressedSize = compressTimestampSerialize(state, packet);
 	}
 
+	// Data compression technique 3: fast delta/Rice compression on frames. Takes
+	// precedence over PNG, as it is the one designed to keep up with full frame-rate.
+	if ((state->formatID & 0x04) && caerEventPacketHeaderGetEventType(packet) == FRAME_EVENT) {
+		compressedSize = compressFrameDelta(state, packet);
+	}
 #ifdef ENABLE_INOUT_PNG_COMPRESSION
 	// Data compression technique 2: do PNG compression on frames, Grayscale and RGB(A).
-	if ((state->formatID & 0x02) && caerEventPacketHeaderGetEventType(packet) == FRAME_EVENT) {
+	else if ((state->formatID & 0x02) && caerEventPacketHeaderGetEventType(packet) == FRAME_EVENT) {
 		compressedSize = compressFramePNG(state, packet);
 	}
 #endif
@@ -606,124 +978,551 @@ static size_t compressTimestampSerialize(outputCommonState state, caerEventPacke
 	return (currPacketOffset);
 }
 
-#ifdef ENABLE_INOUT_PNG_COMPRESSION
-
-// Simple structure to store PNG image bytes.
-struct caer_libpng_buffer {
+// Byte writer for DeltaEvents compression. Stops writing on overflow.
+struct caer_event_delta_writer {
 	uint8_t *buffer;
-	size_t size;
+	size_t position;
+	size_t capacity;
+	bool overflow;
 };
 
-static void caerLibPNGWriteBuffer(png_structp png_ptr, png_bytep data, png_size_t length) {
-	struct caer_libpng_buffer *p = (struct caer_libpng_buffer *) png_get_io_ptr(png_ptr);
-	size_t newSize = p->size + length;
-	uint8_t *bufferSave = p->buffer;
+static inline void caerEventDeltaWriteVarint(struct caer_event_delta_writer *writer, uint32_t value) {
+	do {
+		if (writer->position >= writer->capacity) {
+			writer->overflow = true;
+			return;
+		}
 
-	// Allocate or grow buffer as needed.
-	if (p->buffer) {
-		p->buffer = realloc(p->buffer, newSize);
-	}
-	else {
-		p->buffer = malloc(newSize);
+		uint8_t byte = (uint8_t) (value & 0x7F);
+		value >>= 7;
+
+		writer->buffer[writer->position++] = (value != 0) ? (byte | 0x80) : (byte);
 	}
+	while (value != 0);
+}
 
-	if (p->buffer == NULL) {
-		free(bufferSave); // Free on realloc() failure.
-		png_error(png_ptr, "Write Buffer Error");
+/**
+ * Select the bit width for one lane of a DeltaEvents block, minimizing the
+ * packed size plus the (estimated) size of the exceptions above it.
+ */
+static uint32_t caerEventDeltaLaneWidth(const uint32_t *values, size_t valuesNumber) {
+	// Histogram of the number of significant bits of each value.
+	size_t bitsHistogram[33] = { 0 };
+
+	for (size_t i = 0; i < valuesNumber; i++) {
+		bitsHistogram[(values[i] == 0) ? (0) : (32 - (uint32_t) __builtin_clz(values[i]))]++;
 	}
 
-	// Copy the new bytes to the end of the buffer.
-	memcpy(p->buffer + p->size, data, length);
-	p->size += length;
-}
+	// Zero width is only possible if all values are zero.
+	if (bitsHistogram[0] == valuesNumber) {
+		return (0);
+	}
 
-static inline int caerFrameEventColorToLibPNG(enum caer_frame_event_color_channels channels) {
-	switch (channels) {
-		case GRAYSCALE:
-			return (PNG_COLOR_TYPE_GRAY);
-			break;
+	uint32_t bestWidth = 32;
+	size_t bestCost = valuesNumber * 32;
+	size_t exceptionsCost = 0;
 
-		case RGB:
-			return (PNG_COLOR_TYPE_RGB);
-			break;
+	for (uint32_t width = 31; width >= 1; width--) {
+		// Values with more significant bits than the width become exceptions,
+		// each costing roughly one varint byte per 7 bits.
+		exceptionsCost += bitsHistogram[width + 1] * 8 * ((width + 1 + 6) / 7);
 
-		case RGBA:
-		default:
-			return (PNG_COLOR_TYPE_RGBA);
-			break;
+		size_t cost = (valuesNumber * width) + exceptionsCost;
+		if (cost < bestCost) {
+			bestCost = cost;
+			bestWidth = width;
+		}
 	}
-}
 
-static inline bool caerFrameEventPNGCompress(uint8_t **outBuffer, size_t *outSize, uint16_t *inBuffer, int32_t xSize,
-	int32_t ySize, enum caer_frame_event_color_channels channels) {
-	png_structp png_ptr = NULL;
-	png_infop info_ptr = NULL;
-	png_bytepp row_pointers = NULL;
+	return (bestWidth);
+}
 
-	// Initialize the write struct.
-	png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-	if (png_ptr == NULL) {
-		return (false);
+static inline void caerEventDeltaPackLane(struct caer_event_delta_writer *writer, const uint32_t *values,
+	size_t valuesNumber, uint32_t width) {
+	if (width == 0) {
+		return;
 	}
 
-	// Initialize the info struct.
-	info_ptr = png_create_info_struct(png_ptr);
-	if (info_ptr == NULL) {
-		png_destroy_write_struct(&png_ptr, NULL);
-		return (false);
+	size_t packedSize = ((valuesNumber * width) + 7) / 8;
+
+	if ((writer->position + packedSize) > writer->capacity) {
+		writer->overflow = true;
+		return;
 	}
 
-	// Set up error handling.
-	if (setjmp(png_jmpbuf(png_ptr))) {
-		if (row_pointers != NULL) {
-			png_free(png_ptr, row_pointers);
+	uint32_t maxValue = caerEventDeltaMaxValue(width);
+	uint8_t *out = writer->buffer + writer->position;
+	uint64_t bitBuffer = 0;
+	uint32_t bitCount = 0;
+
+	for (size_t i = 0; i < valuesNumber; i++) {
+		uint32_t value = (values[i] < maxValue) ? (values[i]) : (maxValue);
+
+		bitBuffer |= (uint64_t) value << bitCount;
+		bitCount += width;
+
+		while (bitCount >= 8) {
+			*out++ = (uint8_t) bitBuffer;
+			bitBuffer >>= 8;
+			bitCount -= 8;
 		}
-		png_destroy_write_struct(&png_ptr, &info_ptr);
-		return (false);
 	}
 
-	// Set image attributes.
-	png_set_IHDR(png_ptr, info_ptr, (png_uint_32) xSize, (png_uint_32) ySize, 16, caerFrameEventColorToLibPNG(channels),
-	PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	if (bitCount > 0) {
+		*out = (uint8_t) bitBuffer;
+	}
 
-	// Handle endianness of 16-bit depth pixels correctly.
-	// PNG assumes big-endian, our Frame Event is always little-endian.
-	png_set_swap(png_ptr);
+	writer->position += packedSize;
 
-	// Initialize rows of PNG.
-	row_pointers = png_malloc(png_ptr, (size_t) ySize * sizeof(png_bytep));
-	if (row_pointers == NULL) {
-		png_destroy_write_struct(&png_ptr, &info_ptr);
-		return (false);
+	// Exception list: everything that didn't fit into the packed width.
+	for (size_t i = 0; i < valuesNumber; i++) {
+		if (values[i] >= maxValue) {
+			caerEventDeltaWriteVarint(writer, values[i] - maxValue);
+		}
 	}
+}
 
-	for (size_t y = 0; y < (size_t) ySize; y++) {
-		row_pointers[y] = (png_bytep) &inBuffer[y * (size_t) xSize * channels];
+/**
+ * Compress polarity and spike events with the DeltaEvents format, see
+ * inout_common.h for a description. The events are encoded to scratch
+ * memory first, and only copied back into the packet if they got smaller.
+ *
+ * @param state common output state.
+ * @param packet the packet to compress.
+ * @param packetSize the current event packet size (header + data).
+ *
+ * @return the event packet size (header + data) after compression.
+ *         Must be equal or smaller than the input packetSize.
+ */
+static size_t compressEventDelta(outputCommonState state, caerEventPacketHeader packet, size_t packetSize) {
+	struct caer_event_delta_layout layout;
+	if (!caerEventDeltaGetLayout(caerEventPacketHeaderGetEventType(packet), &layout)) {
+		return (packetSize);
 	}
 
-	// Set write function to buffer one.
-	struct caer_libpng_buffer state = { .buffer = NULL, .size = 0 };
-	png_set_write_fn(png_ptr, &state, &caerLibPNGWriteBuffer, NULL);
+	// Only the standard data + timestamp layout is supported.
+	int32_t eventNumber = caerEventPacketHeaderGetEventNumber(packet);
+	if (eventNumber <= 0 || caerEventPacketHeaderGetEventSize(packet) != 8
+		|| caerEventPacketHeaderGetEventTSOffset(packet) != 4) {
+		return (packetSize);
+	}
 
-	// Actually write the image data.
-	png_set_rows(png_ptr, info_ptr, row_pointers);
-	png_write_png(png_ptr, info_ptr, PNG_TRANSFORM_IDENTITY, NULL);
+	// Compressed data must be smaller than the original, so that's all the space needed.
+	size_t dataSize = packetSize - CAER_EVENT_PACKET_HEADER_SIZE;
 
-	// Free allocated memory for rows.
-	png_free(png_ptr, row_pointers);
+	if (state->eventCompressBufferSize < dataSize) {
+		uint8_t *newBuffer = realloc(state->eventCompressBuffer, dataSize);
+		if (newBuffer == NULL) {
+			return (packetSize);
+		}
 
-	// Destroy main structs.
-	png_destroy_write_struct(&png_ptr, &info_ptr);
+		state->eventCompressBuffer = newBuffer;
+		state->eventCompressBufferSize = dataSize;
+	}
 
-	// Pass out buffer with resulting PNG image.
-	*outBuffer = state.buffer;
-	*outSize = state.size;
+	struct caer_event_delta_writer writer = { .buffer = state->eventCompressBuffer, .position = 0, .capacity =
+		dataSize - 1, .overflow = false };
 
-	return (true);
-}
+	const uint32_t *events = (const uint32_t *) (((uint8_t *) packet) + CAER_EVENT_PACKET_HEADER_SIZE);
 
-static size_t compressFramePNG(outputCommonState state, caerEventPacketHeader packet) {
-	size_t currPacketOffset = CAER_EVENT_PACKET_HEADER_SIZE; // Start here, no change to header.
+	uint32_t lastTimestamp = le32toh(events[1]);
+	uint32_t lastA = 0;
+	uint32_t lastB = 0;
+	uint32_t bMask = (1U << (layout.aShift - layout.bShift)) - 1;
+	uint32_t flagsMask = (1U << layout.bShift) - 1;
+
+	memcpy(writer.buffer, &events[1], sizeof(int32_t)); // First timestamp, already little-endian.
+	writer.position += sizeof(int32_t);
+
+	uint32_t lanes[AEDAT3_EVENT_DELTA_LANES][AEDAT3_EVENT_DELTA_BLOCK_SIZE];
+
+	for (size_t blockStart = 0; blockStart < (size_t) eventNumber; blockStart += AEDAT3_EVENT_DELTA_BLOCK_SIZE) {
+		size_t blockEvents = (size_t) eventNumber - blockStart;
+		if (blockEvents > AEDAT3_EVENT_DELTA_BLOCK_SIZE) {
+			blockEvents = AEDAT3_EVENT_DELTA_BLOCK_SIZE;
+		}
+
+		// Split events into lanes of differences to the previous event.
+		for (size_t i = 0; i < blockEvents; i++) {
+			uint32_t data = le32toh(events[(blockStart + i) * 2]);
+			uint32_t timestamp = le32toh(events[((blockStart + i) * 2) + 1]);
+			uint32_t a = data >> layout.aShift;
+			uint32_t b = (data >> layout.bShift) & bMask;
+
+			lanes[0][i] = caerEventDeltaZigZag(timestamp - lastTimestamp);
+			lanes[1][i] = caerEventDeltaZigZag(a - lastA);
+			lanes[2][i] = caerEventDeltaZigZag(b - lastB);
+			lanes[3][i] = data & flagsMask;
+
+			lastTimestamp = timestamp;
+			lastA = a;
+			lastB = b;
+		}
+
+		uint32_t widths[AEDAT3_EVENT_DELTA_LANES];
+
+		if ((writer.position + AEDAT3_EVENT_DELTA_LANES) > writer.capacity) {
+			return (packetSize);
+		}
+
+		for (size_t l = 0; l < AEDAT3_EVENT_DELTA_LANES; l++) {
+			widths[l] = caerEventDeltaLaneWidth(lanes[l], blockEvents);
+			writer.buffer[writer.position++] = (uint8_t) widths[l];
+		}
+
+		for (size_t l = 0; l < AEDAT3_EVENT_DELTA_LANES; l++) {
+			caerEventDeltaPackLane(&writer, lanes[l], blockEvents, widths[l]);
+		}
+
+		// Bail out early if the events don't compress well enough.
+		if (writer.overflow) {
+			return (packetSize);
+		}
+	}
+
+	memcpy(((uint8_t *) packet) + CAER_EVENT_PACKET_HEADER_SIZE, writer.buffer, writer.position);
+
+	return (CAER_EVENT_PACKET_HEADER_SIZE + writer.position);
+}
+
+// MSB-first bit writer for DeltaFrames compression. Stops writing on overflow.
+struct caer_frame_delta_writer {
+	uint8_t *buffer;
+	size_t position;
+	size_t capacity;
+	uint64_t bitBuffer;
+	uint32_t bitCount;
+	bool overflow;
+};
+
+static inline void caerFrameDeltaWriteBits(struct caer_frame_delta_writer *writer, uint32_t value, uint32_t bits) {
+	// Up to 32 bits at a time, bitCount is always below 32 before this.
+	writer->bitBuffer = (writer->bitBuffer << bits) | value;
+	writer->bitCount += bits;
+
+	if (writer->bitCount >= 32) {
+		writer->bitCount -= 32;
+
+		if ((writer->position + 4) > writer->capacity) {
+			writer->overflow = true;
+			return;
+		}
+
+		uint32_t word = (uint32_t) (writer->bitBuffer >> writer->bitCount);
+		writer->buffer[writer->position++] = (uint8_t) (word >> 24);
+		writer->buffer[writer->position++] = (uint8_t) (word >> 16);
+		writer->buffer[writer->position++] = (uint8_t) (word >> 8);
+		writer->buffer[writer->position++] = (uint8_t) word;
+	}
+}
+
+static inline void caerFrameDeltaWriteFlush(struct caer_frame_delta_writer *writer) {
+	// Pad remaining bits with zeros up to the next byte boundary.
+	while (writer->bitCount > 0 && !writer->overflow) {
+		uint32_t bits = (writer->bitCount >= 8) ? (8) : (writer->bitCount);
+
+		if (writer->position >= writer->capacity) {
+			writer->overflow = true;
+			return;
+		}
+
+		writer->buffer[writer->position++] = (uint8_t) ((writer->bitBuffer >> (writer->bitCount - bits))
+			<< (8 - bits));
+		writer->bitCount -= bits;
+	}
+}
+
+static inline void caerFrameDeltaWriteSample(struct caer_frame_delta_writer *writer,
+	struct caer_frame_delta_context *ctx, int32_t residual) {
+	// Zig-zag map residual to unsigned: 0, -1, 1, -2, 2, ...
+	uint32_t mapped = ((uint32_t) residual << 1) ^ (uint32_t) (residual >> 31);
+	uint32_t k = caerFrameDeltaContextGetK(ctx);
+	uint32_t quotient = mapped >> k;
+
+	if (quotient < AEDAT3_FRAME_DELTA_RICE_LIMIT) {
+		// Unary quotient (zeros terminated by a one), then k remainder bits.
+		caerFrameDeltaWriteBits(writer, 1, quotient + 1);
+		if (k > 0) {
+			caerFrameDeltaWriteBits(writer, mapped & ((1U << k) - 1), k);
+		}
+	}
+	else {
+		// Escape: LIMIT zeros and a one, then the full mapped value.
+		caerFrameDeltaWriteBits(writer, 1, AEDAT3_FRAME_DELTA_RICE_LIMIT + 1);
+		caerFrameDeltaWriteBits(writer, mapped, AEDAT3_FRAME_DELTA_ESCAPE_BITS);
+	}
+
+	caerFrameDeltaContextUpdate(ctx, mapped);
+}
+
+/**
+ * Compress one frame's pixels into the given buffer with the DeltaFrames
+ * format, see inout_common.h for a description.
+ *
+ * @return the compressed block size, or zero if it would not fit into
+ *         the given buffer capacity.
+ */
+static size_t caerFrameEventDeltaCompress(uint8_t *outBuffer, size_t outCapacity, const uint16_t *inBuffer,
+	int32_t xSize, int32_t ySize, enum caer_frame_event_color_channels channels) {
+	size_t rowSamples = (size_t) xSize * channels;
+	size_t samples = rowSamples * (size_t) ySize;
+
+	if (outCapacity < 1 || samples == 0) {
+		return (0);
+	}
+
+	// Find trailing zero bits common to all pixels (ADC resolution below 16 bits).
+	uint16_t allBits = 0;
+	for (size_t i = 0; i < samples; i++) {
+		allBits |= le16toh(inBuffer[i]);
+	}
+
+	uint8_t shift = 0;
+	while (allBits != 0 && (allBits & 0x01) == 0 && shift < 15) {
+		allBits >>= 1;
+		shift++;
+	}
+
+	outBuffer[0] = shift;
+
+	struct caer_frame_delta_writer writer = { .buffer = outBuffer, .position = 1, .capacity = outCapacity,
+		.bitBuffer = 0, .bitCount = 0, .overflow = false };
+
+	struct caer_frame_delta_context ctx[4];
+	for (size_t c = 0; c < 4; c++) {
+		caerFrameDeltaContextInit(&ctx[c]);
+	}
+
+	for (size_t y = 0; y < (size_t) ySize; y++) {
+		const uint16_t *row = inBuffer + (y * rowSamples);
+		const uint16_t *prevRow = (y == 0) ? (row) : (row - rowSamples);
+
+		// First pixel of a row: predict from above (or zero for the very first row).
+		for (size_t c = 0; c < channels; c++) {
+			int32_t curr = (int32_t) (le16toh(row[c]) >> shift);
+			int32_t pred = (y == 0) ? (0) : ((int32_t) (le16toh(prevRow[c]) >> shift));
+
+			caerFrameDeltaWriteSample(&writer, &ctx[c], curr - pred);
+		}
+
+		// Rest of the row: predict from left (first row), or from left/up/up-left.
+		size_t c = 0;
+
+		for (size_t i = channels; i < rowSamples; i++) {
+			int32_t left = (int32_t) (le16toh(row[i - channels]) >> shift);
+			int32_t curr = (int32_t) (le16toh(row[i]) >> shift);
+			int32_t pred = left;
+
+			if (y != 0) {
+				pred = caerFrameDeltaPredict(left, (int32_t) (le16toh(prevRow[i]) >> shift),
+					(int32_t) (le16toh(prevRow[i - channels]) >> shift));
+			}
+
+			caerFrameDeltaWriteSample(&writer, &ctx[c], curr - pred);
+
+			if (++c == channels) {
+				c = 0;
+			}
+		}
+
+		// Bail out early if the frame doesn't compress well enough.
+		if (writer.overflow) {
+			return (0);
+		}
+	}
+
+	caerFrameDeltaWriteFlush(&writer);
+	if (writer.overflow) {
+		return (0);
+	}
+
+	return (writer.position);
+}
+
+/**
+ * Compress frames with the DeltaFrames format. Compared to PNG, this keeps no
+ * per-frame encoder setup, and reuses its output buffer across frames, so that
+ * it can keep up with frame recording at full APS frame-rate. Frames that don't
+ * get smaller are kept uncompressed, like with PNG.
+ *
+ * @param state common output state.
+ * @param packet the packet to compress.
+ *
+ * @return the event packet size (header + data) after compression.
+ *         Must be equal or smaller than the input packetSize.
+ */
+static size_t compressFrameDelta(outputCommonState state, caerEventPacketHeader packet) {
+	size_t currPacketOffset = CAER_EVENT_PACKET_HEADER_SIZE; // Start here, no change to header.
+	// '- sizeof(uint16_t)' to compensate for pixels[1] at end of struct for C++ compatibility.
+	size_t frameEventHeaderSize = (sizeof(struct caer_frame_event) - sizeof(uint16_t));
+
+	CAER_FRAME_ITERATOR_ALL_START((caerFrameEventPacket) packet)
+		size_t pixelSize = caerFrameEventGetPixelsSize(caerFrameIteratorElement);
+
+		// Grow scratch buffer if needed, it is then kept for all following frames.
+		if (state->frameCompressBufferSize < pixelSize) {
+			uint8_t *newBuffer = realloc(state->frameCompressBuffer, pixelSize);
+			if (newBuffer != NULL) {
+				state->frameCompressBuffer = newBuffer;
+				state->frameCompressBufferSize = pixelSize;
+			}
+		}
+
+		// The compressed block plus its length must be smaller than the pixels,
+		// else there is no advantage and we keep the frame uncompressed.
+		size_t outSize = 0;
+		if ((state->frameCompressBufferSize >= pixelSize) && (pixelSize > sizeof(int32_t))) {
+			outSize = caerFrameEventDeltaCompress(state->frameCompressBuffer, pixelSize - sizeof(int32_t) - 1,
+				caerFrameEventGetPixelArrayUnsafe(caerFrameIteratorElement),
+				caerFrameEventGetLengthX(caerFrameIteratorElement), caerFrameEventGetLengthY(caerFrameIteratorElement),
+				caerFrameEventGetChannelNumber(caerFrameIteratorElement));
+		}
+
+		if (outSize == 0) {
+			// Copy this frame uncompressed. Don't want to loose data.
+			size_t fullCopySize = frameEventHeaderSize + pixelSize;
+			memmove(((uint8_t *) packet) + currPacketOffset, caerFrameIteratorElement, fullCopySize);
+			currPacketOffset += fullCopySize;
+
+			continue;
+		}
+
+		// Mark frame as DeltaFrames compressed.
+		SET_NUMBITS32(caerFrameIteratorElement->info, AEDAT3_FRAME_DELTA_INFO_BIT, 0x01, 1);
+
+		// Keep frame event header intact, copy all image data, move memory close together.
+		memmove(((uint8_t *) packet) + currPacketOffset, caerFrameIteratorElement, frameEventHeaderSize);
+		currPacketOffset += frameEventHeaderSize;
+
+		// Store size of compressed block as 4 byte integer.
+		*((int32_t *) (((uint8_t *) packet) + currPacketOffset)) = htole32(I32T(outSize));
+		currPacketOffset += sizeof(int32_t);
+
+		memcpy(((uint8_t *) packet) + currPacketOffset, state->frameCompressBuffer, outSize);
+		currPacketOffset += outSize;
+	}
+
+	return (currPacketOffset);
+}
+
+#ifdef ENABLE_INOUT_PNG_COMPRESSION
+
+// Simple structure to store PNG image bytes.
+struct caer_libpng_buffer {
+	uint8_t *buffer;
+	size_t size;
+};
+
+static void caerLibPNGWriteBuffer(png_structp png_ptr, png_bytep data, png_size_t length) {
+	struct caer_libpng_buffer *p = (struct caer_libpng_buffer *) png_get_io_ptr(png_ptr);
+	size_t newSize = p->size + length;
+	uint8_t *bufferSave = p->buffer;
+
+	// Allocate or grow buffer as needed.
+	if (p->buffer) {
+		p->buffer = realloc(p->buffer, newSize);
+	}
+	else {
+		p->buffer = malloc(newSize);
+	}
+
+	if (p->buffer == NULL) {
+		free(bufferSave); // Free on realloc() failure.
+		png_error(png_ptr, "Write Buffer Error");
+	}
+
+	// Copy the new bytes to the end of the buffer.
+	memcpy(p->buffer + p->size, data, length);
+	p->size += length;
+}
+
+static inline int caerFrameEventColorToLibPNG(enum caer_frame_event_color_channels channels) {
+	switch (channels) {
+		case GRAYSCALE:
+			return (PNG_COLOR_TYPE_GRAY);
+			break;
+
+		case RGB:
+			return (PNG_COLOR_TYPE_RGB);
+			break;
+
+		case RGBA:
+		default:
+			return (PNG_COLOR_TYPE_RGBA);
+			break;
+	}
+}
+
+static inline bool caerFrameEventPNGCompress(uint8_t **outBuffer, size_t *outSize, uint16_t *inBuffer, int32_t xSize,
+	int32_t ySize, enum caer_frame_event_color_channels channels) {
+	png_structp png_ptr = NULL;
+	png_infop info_ptr = NULL;
+	png_bytepp row_pointers = NULL;
+
+	// Initialize the write struct.
+	png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	if (png_ptr == NULL) {
+		return (false);
+	}
+
+	// Initialize the info struct.
+	info_ptr = png_create_info_struct(png_ptr);
+	if (info_ptr == NULL) {
+		png_destroy_write_struct(&png_ptr, NULL);
+		return (false);
+	}
+
+	// Set up error handling.
+	if (setjmp(png_jmpbuf(png_ptr))) {
+		if (row_pointers != NULL) {
+			png_free(png_ptr, row_pointers);
+		}
+		png_destroy_write_struct(&png_ptr, &info_ptr);
+		return (false);
+	}
+
+	// Set image attributes.
+	png_set_IHDR(png_ptr, info_ptr, (png_uint_32) xSize, (png_uint_32) ySize, 16, caerFrameEventColorToLibPNG(channels),
+	PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+	// Handle endianness of 16-bit depth pixels correctly.
+	// PNG assumes big-endian, our Frame Event is always little-endian.
+	png_set_swap(png_ptr);
+
+	// Initialize rows of PNG.
+	row_pointers = png_malloc(png_ptr, (size_t) ySize * sizeof(png_bytep));
+	if (row_pointers == NULL) {
+		png_destroy_write_struct(&png_ptr, &info_ptr);
+		return (false);
+	}
+
+	for (size_t y = 0; y < (size_t) ySize; y++) {
+		row_pointers[y] = (png_bytep) &inBuffer[y * (size_t) xSize * channels];
+	}
+
+	// Set write function to buffer one.
+	struct caer_libpng_buffer state = { .buffer = NULL, .size = 0 };
+	png_set_write_fn(png_ptr, &state, &caerLibPNGWriteBuffer, NULL);
+
+	// Actually write the image data.
+	png_set_rows(png_ptr, info_ptr, row_pointers);
+	png_write_png(png_ptr, info_ptr, PNG_TRANSFORM_IDENTITY, NULL);
+
+	// Free allocated memory for rows.
+	png_free(png_ptr, row_pointers);
+
+	// Destroy main structs.
+	png_destroy_write_struct(&png_ptr, &info_ptr);
+
+	// Pass out buffer with resulting PNG image.
+	*outBuffer = state.buffer;
+	*outSize = state.size;
+
+	return (true);
+}
+
+static size_t compressFramePNG(outputCommonState state, caerEventPacketHeader packet) {
+	size_t currPacketOffset = CAER_EVENT_PACKET_HEADER_SIZE; // Start here, no change to header.
 	// '- sizeof(uint16_t)' to compensate for pixels[1] at end of struct for C++ compatibility.
 	size_t frameEventHeaderSize = (sizeof(struct caer_frame_event) - sizeof(uint16_t));
 
@@ -805,9 +1604,25 @@ static void libuvAsyncShutdown(uv_async_t *handle);
 static void libuvClientShutdown(uv_shutdown_t *clientShutdown, int status);
 static void libuvWriteStatusCheck(uv_handle_t *handle, int status);
 static void writePacket(outputCommonState state, libuvWriteBuf packetBuffer);
+static libuvWriteBuf outputRingGet(outputCommonState state);
+static void statisticsAddOutput(outputCommonState state, size_t outputBytes, uint64_t startTime);
+static void writePacketUDPBatched(outputCommonState state, libuvWriteBuf packetBuffer);
+static void udpBatchFlush(outputCommonState state);
+static void clientAdd(outputCommonNetIO streams, size_t clientIndex, uv_stream_t *client);
+static void clientRemove(outputCommonNetIO streams, size_t clientIndex);
+static void clientWrite(outputCommonState state, size_t clientIndex, libuvWriteMultiBuf buffers);
+static bool clientSend(outputCommonNetIO streams, size_t clientIndex, libuvWriteMultiBuf buffers);
+static void clientDropPending(struct output_common_client *clientInfo, size_t dropNumber);
+static void clientsFlowControl(outputCommonState state);
+static void clientsUpdateStatistics(outputCommonNetIO streams);
+static void updateConnectedClients(outputCommonNetIO streams);
 static void initializeNetworkHeader(outputCommonState state);
+static void fillNetworkHeader(outputCommonNetIO streams, uint8_t *headerMemory, bool startOfUDPPacket);
 static bool writeNetworkHeader(outputCommonNetIO streams, libuvWriteBuf buf, bool startOfUDPPacket);
 static void writeFileHeader(outputCommonState state);
+static void writeFileBuffer(outputCommonState state, libuvWriteBuf packetBuffer);
+static int openFileSegment(outputCommonState state, size_t segmentIndex);
+static bool writeIndexEntry(outputCommonState state, const struct output_common_segment *segment);
 
 static inline _Noreturn void errorExit(outputCommonState state, libuvWriteBuf packetBuffer) {
 	// Free currently held memory.
@@ -854,6 +1669,33 @@ static int outputThread(void *stateArg) {
 			initializeNetworkHeader(state);
 		}
 		else {
+			// Segmented file output: open first segment and the index now that
+			// data is coming in, so that no empty files are ever left behind.
+			if (state->segmentation.basePath != NULL) {
+				size_t indexPathLength = strlen(state->segmentation.basePath) + 11; // -index.csv + NUL.
+				char indexPath[indexPathLength];
+				snprintf(indexPath, indexPathLength, "%s-index.csv", state->segmentation.basePath);
+
+				state->segmentation.indexFileIO = open(indexPath, O_WRONLY | O_CREAT | O_TRUNC,
+				S_IWUSR | S_IRUSR | S_IRGRP);
+				if (state->segmentation.indexFileIO < 0) {
+					caerModuleLog(state->parentModule, CAER_LOG_CRITICAL,
+						"Could not create or open index file '%s' for writing. Error: %d.", indexPath, errno);
+					errorExit(state, NULL);
+				}
+
+				const char *indexHeader = "segment,file,firstTimestamp,lastTimestamp,packets,bytes\n";
+				if (!writeUntilDone(state->segmentation.indexFileIO, (const uint8_t *) indexHeader,
+					strlen(indexHeader))) {
+					errorExit(state, NULL);
+				}
+
+				state->fileIO = openFileSegment(state, 0);
+				if (state->fileIO < 0) {
+					errorExit(state, NULL);
+				}
+			}
+
 			writeFileHeader(state);
 		}
 
@@ -868,7 +1710,7 @@ static int outputThread(void *stateArg) {
 	// in caerOutputCommonExit() we expect the ring-buffer to always be empty!
 	if (!headerSent) {
 		libuvWriteBuf packetBuffer;
-		while ((packetBuffer = caerRingBufferGet(state->outputRing)) != NULL) {
+		while ((packetBuffer = outputRingGet(state)) != NULL) {
 			free(packetBuffer->freeBuf);
 			free(packetBuffer);
 		}
@@ -895,7 +1737,7 @@ static int outputThread(void *stateArg) {
 		struct timespec noDataSleep = { .tv_sec = 0, .tv_nsec = 1000000 };
 
 		while (atomic_load_explicit(&state->running, memory_order_relaxed)) {
-			libuvWriteBuf packetBuffer = caerRingBufferGet(state->outputRing);
+			libuvWriteBuf packetBuffer = outputRingGet(state);
 			if (packetBuffer == NULL) {
 				// There is none, so we can't work on and commit this.
 				// We just sleep here a little and then try again, as we need the data!
@@ -903,42 +1745,158 @@ static int outputThread(void *stateArg) {
 				continue;
 			}
 
-			// Write buffer to file descriptor.
-			if (!writeUntilDone(state->fileIO, (uint8_t *) packetBuffer->buf.base, packetBuffer->buf.len)) {
-				errorExit(state, packetBuffer);
+			writeFileBuffer(state, packetBuffer);
+		}
+
+		// Write all remaining buffers to file. The compressor thread may still
+		// be sending out its last packets, so wait for it to be done.
+		while (true) {
+			bool compressorDone = atomic_load(&state->compressorThreadDone);
+
+			libuvWriteBuf packetBuffer;
+			while ((packetBuffer = outputRingGet(state)) != NULL) {
+				writeFileBuffer(state, packetBuffer);
+			}
+
+			if (compressorDone) {
+				break;
 			}
 
-			free(packetBuffer->freeBuf);
-			free(packetBuffer);
+			thrd_sleep(&noDataSleep, NULL);
 		}
 
-		// Write all remaining buffers to file.
-		libuvWriteBuf packetBuffer;
-		while ((packetBuffer = caerRingBufferGet(state->outputRing)) != NULL) {
-			if (!writeUntilDone(state->fileIO, (uint8_t *) packetBuffer->buf.base, packetBuffer->buf.len)) {
-				errorExit(state, packetBuffer);
+		// Close off last segment. Safe to access, compressor thread is done.
+		if ((state->segmentation.basePath != NULL) && (state->segmentation.current.packetsNumber != 0)) {
+			if (!writeIndexEntry(state, &state->segmentation.current)) {
+				errorExit(state, NULL);
 			}
-
-			free(packetBuffer->freeBuf);
-			free(packetBuffer);
 		}
 	}
 
 	return (thrd_success);
 }
 
+static void writeFileBuffer(outputCommonState state, libuvWriteBuf packetBuffer) {
+	uint64_t writeStart = statisticsTimeNs();
+
+	if (packetBuffer->buf.base == NULL) {
+		// No data: segment rotation marker from compressor thread, which holds
+		// the finished segment's information. Close it and open the next one.
+		const struct output_common_segment *segment = packetBuffer->freeBuf;
+
+		if (!writeIndexEntry(state, segment)) {
+			errorExit(state, packetBuffer);
+		}
+
+		portable_fsync(state->fileIO);
+		close(state->fileIO);
+
+		state->fileIO = openFileSegment(state, segment->index + 1);
+		if (state->fileIO < 0) {
+			errorExit(state, packetBuffer);
+		}
+
+		// Each segment is a full AEDAT file on its own.
+		writeFileHeader(state);
+	}
+	else {
+		// Write buffer to file descriptor.
+		if (!writeUntilDone(state->fileIO, (uint8_t *) packetBuffer->buf.base, packetBuffer->buf.len)) {
+			errorExit(state, packetBuffer);
+		}
+	}
+
+	statisticsAddOutput(state, packetBuffer->buf.len, writeStart);
+
+	free(packetBuffer->freeBuf);
+	free(packetBuffer);
+}
+
+static libuvWriteBuf outputRingGet(outputCommonState state) {
+	libuvWriteBuf packetBuffer = caerRingBufferGet(state->outputRing);
+
+	if (packetBuffer != NULL) {
+		atomic_fetch_sub_explicit(&state->statistics.outputRingUsage, 1, memory_order_relaxed);
+	}
+
+	return (packetBuffer);
+}
+
+static void statisticsAddOutput(outputCommonState state, size_t outputBytes, uint64_t startTime) {
+	atomic_fetch_add_explicit(&state->statistics.outputBytes, outputBytes, memory_order_relaxed);
+	atomic_fetch_add_explicit(&state->statistics.outputTime, statisticsTimeNs() - startTime, memory_order_relaxed);
+}
+
+static int openFileSegment(outputCommonState state, size_t segmentIndex) {
+	// Segment files are named basePath-NNNN.aedat.
+	size_t filePathLength = strlen(state->segmentation.basePath) + 32;
+	char filePath[filePathLength];
+	snprintf(filePath, filePathLength, "%s-%04zu.aedat", state->segmentation.basePath, segmentIndex);
+
+	int fileFd = open(filePath, O_WRONLY | O_CREAT, S_IWUSR | S_IRUSR | S_IRGRP);
+	if (fileFd < 0) {
+		caerModuleLog(state->parentModule, CAER_LOG_CRITICAL,
+			"Could not create or open output file '%s' for writing. Error: %d.", filePath, errno);
+		return (-1);
+	}
+
+	caerModuleLog(state->parentModule, CAER_LOG_INFO, "Opened output file '%s' successfully for writing.", filePath);
+
+	return (fileFd);
+}
+
+static bool writeIndexEntry(outputCommonState state, const struct output_common_segment *segment) {
+	// Only store the file name, not the full path, so that recordings can be moved.
+	const char *baseName = strrchr(state->segmentation.basePath, '/');
+	baseName = (baseName == NULL) ? (state->segmentation.basePath) : (baseName + 1);
+
+	char indexEntry[strlen(baseName) + 128];
+	int indexEntryLength = snprintf(indexEntry, sizeof(indexEntry),
+		"%zu,%s-%04zu.aedat,%" PRIi64 ",%" PRIi64 ",%" PRIu64 ",%" PRIu64 "\n", segment->index, baseName,
+		segment->index, segment->firstTimestamp, segment->lastTimestamp, segment->packetsNumber,
+		segment->dataWritten);
+
+	if (!writeUntilDone(state->segmentation.indexFileIO, (const uint8_t *) indexEntry, (size_t) indexEntryLength)) {
+		caerModuleLog(state->parentModule, CAER_LOG_CRITICAL, "Failed to write index entry for segment %zu.",
+			segment->index);
+		return (false);
+	}
+
+	// Keep index up-to-date on disk, segments may be picked up right away.
+	portable_fsync(state->segmentation.indexFileIO);
+
+	return (true);
+}
+
 static void libuvRingBufferGet(uv_idle_t *handle) {
 	outputCommonState state = handle->data;
 
 	// Write all packets that are currently available out in order,
 	// but never more than 10 at a time.
 	size_t count = 0;
+	size_t countBytes = 0;
+	uint64_t writeStart = statisticsTimeNs();
 	libuvWriteBuf packetBuffer;
-	while (count < MAX_OUTPUT_RINGBUFFER_GET && (packetBuffer = caerRingBufferGet(state->outputRing)) != NULL) {
+	while (count < MAX_OUTPUT_RINGBUFFER_GET && (packetBuffer = outputRingGet(state)) != NULL) {
+		countBytes += packetBuffer->buf.len;
 		writePacket(state, packetBuffer);
 		count++;
 	}
 
+	// Send out everything packed so far, don't hold back data waiting for more.
+	if (count != 0 && state->networkIO->isUDP && state->networkIO->udpBatch.enabled) {
+		udpBatchFlush(state);
+	}
+
+	if (count != 0) {
+		statisticsAddOutput(state, countBytes, writeStart);
+	}
+
+	// Feed held back packets to clients that caught up, disconnect hopeless ones.
+	if (state->networkIO->clientsInfo != NULL) {
+		clientsFlowControl(state);
+	}
+
 	// If nothing, avoid busy loop within libuv event loop by sleeping a little.
 	if (count == 0) {
 		// Sleep for 1 ms.
@@ -957,198 +1915,665 @@ static void libuvAsyncShutdown(uv_async_t *handle) {
 	int retVal = uv_idle_stop(&state->networkIO->ringBufferGet);
 	UV_RET_CHECK(retVal, state->parentModule->moduleSubSystemString, "uv_idle_stop",);
 
-	uv_close((uv_handle_t *) &state->networkIO->ringBufferGet, NULL);
+	uv_close((uv_handle_t *) &state->networkIO->ringBufferGet, NULL);
+
+	// Then we empty the ring-buffer and write out all data.
+	libuvWriteBuf packetBuffer;
+	while ((packetBuffer = outputRingGet(state)) != NULL) {
+		writePacket(state, packetBuffer);
+	}
+
+	if (state->networkIO->isUDP && state->networkIO->udpBatch.enabled) {
+		udpBatchFlush(state);
+	}
+
+	// Shutdown server (if it exists).
+	if (state->networkIO->server != NULL) {
+		uv_close((uv_handle_t *) state->networkIO->server, &libuvCloseFree);
+	}
+
+	// Then we tell all network outputs to shutdown, which will then close them once done.
+	for (size_t i = 0; i < state->networkIO->clientsSize; i++) {
+		uv_stream_t *client = state->networkIO->clients[i];
+
+		if (client == NULL) {
+			continue;
+		}
+
+		if (state->networkIO->isUDP) {
+			// UDP has no shutdown, just close.
+			uv_close((uv_handle_t *) client, &libuvCloseFree);
+			continue;
+		}
+
+		// Send out all data still held back for this client, shutdown waits for it.
+		struct output_common_client *clientInfo = &state->networkIO->clientsInfo[i];
+
+		while (clientInfo->pendingNumber > 0) {
+			libuvWriteMultiBuf buffers = clientInfo->pending[clientInfo->pendingFirst];
+
+			clientInfo->pendingFirst = (clientInfo->pendingFirst + 1) % MAX_OUTPUT_CLIENT_PENDING;
+			clientInfo->pendingNumber--;
+			clientInfo->pendingSize -= buffers->buffers[0].buf.len;
+
+			clientSend(state->networkIO, i, buffers);
+		}
+
+		uv_shutdown_t *clientShutdown = calloc(1, sizeof(*clientShutdown));
+		if (clientShutdown == NULL) {
+			caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to allocate memory for client shutdown.");
+
+			// Hard close.
+			uv_close((uv_handle_t *) client, &libuvCloseFree);
+			continue;
+		}
+
+		retVal = uv_shutdown(clientShutdown, client, &libuvClientShutdown);
+		UV_RET_CHECK(retVal, state->parentModule->moduleSubSystemString, "uv_shutdown",
+			free(clientShutdown); uv_close((uv_handle_t *) client, &libuvCloseFree));
+	}
+
+	// Close shutdown itself.
+	uv_close((uv_handle_t *) &state->networkIO->shutdown, NULL);
+}
+
+static void libuvClientShutdown(uv_shutdown_t *clientShutdown, int status) {
+	uv_close((uv_handle_t *) clientShutdown->handle, &libuvCloseFree);
+
+	free(clientShutdown);
+
+	UV_RET_CHECK(status, __func__, "AfterShutdown",);
+}
+
+static void libuvWriteStatusCheck(uv_handle_t *handle, int status) {
+	if (status < 0) {
+		// Write failed!
+		caerLog(CAER_LOG_ERROR, __func__, "Write failed with error %d (%s). Closing connection.", status,
+			uv_err_name(status));
+
+		// Remove connection from list of active clients.
+		outputCommonNetIO streams = handle->data;
+
+		for (size_t i = 0; i < streams->clientsSize; i++) {
+			if ((uv_handle_t *) streams->clients[i] == handle) {
+				// Close connection and free its memory.
+				clientRemove(streams, i);
+
+				break;
+			}
+		}
+	}
+}
+
+static void writePacket(outputCommonState state, libuvWriteBuf packetBuffer) {
+	// If no active clients exist, don't write anything.
+	if (state->networkIO->activeClients == 0) {
+		free(packetBuffer->freeBuf);
+		free(packetBuffer);
+
+		return;
+	}
+
+	// Write packets to network. TCP/Pipe have their header already written in the
+	// Connection callbacks. Also, the size of the written data doesn't matter, as
+	// they are stream transports, and the network stack will take care of things
+	// like buffering and packet sizes.
+	// Only UDP needs special treatment here to write the proper header and split
+	// the packets up into manageable sizes (<=64K), together with keeping track
+	// of the sequence number.
+	if (state->networkIO->isUDP && state->networkIO->udpBatch.enabled) {
+		// UDP output, packing packets into datagrams and sending them in batches.
+		writePacketUDPBatched(state, packetBuffer);
+	}
+	else if (state->networkIO->isUDP) {
+		// UDP output.
+		// If too much data waiting to be sent, just skip current packet.
+		if (((uv_udp_t *) state->networkIO->clients[0])->send_queue_size > MAX_OUTPUT_QUEUED_SIZE) {
+			goto freePacketBufferUDP;
+		}
+
+		size_t packetSize = packetBuffer->buf.len;
+		size_t packetIndex = 0;
+		bool firstChunk = true;
+
+		// Split packets up into chunks for UDP. Send each chunk with its own
+		// header and increasing sequence number. The very first packet of a chunk is
+		// identifiable by having a negative sequence number (highest bit set to one).
+		while (packetSize > 0) {
+			libuvWriteMultiBuf buffers = libuvWriteBufAlloc(2); // One for network header, one for data.
+			if (buffers == NULL) {
+				caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to allocate memory for network buffers.");
+
+				goto freePacketBufferUDP;
+			}
+
+			buffers->statusCheck = &libuvWriteStatusCheck;
+
+			// Write header into first buffer.
+			if (!writeNetworkHeader(state->networkIO, &buffers->buffers[0], firstChunk)) {
+				caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to write network header.");
+
+				libuvWriteBufFree(buffers);
+				goto freePacketBufferUDP;
+			}
+
+			firstChunk = false;
+
+			// Write data into second buffer.
+			size_t sendSize = (packetSize > AEDAT3_MAX_UDP_SIZE) ? (AEDAT3_MAX_UDP_SIZE) : (packetSize);
+
+			libuvWriteBufInit(&buffers->buffers[1], sendSize);
+			if (buffers->buffers[1].buf.base == NULL) {
+				caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to allocate memory for data buffer.");
+
+				libuvWriteBufFree(buffers);
+				goto freePacketBufferUDP;
+			}
+
+			memcpy(buffers->buffers[1].buf.base, packetBuffer->buf.base + packetIndex, sendSize);
+
+			// For UDP we only support client mode to ONE outside address.
+			int retVal = libuvWriteUDP((uv_udp_t *) state->networkIO->clients[0], state->networkIO->address, buffers);
+			UV_RET_CHECK(retVal, state->parentModule->moduleSubSystemString, "libuvWriteUDP",
+				libuvWriteBufFree(buffers); goto freePacketBufferUDP);
+
+			// Update loop indexes.
+			packetSize -= sendSize;
+			packetIndex += sendSize;
+		}
+
+		// Free all packet memory.
+		freePacketBufferUDP: {
+			free(packetBuffer->freeBuf);
+			free(packetBuffer);
+		}
+	}
+	else {
+		// TCP/Pipe outputs.
+		// Prepare buffers, increase reference count.
+		libuvWriteMultiBuf buffers = libuvWriteBufAlloc(1);
+		if (buffers == NULL) {
+			caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to allocate memory for network buffers.");
+
+			free(packetBuffer->freeBuf);
+			free(packetBuffer);
+			return;
+		}
+
+		buffers->statusCheck = &libuvWriteStatusCheck;
+
+		buffers->refCount = state->networkIO->activeClients;
+
+		buffers->buffers[0] = *packetBuffer;
+		free(packetBuffer);
+
+		// Write to each client, but use common reference-counted buffer.
+		// Each client gets its own flow control, so slow ones don't hold back the others.
+		for (size_t i = 0; i < state->networkIO->clientsSize; i++) {
+			if (state->networkIO->clients[i] == NULL) {
+				continue;
+			}
+
+			clientWrite(state, i, buffers);
+		}
+	}
+}
+
+static void writePacketUDPBatched(outputCommonState state, libuvWriteBuf packetBuffer) {
+	struct output_common_udp_batch *batch = &state->networkIO->udpBatch;
+
+	size_t packetSize = packetBuffer->buf.len;
+	size_t packetIndex = 0;
+	bool startOfPacket = true;
+
+	// Append packet to current datagram, splitting it over as many datagrams as
+	// needed. Each datagram gets its own header and sequence number; the highest
+	// bit of the sequence number is set when the datagram starts with a new packet.
+	while (packetSize > 0) {
+		if (batch->currentSize == 0) {
+			// Start a new datagram, sending out full batches first.
+			if (batch->datagramsNumber == batch->maxDatagrams) {
+				udpBatchFlush(state);
+			}
+
+			fillNetworkHeader(state->networkIO, batch->buffer + (batch->datagramsNumber * batch->datagramSize),
+				startOfPacket);
+			batch->currentSize = AEDAT3_NETWORK_HEADER_LENGTH;
+		}
+
+		size_t freeSpace = batch->datagramSize - batch->currentSize;
+		size_t copySize = (packetSize > freeSpace) ? (freeSpace) : (packetSize);
+
+		memcpy(batch->buffer + (batch->datagramsNumber * batch->datagramSize) + batch->currentSize,
+			packetBuffer->buf.base + packetIndex, copySize);
+
+		batch->currentSize += copySize;
+		packetSize -= copySize;
+		packetIndex += copySize;
+		startOfPacket = false;
+
+		if (batch->currentSize == batch->datagramSize) {
+			// Datagram is full.
+			batch->datagramsNumber++;
+			batch->currentSize = 0;
+		}
+	}
+
+	free(packetBuffer->freeBuf);
+	free(packetBuffer);
+}
+
+static void udpBatchFlush(outputCommonState state) {
+	struct output_common_udp_batch *batch = &state->networkIO->udpBatch;
+
+	// Include last, partially filled datagram.
+	size_t datagramsNumber = batch->datagramsNumber;
+	size_t lastDatagramSize = batch->datagramSize;
+
+	if (batch->currentSize != 0) {
+		lastDatagramSize = batch->currentSize;
+		datagramsNumber++;
+	}
+
+	// Everything is sent (or dropped) synchronously, so reset for next batch now.
+	batch->datagramsNumber = 0;
+	batch->currentSize = 0;
+
+	if (datagramsNumber == 0) {
+		return;
+	}
+
+	uv_os_fd_t socketFd;
+	int retVal = uv_fileno((uv_handle_t *) state->networkIO->clients[0], &socketFd);
+	UV_RET_CHECK(retVal, state->parentModule->moduleSubSystemString, "uv_fileno",
+		batch->datagramsDropped += datagramsNumber; return);
+
+	size_t datagramsSent = 0;
+
+#if defined(OS_LINUX) && OS_LINUX == 1
+	bool socketFull = false;
+
+	// With GSO, the kernel splits one big buffer into datagramSize pieces, only the
+	// last of which may be smaller. This is exactly the layout of our batch buffer.
+	size_t gsoSegments = 65000 / batch->datagramSize;
+	if (gsoSegments > UDP_GSO_MAX_SEGMENTS) {
+		gsoSegments = UDP_GSO_MAX_SEGMENTS;
+	}
+
+	while (batch->useGSO && gsoSegments > 1 && (datagramsNumber - datagramsSent) > 1) {
+		size_t segments = datagramsNumber - datagramsSent;
+		if (segments > gsoSegments) {
+			segments = gsoSegments;
+		}
+
+		size_t sendSize = (segments - 1) * batch->datagramSize;
+		sendSize += ((datagramsSent + segments) == datagramsNumber) ? (lastDatagramSize) : (batch->datagramSize);
+
+		struct iovec iov = { .iov_base = batch->buffer + (datagramsSent * batch->datagramSize), .iov_len = sendSize };
+
+		union {
+			char buf[CMSG_SPACE(sizeof(uint16_t))];
+			struct cmsghdr align;
+		} control;
+		memset(&control, 0, sizeof(control));
+
+		struct msghdr msg = { .msg_name = state->networkIO->address, .msg_namelen = sizeof(struct sockaddr_in),
+			.msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.buf, .msg_controllen = sizeof(control.buf),
+			.msg_flags = 0 };
+
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_UDP;
+		cmsg->cmsg_type = UDP_SEGMENT;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+		*((uint16_t *) CMSG_DATA(cmsg)) = (uint16_t) batch->datagramSize;
+
+		if (sendmsg(socketFd, &msg, 0) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+				// Socket buffer full: drop the rest of this batch.
+				socketFull = true;
+				break;
+			}
+
+			// Not supported by kernel or network device: permanently fall back to sendmmsg().
+			caerModuleLog(state->parentModule, CAER_LOG_INFO,
+				"UDP segmentation offload not available (error %d), using sendmmsg() instead.", errno);
+			batch->useGSO = false;
+			break;
+		}
+
+		datagramsSent += segments;
+	}
+
+	// Send whatever GSO didn't: everything if it's not available, single datagrams
+	// (like the last one of a batch) and datagrams too big to be segmented.
+	if (!socketFull && datagramsSent < datagramsNumber) {
+		struct mmsghdr messages[datagramsNumber];
+		struct iovec iovs[datagramsNumber];
+
+		for (size_t i = datagramsSent; i < datagramsNumber; i++) {
+			iovs[i].iov_base = batch->buffer + (i * batch->datagramSize);
+			iovs[i].iov_len = ((i + 1) == datagramsNumber) ? (lastDatagramSize) : (batch->datagramSize);
+
+			memset(&messages[i], 0, sizeof(messages[i]));
+			messages[i].msg_hdr.msg_name = state->networkIO->address;
+			messages[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+			messages[i].msg_hdr.msg_iov = &iovs[i];
+			messages[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		while (datagramsSent < datagramsNumber) {
+			int sent = sendmmsg(socketFd, &messages[datagramsSent], (unsigned int) (datagramsNumber - datagramsSent), 0);
+			if (sent < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+
+				if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS) {
+					caerModuleLog(state->parentModule, CAER_LOG_ERROR, "sendmmsg() failed with error %d.", errno);
+				}
+
+				// Drop the rest of this batch.
+				break;
+			}
+
+			datagramsSent += (size_t) sent;
+		}
+	}
+#else
+	// No batched send system calls, send datagrams one by one.
+	while (datagramsSent < datagramsNumber) {
+		size_t sendSize = ((datagramsSent + 1) == datagramsNumber) ? (lastDatagramSize) : (batch->datagramSize);
+
+		if (sendto(socketFd, (const void *) (batch->buffer + (datagramsSent * batch->datagramSize)), sendSize, 0,
+			state->networkIO->address, sizeof(struct sockaddr_in)) < 0) {
+			// Drop the rest of this batch.
+			break;
+		}
+
+		datagramsSent++;
+	}
+#endif
+
+	batch->datagramsDropped += (datagramsNumber - datagramsSent);
+}
+
+static void clientAdd(outputCommonNetIO streams, size_t clientIndex, uv_stream_t *client) {
+	streams->clients[clientIndex] = client;
+	streams->activeClients++;
+
+	struct output_common_client *clientInfo = &streams->clientsInfo[clientIndex];
+
+	// Slot is free, so no data can be pending anymore, just reset it.
+	sshsNode statsNode = clientInfo->statsNode;
+	memset(clientInfo, 0, sizeof(*clientInfo));
+	clientInfo->statsNode = statsNode;
+
+	// Remember remote address for display.
+	if (streams->isTCP) {
+		struct sockaddr_storage clientAddress;
+		int clientAddressLength = sizeof(clientAddress);
+
+		if (uv_tcp_getpeername((uv_tcp_t *) client, (struct sockaddr *) &clientAddress, &clientAddressLength) == 0) {
+			char ipString[INET6_ADDRSTRLEN] = { 0 };
+			int port;
+
+			if (clientAddress.ss_family == AF_INET6) {
+				uv_ip6_name((struct sockaddr_in6 *) &clientAddress, ipString, sizeof(ipString));
+				port = ntohs(((struct sockaddr_in6 *) &clientAddress)->sin6_port);
+			}
+			else {
+				uv_ip4_name((struct sockaddr_in *) &clientAddress, ipString, sizeof(ipString));
+				port = ntohs(((struct sockaddr_in *) &clientAddress)->sin_port);
+			}
+
+			snprintf(clientInfo->address, MAX_OUTPUT_CLIENT_ADDRESS, "%s:%d", ipString, port);
+		}
+	}
+	else {
+		snprintf(clientInfo->address, MAX_OUTPUT_CLIENT_ADDRESS, "local%zu", clientIndex);
+	}
+
+	// Per-client statistics, one node per client slot.
+	if (clientInfo->statsNode == NULL) {
+		char nodeName[32];
+		snprintf(nodeName, 32, "clients/client%zu/", clientIndex);
 
-	// Then we empty the ring-buffer and write out all data.
-	libuvWriteBuf packetBuffer;
-	while ((packetBuffer = caerRingBufferGet(state->outputRing)) != NULL) {
-		writePacket(state, packetBuffer);
+		clientInfo->statsNode = sshsGetRelativeNode(streams->moduleNode, nodeName);
 	}
 
-	// Shutdown server (if it exists).
-	if (state->networkIO->server != NULL) {
-		uv_close((uv_handle_t *) state->networkIO->server, &libuvCloseFree);
-	}
+	sshsNodeCreateString(clientInfo->statsNode, "address", clientInfo->address, 0, MAX_OUTPUT_CLIENT_ADDRESS,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Remote address of this client.");
+	sshsNodeCreateLong(clientInfo->statsNode, "packetsSent", 0, 0, INT64_MAX, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Number of event packets sent to this client.");
+	sshsNodeCreateLong(clientInfo->statsNode, "packetsDropped", 0, 0, INT64_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Number of event packets dropped because this client was behind.");
+	sshsNodeCreateLong(clientInfo->statsNode, "bytesSent", 0, 0, INT64_MAX, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Number of bytes sent to this client.");
+	sshsNodeCreateLong(clientInfo->statsNode, "bytesOutstanding", 0, 0, INT64_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Bytes queued for this client, but not yet sent out.");
+	sshsNodeCreateLong(clientInfo->statsNode, "behindTime", 0, 0, INT64_MAX, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Time in ms this client has been continuously behind.");
 
-	// Then we tell all network outputs to shutdown, which will then close them once done.
-	for (size_t i = 0; i < state->networkIO->clientsSize; i++) {
-		uv_stream_t *client = state->networkIO->clients[i];
+	updateConnectedClients(streams);
+}
 
-		if (client == NULL) {
-			continue;
-		}
+static void clientRemove(outputCommonNetIO streams, size_t clientIndex) {
+	uv_stream_t *client = streams->clients[clientIndex];
 
-		if (state->networkIO->isUDP) {
-			// UDP has no shutdown, just close.
-			uv_close((uv_handle_t *) client, &libuvCloseFree);
-			continue;
-		}
+	streams->clients[clientIndex] = NULL;
+	streams->activeClients--;
 
-		uv_shutdown_t *clientShutdown = calloc(1, sizeof(*clientShutdown));
-		if (clientShutdown == NULL) {
-			caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to allocate memory for client shutdown.");
+	if (streams->clientsInfo != NULL) {
+		struct output_common_client *clientInfo = &streams->clientsInfo[clientIndex];
 
-			// Hard close.
-			uv_close((uv_handle_t *) client, &libuvCloseFree);
-			continue;
-		}
+		clientDropPending(clientInfo, clientInfo->pendingNumber);
 
-		retVal = uv_shutdown(clientShutdown, client, &libuvClientShutdown);
-		UV_RET_CHECK(retVal, state->parentModule->moduleSubSystemString, "uv_shutdown",
-			free(clientShutdown); uv_close((uv_handle_t *) client, &libuvCloseFree));
+		sshsNodeRemoveAllAttributes(clientInfo->statsNode);
+
+		updateConnectedClients(streams);
 	}
 
-	// Close shutdown itself.
-	uv_close((uv_handle_t *) &state->networkIO->shutdown, NULL);
+	// Writes still in flight get cancelled, their callbacks free the buffers.
+	if (!uv_is_closing((uv_handle_t *) client)) {
+		uv_close((uv_handle_t *) client, &libuvCloseFree);
+	}
 }
 
-static void libuvClientShutdown(uv_shutdown_t *clientShutdown, int status) {
-	uv_close((uv_handle_t *) clientShutdown->handle, &libuvCloseFree);
+/**
+ * Hand a packet to a client, applying the flow control policy. A client is
+ * behind when it has more than clientMaxQueuedSize bytes outstanding in libuv,
+ * or packets still held back from before. The buffers reference owned by this
+ * client is always consumed.
+ */
+static void clientWrite(outputCommonState state, size_t clientIndex, libuvWriteMultiBuf buffers) {
+	outputCommonNetIO streams = state->networkIO;
+	struct output_common_client *clientInfo = &streams->clientsInfo[clientIndex];
+	size_t maxQueuedSize = atomic_load_explicit(&streams->clientMaxQueuedSize, memory_order_relaxed);
+
+	if (clientInfo->pendingNumber == 0 && streams->clients[clientIndex]->write_queue_size <= maxQueuedSize) {
+		// Client is keeping up, send directly.
+		clientSend(streams, clientIndex, buffers);
+		return;
+	}
 
-	free(clientShutdown);
+	size_t packetSize = buffers->buffers[0].buf.len;
 
-	UV_RET_CHECK(status, __func__, "AfterShutdown",);
+	switch (atomic_load_explicit(&streams->flowControl, memory_order_relaxed)) {
+		case FLOW_CONTROL_DROP_OLDEST:
+			// Make space for the new packet by dropping the oldest ones.
+			while (clientInfo->pendingNumber == MAX_OUTPUT_CLIENT_PENDING
+				|| (clientInfo->pendingNumber > 0 && (clientInfo->pendingSize + packetSize) > maxQueuedSize)) {
+				clientDropPending(clientInfo, 1);
+			}
+			break;
+
+		case FLOW_CONTROL_SKIP_TO_LATEST:
+			// Only the newest packet is of interest.
+			clientDropPending(clientInfo, clientInfo->pendingNumber);
+			break;
+
+		case FLOW_CONTROL_DROP_NEWEST:
+		default:
+			// Skip current packet.
+			clientInfo->packetsDropped++;
+			libuvWriteBufFree(buffers);
+			return;
+	}
+
+	size_t pendingLast = (clientInfo->pendingFirst + clientInfo->pendingNumber) % MAX_OUTPUT_CLIENT_PENDING;
+
+	clientInfo->pending[pendingLast] = buffers;
+	clientInfo->pendingNumber++;
+	clientInfo->pendingSize += packetSize;
 }
 
-static void libuvWriteStatusCheck(uv_handle_t *handle, int status) {
-	if (status < 0) {
-		// Write failed!
-		caerLog(CAER_LOG_ERROR, __func__, "Write failed with error %d (%s). Closing connection.", status,
-			uv_err_name(status));
+static bool clientSend(outputCommonNetIO streams, size_t clientIndex, libuvWriteMultiBuf buffers) {
+	struct output_common_client *clientInfo = &streams->clientsInfo[clientIndex];
 
-		// Remove connection from list of active clients.
-		outputCommonNetIO streams = handle->data;
+	int retVal = libuvWrite(streams->clients[clientIndex], buffers);
+	UV_RET_CHECK(retVal, __func__, "libuvWrite", clientInfo->packetsDropped++; libuvWriteBufFree(buffers); return (false));
 
-		for (size_t i = 0; i < streams->clientsSize; i++) {
-			if ((uv_handle_t *) streams->clients[i] == handle) {
-				streams->clients[i] = NULL;
-				streams->activeClients--;
+	clientInfo->packetsSent++;
+	clientInfo->bytesSent += buffers->buffers[0].buf.len;
 
-				// Close connection and free its memory.
-				uv_close(handle, &libuvCloseFree);
+	return (true);
+}
 
-				break;
-			}
-		}
+static void clientDropPending(struct output_common_client *clientInfo, size_t dropNumber) {
+	while (dropNumber-- > 0 && clientInfo->pendingNumber > 0) {
+		libuvWriteMultiBuf buffers = clientInfo->pending[clientInfo->pendingFirst];
+
+		clientInfo->pendingFirst = (clientInfo->pendingFirst + 1) % MAX_OUTPUT_CLIENT_PENDING;
+		clientInfo->pendingNumber--;
+		clientInfo->pendingSize -= buffers->buffers[0].buf.len;
+		clientInfo->packetsDropped++;
+
+		libuvWriteBufFree(buffers);
 	}
 }
 
-static void writePacket(outputCommonState state, libuvWriteBuf packetBuffer) {
-	// If no active clients exist, don't write anything.
-	if (state->networkIO->activeClients == 0) {
-		free(packetBuffer->freeBuf);
-		free(packetBuffer);
+static void clientsFlowControl(outputCommonState state) {
+	outputCommonNetIO streams = state->networkIO;
 
+	if (streams->activeClients == 0) {
 		return;
 	}
 
-	// Write packets to network. TCP/Pipe have their header already written in the
-	// Connection callbacks. Also, the size of the written data doesn't matter, as
-	// they are stream transports, and the network stack will take care of things
-	// like buffering and packet sizes.
-	// Only UDP needs special treatment here to write the proper header and split
-	// the packets up into manageable sizes (<=64K), together with keeping track
-	// of the sequence number.
-	if (state->networkIO->isUDP) {
-		// UDP output.
-		// If too much data waiting to be sent, just skip current packet.
-		if (((uv_udp_t *) state->networkIO->clients[0])->send_queue_size > MAX_OUTPUT_QUEUED_SIZE) {
-			goto freePacketBufferUDP;
-		}
-
-		size_t packetSize = packetBuffer->buf.len;
-		size_t packetIndex = 0;
-		bool firstChunk = true;
-
-		// Split packets up into chunks for UDP. Send each chunk with its own
-		// header and increasing sequence number. The very first packet of a chunk is
-		// identifiable by having a negative sequence number (highest bit set to one).
-		while (packetSize > 0) {
-			libuvWriteMultiBuf buffers = libuvWriteBufAlloc(2); // One for network header, one for data.
-			if (buffers == NULL) {
-				caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to allocate memory for network buffers.");
-
-				goto freePacketBufferUDP;
-			}
+	size_t maxQueuedSize = atomic_load_explicit(&streams->clientMaxQueuedSize, memory_order_relaxed);
+	int64_t maxBehindTime = I64T(atomic_load_explicit(&streams->clientMaxBehindTime, memory_order_relaxed))
+		* 1000000000LL;
 
-			buffers->statusCheck = &libuvWriteStatusCheck;
+	struct timespec currentTime;
+	portable_clock_gettime_monotonic(&currentTime);
 
-			// Write header into first buffer.
-			if (!writeNetworkHeader(state->networkIO, &buffers->buffers[0], firstChunk)) {
-				caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to write network header.");
+	for (size_t i = 0; i < streams->clientsSize; i++) {
+		uv_stream_t *client = streams->clients[i];
 
-				libuvWriteBufFree(buffers);
-				goto freePacketBufferUDP;
-			}
+		if (client == NULL) {
+			continue;
+		}
 
-			firstChunk = false;
+		struct output_common_client *clientInfo = &streams->clientsInfo[i];
 
-			// Write data into second buffer.
-			size_t sendSize = (packetSize > AEDAT3_MAX_UDP_SIZE) ? (AEDAT3_MAX_UDP_SIZE) : (packetSize);
+		// Send held back packets, as long as the client keeps up.
+		while (clientInfo->pendingNumber > 0 && client->write_queue_size <= maxQueuedSize) {
+			libuvWriteMultiBuf buffers = clientInfo->pending[clientInfo->pendingFirst];
 
-			libuvWriteBufInit(&buffers->buffers[1], sendSize);
-			if (buffers->buffers[1].buf.base == NULL) {
-				caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to allocate memory for data buffer.");
+			clientInfo->pendingFirst = (clientInfo->pendingFirst + 1) % MAX_OUTPUT_CLIENT_PENDING;
+			clientInfo->pendingNumber--;
+			clientInfo->pendingSize -= buffers->buffers[0].buf.len;
 
-				libuvWriteBufFree(buffers);
-				goto freePacketBufferUDP;
+			if (!clientSend(streams, i, buffers)) {
+				break;
 			}
+		}
 
-			memcpy(buffers->buffers[1].buf.base, packetBuffer->buf.base + packetIndex, sendSize);
+		// Track how long the client is behind.
+		if (clientInfo->pendingNumber == 0 && client->write_queue_size <= maxQueuedSize) {
+			clientInfo->behindSince.tv_sec = 0;
+			clientInfo->behindSince.tv_nsec = 0;
+		}
+		else if (clientInfo->behindSince.tv_sec == 0 && clientInfo->behindSince.tv_nsec == 0) {
+			clientInfo->behindSince = currentTime;
+		}
+		else if (maxBehindTime > 0) {
+			int64_t behindTime = (I64T(currentTime.tv_sec - clientInfo->behindSince.tv_sec) * 1000000000LL)
+				+ I64T(currentTime.tv_nsec - clientInfo->behindSince.tv_nsec);
 
-			// For UDP we only support client mode to ONE outside address.
-			int retVal = libuvWriteUDP((uv_udp_t *) state->networkIO->clients[0], state->networkIO->address, buffers);
-			UV_RET_CHECK(retVal, state->parentModule->moduleSubSystemString, "libuvWriteUDP",
-				libuvWriteBufFree(buffers); goto freePacketBufferUDP);
+			if (behindTime >= maxBehindTime) {
+				caerModuleLog(state->parentModule, CAER_LOG_NOTICE,
+					"Client %s was behind for more than %" PRIi64 " seconds, disconnecting it.", clientInfo->address,
+					I64T(maxBehindTime / 1000000000LL));
 
-			// Update loop indexes.
-			packetSize -= sendSize;
-			packetIndex += sendSize;
+				clientRemove(streams, i);
+			}
 		}
+	}
 
-		// Free all packet memory.
-		freePacketBufferUDP: {
-			free(packetBuffer->freeBuf);
-			free(packetBuffer);
-		}
+	// Publish statistics once per second.
+	if (currentTime.tv_sec != streams->clientsStatsLastUpdate.tv_sec) {
+		streams->clientsStatsLastUpdate = currentTime;
+
+		clientsUpdateStatistics(streams);
 	}
-	else {
-		// TCP/Pipe outputs.
-		// Prepare buffers, increase reference count.
-		libuvWriteMultiBuf buffers = libuvWriteBufAlloc(1);
-		if (buffers == NULL) {
-			caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to allocate memory for network buffers.");
+}
 
-			free(packetBuffer->freeBuf);
-			free(packetBuffer);
-			return;
-		}
+static void clientsUpdateStatistics(outputCommonNetIO streams) {
+	struct timespec currentTime;
+	portable_clock_gettime_monotonic(&currentTime);
 
-		buffers->statusCheck = &libuvWriteStatusCheck;
+	for (size_t i = 0; i < streams->clientsSize; i++) {
+		if (streams->clients[i] == NULL) {
+			continue;
+		}
 
-		buffers->refCount = state->networkIO->activeClients;
+		struct output_common_client *clientInfo = &streams->clientsInfo[i];
 
-		buffers->buffers[0] = *packetBuffer;
-		free(packetBuffer);
+		int64_t behindTime = 0;
+		if (clientInfo->behindSince.tv_sec != 0 || clientInfo->behindSince.tv_nsec != 0) {
+			behindTime = (I64T(currentTime.tv_sec - clientInfo->behindSince.tv_sec) * 1000LL)
+				+ (I64T(currentTime.tv_nsec - clientInfo->behindSince.tv_nsec) / 1000000LL);
+		}
 
-		// Write to each client, but use common reference-counted buffer.
-		for (size_t i = 0; i < state->networkIO->clientsSize; i++) {
-			uv_stream_t *client = state->networkIO->clients[i];
+		sshsNodeUpdateReadOnlyAttribute(clientInfo->statsNode, "packetsSent", SSHS_LONG,
+			(union sshs_node_attr_value) { .ilong = I64T(clientInfo->packetsSent) });
+		sshsNodeUpdateReadOnlyAttribute(clientInfo->statsNode, "packetsDropped", SSHS_LONG,
+			(union sshs_node_attr_value) { .ilong = I64T(clientInfo->packetsDropped) });
+		sshsNodeUpdateReadOnlyAttribute(clientInfo->statsNode, "bytesSent", SSHS_LONG,
+			(union sshs_node_attr_value) { .ilong = I64T(clientInfo->bytesSent) });
+		sshsNodeUpdateReadOnlyAttribute(clientInfo->statsNode, "bytesOutstanding", SSHS_LONG,
+			(union sshs_node_attr_value) { .ilong = I64T(streams->clients[i]->write_queue_size + clientInfo->pendingSize) });
+		sshsNodeUpdateReadOnlyAttribute(clientInfo->statsNode, "behindTime", SSHS_LONG,
+			(union sshs_node_attr_value) { .ilong = behindTime });
+	}
+}
 
-			if (client == NULL) {
-				continue;
-			}
+static void updateConnectedClients(outputCommonNetIO streams) {
+	// Only servers have a list of connected clients (removed again on shutdown).
+	if (streams->server == NULL || !sshsNodeAttributeExists(streams->moduleNode, "connectedClients", SSHS_STRING)) {
+		return;
+	}
 
-			// If too much data waiting to be sent, just skip current packet.
-			if (client->write_queue_size > MAX_OUTPUT_QUEUED_SIZE) {
-				libuvWriteBufFree(buffers);
-				return;
-			}
+	char connectedClients[streams->clientsSize * (MAX_OUTPUT_CLIENT_ADDRESS + 1) + 1];
+	size_t connectedClientsLength = 0;
+	connectedClients[0] = '\0';
 
-			int retVal = libuvWrite(client, buffers);
-			UV_RET_CHECK(retVal, state->parentModule->moduleSubSystemString, "libuvWrite", libuvWriteBufFree(buffers));
+	for (size_t i = 0; i < streams->clientsSize; i++) {
+		if (streams->clients[i] == NULL) {
+			continue;
 		}
+
+		connectedClientsLength += (size_t) snprintf(connectedClients + connectedClientsLength,
+			sizeof(connectedClients) - connectedClientsLength, "%s%s", (connectedClientsLength == 0) ? ("") : (","),
+			streams->clientsInfo[i].address);
 	}
+
+	sshsNodeUpdateReadOnlyAttribute(streams->moduleNode, "connectedClients", SSHS_STRING,
+		(union sshs_node_attr_value) { .string = connectedClients });
 }
 
 static void initializeNetworkHeader(outputCommonState state) {
@@ -1160,15 +2585,7 @@ static void initializeNetworkHeader(outputCommonState state) {
 	state->networkIO->networkHeader.sourceID = htole16(I16T(atomic_load(&state->sourceID))); // Always one source per output module.
 }
 
-static bool writeNetworkHeader(outputCommonNetIO streams, libuvWriteBuf buf, bool startOfUDPPacket) {
-	// Create memory chunk for network header to be sent via libuv.
-	// libuv takes care of freeing memory. This is also needed for UDP
-	// to have different sequence numbers in flight.
-	libuvWriteBufInit(buf, AEDAT3_NETWORK_HEADER_LENGTH);
-	if (buf->buf.base == NULL) {
-		return (false);
-	}
-
+static void fillNetworkHeader(outputCommonNetIO streams, uint8_t *headerMemory, bool startOfUDPPacket) {
 	if (streams->isUDP && startOfUDPPacket) {
 		// Set highest bit of sequence number to one.
 		streams->networkHeader.sequenceNumber = htole64(
@@ -1176,7 +2593,7 @@ static bool writeNetworkHeader(outputCommonNetIO streams, libuvWriteBuf buf, boo
 	}
 
 	// Copy in current header.
-	memcpy(buf->buf.base, &streams->networkHeader, AEDAT3_NETWORK_HEADER_LENGTH);
+	memcpy(headerMemory, &streams->networkHeader, AEDAT3_NETWORK_HEADER_LENGTH);
 
 	if (streams->isUDP) {
 		if (startOfUDPPacket) {
@@ -1189,6 +2606,18 @@ static bool writeNetworkHeader(outputCommonNetIO streams, libuvWriteBuf buf, boo
 		// message-based network protocol (UDP for example).
 		streams->networkHeader.sequenceNumber = htole64(I64T(le64toh(streams->networkHeader.sequenceNumber) + 1));
 	}
+}
+
+static bool writeNetworkHeader(outputCommonNetIO streams, libuvWriteBuf buf, bool startOfUDPPacket) {
+	// Create memory chunk for network header to be sent via libuv.
+	// libuv takes care of freeing memory. This is also needed for UDP
+	// to have different sequence numbers in flight.
+	libuvWriteBufInit(buf, AEDAT3_NETWORK_HEADER_LENGTH);
+	if (buf->buf.base == NULL) {
+		return (false);
+	}
+
+	fillNetworkHeader(streams, (uint8_t *) buf->buf.base, startOfUDPPacket);
 
 	return (true);
 }
@@ -1205,18 +2634,38 @@ static void writeFileHeader(outputCommonState state) {
 		writeUntilDone(state->fileIO, (const uint8_t *) "RAW", 3);
 	}
 	else {
-		// Support the various formats and their mixing.
-		if (state->formatID == 0x01) {
+		// Support the various formats and their mixing, comma separated.
+		bool needsSeparator = false;
+
+		if (state->formatID & 0x01) {
 			writeUntilDone(state->fileIO, (const uint8_t *) "SerializedTS", 12);
+			needsSeparator = true;
 		}
 
-		if (state->formatID == 0x02) {
+		if (state->formatID & 0x02) {
+			if (needsSeparator) {
+				writeUntilDone(state->fileIO, (const uint8_t *) ",", 1);
+			}
+
 			writeUntilDone(state->fileIO, (const uint8_t *) "PNGFrames", 9);
+			needsSeparator = true;
+		}
+
+		if (state->formatID & 0x04) {
+			if (needsSeparator) {
+				writeUntilDone(state->fileIO, (const uint8_t *) ",", 1);
+			}
+
+			writeUntilDone(state->fileIO, (const uint8_t *) "DeltaFrames", 11);
+			needsSeparator = true;
 		}
 
-		if (state->formatID == 0x03) {
-			// Serial and PNG together.
-			writeUntilDone(state->fileIO, (const uint8_t *) "SerializedTS,PNGFrames", 12 + 1 + 9);
+		if (state->formatID & 0x08) {
+			if (needsSeparator) {
+				writeUntilDone(state->fileIO, (const uint8_t *) ",", 1);
+			}
+
+			writeUntilDone(state->fileIO, (const uint8_t *) "DeltaEvents", 11);
 		}
 	}
 
@@ -1320,10 +2769,7 @@ void caerOutputCommonOnServerConnection(uv_stream_t *server, int status) {
 			UV_RET_CHECK(retVal, __func__, "libuvWrite", libuvWriteBufFree(buffers); goto killConnection);
 
 			// Ready now for more data, so set client field for writePacket().
-			streams->clients[i] = client;
-			streams->activeClients++;
-
-			// TODO: add client IP to connected clients list.
+			clientAdd(streams, i, client);
 
 			return;
 		}
@@ -1361,21 +2807,56 @@ void caerOutputCommonOnClientConnection(uv_connect_t *connectionRequest, int sta
 	UV_RET_CHECK(retVal, __func__, "libuvWrite", libuvWriteBufFree(buffers); goto cleanupRequest);
 
 	// Ready now for more data, so set client field for writePacket().
-	streams->clients[0] = connectionRequest->handle;
-	streams->activeClients++;
+	clientAdd(streams, 0, connectionRequest->handle);
 
 	cleanupRequest: {
 		free(connectionRequest);
 	}
 }
 
+static void statisticsInit(outputCommonState state, sshsNode moduleNode, size_t ringSize) {
+	struct output_common_statistics *stats = &state->statistics;
+
+	stats->statsNode = sshsGetRelativeNode(moduleNode, "statistics/");
+	stats->ringSize = ringSize;
+	stats->lastUpdateTime = statisticsTimeNs();
+
+	sshsNodeCreateInt(stats->statsNode, "compressorRingUsage", 0, 0, 100, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Peak usage in percent of the ring-buffer between mainloop and compressor thread. "
+		"Close to 100 means packets are about to be dropped.");
+	sshsNodeCreateAttributePollTime(stats->statsNode, "compressorRingUsage", SSHS_INT, 1);
+	sshsNodeCreateInt(stats->statsNode, "outputRingUsage", 0, 0, 100, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Peak usage in percent of the ring-buffer between compressor and output thread. "
+		"Close to 100 means the output can't keep up.");
+	sshsNodeCreateAttributePollTime(stats->statsNode, "outputRingUsage", SSHS_INT, 1);
+	sshsNodeCreateLong(stats->statsNode, "packetsDropped", 0, 0, INT64_MAX, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Number of event packets dropped because the output was too slow (keepPackets disabled).");
+	sshsNodeCreateAttributePollTime(stats->statsNode, "packetsDropped", SSHS_LONG, 1);
+	sshsNodeCreateLong(stats->statsNode, "bytesWritten", 0, 0, INT64_MAX, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Number of bytes written to the output, after compression.");
+	sshsNodeCreateAttributePollTime(stats->statsNode, "bytesWritten", SSHS_LONG, 1);
+	sshsNodeCreateLong(stats->statsNode, "writeThroughput", 0, 0, INT64_MAX, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Bytes per second written to the output, after compression.");
+	sshsNodeCreateAttributePollTime(stats->statsNode, "writeThroughput", SSHS_LONG, 1);
+	sshsNodeCreateFloat(stats->statsNode, "compressionLoad", 0, 0, 100, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Percentage of time spent compressing event packets.");
+	sshsNodeCreateAttributePollTime(stats->statsNode, "compressionLoad", SSHS_FLOAT, 1);
+	sshsNodeCreateFloat(stats->statsNode, "outputLoad", 0, 0, 100, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Percentage of time spent writing data to the output (I/O).");
+	sshsNodeCreateAttributePollTime(stats->statsNode, "outputLoad", SSHS_FLOAT, 1);
+}
+
 bool caerOutputCommonInit(caerModuleData moduleData, int fileDescriptor, outputCommonNetIO streams) {
 	outputCommonState state = moduleData->moduleState;
 
 	state->parentModule = moduleData;
 
-	// Check for invalid input combinations.
-	if ((fileDescriptor < 0 && streams == NULL) || (fileDescriptor != -1 && streams != NULL)) {
+	// Check for invalid input combinations. Segmented file output opens its files
+	// later on in the output thread, and thus doesn't pass a file descriptor.
+	bool isSegmented = (state->segmentation.basePath != NULL);
+
+	if ((fileDescriptor < 0 && streams == NULL && !isSegmented) || (fileDescriptor != -1 && streams != NULL)
+		|| (fileDescriptor != -1 && isSegmented)) {
 		return (false);
 	}
 
@@ -1383,6 +2864,7 @@ bool caerOutputCommonInit(caerModuleData moduleData, int fileDescriptor, outputC
 	state->isNetworkStream = (streams != NULL);
 	state->fileIO = fileDescriptor;
 	state->networkIO = streams;
+	state->segmentation.indexFileIO = -1;
 
 	// If in server mode, add SSHS attribute to track connected client IPs.
 	if (state->isNetworkStream && state->networkIO->server != NULL) {
@@ -1390,6 +2872,40 @@ bool caerOutputCommonInit(caerModuleData moduleData, int fileDescriptor, outputC
 			SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "IPs of clients currently connected to output server.");
 	}
 
+	// Stream (TCP/Pipe) network outputs have per-client flow control.
+	if (state->isNetworkStream) {
+		state->networkIO->clientsInfo = NULL;
+		state->networkIO->moduleNode = moduleData->moduleNode;
+		state->networkIO->clientsStatsLastUpdate.tv_sec = 0;
+		state->networkIO->clientsStatsLastUpdate.tv_nsec = 0;
+	}
+
+	if (state->isNetworkStream && !state->networkIO->isUDP) {
+		sshsNodeCreateString(moduleData->moduleNode, "clientFlowControl", "DropNewest", 10, 12, SSHS_FLAGS_NORMAL,
+			"What to do with new data for a client that is behind: drop it (DropNewest), hold it back dropping the oldest held back data (DropOldest), or hold back only the most recent packet (SkipToLatest).");
+		sshsNodeCreateAttributeListOptions(moduleData->moduleNode, "clientFlowControl", SSHS_STRING,
+			"DropNewest,DropOldest,SkipToLatest", false);
+		sshsNodeCreateInt(moduleData->moduleNode, "clientMaxQueuedSize", MAX_OUTPUT_QUEUED_SIZE / 1024, 16, 1024 * 1024,
+			SSHS_FLAGS_NORMAL, "Maximum data in KiB waiting to be sent to a client, before it is considered behind.");
+		sshsNodeCreateInt(moduleData->moduleNode, "clientMaxBehindTime", 0, 0, 3600, SSHS_FLAGS_NORMAL,
+			"Disconnect clients that are continuously behind for this many seconds (0 = never).");
+
+		char *flowControlString = sshsNodeGetString(moduleData->moduleNode, "clientFlowControl");
+		atomic_store(&state->networkIO->flowControl, parseFlowControl(flowControlString));
+		free(flowControlString);
+
+		atomic_store(&state->networkIO->clientMaxQueuedSize,
+			(size_t) sshsNodeGetInt(moduleData->moduleNode, "clientMaxQueuedSize") * 1024);
+		atomic_store(&state->networkIO->clientMaxBehindTime,
+			sshsNodeGetInt(moduleData->moduleNode, "clientMaxBehindTime"));
+
+		state->networkIO->clientsInfo = calloc(state->networkIO->clientsSize, sizeof(struct output_common_client));
+		if (state->networkIO->clientsInfo == NULL) {
+			caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to allocate memory for clients information.");
+			return (false);
+		}
+	}
+
 	// Initial source ID has to be -1 (invalid).
 	atomic_store(&state->sourceID, -1);
 
@@ -1399,17 +2915,46 @@ bool caerOutputCommonInit(caerModuleData moduleData, int fileDescriptor, outputC
 		"Ensure all packets are kept (stall output if transfer-buffer full).");
 	sshsNodeCreateInt(moduleData->moduleNode, "ringBufferSize", 512, 8, 4096, SSHS_FLAGS_NORMAL,
 		"Size of EventPacketContainer and EventPacket queues, used for transfers between mainloop and output threads.");
+	sshsNodeCreateString(moduleData->moduleNode, "format", "", 0, 64, SSHS_FLAGS_NORMAL,
+		"Compression formats to apply to the data, none selected means RAW. DeltaFrames takes precedence over PNGFrames, "
+		"DeltaEvents over SerializedTS.");
+	sshsNodeCreateAttributeListOptions(moduleData->moduleNode, "format", SSHS_STRING,
+		"SerializedTS,PNGFrames,DeltaFrames,DeltaEvents", true);
 
 	atomic_store(&state->validOnly, sshsNodeGetBool(moduleData->moduleNode, "validOnly"));
 	atomic_store(&state->keepPackets, sshsNodeGetBool(moduleData->moduleNode, "keepPackets"));
 	int ringSize = sshsNodeGetInt(moduleData->moduleNode, "ringBufferSize");
 
-	// Format configuration (compression modes).
+	// Format configuration (compression modes). Only changes here at init time!
 	state->formatID = 0x00; // RAW format by default.
 
+	char *formatString = sshsNodeGetString(moduleData->moduleNode, "format");
+
+	if (strstr(formatString, "SerializedTS") != NULL) {
+		state->formatID |= 0x01;
+	}
+
+	if (strstr(formatString, "PNGFrames") != NULL) {
+		state->formatID |= 0x02;
+	}
+
+	if (strstr(formatString, "DeltaFrames") != NULL) {
+		state->formatID |= 0x04;
+	}
+
+	if (strstr(formatString, "DeltaEvents") != NULL) {
+		state->formatID |= 0x08;
+	}
+
+	free(formatString);
+
 	// Initialize compressor ring-buffer. ringBufferSize only changes here at init time!
 	state->compressorRing = caerRingBufferInit((size_t) ringSize);
 	if (state->compressorRing == NULL) {
+		if (state->isNetworkStream) {
+			free(state->networkIO->clientsInfo);
+		}
+
 		caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to allocate compressor ring-buffer.");
 		return (false);
 	}
@@ -1418,6 +2963,9 @@ bool caerOutputCommonInit(caerModuleData moduleData, int fileDescriptor, outputC
 	state->outputRing = caerRingBufferInit((size_t) ringSize);
 	if (state->outputRing == NULL) {
 		caerRingBufferFree(state->compressorRing);
+		if (state->isNetworkStream) {
+			free(state->networkIO->clientsInfo);
+		}
 
 		caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to allocate output ring-buffer.");
 		return (false);
@@ -1429,30 +2977,36 @@ bool caerOutputCommonInit(caerModuleData moduleData, int fileDescriptor, outputC
 		state->networkIO->shutdown.data = state;
 		int retVal = uv_async_init(&state->networkIO->loop, &state->networkIO->shutdown, &libuvAsyncShutdown);
 		UV_RET_CHECK(retVal, state->parentModule->moduleSubSystemString, "uv_async_init",
-			caerRingBufferFree(state->compressorRing); caerRingBufferFree(state->outputRing); return (false));
+			caerRingBufferFree(state->compressorRing); caerRingBufferFree(state->outputRing); free(state->networkIO->clientsInfo); return (false));
 
 		// Use idle handles to check for new data on every loop run.
 		state->networkIO->ringBufferGet.data = state;
 		retVal = uv_idle_init(&state->networkIO->loop, &state->networkIO->ringBufferGet);
 		UV_RET_CHECK(retVal, state->parentModule->moduleSubSystemString, "uv_idle_init",
-			uv_close((uv_handle_t *) &state->networkIO->shutdown, NULL); caerRingBufferFree(state->compressorRing); caerRingBufferFree(state->outputRing); return (false));
+			uv_close((uv_handle_t *) &state->networkIO->shutdown, NULL); caerRingBufferFree(state->compressorRing); caerRingBufferFree(state->outputRing); free(state->networkIO->clientsInfo); return (false));
 
 		retVal = uv_idle_start(&state->networkIO->ringBufferGet, &libuvRingBufferGet);
 		UV_RET_CHECK(retVal, state->parentModule->moduleSubSystemString, "uv_idle_start",
-			uv_close((uv_handle_t *) &state->networkIO->ringBufferGet, NULL); uv_close((uv_handle_t *) &state->networkIO->shutdown, NULL); caerRingBufferFree(state->compressorRing); caerRingBufferFree(state->outputRing); return (false));
+			uv_close((uv_handle_t *) &state->networkIO->ringBufferGet, NULL); uv_close((uv_handle_t *) &state->networkIO->shutdown, NULL); caerRingBufferFree(state->compressorRing); caerRingBufferFree(state->outputRing); free(state->networkIO->clientsInfo); return (false));
 	}
 
+	// Live statistics, updated by the compressor thread.
+	statisticsInit(state, moduleData->moduleNode, (size_t) ringSize);
+
 	// Start output handling thread.
 	atomic_store(&state->running, true);
+	atomic_store(&state->compressorThreadDone, false);
 
 	if (thrd_create(&state->compressorThread, &compressorThread, state) != thrd_success) {
 		if (state->isNetworkStream) {
 			uv_idle_stop(&state->networkIO->ringBufferGet);
 			uv_close((uv_handle_t *) &state->networkIO->ringBufferGet, NULL);
 			uv_close((uv_handle_t *) &state->networkIO->shutdown, NULL);
+			free(state->networkIO->clientsInfo);
 		}
 		caerRingBufferFree(state->compressorRing);
 		caerRingBufferFree(state->outputRing);
+		sshsNodeRemoveAllAttributes(state->statistics.statsNode);
 
 		caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to start compressor thread.");
 		return (false);
@@ -1472,9 +3026,11 @@ bool caerOutputCommonInit(caerModuleData moduleData, int fileDescriptor, outputC
 			uv_idle_stop(&state->networkIO->ringBufferGet);
 			uv_close((uv_handle_t *) &state->networkIO->ringBufferGet, NULL);
 			uv_close((uv_handle_t *) &state->networkIO->shutdown, NULL);
+			free(state->networkIO->clientsInfo);
 		}
 		caerRingBufferFree(state->compressorRing);
 		caerRingBufferFree(state->outputRing);
+		sshsNodeRemoveAllAttributes(state->statistics.statsNode);
 
 		caerModuleLog(state->parentModule, CAER_LOG_ERROR, "Failed to start output thread.");
 		return (false);
@@ -1531,6 +3087,9 @@ void caerOutputCommonExit(caerModuleData moduleData) {
 
 	caerRingBufferFree(state->outputRing);
 
+	// Threads are gone, no more live statistics.
+	sshsNodeRemoveAllAttributes(state->statistics.statsNode);
+
 	// Cleanup IO resources.
 	if (state->isNetworkStream) {
 		if (state->networkIO->server != NULL) {
@@ -1545,19 +3104,56 @@ void caerOutputCommonExit(caerModuleData moduleData) {
 		retVal = uv_loop_close(&state->networkIO->loop);
 		UV_RET_CHECK(retVal, state->parentModule->moduleSubSystemString, "uv_loop_close",);
 
+		if (state->networkIO->clientsInfo != NULL) {
+			// All clients are gone, remove their held back data and statistics.
+			for (size_t i = 0; i < state->networkIO->clientsSize; i++) {
+				struct output_common_client *clientInfo = &state->networkIO->clientsInfo[i];
+
+				clientDropPending(clientInfo, clientInfo->pendingNumber);
+
+				if (clientInfo->statsNode != NULL) {
+					sshsNodeRemoveAllAttributes(clientInfo->statsNode);
+				}
+			}
+
+			free(state->networkIO->clientsInfo);
+		}
+
+		if (state->networkIO->isUDP && state->networkIO->udpBatch.enabled) {
+			if (state->networkIO->udpBatch.datagramsDropped != 0) {
+				caerModuleLog(state->parentModule, CAER_LOG_NOTICE,
+					"Dropped %" PRIu64 " datagrams due to full socket send buffer.",
+					state->networkIO->udpBatch.datagramsDropped);
+			}
+
+			free(state->networkIO->udpBatch.buffer);
+		}
+
 		// Free allocated memory. libuv already frees all client/server related memory.
 		free(state->networkIO->address);
 		free(state->networkIO);
 	}
 	else {
-		// Ensure all data written to disk.
-		portable_fsync(state->fileIO);
+		// Segmented outputs might have never opened a file.
+		if (state->fileIO >= 0) {
+			// Ensure all data written to disk.
+			portable_fsync(state->fileIO);
 
-		// Close file descriptor.
-		close(state->fileIO);
+			// Close file descriptor.
+			close(state->fileIO);
+		}
+
+		if (state->segmentation.indexFileIO >= 0) {
+			portable_fsync(state->segmentation.indexFileIO);
+			close(state->segmentation.indexFileIO);
+		}
+
+		free(state->segmentation.basePath);
 	}
 
 	free(state->sourceInfoString);
+	free(state->frameCompressBuffer);
+	free(state->eventCompressBuffer);
 
 	// Print final statistics results.
 	caerModuleLog(state->parentModule, CAER_LOG_INFO,
@@ -1566,6 +3162,12 @@ void caerOutputCommonExit(caerModuleData moduleData) {
 		state->statistics.packetsNumber, state->statistics.packetsTotalSize, state->statistics.packetsHeaderSize,
 		state->statistics.packetsDataSize, state->statistics.dataWritten,
 		(state->statistics.packetsTotalSize - state->statistics.dataWritten));
+
+	uint64_t packetsDropped = atomic_load(&state->statistics.packetsDropped);
+	if (packetsDropped != 0) {
+		caerModuleLog(state->parentModule, CAER_LOG_WARNING,
+			"Dropped %" PRIu64 " packets because the output could not keep up.", packetsDropped);
+	}
 }
 
 static void caerOutputCommonConfigListener(sshsNode node, void *userData, enum sshs_node_attribute_events event,
@@ -1584,5 +3186,14 @@ static void caerOutputCommonConfigListener(sshsNode node, void *userData, enum s
 			// Set keep packets flag to given value.
 			atomic_store(&state->keepPackets, changeValue.boolean);
 		}
+		else if (changeType == SSHS_STRING && caerStrEquals(changeKey, "clientFlowControl")) {
+			atomic_store(&state->networkIO->flowControl, parseFlowControl(changeValue.string));
+		}
+		else if (changeType == SSHS_INT && caerStrEquals(changeKey, "clientMaxQueuedSize")) {
+			atomic_store(&state->networkIO->clientMaxQueuedSize, (size_t) changeValue.iint * 1024);
+		}
+		else if (changeType == SSHS_INT && caerStrEquals(changeKey, "clientMaxBehindTime")) {
+			atomic_store(&state->networkIO->clientMaxBehindTime, changeValue.iint);
+		}
 	}
 }
@@ -12,6 +12,55 @@
 
 #define MAX_OUTPUT_RINGBUFFER_GET 10
 #define MAX_OUTPUT_QUEUED_SIZE (1 * 1024 * 1024) // 1MB outstanding writes
+#define MAX_OUTPUT_CLIENT_PENDING 128 // Packets held back per slow client
+#define MAX_OUTPUT_CLIENT_ADDRESS 64
+#define MAX_OUTPUT_STATISTICS_EVENT_TYPES 32 // Per-type compression statistics for type IDs below this
+
+enum output_common_flow_control {
+	/// Client behind: don't send it new packets until it catches up.
+	FLOW_CONTROL_DROP_NEWEST = 0,
+	/// Client behind: hold back new packets, dropping the oldest held back ones.
+	FLOW_CONTROL_DROP_OLDEST = 1,
+	/// Client behind: hold back only the most recent packet.
+	FLOW_CONTROL_SKIP_TO_LATEST = 2,
+};
+
+struct output_common_client {
+	/// Packets held back for this client, oldest first (circular buffer).
+	libuvWriteMultiBuf pending[MAX_OUTPUT_CLIENT_PENDING];
+	size_t pendingFirst;
+	size_t pendingNumber;
+	/// Total bytes held back in pending.
+	size_t pendingSize;
+	/// Since when the client is continuously behind (monotonic), zero if not.
+	struct timespec behindSince;
+	/// Remote address, for display.
+	char address[MAX_OUTPUT_CLIENT_ADDRESS];
+	/// Statistics, published to SSHS periodically.
+	uint64_t packetsSent;
+	uint64_t packetsDropped;
+	uint64_t bytesSent;
+	sshsNode statsNode;
+};
+
+struct output_common_udp_batch {
+	/// Pack multiple event packets into datagrams, and send them in batches.
+	bool enabled;
+	/// Try to use UDP generic segmentation offload (Linux only).
+	bool useGSO;
+	/// Size of a full datagram, including the AEDAT 3 network header.
+	size_t datagramSize;
+	/// Maximum number of datagrams to collect before sending them out.
+	size_t maxDatagrams;
+	/// Datagram memory (maxDatagrams * datagramSize), contiguous for GSO.
+	uint8_t *buffer;
+	/// Number of completely filled datagrams in buffer.
+	size_t datagramsNumber;
+	/// Bytes used in the datagram currently being filled (0 if none started).
+	size_t currentSize;
+	/// Number of datagrams that could not be sent (socket buffer full).
+	uint64_t datagramsDropped;
+};
 
 struct output_common_netio {
 	/// Keep the full network header around, so we can easily update and write it.
@@ -24,6 +73,20 @@ struct output_common_netio {
 	uv_async_t shutdown;
 	uv_idle_t ringBufferGet;
 	uv_stream_t *server;
+	/// UDP only: datagram packing and batched sending support.
+	struct output_common_udp_batch udpBatch;
+	/// TCP/Pipe only: per-client flow control and statistics, clientsSize entries.
+	struct output_common_client *clientsInfo;
+	/// Flow control policy to apply to clients falling behind.
+	atomic_int flowControl;
+	/// Maximum bytes outstanding per client before it's considered behind.
+	atomic_size_t clientMaxQueuedSize;
+	/// Disconnect clients behind for longer than this many seconds (0 = never).
+	atomic_int clientMaxBehindTime;
+	/// Last time the per-client statistics were published.
+	struct timespec clientsStatsLastUpdate;
+	/// Module configuration node, to publish connected clients information.
+	sshsNode moduleNode;
 	size_t activeClients;
 	size_t clientsSize;
 	uv_stream_t *clients[];
@@ -31,12 +94,60 @@ struct output_common_netio {
 
 typedef struct output_common_netio *outputCommonNetIO;
 
+struct output_common_segment {
+	size_t index;
+	int64_t firstTimestamp;
+	int64_t lastTimestamp;
+	uint64_t packetsNumber;
+	uint64_t dataWritten;
+};
+
+struct output_common_segmentation {
+	/// Rotate to a new segment after this many bytes were written (0 = unlimited).
+	uint64_t maxSize;
+	/// Rotate to a new segment after this many µs of event time (0 = unlimited).
+	int64_t maxDuration;
+	/// Common path of all segment files and the index file (without suffix).
+	/// NULL if segmentation is disabled.
+	char *basePath;
+	/// The file descriptor for the index (manifest) file.
+	int indexFileIO;
+	/// Segment currently being filled, tracked by the compressor thread.
+	struct output_common_segment current;
+	/// Limit reached, start a new segment with the next packet container.
+	bool rotatePending;
+};
+
 struct output_common_statistics {
 	uint64_t packetsNumber;
 	uint64_t packetsTotalSize;
 	uint64_t packetsHeaderSize;
 	uint64_t packetsDataSize;
 	uint64_t dataWritten;
+	/// Live statistics, published read-only to SSHS about once per second.
+	sshsNode statsNode;
+	/// Ring-buffer sizes and current number of elements in them.
+	size_t ringSize;
+	atomic_size_t compressorRingUsage;
+	atomic_size_t outputRingUsage;
+	/// Highest ring-buffer usage seen since last update (compressor thread).
+	size_t compressorRingPeak;
+	size_t outputRingPeak;
+	/// Event packets discarded because the compressor ring-buffer was full, or output failed.
+	atomic_uint_fast64_t packetsDropped;
+	/// Bytes and time (ns) spent writing them, tracked by the output thread.
+	atomic_uint_fast64_t outputBytes;
+	atomic_uint_fast64_t outputTime;
+	/// Time (ns) spent compressing, and per event type size before and after
+	/// compression, since last update (compressor thread).
+	uint64_t compressionTime;
+	uint64_t typeSizeUncompressed[MAX_OUTPUT_STATISTICS_EVENT_TYPES];
+	uint64_t typeSizeCompressed[MAX_OUTPUT_STATISTICS_EVENT_TYPES];
+	bool typeAttributeCreated[MAX_OUTPUT_STATISTICS_EVENT_TYPES];
+	/// Values at last update, to calculate rates.
+	uint64_t lastUpdateTime;
+	uint64_t lastOutputBytes;
+	uint64_t lastOutputTime;
 };
 
 struct output_common_state {
@@ -77,8 +188,20 @@ struct output_common_state {
 	int64_t lastTimestamp;
 	/// Support different formats, providing data compression.
 	int8_t formatID;
+	/// Scratch memory for DeltaFrames compression, reused across frames.
+	uint8_t *frameCompressBuffer;
+	/// Size of DeltaFrames compression scratch memory.
+	size_t frameCompressBufferSize;
+	/// Scratch memory for DeltaEvents compression, reused across packets.
+	uint8_t *eventCompressBuffer;
+	/// Size of DeltaEvents compression scratch memory.
+	size_t eventCompressBufferSize;
 	/// Output module statistics collection.
 	struct output_common_statistics statistics;
+	/// File output rotation (segments) support.
+	struct output_common_segmentation segmentation;
+	/// Signal output thread that the compressor thread has sent out all remaining data.
+	atomic_bool compressorThreadDone;
 	/// Reference to parent module's original data.
 	caerModuleData parentModule;
 };
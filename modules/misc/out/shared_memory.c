@@ -0,0 +1,388 @@
+#include "main.h"
+#include "base/mainloop.h"
+#include "base/module.h"
+#include "modules/misc/shm_ring.h"
+#include "ext/portable_time.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <libcaer/events/common.h>
+#include <libcaer/events/packetContainer.h>
+
+#define DEFAULT_SHM_NAME "/caer-events"
+
+struct shared_memory_state {
+	char *shmName;
+	int shmFd;
+	size_t shmSize;
+	struct caer_shm_ring_header *ring;
+	uint64_t dataMask;
+	uint64_t writePosition;
+	bool validOnly;
+	uint64_t packetsDropped;
+};
+
+typedef struct shared_memory_state *sharedMemoryState;
+
+static void caerOutputSharedMemoryConfigInit(sshsNode moduleNode);
+static bool caerOutputSharedMemoryInit(caerModuleData moduleData);
+static void caerOutputSharedMemoryRun(caerModuleData moduleData, caerEventPacketContainer in,
+	caerEventPacketContainer *out);
+static void caerOutputSharedMemoryConfig(caerModuleData moduleData);
+static void caerOutputSharedMemoryExit(caerModuleData moduleData);
+
+static const struct caer_module_functions OutputSharedMemoryFunctions = { .moduleConfigInit =
+	&caerOutputSharedMemoryConfigInit, .moduleInit = &caerOutputSharedMemoryInit, .moduleRun =
+	&caerOutputSharedMemoryRun, .moduleConfig = &caerOutputSharedMemoryConfig, .moduleExit =
+	&caerOutputSharedMemoryExit, .moduleReset = NULL };
+
+static const struct caer_event_stream_in OutputSharedMemoryInputs[] = { { .type = -1, .number = -1, .readOnly =
+true } };
+
+static const struct caer_module_info OutputSharedMemoryInfo = { .version = 1, .name = "SharedMemoryOutput",
+	.description = "Publish event packets into a shared memory ring for local consumers.", .type = CAER_MODULE_OUTPUT,
+	.memSize = sizeof(struct shared_memory_state), .functions = &OutputSharedMemoryFunctions, .inputStreams =
+		OutputSharedMemoryInputs, .inputStreamsSize = CAER_EVENT_STREAM_IN_SIZE(OutputSharedMemoryInputs),
+	.outputStreams = NULL, .outputStreamsSize = 0, };
+
+caerModuleInfo caerModuleGetInfo(void) {
+	return (&OutputSharedMemoryInfo);
+}
+
+static bool shmRingWritePacket(caerModuleData moduleData, caerEventPacketHeaderConst packet, uint32_t flags);
+static bool shmStaleRemove(caerModuleData moduleData, const char *shmName);
+
+static inline bool shmPacketHasContent(sharedMemoryState state, caerEventPacketHeaderConst packet) {
+	if (packet == NULL) {
+		return (false);
+	}
+
+	return ((state->validOnly) ? (caerEventPacketHeaderGetEventValid(packet) > 0) :
+		(caerEventPacketHeaderGetEventNumber(packet) > 0));
+}
+
+static void caerOutputSharedMemoryConfigInit(sshsNode moduleNode) {
+	sshsNodeCreateString(moduleNode, "shmName", DEFAULT_SHM_NAME, 2, 250, SSHS_FLAGS_NORMAL,
+		"Name of the POSIX shared memory object to create (must start with '/').");
+	sshsNodeCreateInt(moduleNode, "ringSize", 64, 1, 4096, SSHS_FLAGS_NORMAL,
+		"Size of the shared memory ring in MiB (rounded up to a power of two). Bigger rings let slow readers lag more before they overrun.");
+	sshsNodeCreateBool(moduleNode, "validOnly", false, SSHS_FLAGS_NORMAL, "Only send valid events.");
+}
+
+static bool caerOutputSharedMemoryInit(caerModuleData moduleData) {
+	sharedMemoryState state = moduleData->moduleState;
+
+	state->shmName = sshsNodeGetString(moduleData->moduleNode, "shmName");
+	if (state->shmName[0] != '/' || strchr(state->shmName + 1, '/') != NULL) {
+		caerModuleLog(moduleData, CAER_LOG_ERROR,
+			"Invalid shared memory name '%s', must start with '/' and contain no other '/'.", state->shmName);
+		free(state->shmName);
+		return (false);
+	}
+
+	// Data area size must be a power of two, for fast index calculation.
+	uint64_t dataSize = 1024 * 1024;
+	uint64_t requestedSize = U64T(sshsNodeGetInt(moduleData->moduleNode, "ringSize")) * 1024 * 1024;
+
+	while (dataSize < requestedSize) {
+		dataSize <<= 1;
+	}
+
+	state->dataMask = dataSize - 1;
+	state->shmSize = CAER_SHM_RING_HEADER_SIZE + (size_t) dataSize;
+
+	// Never replace an existing object: it may be the live ring of another writer.
+	// Only objects left over by a crashed writer are removed, and creation retried.
+	state->shmFd = shm_open(state->shmName, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (state->shmFd < 0 && errno == EEXIST) {
+		if (shmStaleRemove(moduleData, state->shmName)) {
+			state->shmFd = shm_open(state->shmName, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+		}
+		else {
+			errno = EEXIST;
+		}
+	}
+
+	if (state->shmFd < 0) {
+		if (errno == EEXIST) {
+#if defined(OS_LINUX) && OS_LINUX == 1
+			caerModuleLog(moduleData, CAER_LOG_ERROR,
+				"Shared memory '%s' already exists and another writer is using it. If not, remove '/dev/shm%s'.",
+				state->shmName, state->shmName);
+#else
+			caerModuleLog(moduleData, CAER_LOG_ERROR,
+				"Shared memory '%s' already exists and another writer is using it. If not, remove it with "
+				"shm_unlink().", state->shmName);
+#endif
+		}
+		else {
+			caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to create shared memory '%s'. Error: %d.",
+				state->shmName, errno);
+		}
+
+		free(state->shmName);
+		return (false);
+	}
+
+	if (ftruncate(state->shmFd, (off_t) state->shmSize) != 0) {
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to set shared memory size to %zu bytes. Error: %d.",
+			state->shmSize, errno);
+		close(state->shmFd);
+		shm_unlink(state->shmName);
+		free(state->shmName);
+		return (false);
+	}
+
+	state->ring = mmap(NULL, state->shmSize, PROT_READ | PROT_WRITE, MAP_SHARED, state->shmFd, 0);
+	if (state->ring == MAP_FAILED) {
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to map shared memory. Error: %d.", errno);
+		close(state->shmFd);
+		shm_unlink(state->shmName);
+		free(state->shmName);
+		return (false);
+	}
+
+	// Freshly created shared memory is zeroed, only fill in what's different.
+	// A session ID lets readers detect a different writer instance.
+	struct timespec now;
+	portable_clock_gettime_monotonic(&now);
+
+	state->ring->magic = CAER_SHM_RING_MAGIC;
+	state->ring->version = CAER_SHM_RING_VERSION;
+	state->ring->dataSize = dataSize;
+	state->ring->sessionID = (U64T(now.tv_sec) * 1000000000LLU) + U64T(now.tv_nsec);
+	state->ring->sourceID = -1;
+	state->ring->writerPID = I32T(getpid());
+
+	state->writePosition = 0;
+	atomic_store_explicit(&state->ring->writeReserve, 0, memory_order_relaxed);
+	atomic_store_explicit(&state->ring->writeCommit, 0, memory_order_relaxed);
+
+	// Publish header to readers.
+	atomic_store_explicit(&state->ring->writerActive, 1, memory_order_release);
+
+	caerOutputSharedMemoryConfig(moduleData);
+
+	// Add config listeners last, to avoid having them dangling if Init doesn't succeed.
+	sshsNodeAddAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
+
+	caerModuleLog(moduleData, CAER_LOG_INFO, "Publishing events to shared memory '%s' (%" PRIu64 " bytes ring).",
+		state->shmName, dataSize);
+
+	return (true);
+}
+
+static void caerOutputSharedMemoryRun(caerModuleData moduleData, caerEventPacketContainer in,
+	caerEventPacketContainer *out) {
+	UNUSED_ARGUMENT(out);
+
+	sharedMemoryState state = moduleData->moduleState;
+
+	// Find last packet with content, to mark the end of this container.
+	int32_t lastPacket = -1;
+
+	for (int32_t i = 0; i < caerEventPacketContainerGetEventPacketsNumber(in); i++) {
+		if (shmPacketHasContent(state, caerEventPacketContainerGetEventPacketConst(in, i))) {
+			lastPacket = i;
+		}
+	}
+
+	for (int32_t i = 0; i <= lastPacket; i++) {
+		caerEventPacketHeaderConst packet = caerEventPacketContainerGetEventPacketConst(in, i);
+
+		if (!shmPacketHasContent(state, packet)) {
+			continue;
+		}
+
+		uint32_t flags = (i == lastPacket) ? (CAER_SHM_RING_RECORD_CONTAINER_END) : (0);
+
+		if (state->ring->sourceID == -1) {
+			state->ring->sourceID = caerEventPacketHeaderGetEventSource(packet);
+		}
+
+		if (state->validOnly
+			&& caerEventPacketHeaderGetEventValid(packet) != caerEventPacketHeaderGetEventNumber(packet)) {
+			// Compact the packet first, so readers get exactly the valid events.
+			caerEventPacketHeader validPacket = caerEventPacketCopyOnlyValidEvents(packet);
+
+			if (validPacket != NULL) {
+				shmRingWritePacket(moduleData, validPacket, flags);
+				free(validPacket);
+			}
+		}
+		else {
+			shmRingWritePacket(moduleData, packet, flags);
+		}
+	}
+}
+
+static void caerOutputSharedMemoryConfig(caerModuleData moduleData) {
+	caerModuleConfigUpdateReset(moduleData);
+
+	sharedMemoryState state = moduleData->moduleState;
+
+	state->validOnly = sshsNodeGetBool(moduleData->moduleNode, "validOnly");
+}
+
+static void caerOutputSharedMemoryExit(caerModuleData moduleData) {
+	// Remove listener, which can reference invalid memory in userData.
+	sshsNodeRemoveAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
+
+	sharedMemoryState state = moduleData->moduleState;
+
+	// Tell readers no more data is coming, then remove the name. Readers can keep
+	// their mapping until they detach, the memory is freed only then.
+	atomic_store_explicit(&state->ring->writerActive, 0, memory_order_release);
+
+	munmap(state->ring, state->shmSize);
+	close(state->shmFd);
+	shm_unlink(state->shmName);
+
+	if (state->packetsDropped != 0) {
+		caerModuleLog(moduleData, CAER_LOG_NOTICE, "Dropped %" PRIu64 " packets too big for the shared memory ring.",
+			state->packetsDropped);
+	}
+
+	free(state->shmName);
+}
+
+/**
+ * Check if the existing shared memory object was left over by a writer that
+ * didn't exit cleanly, meaning its process is gone, and remove it if so.
+ * Readers still attached to it are told that no more data is coming.
+ * Objects without a known writer are never touched, they may be in the middle
+ * of being set up by another writer.
+ *
+ * @param moduleData module data.
+ * @param shmName name of the shared memory object.
+ *
+ * @return true if the name is free now, false if the object is in use or
+ * couldn't be checked.
+ */
+static bool shmStaleRemove(caerModuleData moduleData, const char *shmName) {
+	int shmFd = shm_open(shmName, O_RDWR, 0);
+	if (shmFd < 0) {
+		// Removed meanwhile, the name is free.
+		return (errno == ENOENT);
+	}
+
+	struct stat shmStat;
+	if (fstat(shmFd, &shmStat) != 0 || (size_t) shmStat.st_size < CAER_SHM_RING_HEADER_SIZE) {
+		close(shmFd);
+		return (false);
+	}
+
+	struct caer_shm_ring_header *ring = mmap(NULL, CAER_SHM_RING_HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+		shmFd, 0);
+	close(shmFd);
+
+	if (ring == MAP_FAILED) {
+		return (false);
+	}
+
+	int32_t writerPID = 0;
+	bool stale = false;
+
+	if (ring->magic == CAER_SHM_RING_MAGIC && ring->version == CAER_SHM_RING_VERSION && ring->writerPID > 0) {
+		writerPID = ring->writerPID;
+
+		// Signal 0 only checks if the process exists.
+		if (kill((pid_t) writerPID, 0) != 0 && errno == ESRCH) {
+			stale = true;
+			atomic_store_explicit(&ring->writerActive, 0, memory_order_release);
+		}
+	}
+
+	munmap(ring, CAER_SHM_RING_HEADER_SIZE);
+
+	if (!stale) {
+		return (false);
+	}
+
+	if (shm_unlink(shmName) != 0 && errno != ENOENT) {
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to remove stale shared memory '%s'. Error: %d.", shmName,
+			errno);
+		return (false);
+	}
+
+	caerModuleLog(moduleData, CAER_LOG_NOTICE, "Removed shared memory '%s' left over by writer process %" PRIi32 ".",
+		shmName, writerPID);
+
+	return (true);
+}
+
+/**
+ * Append one event packet as a record to the shared memory ring. The writer
+ * never blocks: readers that are too slow simply detect that their data was
+ * overwritten. Only eventNumber events are copied, and the eventCapacity of
+ * the copy is set to match, so readers see a compact, complete packet.
+ *
+ * @param moduleData module data.
+ * @param packet the event packet to publish.
+ * @param flags record flags (CAER_SHM_RING_RECORD_CONTAINER_END).
+ *
+ * @return true if the packet was written, false if too big for the ring.
+ */
+static bool shmRingWritePacket(caerModuleData moduleData, caerEventPacketHeaderConst packet, uint32_t flags) {
+	sharedMemoryState state = moduleData->moduleState;
+
+	size_t eventsSize = (size_t) caerEventPacketHeaderGetEventNumber(packet)
+		* (size_t) caerEventPacketHeaderGetEventSize(packet);
+	size_t payloadSize = CAER_EVENT_PACKET_HEADER_SIZE + eventsSize;
+	uint64_t recordSpace = caerShmRingRecordSpace(payloadSize);
+
+	// A record must leave enough space for readers to get at it before it's
+	// overwritten, so limit it to half the ring.
+	if (recordSpace > (state->ring->dataSize / 2)) {
+		state->packetsDropped++;
+		return (false);
+	}
+
+	uint64_t position = state->writePosition;
+	uint64_t index = position & state->dataMask;
+
+	// Records never wrap around: if it doesn't fit before the end, fill the rest
+	// with a padding record and start over at the beginning.
+	uint64_t paddingSpace = 0;
+	if ((index + recordSpace) > state->ring->dataSize) {
+		paddingSpace = state->ring->dataSize - index;
+	}
+
+	// Announce the area about to be overwritten before touching it.
+	atomic_store_explicit(&state->ring->writeReserve, position + paddingSpace + recordSpace, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	uint8_t *data = caerShmRingData(state->ring);
+
+	if (paddingSpace != 0) {
+		struct caer_shm_ring_record *padding = (struct caer_shm_ring_record *) (data + index);
+		padding->size = (uint32_t) (paddingSpace - sizeof(struct caer_shm_ring_record));
+		padding->flags = CAER_SHM_RING_RECORD_PADDING;
+
+		position += paddingSpace;
+		index = 0;
+	}
+
+	struct caer_shm_ring_record *record = (struct caer_shm_ring_record *) (data + index);
+	record->size = (uint32_t) payloadSize;
+	record->flags = flags;
+
+	uint8_t *payload = (uint8_t *) (record + 1);
+	memcpy(payload, packet, CAER_EVENT_PACKET_HEADER_SIZE);
+	caerEventPacketHeaderSetEventCapacity((caerEventPacketHeader) payload,
+		caerEventPacketHeaderGetEventNumber(packet));
+	memcpy(payload + CAER_EVENT_PACKET_HEADER_SIZE, ((const uint8_t *) packet) + CAER_EVENT_PACKET_HEADER_SIZE,
+		eventsSize);
+
+	position += recordSpace;
+
+	// Make the record visible to readers.
+	atomic_store_explicit(&state->ring->writeCommit, position, memory_order_release);
+	state->writePosition = position;
+
+	return (true);
+}
@@ -0,0 +1,71 @@
+#ifndef SHM_RING_H_
+#define SHM_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/**
+ * Shared memory ring layout, used by the SharedMemoryOutput module to publish
+ * event packets to local consumers, see utils/shmreader/ for the reader library.
+ *
+ * The shared memory object starts with a header page, followed by the data
+ * area, whose size is a power of two. The data area is a byte ring of records,
+ * each one consisting of a record header and the full event packet (packet
+ * header plus all events, with eventCapacity equal to eventNumber), padded to
+ * a multiple of eight bytes. Records never wrap around the end of the ring;
+ * a padding record fills the remaining space instead.
+ * All positions are absolute, monotonically increasing byte offsets; the
+ * index into the data area is (position & (dataSize - 1)).
+ *
+ * There is exactly one writer and any number of readers. The writer never
+ * waits on readers: before writing a record, it publishes in writeReserve the
+ * position up to which it will write, then the record, and finally moves
+ * writeCommit forward. Readers keep their own read position, read records up
+ * to writeCommit, and after reading check writeReserve again: if the writer
+ * got more than dataSize ahead of the read position, the data was (possibly)
+ * overwritten while reading and must be discarded (overrun).
+ */
+#define CAER_SHM_RING_MAGIC 0x52485343 // "CSHR" in little-endian.
+#define CAER_SHM_RING_VERSION 1
+#define CAER_SHM_RING_HEADER_SIZE 4096
+#define CAER_SHM_RING_ALIGNMENT 8
+#define CAER_SHM_RING_CACHELINE 64
+
+#define CAER_SHM_RING_RECORD_PADDING 0x01
+#define CAER_SHM_RING_RECORD_CONTAINER_END 0x02
+
+struct caer_shm_ring_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t dataSize;
+	uint64_t sessionID;
+	int16_t sourceID;
+	uint8_t reserved0[CAER_SHM_RING_CACHELINE - 26];
+	// Writer positions, each on its own cache line, as they are hammered by readers.
+	_Atomic uint64_t writeReserve;
+	uint8_t reserved1[CAER_SHM_RING_CACHELINE - sizeof(uint64_t)];
+	_Atomic uint64_t writeCommit;
+	uint8_t reserved2[CAER_SHM_RING_CACHELINE - sizeof(uint64_t)];
+	_Atomic uint32_t writerActive;
+	// Process ID of the writer, to detect objects left over by a crashed writer (0 if unknown).
+	int32_t writerPID;
+};
+
+struct caer_shm_ring_record {
+	uint32_t size; // Size of the payload following this header, in bytes.
+	uint32_t flags;
+};
+
+static inline uint64_t caerShmRingRecordSpace(size_t payloadSize) {
+	uint64_t space = sizeof(struct caer_shm_ring_record) + payloadSize;
+
+	return ((space + (CAER_SHM_RING_ALIGNMENT - 1)) & ~((uint64_t) CAER_SHM_RING_ALIGNMENT - 1));
+}
+
+static inline uint8_t *caerShmRingData(struct caer_shm_ring_header *header) {
+	return (((uint8_t *) header) + CAER_SHM_RING_HEADER_SIZE);
+}
+
+#endif /* SHM_RING_H_ */
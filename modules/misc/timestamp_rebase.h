@@ -0,0 +1,75 @@
+#ifndef TIMESTAMP_REBASE_H_
+#define TIMESTAMP_REBASE_H_
+
+#include "main.h"
+
+/**
+ * Timestamp maps keep the last event timestamp of every pixel as 32bit value
+ * relative to a 64bit base, where 0 means never. Relative timestamps are
+ * rebased once they reach 2^30 µs (about 18 minutes), keeping only the last
+ * 2^29 µs (about 9 minutes). That is way above any time window modules compare
+ * timestamps against, so timestamps dropping out of the maps this way behave
+ * exactly like no timestamp at all (0).
+ *
+ * Events are checked for rebases in blocks. All timestamps of a block must fit
+ * the maps after a rebase, so a block must never span CAER_TIMESTAMP_REBASE_KEEP
+ * or more, see caerTimestampRebaseFits().
+ */
+#define CAER_TIMESTAMP_REBASE_LIMIT (1LL << 30)
+#define CAER_TIMESTAMP_REBASE_KEEP (1LL << 29)
+
+/**
+ * Whether timestamp can be added to a block of events with timestamps from
+ * minTimestamp to maxTimestamp. Otherwise, a new block must be started.
+ */
+static inline bool caerTimestampRebaseFits(int64_t minTimestamp, int64_t maxTimestamp, int64_t timestamp) {
+	return ((timestamp - minTimestamp) < CAER_TIMESTAMP_REBASE_KEEP
+		&& (maxTimestamp - timestamp) < CAER_TIMESTAMP_REBASE_KEEP);
+}
+
+/**
+ * Whether the maps must be rebased to store timestamps from minTimestamp to
+ * maxTimestamp relative to timestampBase.
+ */
+static inline bool caerTimestampRebaseNeeded(int64_t timestampBase, int64_t minTimestamp, int64_t maxTimestamp) {
+	return ((minTimestamp - timestampBase) < 1 || (maxTimestamp - timestampBase) >= CAER_TIMESTAMP_REBASE_LIMIT);
+}
+
+/**
+ * Move the timestamp base to maxTimestamp - CAER_TIMESTAMP_REBASE_KEEP.
+ * Returns by how much the maps' relative timestamps have to be lowered, see
+ * caerTimestampMapRebase(), or 0 if the maps have to be cleared instead: when
+ * time went backwards, or after a gap so long that no timestamp in the maps
+ * would survive (the shift then doesn't even fit into 32bit).
+ */
+static inline int32_t caerTimestampRebase(int64_t *timestampBase, int64_t maxTimestamp) {
+	int64_t newBase = maxTimestamp - CAER_TIMESTAMP_REBASE_KEEP;
+	int64_t shift = newBase - *timestampBase;
+
+	*timestampBase = newBase;
+
+	if (shift <= 0 || shift >= CAER_TIMESTAMP_REBASE_LIMIT) {
+		return (0);
+	}
+
+	return (I32T(shift));
+}
+
+/**
+ * Lower all relative timestamps in the map by shift, as returned by
+ * caerTimestampRebase(), dropping those that fall out. Clears the map if
+ * shift is 0.
+ */
+static inline void caerTimestampMapRebase(int32_t *map, size_t mapSize, int32_t shift) {
+	if (shift == 0) {
+		memset(map, 0, mapSize * sizeof(int32_t));
+		return;
+	}
+
+	for (size_t i = 0; i < mapSize; i++) {
+		int32_t newTS = map[i] - shift;
+		map[i] = (newTS > 0) ? (newTS) : (0);
+	}
+}
+
+#endif /* TIMESTAMP_REBASE_H_ */
@@ -0,0 +1,241 @@
+#ifndef WORKER_THREADS_H_
+#define WORKER_THREADS_H_
+
+#include "main.h"
+
+#include "ext/c11threads_posix.h"
+
+/**
+ * Worker threads for modules that split the processing of a packet into
+ * parts, like horizontal bands of the sensor or single frames. There are
+ * workersNumber workers: worker 0 is the mainloop thread itself, all others
+ * run their own thread. caerWorkerThreadsRun() calls the work function once
+ * per worker, with the worker's index, and returns when all calls are done.
+ * Idle threads block on a condition variable, so they cost nothing between
+ * packets and while the module is not receiving data.
+ */
+typedef void (*caerWorkerThreadsFunction)(void *workData, size_t worker);
+
+struct caer_worker_threads;
+
+struct caer_worker_thread {
+	struct caer_worker_threads *workers;
+	size_t index;
+	thrd_t thread;
+	/// Last work generation this thread completed.
+	uint32_t doneGeneration;
+};
+
+struct caer_worker_threads {
+	size_t workersNumber;
+	caerWorkerThreadsFunction work;
+	void *workData;
+	const char *threadName;
+	/// Threads of workers 1 to workersNumber - 1, only the first threadsNumber were started.
+	struct caer_worker_thread *threads;
+	size_t threadsNumber;
+	/// Hand-off, all protected by lock: a new generation starts work on all
+	/// threads, each one then decrements workersPending once finished.
+	mtx_t lock;
+	cnd_t workAvailable;
+	cnd_t workDone;
+	uint32_t workGeneration;
+	size_t workersPending;
+	bool running;
+};
+
+/**
+ * One per-event array to grow with caerWorkerArraysReserve(): array is the
+ * address of the pointer to the array, of any type.
+ */
+struct caer_worker_array {
+	void *array;
+	size_t elementSize;
+};
+
+static inline int caerWorkerThread(void *threadPtr) {
+	struct caer_worker_thread *thread = threadPtr;
+	struct caer_worker_threads *workers = thread->workers;
+
+	thrd_set_name(workers->threadName);
+
+	mtx_lock(&workers->lock);
+
+	while (true) {
+		while (workers->running && workers->workGeneration == thread->doneGeneration) {
+			cnd_wait(&workers->workAvailable, &workers->lock);
+		}
+
+		if (!workers->running) {
+			break;
+		}
+
+		thread->doneGeneration = workers->workGeneration;
+
+		mtx_unlock(&workers->lock);
+
+		(*workers->work)(workers->workData, thread->index);
+
+		mtx_lock(&workers->lock);
+
+		workers->workersPending--;
+
+		if (workers->workersPending == 0) {
+			cnd_signal(&workers->workDone);
+		}
+	}
+
+	mtx_unlock(&workers->lock);
+
+	return (thrd_success);
+}
+
+/**
+ * Stop and join all started threads. Safe to call on never started or
+ * already stopped workers.
+ */
+static inline void caerWorkerThreadsStop(struct caer_worker_threads *workers) {
+	if (workers->threads != NULL) {
+		mtx_lock(&workers->lock);
+		workers->running = false;
+		cnd_broadcast(&workers->workAvailable);
+		mtx_unlock(&workers->lock);
+
+		for (size_t t = 0; t < workers->threadsNumber; t++) {
+			thrd_join(workers->threads[t].thread, NULL);
+		}
+
+		free(workers->threads);
+		workers->threads = NULL;
+		workers->threadsNumber = 0;
+
+		cnd_destroy(&workers->workDone);
+		cnd_destroy(&workers->workAvailable);
+		mtx_destroy(&workers->lock);
+	}
+
+	workers->workersNumber = 0;
+}
+
+/**
+ * Start a thread for every worker except worker 0. With a single worker, no
+ * threads are needed and work is simply done on the calling thread.
+ * On failure, all started threads are stopped again.
+ */
+static inline bool caerWorkerThreadsStart(struct caer_worker_threads *workers, size_t workersNumber,
+	caerWorkerThreadsFunction work, void *workData, const char *threadName) {
+	workers->workersNumber = workersNumber;
+	workers->work = work;
+	workers->workData = workData;
+	workers->threadName = threadName;
+
+	if (workersNumber <= 1) {
+		return (true);
+	}
+
+	if (mtx_init(&workers->lock, mtx_plain) != thrd_success) {
+		workers->workersNumber = 0;
+		return (false);
+	}
+
+	if (cnd_init(&workers->workAvailable) != thrd_success) {
+		mtx_destroy(&workers->lock);
+		workers->workersNumber = 0;
+		return (false);
+	}
+
+	if (cnd_init(&workers->workDone) != thrd_success) {
+		cnd_destroy(&workers->workAvailable);
+		mtx_destroy(&workers->lock);
+		workers->workersNumber = 0;
+		return (false);
+	}
+
+	workers->threads = calloc(workersNumber - 1, sizeof(struct caer_worker_thread));
+	if (workers->threads == NULL) {
+		cnd_destroy(&workers->workDone);
+		cnd_destroy(&workers->workAvailable);
+		mtx_destroy(&workers->lock);
+		workers->workersNumber = 0;
+		return (false);
+	}
+
+	workers->threadsNumber = 0;
+	workers->running = true;
+
+	for (size_t t = 0; t < (workersNumber - 1); t++) {
+		struct caer_worker_thread *thread = &workers->threads[t];
+
+		thread->workers = workers;
+		thread->index = t + 1;
+		thread->doneGeneration = workers->workGeneration;
+
+		if (thrd_create(&thread->thread, &caerWorkerThread, thread) != thrd_success) {
+			// Only the threads started so far are joined.
+			caerWorkerThreadsStop(workers);
+			return (false);
+		}
+
+		workers->threadsNumber++;
+	}
+
+	return (true);
+}
+
+/**
+ * Do work on all workers, worker 0 on the calling thread, and wait for all
+ * of them to be done.
+ */
+static inline void caerWorkerThreadsRun(struct caer_worker_threads *workers) {
+	if (workers->workersNumber <= 1) {
+		(*workers->work)(workers->workData, 0);
+		return;
+	}
+
+	mtx_lock(&workers->lock);
+	workers->workGeneration++;
+	workers->workersPending = workers->workersNumber - 1;
+	cnd_broadcast(&workers->workAvailable);
+	mtx_unlock(&workers->lock);
+
+	(*workers->work)(workers->workData, 0);
+
+	mtx_lock(&workers->lock);
+
+	while (workers->workersPending != 0) {
+		cnd_wait(&workers->workDone, &workers->lock);
+	}
+
+	mtx_unlock(&workers->lock);
+}
+
+/**
+ * Ensure all given per-event arrays can hold eventNumber elements. Arrays
+ * only ever grow, and capacity tracks how many elements all of them can hold.
+ * On failure, the arrays are still valid, with at least the old capacity.
+ */
+static inline bool caerWorkerArraysReserve(size_t *capacity, size_t eventNumber,
+	const struct caer_worker_array *arrays, size_t arraysNumber) {
+	if (eventNumber <= *capacity) {
+		return (true);
+	}
+
+	for (size_t a = 0; a < arraysNumber; a++) {
+		// Pointers to different types can't be accessed through a void **, so copy them around.
+		void *array;
+		memcpy(&array, arrays[a].array, sizeof(void *));
+
+		array = realloc(array, eventNumber * arrays[a].elementSize);
+		if (array == NULL) {
+			return (false);
+		}
+
+		memcpy(arrays[a].array, &array, sizeof(void *));
+	}
+
+	*capacity = eventNumber;
+
+	return (true);
+}
+
+#endif /* WORKER_THREADS_H_ */
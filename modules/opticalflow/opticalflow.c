@@ -0,0 +1,718 @@
+#include "main.h"
+#include "base/mainloop.h"
+#include "base/module.h"
+#include "ext/portable_time.h"
+
+#include "modules/misc/timestamp_rebase.h"
+#include "modules/misc/worker_threads.h"
+
+#include <libcaer/events/polarity.h>
+#include <libcaer/events/point4d.h>
+
+// Events are decoded in blocks, checking for rebases once per block.
+#define OPTICALFLOW_BLOCK_SIZE 256
+#define OPTICALFLOW_MAX_RADIUS 5
+// Parallel flow: maximum number of bands (threads).
+#define OPTICALFLOW_MAX_THREADS 32
+// Per-event arrays, not counting the bands' event lists.
+#define OPTICALFLOW_EVENT_ARRAYS 7
+// Benchmark results are logged this often, in seconds.
+#define OPTICALFLOW_BENCHMARK_INTERVAL 5
+
+typedef struct OpticalFlow_state *OpticalFlowState;
+
+/**
+ * The sensor is split into horizontal bands, one per thread (a single band
+ * when serial). Each band keeps private surfaces of active events covering its
+ * own rows plus radius rows above and below (halo), and gets, in packet order,
+ * all events on those rows. Flow is computed only for events on its own rows,
+ * halo events just update the surfaces. So every band sees the complete,
+ * ordered history of all pixels its plane fits read, and results do not depend
+ * on the number of threads.
+ */
+struct OpticalFlow_band {
+	/// Sensor rows owned by this band: [rowStart, rowEnd).
+	int32_t rowStart;
+	int32_t rowEnd;
+	/// Last event timestamps (OFF, ON), relative to timestampBase (0 means never).
+	/// Row-major, covering the rows [rowStart - radius, rowEnd + radius), with a
+	/// border of radius pixels left and right, so plane fits need no bounds checks.
+	int32_t *surface[2];
+	size_t surfaceSize;
+	/// Indexes of the events to process, in packet order.
+	int32_t *events;
+	size_t eventsSize;
+};
+
+/**
+ * Normal flow by local plane fitting: around every event, the timestamps of
+ * recent events of the same polarity (within windowTime) form a surface
+ * t(x, y) that is locally approximated by a plane, fitted by least squares.
+ * Its gradient g (in µs per pixel) gives the normal flow v = g / |g|^2, the
+ * speed of the edge perpendicular to itself.
+ * Flow is output as POINT4D events: X/Y are the pixel address, Z/W the flow in
+ * pixels per second along X/Y, type is the polarity.
+ */
+struct OpticalFlow_state {
+	int16_t sizeX;
+	int16_t sizeY;
+	int32_t radius;
+	int32_t windowTime;
+	int32_t minPoints;
+	float minGradient2;
+	int32_t threads;
+	size_t surfaceStride;
+	int64_t timestampBase;
+	/// Bands and sensor row to band lookup. Band 0 is processed by the mainloop
+	/// thread, all others by their own worker thread.
+	struct OpticalFlow_band *bands;
+	size_t bandsNumber;
+	size_t *rowBand;
+	/// Per-packet decoded events and flow results, indexed by event number.
+	uint16_t *eventX;
+	uint16_t *eventY;
+	uint8_t *eventPolarity;
+	int32_t *eventTimestamp;
+	float *flowX;
+	float *flowY;
+	bool *flowValid;
+	size_t eventCapacity;
+	struct caer_worker_threads workers;
+	bool benchmark;
+	uint64_t benchmarkTime;
+	uint64_t benchmarkEvents;
+	uint64_t benchmarkFlow;
+	struct timespec benchmarkLastLog;
+};
+
+static void caerOpticalFlowConfigInit(sshsNode moduleNode);
+static bool caerOpticalFlowInit(caerModuleData moduleData);
+static void caerOpticalFlowRun(caerModuleData moduleData, caerEventPacketContainer in, caerEventPacketContainer *out);
+static void caerOpticalFlowConfig(caerModuleData moduleData);
+static void caerOpticalFlowExit(caerModuleData moduleData);
+static void caerOpticalFlowReset(caerModuleData moduleData, int16_t resetCallSourceID);
+static void flowBands(OpticalFlowState state);
+static void flowBand(OpticalFlowState state, struct OpticalFlow_band *band);
+static void bandWork(void *statePtr, size_t band);
+static bool bandsStart(caerModuleData moduleData, int32_t threads);
+static void bandsStop(OpticalFlowState state);
+static bool eventsReserve(OpticalFlowState state, size_t eventNumber);
+static void surfacesRebase(OpticalFlowState state, int64_t maxTimestamp);
+static void benchmarkUpdate(caerModuleData moduleData, const struct timespec *start, size_t events, size_t flow);
+
+static const struct caer_module_functions OpticalFlowFunctions = { .moduleConfigInit = &caerOpticalFlowConfigInit,
+	.moduleInit = &caerOpticalFlowInit, .moduleRun = &caerOpticalFlowRun, .moduleConfig = &caerOpticalFlowConfig,
+	.moduleExit = &caerOpticalFlowExit, .moduleReset = &caerOpticalFlowReset };
+
+static const struct caer_event_stream_in OpticalFlowInputs[] = { { .type = POLARITY_EVENT, .number = 1, .readOnly =
+	true } };
+
+static const struct caer_event_stream_out OpticalFlowOutputs[] = { { .type = POINT4D_EVENT } };
+
+static const struct caer_module_info OpticalFlowInfo = { .version = 1, .name = "OpticalFlow", .description =
+	"Per-event normal optical flow by local plane fitting.", .type = CAER_MODULE_PROCESSOR, .memSize =
+	sizeof(struct OpticalFlow_state), .functions = &OpticalFlowFunctions, .inputStreams = OpticalFlowInputs,
+	.inputStreamsSize = CAER_EVENT_STREAM_IN_SIZE(OpticalFlowInputs), .outputStreams = OpticalFlowOutputs,
+	.outputStreamsSize = CAER_EVENT_STREAM_OUT_SIZE(OpticalFlowOutputs), };
+
+caerModuleInfo caerModuleGetInfo(void) {
+	return (&OpticalFlowInfo);
+}
+
+static void caerOpticalFlowConfigInit(sshsNode moduleNode) {
+	sshsNodeCreateInt(moduleNode, "radius", 2, 1, OPTICALFLOW_MAX_RADIUS, SSHS_FLAGS_NORMAL,
+		"Radius in pixels of the neighborhood to fit the plane on (2 means 5x5 pixels).");
+	sshsNodeCreateInt(moduleNode, "windowTime", 20000, 1, 1000000, SSHS_FLAGS_NORMAL,
+		"Only neighboring events at most this many µs older than the current one are used for the fit.");
+	sshsNodeCreateInt(moduleNode, "minPoints", 6, 3, (2 * OPTICALFLOW_MAX_RADIUS + 1) * (2 * OPTICALFLOW_MAX_RADIUS + 1),
+		SSHS_FLAGS_NORMAL, "Minimum number of events (including the current one) needed to fit a plane.");
+	sshsNodeCreateInt(moduleNode, "maxSpeed", 10000, 1, 10000000, SSHS_FLAGS_NORMAL,
+		"Flow faster than this many pixels per second is considered unreliable and discarded.");
+	sshsNodeCreateInt(moduleNode, "threads", 1, 1, OPTICALFLOW_MAX_THREADS, SSHS_FLAGS_NORMAL,
+		"Number of threads to compute flow with, each one handling a horizontal band of the sensor. 1 means serial.");
+	sshsNodeCreateBool(moduleNode, "benchmark", false, SSHS_FLAGS_NORMAL,
+		"Measure processing time and periodically log the achieved event rate.");
+}
+
+static bool caerOpticalFlowInit(caerModuleData moduleData) {
+	// Wait for input to be ready. All inputs, once they are up and running, will
+	// have a valid sourceInfo node to query, especially if dealing with data.
+	int16_t *inputs = caerMainloopGetModuleInputIDs(moduleData->moduleID, NULL);
+	if (inputs == NULL) {
+		return (false);
+	}
+
+	int16_t sourceID = inputs[0];
+	free(inputs);
+
+	OpticalFlowState state = moduleData->moduleState;
+
+	// Surfaces are allocated per band using info from sourceInfo.
+	sshsNode sourceInfoSource = caerMainloopGetSourceInfo(sourceID);
+	if (sourceInfoSource == NULL) {
+		return (false);
+	}
+
+	state->sizeX = sshsNodeGetShort(sourceInfoSource, "polaritySizeX");
+	state->sizeY = sshsNodeGetShort(sourceInfoSource, "polaritySizeY");
+
+	// Initialize configuration, this also sets up the bands.
+	caerOpticalFlowConfig(moduleData);
+
+	if (state->bandsNumber == 0) {
+		return (false);
+	}
+
+	sshsNode sourceInfoNode = sshsGetRelativeNode(moduleData->moduleNode, "sourceInfo/");
+	sshsNodeCreateShort(sourceInfoNode, "dataSizeX", state->sizeX, 1, INT16_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Output data width.");
+	sshsNodeCreateShort(sourceInfoNode, "dataSizeY", state->sizeY, 1, INT16_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Output data height.");
+
+	// Add config listeners last, to avoid having them dangling if Init doesn't succeed.
+	sshsNodeAddAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
+
+	return (true);
+}
+
+static void caerOpticalFlowRun(caerModuleData moduleData, caerEventPacketContainer in, caerEventPacketContainer *out) {
+	caerPolarityEventPacketConst polarity =
+		(caerPolarityEventPacketConst) caerEventPacketContainerFindEventPacketByTypeConst(in, POLARITY_EVENT);
+
+	// Only process packets with content.
+	if (polarity == NULL) {
+		return;
+	}
+
+	OpticalFlowState state = moduleData->moduleState;
+
+	int32_t eventNumber = caerEventPacketHeaderGetEventNumber(&polarity->packetHeader);
+
+	if (state->bandsNumber == 0 || !eventsReserve(state, (size_t) eventNumber)) {
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for events, packet skipped.");
+		return;
+	}
+
+	struct timespec benchmarkStart;
+	if (state->benchmark) {
+		portable_clock_gettime_monotonic(&benchmarkStart);
+	}
+
+	int32_t radius = state->radius;
+	int64_t timestamp[OPTICALFLOW_BLOCK_SIZE];
+
+	for (int32_t blockStart = 0, blockSize = 0; blockStart < eventNumber; blockStart += blockSize) {
+		blockSize = eventNumber - blockStart;
+		if (blockSize > OPTICALFLOW_BLOCK_SIZE) {
+			blockSize = OPTICALFLOW_BLOCK_SIZE;
+		}
+
+		// First decode all events of the block.
+		int64_t minTimestamp = INT64_MAX;
+		int64_t maxTimestamp = INT64_MIN;
+
+		for (int32_t i = 0; i < blockSize; i++) {
+			int32_t event = blockStart + i;
+			caerPolarityEventConst polarityEvent = caerPolarityEventPacketGetEventConst(polarity, event);
+
+			state->eventX[event] = caerPolarityEventGetX(polarityEvent);
+			state->eventY[event] = caerPolarityEventGetY(polarityEvent);
+			state->eventPolarity[event] = caerPolarityEventGetPolarity(polarityEvent);
+			state->flowValid[event] = false;
+
+			// Invalid events are never assigned to a band, so their timestamp doesn't matter.
+			timestamp[i] = caerPolarityEventGetTimestamp64(polarityEvent, polarity);
+
+			// End the block early if its timestamps would not fit the surfaces together.
+			if (i > 0 && !caerTimestampRebaseFits(minTimestamp, maxTimestamp, timestamp[i])) {
+				blockSize = i;
+				break;
+			}
+
+			minTimestamp = (timestamp[i] < minTimestamp) ? (timestamp[i]) : (minTimestamp);
+			maxTimestamp = (timestamp[i] > maxTimestamp) ? (timestamp[i]) : (maxTimestamp);
+		}
+
+		// Keep relative timestamps in range, so they fit into the 32bit surfaces.
+		if (caerTimestampRebaseNeeded(state->timestampBase, minTimestamp, maxTimestamp)) {
+			// All events assigned so far must be processed with the old base first.
+			flowBands(state);
+
+			surfacesRebase(state, maxTimestamp);
+		}
+
+		// Then assign valid events to the band owning their row, and to the
+		// neighboring bands that have that row in their halo.
+		for (int32_t i = 0; i < blockSize; i++) {
+			int32_t event = blockStart + i;
+
+			state->eventTimestamp[event] = I32T(timestamp[i] - state->timestampBase);
+
+			if (!caerPolarityEventIsValid(caerPolarityEventPacketGetEventConst(polarity, event))) {
+				continue;
+			}
+
+			int32_t y = state->eventY[event];
+			size_t b = state->rowBand[y];
+
+			state->bands[b].events[state->bands[b].eventsSize++] = event;
+
+			for (size_t h = b; h > 0 && (state->bands[h - 1].rowEnd + radius) > y; h--) {
+				state->bands[h - 1].events[state->bands[h - 1].eventsSize++] = event;
+			}
+
+			for (size_t h = b + 1; h < state->bandsNumber && (state->bands[h].rowStart - radius) <= y; h++) {
+				state->bands[h].events[state->bands[h].eventsSize++] = event;
+			}
+		}
+	}
+
+	flowBands(state);
+
+	// Collect the flow results in packet order.
+	int32_t flowNumber = 0;
+
+	for (int32_t i = 0; i < eventNumber; i++) {
+		flowNumber += state->flowValid[i];
+	}
+
+	if (state->benchmark) {
+		benchmarkUpdate(moduleData, &benchmarkStart, (size_t) eventNumber, (size_t) flowNumber);
+	}
+
+	if (flowNumber == 0) {
+		return;
+	}
+
+	caerPoint4DEventPacket flow = caerPoint4DEventPacketAllocate(flowNumber, moduleData->moduleID,
+		caerEventPacketHeaderGetEventTSOverflow(&polarity->packetHeader));
+	if (flow == NULL) {
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate flow packet.");
+		return;
+	}
+
+	int32_t flowPosition = 0;
+
+	for (int32_t i = 0; i < eventNumber; i++) {
+		if (!state->flowValid[i]) {
+			continue;
+		}
+
+		caerPoint4DEvent flowEvent = caerPoint4DEventPacketGetEvent(flow, flowPosition++);
+
+		caerPoint4DEventSetX(flowEvent, state->eventX[i]);
+		caerPoint4DEventSetY(flowEvent, state->eventY[i]);
+		caerPoint4DEventSetZ(flowEvent, state->flowX[i]);
+		caerPoint4DEventSetW(flowEvent, state->flowY[i]);
+		caerPoint4DEventSetType(flowEvent, state->eventPolarity[i]);
+		caerPoint4DEventSetTimestamp(flowEvent,
+			caerPolarityEventGetTimestamp(caerPolarityEventPacketGetEventConst(polarity, i)));
+		caerPoint4DEventValidate(flowEvent, flow);
+	}
+
+	// Make a packet container and return the result.
+	// Also remember to put this new container up for freeing at loop end.
+	*out = caerEventPacketContainerAllocate(1);
+	if (*out == NULL) {
+		free(flow);
+		return;
+	}
+
+	caerEventPacketContainerSetEventPacket(*out, 0, (caerEventPacketHeader) flow);
+}
+
+/**
+ * Fit a plane to the recent events around center, which holds the event at
+ * the given timestamp, and derive the normal flow from it.
+ * Coordinates and times are relative to the current event, which is the
+ * origin of the fit and always part of it. The sums are exact integers: each
+ * row is reduced without branches, only including recent events, so that the
+ * loop vectorizes, and rows are then combined.
+ * Returns false if there is not enough support for a reliable estimate.
+ */
+static inline bool flowFit(const OpticalFlowState state, const int32_t *center, int32_t ts, int32_t radius,
+	float *flowX, float *flowY) {
+	int32_t windowTime = state->windowTime;
+	int32_t stride = I32T(state->surfaceStride);
+
+	int32_t n = 0, sx = 0, sy = 0, st = 0, sxx = 0, sxy = 0, syy = 0, sxt = 0, syt = 0;
+
+	for (int32_t dy = -radius; dy <= radius; dy++) {
+		const int32_t *row = center + (dy * stride);
+
+		int32_t rowN = 0, rowX = 0, rowXX = 0, rowT = 0, rowXT = 0;
+
+		for (int32_t dx = -radius; dx <= radius; dx++) {
+			int32_t lastTS = row[dx];
+			int32_t dt = lastTS - ts;
+
+			// All ones for recent events, zero otherwise. With a constant radius,
+			// masking leaves only multiplications by constants.
+			int32_t mask = -((lastTS != 0) & (U32T(-dt) < U32T(windowTime)));
+			int32_t maskedDT = mask & dt;
+
+			rowN -= mask;
+			rowX += mask & dx;
+			rowXX += mask & (dx * dx);
+			rowT += maskedDT;
+			rowXT += maskedDT * dx;
+		}
+
+		n += rowN;
+		sx += rowX;
+		sy += rowN * dy;
+		st += rowT;
+		sxx += rowXX;
+		sxy += rowX * dy;
+		syy += rowN * dy * dy;
+		sxt += rowXT;
+		syt += rowT * dy;
+	}
+
+	// The center holds the previous event at this pixel, superseded by the
+	// current one, which is at the origin and adds nothing but a point.
+	int32_t lastCenterTS = *center;
+	int32_t centerDT = lastCenterTS - ts;
+	int32_t centerMask = -((lastCenterTS != 0) & (U32T(-centerDT) < U32T(windowTime)));
+
+	n += 1 + centerMask;
+	st -= centerMask & centerDT;
+
+	if (n < state->minPoints) {
+		return (false);
+	}
+
+	// Solve the normal equations of t = a * x + b * y + c, centered on the means.
+	double invN = (double) 1.0f / (double) n;
+	double cxx = sxx - ((double) sx * sx * invN);
+	double cxy = sxy - ((double) sx * sy * invN);
+	double cyy = syy - ((double) sy * sy * invN);
+	double cxt = sxt - ((double) sx * st * invN);
+	double cyt = syt - ((double) sy * st * invN);
+
+	// Points on a line (or fewer) don't define a plane.
+	double det = (cxx * cyy) - (cxy * cxy);
+	if (det < (double) 1e-3f) {
+		return (false);
+	}
+
+	float a = (float) (((cyy * cxt) - (cxy * cyt)) / det);
+	float b = (float) (((cxx * cyt) - (cxy * cxt)) / det);
+
+	// A (nearly) flat plane means (nearly) infinite speed.
+	float gradient2 = (a * a) + (b * b);
+	if (gradient2 < state->minGradient2) {
+		return (false);
+	}
+
+	// µs per pixel to pixels per second.
+	*flowX = (a / gradient2) * 1000000.0f;
+	*flowY = (b / gradient2) * 1000000.0f;
+
+	return (true);
+}
+
+/**
+ * Process all events assigned to the bands so far, in parallel, and wait for
+ * all bands to be done. Does nothing if no events are pending.
+ */
+static void flowBands(OpticalFlowState state) {
+	size_t eventsPending = 0;
+
+	for (size_t b = 0; b < state->bandsNumber; b++) {
+		eventsPending += state->bands[b].eventsSize;
+	}
+
+	if (eventsPending == 0) {
+		return;
+	}
+
+	// Band 0 is taken care of by the mainloop thread meanwhile.
+	caerWorkerThreadsRun(&state->workers);
+
+	for (size_t b = 0; b < state->bandsNumber; b++) {
+		state->bands[b].eventsSize = 0;
+	}
+}
+
+/**
+ * Process the band's events with a given radius. Always called with a constant
+ * radius, so that the compiler fully unrolls and vectorizes the plane fit.
+ */
+static inline void flowBandRadius(OpticalFlowState state, struct OpticalFlow_band *band, int32_t radius) {
+	size_t stride = state->surfaceStride;
+
+	for (size_t e = 0; e < band->eventsSize; e++) {
+		int32_t event = band->events[e];
+
+		int32_t y = state->eventY[event];
+		int32_t ts = state->eventTimestamp[event];
+
+		int32_t *center = band->surface[state->eventPolarity[event]]
+			+ ((size_t) (y - band->rowStart + radius) * stride) + state->eventX[event] + (size_t) radius;
+
+		if (y >= band->rowStart && y < band->rowEnd) {
+			state->flowValid[event] = flowFit(state, center, ts, radius, &state->flowX[event],
+				&state->flowY[event]);
+		}
+
+		*center = ts;
+	}
+}
+
+static void flowBand(OpticalFlowState state, struct OpticalFlow_band *band) {
+	switch (state->radius) {
+		case 1:
+			flowBandRadius(state, band, 1);
+			break;
+
+		case 2:
+			flowBandRadius(state, band, 2);
+			break;
+
+		case 3:
+			flowBandRadius(state, band, 3);
+			break;
+
+		case 4:
+			flowBandRadius(state, band, 4);
+			break;
+
+		default:
+			flowBandRadius(state, band, OPTICALFLOW_MAX_RADIUS);
+			break;
+	}
+}
+
+static void bandWork(void *statePtr, size_t band) {
+	OpticalFlowState state = statePtr;
+
+	flowBand(state, &state->bands[band]);
+}
+
+/**
+ * Split the sensor into bands of equal height, allocate their surfaces and
+ * start one thread per band, except band 0. On failure, fall back to serial.
+ */
+static bool bandsStart(caerModuleData moduleData, int32_t threads) {
+	OpticalFlowState state = moduleData->moduleState;
+
+	size_t bandsNumber = ((size_t) threads < (size_t) state->sizeY) ? ((size_t) threads) : ((size_t) state->sizeY);
+
+	state->surfaceStride = (size_t) state->sizeX + (2 * (size_t) state->radius);
+	state->timestampBase = 0;
+
+	state->bands = calloc(bandsNumber, sizeof(struct OpticalFlow_band));
+	state->rowBand = calloc((size_t) state->sizeY, sizeof(size_t));
+	if (state->bands == NULL || state->rowBand == NULL) {
+		bandsStop(state);
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for bands.");
+		return (false);
+	}
+
+	state->bandsNumber = bandsNumber;
+
+	for (size_t b = 0; b < bandsNumber; b++) {
+		struct OpticalFlow_band *band = &state->bands[b];
+
+		band->rowStart = I32T((b * (size_t) state->sizeY) / bandsNumber);
+		band->rowEnd = I32T(((b + 1) * (size_t) state->sizeY) / bandsNumber);
+
+		for (int32_t row = band->rowStart; row < band->rowEnd; row++) {
+			state->rowBand[row] = b;
+		}
+
+		band->surfaceSize = state->surfaceStride * (size_t) (band->rowEnd - band->rowStart + (2 * state->radius));
+
+		band->surface[0] = calloc(band->surfaceSize, sizeof(int32_t));
+		band->surface[1] = calloc(band->surfaceSize, sizeof(int32_t));
+		if (band->surface[0] == NULL || band->surface[1] == NULL) {
+			bandsStop(state);
+
+			caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for surfaces.");
+			return (false);
+		}
+	}
+
+	if (!caerWorkerThreadsStart(&state->workers, bandsNumber, &bandWork, state, "OpticalFlowBand")) {
+		bandsStop(state);
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to start band threads.");
+		return (false);
+	}
+
+	return (true);
+}
+
+static void bandsStop(OpticalFlowState state) {
+	caerWorkerThreadsStop(&state->workers);
+
+	if (state->bands != NULL) {
+		for (size_t b = 0; b < state->bandsNumber; b++) {
+			free(state->bands[b].surface[0]);
+			free(state->bands[b].surface[1]);
+			free(state->bands[b].events);
+		}
+	}
+
+	free(state->bands);
+	state->bands = NULL;
+	state->bandsNumber = 0;
+
+	free(state->rowBand);
+	state->rowBand = NULL;
+
+	free(state->eventX);
+	state->eventX = NULL;
+	free(state->eventY);
+	state->eventY = NULL;
+	free(state->eventPolarity);
+	state->eventPolarity = NULL;
+	free(state->eventTimestamp);
+	state->eventTimestamp = NULL;
+	free(state->flowX);
+	state->flowX = NULL;
+	free(state->flowY);
+	state->flowY = NULL;
+	free(state->flowValid);
+	state->flowValid = NULL;
+	state->eventCapacity = 0;
+}
+
+/**
+ * Ensure per-event memory can hold the given number of events. Every event is
+ * assigned at most once to each band, so each band needs the same capacity.
+ */
+static bool eventsReserve(OpticalFlowState state, size_t eventNumber) {
+	struct caer_worker_array arrays[OPTICALFLOW_EVENT_ARRAYS + OPTICALFLOW_MAX_THREADS] = { { &state->eventX,
+		sizeof(uint16_t) }, { &state->eventY, sizeof(uint16_t) }, { &state->eventPolarity, sizeof(uint8_t) }, {
+		&state->eventTimestamp, sizeof(int32_t) }, { &state->flowX, sizeof(float) }, { &state->flowY, sizeof(float) },
+		{ &state->flowValid, sizeof(bool) } };
+
+	for (size_t b = 0; b < state->bandsNumber; b++) {
+		arrays[OPTICALFLOW_EVENT_ARRAYS + b] = (struct caer_worker_array ) { &state->bands[b].events,
+			sizeof(int32_t) };
+	}
+
+	return (caerWorkerArraysReserve(&state->eventCapacity, eventNumber, arrays,
+		OPTICALFLOW_EVENT_ARRAYS + state->bandsNumber));
+}
+
+/**
+ * Move the timestamp base, so that timestamps up to maxTimestamp can be stored
+ * relative to it in the 32bit surfaces of all bands, see timestamp_rebase.h.
+ */
+static void surfacesRebase(OpticalFlowState state, int64_t maxTimestamp) {
+	int32_t shift = caerTimestampRebase(&state->timestampBase, maxTimestamp);
+
+	for (size_t b = 0; b < state->bandsNumber; b++) {
+		caerTimestampMapRebase(state->bands[b].surface[0], state->bands[b].surfaceSize, shift);
+		caerTimestampMapRebase(state->bands[b].surface[1], state->bands[b].surfaceSize, shift);
+	}
+}
+
+/**
+ * Add a packet's processing time to the benchmark, and log the results every
+ * OPTICALFLOW_BENCHMARK_INTERVAL seconds.
+ */
+static void benchmarkUpdate(caerModuleData moduleData, const struct timespec *start, size_t events, size_t flow) {
+	OpticalFlowState state = moduleData->moduleState;
+
+	struct timespec end;
+	portable_clock_gettime_monotonic(&end);
+
+	state->benchmarkTime += (U64T(end.tv_sec - start->tv_sec) * 1000000000ULL) + U64T(end.tv_nsec)
+		- U64T(start->tv_nsec);
+	state->benchmarkEvents += events;
+	state->benchmarkFlow += flow;
+
+	if ((end.tv_sec - state->benchmarkLastLog.tv_sec) < OPTICALFLOW_BENCHMARK_INTERVAL) {
+		return;
+	}
+
+	if (state->benchmarkEvents > 0 && state->benchmarkTime > 0) {
+		caerModuleLog(moduleData, CAER_LOG_INFO,
+			"Benchmark: %" PRIu64 " events in %.3f ms, %.1f ns/event (%.2f Mevt/s), %" PRIu64 " flow events.",
+			state->benchmarkEvents, (double) state->benchmarkTime / (double) 1.0e6f,
+			(double) state->benchmarkTime / (double) state->benchmarkEvents,
+			((double) state->benchmarkEvents * (double) 1.0e3f) / (double) state->benchmarkTime, state->benchmarkFlow);
+	}
+
+	state->benchmarkTime = 0;
+	state->benchmarkEvents = 0;
+	state->benchmarkFlow = 0;
+	state->benchmarkLastLog = end;
+}
+
+static void caerOpticalFlowConfig(caerModuleData moduleData) {
+	caerModuleConfigUpdateReset(moduleData);
+
+	OpticalFlowState state = moduleData->moduleState;
+
+	int32_t radius = sshsNodeGetInt(moduleData->moduleNode, "radius");
+	int32_t threads = sshsNodeGetInt(moduleData->moduleNode, "threads");
+
+	state->windowTime = sshsNodeGetInt(moduleData->moduleNode, "windowTime");
+	state->minPoints = sshsNodeGetInt(moduleData->moduleNode, "minPoints");
+
+	// Speed is 1 / |gradient|, so compare squared gradients to avoid the root.
+	int32_t maxSpeed = sshsNodeGetInt(moduleData->moduleNode, "maxSpeed");
+	float minGradient = 1000000.0f / (float) maxSpeed;
+	state->minGradient2 = minGradient * minGradient;
+
+	// Surfaces depend on the radius, so rebuild bands on its changes too. This
+	// starts over with empty surfaces. Config changes are applied between
+	// packets, so the band threads are idle.
+	if (radius != state->radius || threads != state->threads || state->bandsNumber == 0) {
+		bandsStop(state);
+
+		state->radius = radius;
+		state->threads = threads;
+
+		if (!bandsStart(moduleData, threads) && threads > 1) {
+			caerModuleLog(moduleData, CAER_LOG_WARNING, "Falling back to serial flow computation.");
+
+			bandsStart(moduleData, 1);
+		}
+	}
+
+	bool benchmark = sshsNodeGetBool(moduleData->moduleNode, "benchmark");
+
+	// Start a fresh measurement when enabled.
+	if (benchmark && !state->benchmark) {
+		state->benchmarkTime = 0;
+		state->benchmarkEvents = 0;
+		state->benchmarkFlow = 0;
+		portable_clock_gettime_monotonic(&state->benchmarkLastLog);
+	}
+
+	state->benchmark = benchmark;
+}
+
+static void caerOpticalFlowExit(caerModuleData moduleData) {
+	// Remove listener, which can reference invalid memory in userData.
+	sshsNodeRemoveAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
+
+	OpticalFlowState state = moduleData->moduleState;
+
+	// Stop band threads, if any, and ensure surfaces are freed.
+	bandsStop(state);
+
+	sshsNode sourceInfoNode = sshsGetRelativeNode(moduleData->moduleNode, "sourceInfo/");
+	sshsNodeClearSubTree(sourceInfoNode, true);
+}
+
+static void caerOpticalFlowReset(caerModuleData moduleData, int16_t resetCallSourceID) {
+	UNUSED_ARGUMENT(resetCallSourceID);
+
+	OpticalFlowState state = moduleData->moduleState;
+
+	// Reset surfaces to all zeros (startup state).
+	for (size_t b = 0; b < state->bandsNumber; b++) {
+		memset(state->bands[b].surface[0], 0, state->bands[b].surfaceSize * sizeof(int32_t));
+		memset(state->bands[b].surface[1], 0, state->bands[b].surfaceSize * sizeof(int32_t));
+	}
+
+	state->timestampBase = 0;
+}
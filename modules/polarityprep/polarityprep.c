@@ -0,0 +1,386 @@
+#include "main.h"
+#include "base/mainloop.h"
+#include "base/module.h"
+#include "ext/pathmax.h"
+#include "modules/misc/hotpixel_mask.h"
+#include "modules/misc/timestamp_rebase.h"
+
+#include <libcaer/events/polarity.h>
+
+#include <errno.h>
+
+/**
+ * Polarity pre-processing: the usual chain of polarity filters, fused into a
+ * single pass over the packet. Each event goes through the enabled stages in
+ * this order, and stops at the first one that filters it out:
+ * - ROI: only events inside the region of interest pass.
+ * - hot-pixel mask: events from pixels marked as hot are filtered out.
+ * - sub-sampling: addresses are shifted right, all following stages work on
+ *   the sub-sampled addresses, and so does everything downstream.
+ * - refractory period: events closer in time than the refractory period to
+ *   the previous event at the same pixel are filtered out.
+ * - background activity: events not supported by a recent event at one of
+ *   their neighboring pixels are filtered out, like the BAFilter module does.
+ * Events filtered out by a stage don't influence the following ones.
+ */
+struct PolarityPrep_state {
+	int16_t sizeX;
+	int16_t sizeY;
+	// ROI.
+	bool roiEnabled;
+	uint16_t roiStartX;
+	uint16_t roiStartY;
+	uint16_t roiEndX;
+	uint16_t roiEndY;
+	// Hot-pixel mask, learned over a calibration window, same as the HotPixelFilter module.
+	bool hotPixelEnabled;
+	struct caer_hotpixel_mask hotPixelMask;
+	struct caer_hotpixel_learner hotPixelLearner;
+	int32_t hotPixelRate;
+	char *hotPixelMaskFile;
+	// Sub-sampling.
+	bool subSampleEnabled;
+	int8_t subSampleBy;
+	/// Refractory period and background activity maps: last event timestamps,
+	/// relative to timestampBase (0 means never). Row-major, with a border of
+	/// one pixel on each side, so that all eight neighbors of any pixel can be
+	/// updated without bounds checks.
+	int32_t *refractoryMap;
+	int32_t *baMap;
+	size_t timestampMapStride;
+	size_t timestampMapSize;
+	int64_t timestampBase;
+	bool refractoryEnabled;
+	int32_t refractoryPeriod;
+	bool baEnabled;
+	int32_t baDeltaT;
+};
+
+typedef struct PolarityPrep_state *PolarityPrepState;
+
+static void caerPolarityPrepConfigInit(sshsNode moduleNode);
+static bool caerPolarityPrepInit(caerModuleData moduleData);
+static void caerPolarityPrepRun(caerModuleData moduleData, caerEventPacketContainer in, caerEventPacketContainer *out);
+static void caerPolarityPrepConfig(caerModuleData moduleData);
+static void caerPolarityPrepExit(caerModuleData moduleData);
+static void caerPolarityPrepReset(caerModuleData moduleData, int16_t resetCallSourceID);
+static void hotPixelLearnDone(caerModuleData moduleData);
+static void timestampMapsRebase(PolarityPrepState state, int64_t timestamp);
+
+static const struct caer_module_functions PolarityPrepFunctions = { .moduleConfigInit = &caerPolarityPrepConfigInit,
+	.moduleInit = &caerPolarityPrepInit, .moduleRun = &caerPolarityPrepRun, .moduleConfig = &caerPolarityPrepConfig,
+	.moduleExit = &caerPolarityPrepExit, .moduleReset = &caerPolarityPrepReset };
+
+static const struct caer_event_stream_in PolarityPrepInputs[] = { { .type = POLARITY_EVENT, .number = 1, .readOnly =
+	false } };
+
+static const struct caer_module_info PolarityPrepInfo = { .version = 1, .name = "PolarityPrep", .description =
+	"Fused polarity pre-processing: ROI, hot-pixel mask, sub-sampling, refractory period and background activity filtering.",
+	.type = CAER_MODULE_PROCESSOR, .memSize = sizeof(struct PolarityPrep_state), .functions = &PolarityPrepFunctions,
+	.inputStreams = PolarityPrepInputs, .inputStreamsSize = CAER_EVENT_STREAM_IN_SIZE(PolarityPrepInputs),
+	.outputStreams = NULL, .outputStreamsSize = 0, };
+
+caerModuleInfo caerModuleGetInfo(void) {
+	return (&PolarityPrepInfo);
+}
+
+static void caerPolarityPrepConfigInit(sshsNode moduleNode) {
+	sshsNodeCreateBool(moduleNode, "roiEnabled", false, SSHS_FLAGS_NORMAL,
+		"Only let events inside the region of interest through.");
+	sshsNodeCreateShort(moduleNode, "roiStartX", 0, 0, INT16_MAX, SSHS_FLAGS_NORMAL,
+		"Region of interest: first column (inclusive).");
+	sshsNodeCreateShort(moduleNode, "roiStartY", 0, 0, INT16_MAX, SSHS_FLAGS_NORMAL,
+		"Region of interest: first row (inclusive).");
+	sshsNodeCreateShort(moduleNode, "roiEndX", INT16_MAX, 0, INT16_MAX, SSHS_FLAGS_NORMAL,
+		"Region of interest: last column (inclusive).");
+	sshsNodeCreateShort(moduleNode, "roiEndY", INT16_MAX, 0, INT16_MAX, SSHS_FLAGS_NORMAL,
+		"Region of interest: last row (inclusive).");
+
+	sshsNodeCreateBool(moduleNode, "hotPixelEnabled", false, SSHS_FLAGS_NORMAL,
+		"Filter out events from pixels in the hot-pixel mask.");
+	sshsNodeCreateString(moduleNode, "hotPixelMaskFile", "polarityprep.mask", 1, PATH_MAX, SSHS_FLAGS_NORMAL,
+		"Hot-pixel mask file, loaded at startup and saved after learning (same format as HotPixelFilter).");
+	sshsNodeCreateBool(moduleNode, "hotPixelLearn", false, SSHS_FLAGS_NORMAL,
+		"Learn a new hot-pixel mask over the next hotPixelLearnTime ms of events.");
+	sshsNodeCreateInt(moduleNode, "hotPixelLearnTime", 5000, 100, 600000, SSHS_FLAGS_NORMAL,
+		"Duration of the hot-pixel learning window in ms.");
+	sshsNodeCreateInt(moduleNode, "hotPixelRate", 100, 1, 10000000, SSHS_FLAGS_NORMAL,
+		"Pixels with a mean event rate in Hz at or above this during learning are considered hot.");
+
+	sshsNodeCreateBool(moduleNode, "subSampleEnabled", false, SSHS_FLAGS_NORMAL, "Sub-sample event addresses.");
+	sshsNodeCreateByte(moduleNode, "subSampleBy", 1, 1, 15, SSHS_FLAGS_NORMAL,
+		"Sub-sample event addresses by shifting right by this amount.");
+
+	sshsNodeCreateBool(moduleNode, "refractoryEnabled", false, SSHS_FLAGS_NORMAL,
+		"Filter out events too close in time to the previous event at the same pixel.");
+	sshsNodeCreateInt(moduleNode, "refractoryPeriod", 1000, 1, 10000000, SSHS_FLAGS_NORMAL,
+		"Minimum time difference in µs between events at the same pixel.");
+
+	sshsNodeCreateBool(moduleNode, "baEnabled", false, SSHS_FLAGS_NORMAL,
+		"Filter out background activity (uncorrelated noise).");
+	sshsNodeCreateInt(moduleNode, "baDeltaT", 30000, 1, 10000000, SSHS_FLAGS_NORMAL,
+		"Maximum time difference in µs for events to be considered correlated and not be filtered out.");
+}
+
+static bool caerPolarityPrepInit(caerModuleData moduleData) {
+	// Wait for input to be ready. All inputs, once they are up and running, will
+	// have a valid sourceInfo node to query, especially if dealing with data.
+	int16_t *inputs = caerMainloopGetModuleInputIDs(moduleData->moduleID, NULL);
+	if (inputs == NULL) {
+		return (false);
+	}
+
+	int16_t sourceID = inputs[0];
+	free(inputs);
+
+	PolarityPrepState state = moduleData->moduleState;
+
+	// Allocate maps using info from sourceInfo.
+	sshsNode sourceInfo = caerMainloopGetSourceInfo(sourceID);
+	if (sourceInfo == NULL) {
+		return (false);
+	}
+
+	state->sizeX = sshsNodeGetShort(sourceInfo, "polaritySizeX");
+	state->sizeY = sshsNodeGetShort(sourceInfo, "polaritySizeY");
+
+	state->timestampMapStride = (size_t) state->sizeX + 2;
+	state->timestampMapSize = state->timestampMapStride * ((size_t) state->sizeY + 2);
+	state->timestampBase = 0;
+
+	state->refractoryMap = calloc(state->timestampMapSize, sizeof(int32_t));
+	if (state->refractoryMap == NULL) {
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for refractoryMap.");
+		return (false);
+	}
+
+	state->baMap = calloc(state->timestampMapSize, sizeof(int32_t));
+	if (state->baMap == NULL) {
+		free(state->refractoryMap);
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for baMap.");
+		return (false);
+	}
+
+	if (!caerHotPixelMaskInit(&state->hotPixelMask, state->sizeX, state->sizeY)) {
+		free(state->refractoryMap);
+		free(state->baMap);
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for hot-pixel mask.");
+		return (false);
+	}
+
+	// Never start learning right away, only on explicit request.
+	sshsNodePutBool(moduleData->moduleNode, "hotPixelLearn", false);
+
+	caerPolarityPrepConfig(moduleData);
+
+	if (caerHotPixelMaskLoad(&state->hotPixelMask, state->hotPixelMaskFile)) {
+		caerModuleLog(moduleData, CAER_LOG_INFO, "Loaded hot-pixel mask from '%s'.", state->hotPixelMaskFile);
+	}
+
+	// Add config listeners last, to avoid having them dangling if Init doesn't succeed.
+	sshsNodeAddAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
+
+	// Nothing that can fail here.
+	return (true);
+}
+
+static void caerPolarityPrepRun(caerModuleData moduleData, caerEventPacketContainer in, caerEventPacketContainer *out) {
+	UNUSED_ARGUMENT(out);
+
+	caerPolarityEventPacket polarity = (caerPolarityEventPacket) caerEventPacketContainerFindEventPacketByType(in,
+		POLARITY_EVENT);
+
+	// Only process packets with content.
+	if (polarity == NULL) {
+		return;
+	}
+
+	PolarityPrepState state = moduleData->moduleState;
+
+	size_t stride = state->timestampMapStride;
+	uint8_t subSampleShift = (state->subSampleEnabled) ? (U8T(state->subSampleBy)) : (0);
+	bool needTimestamps = state->refractoryEnabled || state->baEnabled;
+
+	CAER_POLARITY_ITERATOR_VALID_START(polarity)
+		uint16_t x = caerPolarityEventGetX(caerPolarityIteratorElement);
+		uint16_t y = caerPolarityEventGetY(caerPolarityIteratorElement);
+
+		if (caerHotPixelLearnerActive(&state->hotPixelLearner)
+			&& caerHotPixelLearnerAdd(&state->hotPixelLearner, &state->hotPixelMask, x, y,
+				caerPolarityEventGetTimestamp64(caerPolarityIteratorElement, polarity))) {
+			hotPixelLearnDone(moduleData);
+		}
+
+		if (state->roiEnabled
+			&& (x < state->roiStartX || x > state->roiEndX || y < state->roiStartY || y > state->roiEndY)) {
+			caerPolarityEventInvalidate(caerPolarityIteratorElement, polarity);
+			continue;
+		}
+
+		if (state->hotPixelEnabled && caerHotPixelMaskGet(&state->hotPixelMask, x, y)) {
+			caerPolarityEventInvalidate(caerPolarityIteratorElement, polarity);
+			continue;
+		}
+
+		if (subSampleShift != 0) {
+			x = U16T(x >> subSampleShift);
+			y = U16T(y >> subSampleShift);
+
+			caerPolarityEventSetX(caerPolarityIteratorElement, x);
+			caerPolarityEventSetY(caerPolarityIteratorElement, y);
+		}
+
+		if (!needTimestamps) {
+			continue;
+		}
+
+		int64_t timestamp = caerPolarityEventGetTimestamp64(caerPolarityIteratorElement, polarity);
+
+		// Keep relative timestamps in range, so they fit into the 32bit maps.
+		if (caerTimestampRebaseNeeded(state->timestampBase, timestamp, timestamp)) {
+			timestampMapsRebase(state, timestamp);
+		}
+
+		int32_t ts = I32T(timestamp - state->timestampBase);
+
+		// Plus one for the border.
+		size_t mapIndex = (((size_t) y + 1) * stride) + ((size_t) x + 1);
+
+		if (state->refractoryEnabled) {
+			int32_t lastTS = state->refractoryMap[mapIndex];
+
+			state->refractoryMap[mapIndex] = ts;
+
+			if (lastTS != 0 && (ts - lastTS) < state->refractoryPeriod) {
+				caerPolarityEventInvalidate(caerPolarityIteratorElement, polarity);
+				continue;
+			}
+		}
+
+		if (state->baEnabled) {
+			int32_t *center = state->baMap + mapIndex;
+			int32_t lastTS = *center;
+
+			// Update neighboring region: rows above and below are contiguous.
+			int32_t *above = center - stride;
+			int32_t *below = center + stride;
+
+			above[-1] = ts;
+			above[0] = ts;
+			above[1] = ts;
+			center[-1] = ts;
+			center[1] = ts;
+			below[-1] = ts;
+			below[0] = ts;
+			below[1] = ts;
+
+			if (lastTS == 0 || (ts - lastTS) >= state->baDeltaT) {
+				caerPolarityEventInvalidate(caerPolarityIteratorElement, polarity);
+				continue;
+			}
+		}
+	CAER_POLARITY_ITERATOR_VALID_END
+}
+
+/**
+ * Build the new hot-pixel mask from the learning window and save it.
+ */
+static void hotPixelLearnDone(caerModuleData moduleData) {
+	PolarityPrepState state = moduleData->moduleState;
+
+	size_t hotPixels = caerHotPixelLearnerFinish(&state->hotPixelLearner, &state->hotPixelMask, state->hotPixelRate);
+
+	if (caerHotPixelMaskSave(&state->hotPixelMask, state->hotPixelMaskFile)) {
+		caerModuleLog(moduleData, CAER_LOG_INFO, "Hot-pixel learning done, %zu hot pixels found. Mask saved to '%s'.",
+			hotPixels, state->hotPixelMaskFile);
+	}
+	else {
+		caerModuleLog(moduleData, CAER_LOG_ERROR,
+			"Hot-pixel learning done, %zu hot pixels found. Failed to save mask to '%s'. Error: %d.", hotPixels,
+			state->hotPixelMaskFile, errno);
+	}
+
+	sshsNodePutBool(moduleData->moduleNode, "hotPixelLearn", false);
+}
+
+/**
+ * Move the timestamp base, so that the given timestamp can be stored relative
+ * to it in the 32bit maps, see timestamp_rebase.h.
+ */
+static void timestampMapsRebase(PolarityPrepState state, int64_t timestamp) {
+	int32_t shift = caerTimestampRebase(&state->timestampBase, timestamp);
+
+	caerTimestampMapRebase(state->refractoryMap, state->timestampMapSize, shift);
+	caerTimestampMapRebase(state->baMap, state->timestampMapSize, shift);
+}
+
+static void caerPolarityPrepConfig(caerModuleData moduleData) {
+	caerModuleConfigUpdateReset(moduleData);
+
+	PolarityPrepState state = moduleData->moduleState;
+
+	state->roiEnabled = sshsNodeGetBool(moduleData->moduleNode, "roiEnabled");
+	state->roiStartX = U16T(sshsNodeGetShort(moduleData->moduleNode, "roiStartX"));
+	state->roiStartY = U16T(sshsNodeGetShort(moduleData->moduleNode, "roiStartY"));
+	state->roiEndX = U16T(sshsNodeGetShort(moduleData->moduleNode, "roiEndX"));
+	state->roiEndY = U16T(sshsNodeGetShort(moduleData->moduleNode, "roiEndY"));
+
+	state->hotPixelEnabled = sshsNodeGetBool(moduleData->moduleNode, "hotPixelEnabled");
+	state->hotPixelRate = sshsNodeGetInt(moduleData->moduleNode, "hotPixelRate");
+
+	// Only pick up a new file name when not learning, so the mask goes where the user expects.
+	if (!caerHotPixelLearnerActive(&state->hotPixelLearner)) {
+		free(state->hotPixelMaskFile);
+		state->hotPixelMaskFile = sshsNodeGetString(moduleData->moduleNode, "hotPixelMaskFile");
+	}
+
+	// Start learning on request, the window begins with the next event.
+	if (sshsNodeGetBool(moduleData->moduleNode, "hotPixelLearn")
+		&& !caerHotPixelLearnerActive(&state->hotPixelLearner)) {
+		if (caerHotPixelLearnerStart(&state->hotPixelLearner, &state->hotPixelMask,
+			I64T(sshsNodeGetInt(moduleData->moduleNode, "hotPixelLearnTime")) * 1000)) {
+			caerModuleLog(moduleData, CAER_LOG_INFO, "Hot-pixel learning started.");
+		}
+		else {
+			caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to allocate memory for hot-pixel learning.");
+			sshsNodePutBool(moduleData->moduleNode, "hotPixelLearn", false);
+		}
+	}
+
+	state->subSampleEnabled = sshsNodeGetBool(moduleData->moduleNode, "subSampleEnabled");
+	state->subSampleBy = sshsNodeGetByte(moduleData->moduleNode, "subSampleBy");
+
+	state->refractoryEnabled = sshsNodeGetBool(moduleData->moduleNode, "refractoryEnabled");
+	state->refractoryPeriod = sshsNodeGetInt(moduleData->moduleNode, "refractoryPeriod");
+
+	state->baEnabled = sshsNodeGetBool(moduleData->moduleNode, "baEnabled");
+	state->baDeltaT = sshsNodeGetInt(moduleData->moduleNode, "baDeltaT");
+}
+
+static void caerPolarityPrepExit(caerModuleData moduleData) {
+	// Remove listener, which can reference invalid memory in userData.
+	sshsNodeRemoveAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
+
+	PolarityPrepState state = moduleData->moduleState;
+
+	// Ensure maps are freed.
+	free(state->refractoryMap);
+	free(state->baMap);
+	caerHotPixelLearnerStop(&state->hotPixelLearner);
+	caerHotPixelMaskFree(&state->hotPixelMask);
+
+	free(state->hotPixelMaskFile);
+}
+
+static void caerPolarityPrepReset(caerModuleData moduleData, int16_t resetCallSourceID) {
+	UNUSED_ARGUMENT(resetCallSourceID);
+
+	PolarityPrepState state = moduleData->moduleState;
+
+	// Reset timestamp maps to all zeros (startup state). The hot-pixel mask is kept.
+	memset(state->refractoryMap, 0, state->timestampMapSize * sizeof(int32_t));
+	memset(state->baMap, 0, state->timestampMapSize * sizeof(int32_t));
+	state->timestampBase = 0;
+}
@@ -2,19 +2,46 @@
 #include "base/mainloop.h"
 #include "base/module.h"
 
+// Latency histogram: exact below 16us, then 16 linear sub-buckets per power
+// of two (~6% resolution), up to 2^32us.
+#define LATENCY_SUB_BUCKETS_BITS 4
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKETS_BITS)
+#define LATENCY_MAX_BITS 32
+#define LATENCY_BUCKETS (LATENCY_SUB_BUCKETS + ((LATENCY_MAX_BITS - LATENCY_SUB_BUCKETS_BITS) * LATENCY_SUB_BUCKETS))
+
+#define CAER_STATISTICS_STRING_LATENCY "Latency p50/p99 us: %8" PRIi64 " / %8" PRIi64
+
+struct caer_statistics_module_state {
+	struct caer_statistics_state statistics;
+	bool measureLatency;
+	sshsNode latencyNode;
+	struct timespec latencyLastTime;
+	int64_t latencyMax;
+	int64_t latencyP50;
+	int64_t latencyP99;
+	uint64_t latencyCount;
+	uint32_t latencyHistogram[LATENCY_BUCKETS];
+};
+
+typedef struct caer_statistics_module_state *caerStatisticsModuleState;
+
 static bool caerStatisticsInit(caerModuleData moduleData);
 static void caerStatisticsRun(caerModuleData moduleData, caerEventPacketContainer in, caerEventPacketContainer *out);
+static void caerStatisticsConfig(caerModuleData moduleData);
 static void caerStatisticsExit(caerModuleData moduleData);
 static void caerStatisticsReset(caerModuleData moduleData, int16_t resetCallSourceID);
+static void latencyUpdate(caerStatisticsModuleState state, caerEventPacketHeaderConst packetHeader);
+static void latencyReset(caerStatisticsModuleState state);
 
 static const struct caer_module_functions StatisticsFunctions = { .moduleInit = &caerStatisticsInit, .moduleRun =
-	&caerStatisticsRun, .moduleConfig = NULL, .moduleExit = &caerStatisticsExit, .moduleReset = &caerStatisticsReset };
+	&caerStatisticsRun, .moduleConfig = &caerStatisticsConfig, .moduleExit = &caerStatisticsExit, .moduleReset =
+	&caerStatisticsReset };
 
 static const struct caer_event_stream_in StatisticsInputs[] = { { .type = -1, .number = 1, .readOnly = true } };
 
 static const struct caer_module_info StatisticsInfo = { .version = 1, .name = "Statistics", .description =
 	"Display statistics on number of events.", .type = CAER_MODULE_OUTPUT, .memSize =
-	sizeof(struct caer_statistics_state), .functions = &StatisticsFunctions, .inputStreams = StatisticsInputs,
+	sizeof(struct caer_statistics_module_state), .functions = &StatisticsFunctions, .inputStreams = StatisticsInputs,
 	.inputStreamsSize = CAER_EVENT_STREAM_IN_SIZE(StatisticsInputs), .outputStreams =
 	NULL, .outputStreamsSize = 0, };
 
@@ -23,14 +50,47 @@ caerModuleInfo caerModuleGetInfo(void) {
 }
 
 static bool caerStatisticsInit(caerModuleData moduleData) {
-	caerStatisticsState state = moduleData->moduleState;
+	caerStatisticsModuleState state = moduleData->moduleState;
 
 	// Configurable division factor.
 	sshsNodeCreateLong(moduleData->moduleNode, "divisionFactor", 1000, 1, INT64_MAX, SSHS_FLAGS_NORMAL,
 		"Division factor for statistics display, to get Kilo/Mega/... events shown.");
-	state->divisionFactor = U64T(sshsNodeGetLong(moduleData->moduleNode, "divisionFactor"));
+	state->statistics.divisionFactor = U64T(sshsNodeGetLong(moduleData->moduleNode, "divisionFactor"));
+
+	sshsNodeCreateBool(moduleData->moduleNode, "measureLatency", false, SSHS_FLAGS_NORMAL,
+		"Measure how old packets are when they reach this module, relative to when the input produced them.");
+	state->measureLatency = sshsNodeGetBool(moduleData->moduleNode, "measureLatency");
+
+	// Latency percentiles over the last second, in microseconds.
+	state->latencyNode = sshsGetRelativeNode(moduleData->moduleNode, "latency/");
+
+	sshsNodeCreateLong(state->latencyNode, "p50", 0, 0, INT64_MAX, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Median packet latency (in us).");
+	sshsNodeCreateAttributePollTime(state->latencyNode, "p50", SSHS_LONG, 1);
+	sshsNodeCreateLong(state->latencyNode, "p95", 0, 0, INT64_MAX, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"95th percentile packet latency (in us).");
+	sshsNodeCreateAttributePollTime(state->latencyNode, "p95", SSHS_LONG, 1);
+	sshsNodeCreateLong(state->latencyNode, "p99", 0, 0, INT64_MAX, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"99th percentile packet latency (in us).");
+	sshsNodeCreateAttributePollTime(state->latencyNode, "p99", SSHS_LONG, 1);
+	sshsNodeCreateLong(state->latencyNode, "max", 0, 0, INT64_MAX, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Maximum packet latency (in us).");
+	sshsNodeCreateAttributePollTime(state->latencyNode, "max", SSHS_LONG, 1);
+	sshsNodeCreateLong(state->latencyNode, "packets", 0, 0, INT64_MAX, SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT,
+		"Number of packets the latency percentiles are based on.");
+	sshsNodeCreateAttributePollTime(state->latencyNode, "packets", SSHS_LONG, 1);
 
-	return (caerStatisticsStringInit(state));
+	if (!caerStatisticsStringInit(&state->statistics)) {
+		sshsNodeClearSubTree(state->latencyNode, true);
+		return (false);
+	}
+
+	latencyReset(state);
+
+	// Add config listeners last, to avoid having them dangling if Init doesn't succeed.
+	sshsNodeAddAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
+
+	return (true);
 }
 
 static void caerStatisticsRun(caerModuleData moduleData, caerEventPacketContainer in, caerEventPacketContainer *out) {
@@ -39,23 +99,171 @@ static void caerStatisticsRun(caerModuleData moduleData, caerEventPacketContaine
 	// Interpret variable arguments (same as above in main function).
 	caerEventPacketHeaderConst packetHeader = caerEventPacketContainerGetEventPacketConst(in, 0);
 
-	caerStatisticsState state = moduleData->moduleState;
-	caerStatisticsStringUpdate(packetHeader, state);
+	caerStatisticsModuleState state = moduleData->moduleState;
+	caerStatisticsStringUpdate(packetHeader, &state->statistics);
 
-	fprintf(stdout, "\r%s - %s", state->currentStatisticsStringTotal, state->currentStatisticsStringValid);
+	if (state->measureLatency) {
+		latencyUpdate(state, packetHeader);
+
+		fprintf(stdout, "\r%s - %s - " CAER_STATISTICS_STRING_LATENCY, state->statistics.currentStatisticsStringTotal,
+			state->statistics.currentStatisticsStringValid, state->latencyP50, state->latencyP99);
+	}
+	else {
+		fprintf(stdout, "\r%s - %s", state->statistics.currentStatisticsStringTotal,
+			state->statistics.currentStatisticsStringValid);
+	}
 	fflush(stdout);
 }
 
+static void caerStatisticsConfig(caerModuleData moduleData) {
+	caerModuleConfigUpdateReset(moduleData);
+
+	caerStatisticsModuleState state = moduleData->moduleState;
+
+	state->statistics.divisionFactor = U64T(sshsNodeGetLong(moduleData->moduleNode, "divisionFactor"));
+
+	bool measureLatency = sshsNodeGetBool(moduleData->moduleNode, "measureLatency");
+	if (measureLatency != state->measureLatency) {
+		state->measureLatency = measureLatency;
+
+		latencyReset(state);
+	}
+}
+
 static void caerStatisticsExit(caerModuleData moduleData) {
-	caerStatisticsState state = moduleData->moduleState;
+	// Remove listener, which can reference invalid memory in userData.
+	sshsNodeRemoveAttributeListener(moduleData->moduleNode, moduleData, &caerModuleConfigDefaultListener);
+
+	caerStatisticsModuleState state = moduleData->moduleState;
+
+	caerStatisticsStringExit(&state->statistics);
 
-	caerStatisticsStringExit(state);
+	sshsNodeClearSubTree(state->latencyNode, true);
 }
 
 static void caerStatisticsReset(caerModuleData moduleData, int16_t resetCallSourceID) {
 	UNUSED_ARGUMENT(resetCallSourceID);
 
-	caerStatisticsState state = moduleData->moduleState;
+	caerStatisticsModuleState state = moduleData->moduleState;
+
+	caerStatisticsStringReset(&state->statistics);
+
+	// Timestamps restarted, drop samples taken against the old time base.
+	latencyReset(state);
+}
+
+static inline size_t latencyBucket(uint64_t latency) {
+	if (latency < LATENCY_SUB_BUCKETS) {
+		return ((size_t) latency);
+	}
+
+	if (latency >= (1ULL << LATENCY_MAX_BITS)) {
+		return (LATENCY_BUCKETS - 1);
+	}
+
+	uint32_t msb = 63 - (uint32_t) __builtin_clzll(latency);
+	uint32_t shift = msb - LATENCY_SUB_BUCKETS_BITS;
+
+	return (LATENCY_SUB_BUCKETS + ((size_t) shift * LATENCY_SUB_BUCKETS)
+		+ ((size_t) (latency >> shift) & (LATENCY_SUB_BUCKETS - 1)));
+}
+
+// Upper edge of a bucket, so reported percentiles never understate latency.
+static inline int64_t latencyBucketValue(size_t bucket) {
+	if (bucket < LATENCY_SUB_BUCKETS) {
+		return (I64T(bucket));
+	}
+
+	uint32_t shift = U32T((bucket - LATENCY_SUB_BUCKETS) / LATENCY_SUB_BUCKETS);
+	uint64_t sub = (bucket - LATENCY_SUB_BUCKETS) % LATENCY_SUB_BUCKETS;
+
+	return (I64T((((LATENCY_SUB_BUCKETS + sub + 1) << shift)) - 1));
+}
+
+static void latencyUpdate(caerStatisticsModuleState state, caerEventPacketHeaderConst packetHeader) {
+	struct timespec currentTime;
+	portable_clock_gettime_monotonic(&currentTime);
+
+	// The newest event in the packet tells how fresh the data is. Only packets
+	// that come straight from an input module have a known time base.
+	int64_t timeOffset;
+
+	if ((packetHeader != NULL) && (caerEventPacketHeaderGetEventNumber(packetHeader) > 0)
+		&& caerMainloopGetSourceTimeOffset(caerEventPacketHeaderGetEventSource(packetHeader), &timeOffset)) {
+		const void *lastEvent = caerGenericEventGetEvent(packetHeader,
+			caerEventPacketHeaderGetEventNumber(packetHeader) - 1);
+		int64_t eventTime = caerGenericEventGetTimestamp64(lastEvent, packetHeader) + timeOffset;
+
+		int64_t hostTime = (I64T(currentTime.tv_sec) * 1000000LL) + I64T(currentTime.tv_nsec / 1000);
+		int64_t latency = hostTime - eventTime;
+
+		// The offset tracks the fastest packet seen, small drift can push this below zero.
+		if (latency < 0) {
+			latency = 0;
+		}
+
+		state->latencyHistogram[latencyBucket(U64T(latency))]++;
+		state->latencyCount++;
+
+		if (latency > state->latencyMax) {
+			state->latencyMax = latency;
+		}
+	}
+
+	uint64_t diffNanoTime = (uint64_t) (((int64_t) (currentTime.tv_sec - state->latencyLastTime.tv_sec)
+		* 1000000000LL) + (int64_t) (currentTime.tv_nsec - state->latencyLastTime.tv_nsec));
+
+	// Publish percentiles roughly every second.
+	if (diffNanoTime < 1000000000LLU) {
+		return;
+	}
+
+	const uint64_t targets[3] = { (state->latencyCount * 50 + 99) / 100, (state->latencyCount * 95 + 99) / 100,
+		(state->latencyCount * 99 + 99) / 100 };
+	int64_t percentiles[3] = { 0, 0, 0 };
+
+	if (state->latencyCount > 0) {
+		uint64_t cumulative = 0;
+		size_t found = 0;
+
+		for (size_t i = 0; (i < LATENCY_BUCKETS) && (found < 3); i++) {
+			cumulative += state->latencyHistogram[i];
+
+			while ((found < 3) && (cumulative >= targets[found])) {
+				// Bucket edges can overshoot the real maximum.
+				int64_t value = latencyBucketValue(i);
+				percentiles[found++] = (value < state->latencyMax) ? (value) : (state->latencyMax);
+			}
+		}
+	}
+
+	state->latencyP50 = percentiles[0];
+	state->latencyP99 = percentiles[2];
+
+	sshsNodeUpdateReadOnlyAttribute(state->latencyNode, "p50", SSHS_LONG,
+		(union sshs_node_attr_value) { .ilong = percentiles[0] });
+	sshsNodeUpdateReadOnlyAttribute(state->latencyNode, "p95", SSHS_LONG,
+		(union sshs_node_attr_value) { .ilong = percentiles[1] });
+	sshsNodeUpdateReadOnlyAttribute(state->latencyNode, "p99", SSHS_LONG,
+		(union sshs_node_attr_value) { .ilong = percentiles[2] });
+	sshsNodeUpdateReadOnlyAttribute(state->latencyNode, "max", SSHS_LONG,
+		(union sshs_node_attr_value) { .ilong = state->latencyMax });
+	sshsNodeUpdateReadOnlyAttribute(state->latencyNode, "packets", SSHS_LONG,
+		(union sshs_node_attr_value) { .ilong = I64T(state->latencyCount) });
+
+	// Reset for next update.
+	memset(state->latencyHistogram, 0, sizeof(state->latencyHistogram));
+	state->latencyCount = 0;
+	state->latencyMax = 0;
+	state->latencyLastTime = currentTime;
+}
+
+static void latencyReset(caerStatisticsModuleState state) {
+	memset(state->latencyHistogram, 0, sizeof(state->latencyHistogram));
+	state->latencyCount = 0;
+	state->latencyMax = 0;
+	state->latencyP50 = 0;
+	state->latencyP99 = 0;
 
-	caerStatisticsStringReset(state);
+	portable_clock_gettime_monotonic(&state->latencyLastTime);
 }
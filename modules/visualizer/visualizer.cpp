@@ -2,6 +2,7 @@
 #include "base/mainloop.h"
 #include "base/module.h"
 #include "ext/threads_ext.h"
+#include "ext/pathmax.h"
 #include "ext/resources/LiberationSans-Bold.h"
 #include "ext/sfml/helpers.hpp"
 #include "modules/statistics/statistics.h"
@@ -12,12 +13,16 @@
 
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
 
 #if defined(OS_LINUX) && OS_LINUX == 1
 #include <X11/Xlib.h>
 #endif
 
 #define VISUALIZER_REFRESH_RATE 60
+#define VISUALIZER_REFRESH_RATE_MAX 1000
 #define VISUALIZER_ZOOM_DEF  2.0f
 #define VISUALIZER_ZOOM_INC 0.25f
 #define VISUALIZER_ZOOM_MIN 0.50f
@@ -35,6 +40,8 @@
 #define GLOBAL_FONT_SIZE 20 // in pixels
 #define GLOBAL_FONT_SPACING 5 // in pixels
 
+#define VISUALIZER_FRAME_STATISTICS_STRING "FPS: %.1f (max %" PRIu32 "), dropped frames: %" PRIu64
+
 // Calculated at system init.
 static uint32_t STATISTICS_WIDTH = 0;
 static uint32_t STATISTICS_HEIGHT = 0;
@@ -48,13 +55,15 @@ struct caer_visualizer_state {
 	uint32_t renderSizeX;
 	uint32_t renderSizeY;
 	std::atomic<float> renderZoomFactor;
+	std::atomic<float> accumulationDecay;
 	void *renderState; // Reserved for renderers to put their internal state into.
 	sf::RenderWindow *renderWindow;
+	sf::RenderTarget *renderTarget;
 	sf::Font *font;
 	std::atomic_bool running;
 	std::atomic_bool windowResize;
 	std::atomic_bool windowMove;
-	caerRingBuffer dataTransfer;
+	std::atomic_bool renderStateReady;
 	std::thread *renderingThread;
 	caerVisualizerRendererInfo renderer;
 	caerVisualizerEventHandlerInfo eventHandler;
@@ -62,8 +71,36 @@ struct caer_visualizer_state {
 	struct caer_statistics_state packetStatistics;
 	std::atomic_uint_fast32_t packetSubsampleRendering;
 	uint32_t packetSubsampleCount;
+	std::atomic_uint_fast32_t maxFrameRate;
+	sshsNode statisticsNode;
+	// Frame statistics, only accessed by the rendering thread.
+	uint32_t framesDisplayed;
+	uint64_t framesDropped;
+	char frameStatisticsString[128];
+	// Headless mode: render offscreen and write frames to files on a separate thread.
+	bool headless;
+	bool outputVideo;
+	char *outputPath;
+	sf::RenderTexture *renderTexture;
+	caerRingBuffer outputTransfer;
+	std::atomic_bool outputRunning;
+	std::thread *outputThread;
+	// Wakes the output thread up for new frames or to exit.
+	std::mutex *outputLock;
+	std::condition_variable *outputWake;
+	uint64_t outputFrameNumber; // Rendering thread only.
+	sf::Image *outputLastFrame; // Rendering thread only.
+	FILE *outputVideoFile; // Output thread only.
+	sf::Vector2u outputVideoSize; // Output thread only.
+};
+
+struct visualizer_headless_frame {
+	uint64_t number;
+	sf::Image image;
 };
 
+typedef struct visualizer_headless_frame *visualizerHeadlessFrame;
+
 typedef struct caer_visualizer_state *caerVisualizerState;
 
 static void caerVisualizerConfigInit(sshsNode moduleNode);
@@ -78,11 +115,19 @@ static bool initRenderSize(caerModuleData moduleData, int16_t *inputs, size_t in
 static void initRenderersHandlers(caerModuleData moduleData);
 static bool initGraphics(caerModuleData moduleData);
 static void exitGraphics(caerModuleData moduleData);
+static void setGraphicsActive(caerVisualizerState state, bool active);
+static void displayGraphics(caerVisualizerState state);
+static bool initHeadlessOutput(caerModuleData moduleData);
+static void exitHeadlessOutput(caerModuleData moduleData);
+static void headlessOutputFrame(caerModuleData moduleData, bool newFrame);
+static void headlessWriteFrame(caerModuleData moduleData, visualizerHeadlessFrame frame);
+static int headlessOutputThread(void *inModuleData);
 static void updateDisplaySize(caerVisualizerState state);
 static void updateDisplayLocation(caerVisualizerState state);
 static void saveDisplayLocation(caerVisualizerState state);
 static void handleEvents(caerModuleData moduleData);
 static void renderScreen(caerModuleData moduleData);
+static void updateFrameStatistics(caerVisualizerState state, std::chrono::steady_clock::duration interval);
 static int renderThread(void *inModuleData);
 
 static const struct caer_module_functions VisualizerFunctions = { .moduleConfigInit = &caerVisualizerConfigInit,
@@ -110,6 +155,10 @@ static void caerVisualizerConfigInit(sshsNode moduleNode) {
 
 	sshsNodeCreateInt(moduleNode, "subsampleRendering", 1, 1, 100000, SSHS_FLAGS_NORMAL,
 		"Speed-up rendering by only taking every Nth EventPacketContainer to render.");
+	sshsNodeCreateFloat(moduleNode, "accumulationDecay", 0.0f, 0.0f, 1.0f, SSHS_FLAGS_NORMAL,
+		"Fraction of event intensity kept per displayed frame (0 shows only events since the last frame).");
+	sshsNodeCreateInt(moduleNode, "maxFrameRate", VISUALIZER_REFRESH_RATE, 1, VISUALIZER_REFRESH_RATE_MAX,
+		SSHS_FLAGS_NORMAL, "Maximum number of frames to display per second. Data in between is merged into one frame.");
 	sshsNodeCreateBool(moduleNode, "showStatistics", true, SSHS_FLAGS_NORMAL,
 		"Show useful statistics below content (bottom of window).");
 	sshsNodeCreateFloat(moduleNode, "zoomFactor", VISUALIZER_ZOOM_DEF, VISUALIZER_ZOOM_MIN,
@@ -118,6 +167,15 @@ static void caerVisualizerConfigInit(sshsNode moduleNode) {
 		"Position of window on screen (X coordinate).");
 	sshsNodeCreateInt(moduleNode, "windowPositionY", VISUALIZER_POSITION_Y_DEF, 0, UINT16_MAX, SSHS_FLAGS_NORMAL,
 		"Position of window on screen (Y coordinate).");
+
+	sshsNodeCreateBool(moduleNode, "headless", false, SSHS_FLAGS_NORMAL,
+		"Render offscreen without opening a window, and write the frames to headlessOutputPath.");
+	sshsNodeCreate(moduleNode, "headlessOutputFormat", "PNG", 3, 3, SSHS_FLAGS_NORMAL,
+		"Headless output format: one PNG image per new frame, or a Y4M video stream at maxFrameRate "
+		"(fixed at module start while recording).");
+	sshsNodeCreateAttributeListOptions(moduleNode, "headlessOutputFormat", SSHS_STRING, "PNG,Y4M", false);
+	sshsNodeCreate(moduleNode, "headlessOutputPath", "caer_visualizer", 1, PATH_MAX, SSHS_FLAGS_NORMAL,
+		"Headless output path prefix. PNG images get '-FRAMENUMBER.png' appended, video gets '.y4m'.");
 }
 
 static bool caerVisualizerInit(caerModuleData moduleData) {
@@ -150,6 +208,10 @@ static bool caerVisualizerInit(caerModuleData moduleData) {
 	free(inputs);
 
 	state->packetSubsampleRendering.store(U32T(sshsNodeGetInt(moduleData->moduleNode, "subsampleRendering")));
+	state->accumulationDecay.store(sshsNodeGetFloat(moduleData->moduleNode, "accumulationDecay"));
+	state->maxFrameRate.store(U32T(sshsNodeGetInt(moduleData->moduleNode, "maxFrameRate")));
+
+	state->headless = sshsNodeGetBool(moduleData->moduleNode, "headless");
 
 	// Enable packet statistics.
 	if (!caerStatisticsStringInit(&state->packetStatistics)) {
@@ -157,21 +219,11 @@ static bool caerVisualizerInit(caerModuleData moduleData) {
 		return (false);
 	}
 
-	// Initialize ring-buffer to transfer data to render thread.
-	state->dataTransfer = caerRingBufferInit(64);
-	if (state->dataTransfer == nullptr) {
-		caerStatisticsStringExit(&state->packetStatistics);
-
-		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to initialize transfer ring-buffer.");
-		return (false);
-	}
-
 #if VISUALIZER_HANDLE_EVENTS_MAIN == 1
 	// Initialize graphics on main thread.
 	// On OS X, creation (and destruction) of the window, as well as its event
 	// handling must happen on the main thread. Only drawing can be separate.
 	if (!initGraphics(moduleData)) {
-		caerRingBufferFree(state->dataTransfer);
 		caerStatisticsStringExit(&state->packetStatistics);
 
 		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to initialize rendering window.");
@@ -179,21 +231,50 @@ static bool caerVisualizerInit(caerModuleData moduleData) {
 	}
 
 	// Disable OpenGL context to pass it to thread.
-	state->renderWindow->setActive(false);
+	setGraphicsActive(state, false);
 #endif
 
+	// Rendering statistics, updated once per second by the rendering thread.
+	state->statisticsNode = sshsGetRelativeNode(moduleData->moduleNode, "statistics/");
+
+	sshsNodeCreateFloat(state->statisticsNode, "displayedFPS", 0, 0, VISUALIZER_REFRESH_RATE_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Frames displayed per second.");
+	sshsNodeCreateAttributePollTime(state->statisticsNode, "displayedFPS", SSHS_FLOAT, 1);
+	sshsNodeCreateLong(state->statisticsNode, "droppedFrames", 0, 0, INT64_MAX,
+		SSHS_FLAGS_READ_ONLY | SSHS_FLAGS_NO_EXPORT, "Frames not displayed or written in time.");
+	sshsNodeCreateAttributePollTime(state->statisticsNode, "droppedFrames", SSHS_LONG, 1);
+
+	snprintf(state->frameStatisticsString, 128, VISUALIZER_FRAME_STATISTICS_STRING, 0.0,
+		U32T(state->maxFrameRate.load()), U64T(0));
+
+	// Headless mode writes frames out on its own thread.
+	if (state->headless && !initHeadlessOutput(moduleData)) {
+#if VISUALIZER_HANDLE_EVENTS_MAIN == 1
+		exitGraphics(moduleData);
+#endif
+		sshsNodeClearSubTree(state->statisticsNode, true);
+		caerStatisticsStringExit(&state->packetStatistics);
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to initialize headless output.");
+		return (false);
+	}
+
 	// Start separate rendering thread. Decouples presentation from
-	// data processing and preparation. Communication over ring-buffer.
+	// data processing and preparation. Renderers accumulate data into
+	// their state on the mainloop thread and display it from there.
 	state->running.store(true);
 
 	try {
 		state->renderingThread = new std::thread(&renderThread, moduleData);
 	}
 	catch (const std::system_error &ex) {
+		if (state->headless) {
+			exitHeadlessOutput(moduleData);
+		}
 #if VISUALIZER_HANDLE_EVENTS_MAIN == 1
 		exitGraphics(moduleData);
 #endif
-		caerRingBufferFree(state->dataTransfer);
+		sshsNodeClearSubTree(state->statisticsNode, true);
 		caerStatisticsStringExit(&state->packetStatistics);
 
 		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to start rendering thread. Error: '%s' (%d).", ex.what(),
@@ -236,15 +317,13 @@ static void caerVisualizerExit(caerModuleData moduleData) {
 	exitGraphics(moduleData);
 #endif
 
-	// Now clean up the ring-buffer and its contents.
-	caerEventPacketContainer container;
-	while ((container = (caerEventPacketContainer) caerRingBufferGet(state->dataTransfer)) != nullptr) {
-		caerEventPacketContainerFree(container);
+	// Rendering is done, let the headless output finish writing all frames.
+	if (state->headless) {
+		exitHeadlessOutput(moduleData);
 	}
 
-	caerRingBufferFree(state->dataTransfer);
-
-	// Then the statistics string.
+	// Then the statistics.
+	sshsNodeClearSubTree(state->statisticsNode, true);
 	caerStatisticsStringExit(&state->packetStatistics);
 
 	caerModuleLog(moduleData, CAER_LOG_DEBUG, "Exited successfully.");
@@ -282,19 +361,14 @@ static void caerVisualizerRun(caerModuleData moduleData, caerEventPacketContaine
 		return;
 	}
 
-	if (caerRingBufferFull(state->dataTransfer)) {
-		caerModuleLog(moduleData, CAER_LOG_INFO, "Transfer ring-buffer full.");
-		return;
-	}
-
-	caerEventPacketContainer containerCopy = caerEventPacketContainerCopyAllEvents(in);
-	if (containerCopy == nullptr) {
-		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to copy event packet container for rendering.");
+	// Renderer state is created on the rendering thread, wait for it.
+	if (state->renderer->accumulate == nullptr || !state->renderStateReady.load(std::memory_order_acquire)) {
 		return;
 	}
 
-	// Will always succeed because of full check above.
-	caerRingBufferPut(state->dataTransfer, containerCopy);
+	// Let the renderer take what it needs from the container, so that all data
+	// between two displayed frames is shown, without copying whole containers.
+	(*state->renderer->accumulate)((caerVisualizerPublicState) state, in);
 }
 
 static void caerVisualizerReset(caerModuleData moduleData, int16_t resetCallSourceID) {
@@ -326,6 +400,15 @@ static void caerVisualizerConfigListener(sshsNode node, void *userData, enum ssh
 		else if (changeType == SSHS_INT && caerStrEquals(changeKey, "subsampleRendering")) {
 			state->packetSubsampleRendering.store(U32T(changeValue.iint));
 		}
+		else if (changeType == SSHS_FLOAT && caerStrEquals(changeKey, "accumulationDecay")) {
+			state->accumulationDecay.store(changeValue.ffloat);
+		}
+		else if (changeType == SSHS_INT && caerStrEquals(changeKey, "maxFrameRate")) {
+			// The Y4M header declares the frame rate for the whole stream, so it can't change while recording.
+			if (!(state->headless && state->outputVideo)) {
+				state->maxFrameRate.store(U32T(changeValue.iint));
+			}
+		}
 		else if (changeType == SSHS_INT && caerStrEquals(changeKey, "windowPositionX")) {
 			// Set move flag.
 			state->windowMove.store(true);
@@ -357,12 +440,23 @@ static void initSystemOnce(caerModuleData moduleData) {
 		return;
 	}
 
-	// Determine statistics string width.
+	// Same for frame statistics string.
+	size_t maxFrameStatStringLength = (size_t) snprintf(nullptr, 0, VISUALIZER_FRAME_STATISTICS_STRING,
+		(double) VISUALIZER_REFRESH_RATE_MAX, U32T(VISUALIZER_REFRESH_RATE_MAX), UINT64_MAX);
+
+	char maxFrameStatString[maxFrameStatStringLength + 1];
+	snprintf(maxFrameStatString, maxFrameStatStringLength + 1, VISUALIZER_FRAME_STATISTICS_STRING,
+		(double) VISUALIZER_REFRESH_RATE_MAX, U32T(VISUALIZER_REFRESH_RATE_MAX), UINT64_MAX);
+	maxFrameStatString[maxFrameStatStringLength] = '\0';
+
+	// Determine statistics string width, the widest line counts.
 	sf::Text maxStatText(maxStatString, font, GLOBAL_FONT_SIZE);
-	STATISTICS_WIDTH = (2 * GLOBAL_FONT_SPACING) + U32T(maxStatText.getLocalBounds().width);
+	sf::Text maxFrameStatText(maxFrameStatString, font, GLOBAL_FONT_SIZE);
+	STATISTICS_WIDTH = (2 * GLOBAL_FONT_SPACING)
+		+ U32T(std::max(maxStatText.getLocalBounds().width, maxFrameStatText.getLocalBounds().width));
 
-	// 3 lines of statistics.
-	STATISTICS_HEIGHT = (4 * GLOBAL_FONT_SPACING) + (3 * U32T(maxStatText.getLocalBounds().height));
+	// 4 lines of statistics.
+	STATISTICS_HEIGHT = (5 * GLOBAL_FONT_SPACING) + (4 * U32T(maxStatText.getLocalBounds().height));
 }
 
 static bool initRenderSize(caerModuleData moduleData, int16_t *inputs, size_t inputsSize) {
@@ -467,18 +561,36 @@ static bool initGraphics(caerModuleData moduleData) {
 		openGLSettings.attributeFlags = sf::ContextSettings::Default;
 	}
 
-	// Create display window and set its title.
-	state->renderWindow = new sf::RenderWindow(sf::VideoMode(state->renderSizeX, state->renderSizeY),
-		moduleData->moduleSubSystemString, sf::Style::Titlebar | sf::Style::Close, openGLSettings);
-	if (state->renderWindow == nullptr) {
-		caerModuleLog(moduleData, CAER_LOG_ERROR,
-			"Failed to create display window with sizeX=%" PRIu32 ", sizeY=%" PRIu32 ".", state->renderSizeX,
-			state->renderSizeY);
-		return (false);
+	if (state->headless) {
+		// Render into an offscreen texture instead of a window. This still needs an OpenGL
+		// context, but no visible display: on servers a virtual one (Xvfb) is enough.
+		state->renderTexture = new sf::RenderTexture();
+		if (state->renderTexture == nullptr || !state->renderTexture->create(state->renderSizeX, state->renderSizeY)) {
+			caerModuleLog(moduleData, CAER_LOG_ERROR,
+				"Failed to create offscreen render texture with sizeX=%" PRIu32 ", sizeY=%" PRIu32 ".",
+				state->renderSizeX, state->renderSizeY);
+
+			delete state->renderTexture;
+			return (false);
+		}
+
+		state->renderTarget = state->renderTexture;
+	}
+	else {
+		// Create display window and set its title.
+		state->renderWindow = new sf::RenderWindow(sf::VideoMode(state->renderSizeX, state->renderSizeY),
+			moduleData->moduleSubSystemString, sf::Style::Titlebar | sf::Style::Close, openGLSettings);
+		if (state->renderWindow == nullptr) {
+			caerModuleLog(moduleData, CAER_LOG_ERROR,
+				"Failed to create display window with sizeX=%" PRIu32 ", sizeY=%" PRIu32 ".", state->renderSizeX,
+				state->renderSizeY);
+			return (false);
+		}
+
+		state->renderTarget = state->renderWindow;
 	}
 
-	// Set frameRate limit to 60 FPS.
-	state->renderWindow->setFramerateLimit(60);
+	// No frameRate limit here, the rendering thread paces itself (see maxFrameRate).
 
 	// Default zoom factor for above window would be 1.
 	state->renderZoomFactor.store(1.0f);
@@ -511,14 +623,38 @@ static bool initGraphics(caerModuleData moduleData) {
 static void exitGraphics(caerModuleData moduleData) {
 	caerVisualizerState state = (caerVisualizerState) moduleData->moduleState;
 
-	// Save visualizer window location in config.
-	saveDisplayLocation(state);
+	if (state->headless) {
+		delete state->renderTexture;
+	}
+	else {
+		// Save visualizer window location in config.
+		saveDisplayLocation(state);
+
+		// Close rendering window and free memory.
+		state->renderWindow->close();
 
-	// Close rendering window and free memory.
-	state->renderWindow->close();
+		delete state->renderWindow;
+	}
 
 	delete state->font;
-	delete state->renderWindow;
+}
+
+static void setGraphicsActive(caerVisualizerState state, bool active) {
+	if (state->headless) {
+		state->renderTexture->setActive(active);
+	}
+	else {
+		state->renderWindow->setActive(active);
+	}
+}
+
+static void displayGraphics(caerVisualizerState state) {
+	if (state->headless) {
+		state->renderTexture->display();
+	}
+	else {
+		state->renderWindow->display();
+	}
 }
 
 static void updateDisplaySize(caerVisualizerState state) {
@@ -542,20 +678,31 @@ static void updateDisplaySize(caerVisualizerState state) {
 	}
 
 	// Set window size to zoomed area (only if value changed!).
-	sf::Vector2u oldSize = state->renderWindow->getSize();
+	sf::Vector2u oldSize = state->renderTarget->getSize();
 
 	if ((newRenderWindowSize.x != oldSize.x) || (newRenderWindowSize.y != oldSize.y)) {
-		state->renderWindow->setSize(newRenderWindowSize);
+		if (state->headless) {
+			// Offscreen textures can't be resized, only recreated.
+			state->renderTexture->create(newRenderWindowSize.x, newRenderWindowSize.y);
+		}
+		else {
+			state->renderWindow->setSize(newRenderWindowSize);
+		}
 
 		// Update zoom factor.
 		state->renderZoomFactor.store(zoomFactor);
 
 		// Set view size to render area.
-		state->renderWindow->setView(sf::View(sf::FloatRect(0, 0, newRenderWindowSize.x, newRenderWindowSize.y)));
+		state->renderTarget->setView(sf::View(sf::FloatRect(0, 0, newRenderWindowSize.x, newRenderWindowSize.y)));
 	}
 }
 
 static void updateDisplayLocation(caerVisualizerState state) {
+	// No window to move when headless.
+	if (state->headless) {
+		return;
+	}
+
 	// Set current position to what is in configuration storage.
 	const sf::Vector2i newPos(sshsNodeGetInt(state->visualizerConfigNode, "windowPositionX"),
 		sshsNodeGetInt(state->visualizerConfigNode, "windowPositionY"));
@@ -574,6 +721,11 @@ static void saveDisplayLocation(caerVisualizerState state) {
 static void handleEvents(caerModuleData moduleData) {
 	caerVisualizerState state = (caerVisualizerState) moduleData->moduleState;
 
+	// No window to get events from when headless.
+	if (state->headless) {
+		return;
+	}
+
 	sf::Event event;
 
 	while (state->renderWindow->pollEvent(event)) {
@@ -712,32 +864,13 @@ static void renderScreen(caerModuleData moduleData) {
 		updateDisplayLocation(state);
 	}
 
-	// TODO: rethink this, implement max FPS control, FPS count,
-	// and multiple render passes per displayed frame.
-	caerEventPacketContainer container = (caerEventPacketContainer) caerRingBufferGet(state->dataTransfer);
-
-	repeat: if (container != nullptr) {
-		// Are there others? Only render last one, to avoid getting backed up!
-		caerEventPacketContainer container2 = (caerEventPacketContainer) caerRingBufferGet(state->dataTransfer);
-
-		if (container2 != nullptr) {
-			caerEventPacketContainerFree(container);
-			container = container2;
-			goto repeat;
-		}
-	}
-
 	bool drewSomething = false;
 
-	if (container != nullptr) {
-		// Update render window with new content. (0, 0) is upper left corner.
-		// NULL renderer is supported and simply does nothing (black screen).
-		if (state->renderer->renderer != nullptr) {
-			drewSomething = (*state->renderer->renderer)((caerVisualizerPublicState) state, container);
-		}
-
-		// Free packet container copy.
-		caerEventPacketContainerFree(container);
+	// Update render window with everything accumulated since the last pass, so that all
+	// data arriving between two displayed frames is merged. (0, 0) is upper left corner.
+	// NULL renderer is supported and simply does nothing (black screen).
+	if (state->renderer->renderer != nullptr) {
+		drewSomething = (*state->renderer->renderer)((caerVisualizerPublicState) state);
 	}
 
 	// Render content to display.
@@ -755,31 +888,66 @@ static void renderScreen(caerModuleData moduleData) {
 			sfml::Helpers::setTextColor(totalEventsText, sf::Color::White);
 			totalEventsText.setPosition(GLOBAL_FONT_SPACING,
 				state->renderSizeY * state->renderZoomFactor.load(std::memory_order_relaxed));
-			state->renderWindow->draw(totalEventsText);
+			state->renderTarget->draw(totalEventsText);
 
 			sf::Text validEventsText(state->packetStatistics.currentStatisticsStringValid, *state->font,
 			GLOBAL_FONT_SIZE);
 			sfml::Helpers::setTextColor(validEventsText, sf::Color::White);
 			validEventsText.setPosition(GLOBAL_FONT_SPACING,
 				(state->renderSizeY * state->renderZoomFactor.load(std::memory_order_relaxed)) + GLOBAL_FONT_SIZE);
-			state->renderWindow->draw(validEventsText);
+			state->renderTarget->draw(validEventsText);
 
 			sf::Text GapEventsText(state->packetStatistics.currentStatisticsStringGap, *state->font,
 			GLOBAL_FONT_SIZE);
 			sfml::Helpers::setTextColor(GapEventsText, sf::Color::White);
 			GapEventsText.setPosition(GLOBAL_FONT_SPACING,
 				(state->renderSizeY * state->renderZoomFactor.load(std::memory_order_relaxed)) + (2 * GLOBAL_FONT_SIZE));
-			state->renderWindow->draw(GapEventsText);
+			state->renderTarget->draw(GapEventsText);
+
+			sf::Text frameStatisticsText(state->frameStatisticsString, *state->font, GLOBAL_FONT_SIZE);
+			sfml::Helpers::setTextColor(frameStatisticsText, sf::Color::White);
+			frameStatisticsText.setPosition(GLOBAL_FONT_SPACING,
+				(state->renderSizeY * state->renderZoomFactor.load(std::memory_order_relaxed))
+					+ (3 * GLOBAL_FONT_SIZE));
+			state->renderTarget->draw(frameStatisticsText);
 		}
 
 		// Draw to screen.
-		state->renderWindow->display();
+		displayGraphics(state);
+
+		state->framesDisplayed++;
+
+		// Keep a copy of what was displayed for headless output.
+		if (state->headless) {
+			*state->outputLastFrame = state->renderTexture->getTexture().copyToImage();
+		}
 
 		// Reset window to all black for next rendering pass.
-		state->renderWindow->clear(sf::Color::Black);
+		state->renderTarget->clear(sf::Color::Black);
+	}
+
+	if (state->headless) {
+		headlessOutputFrame(moduleData, drewSomething);
 	}
 }
 
+static void updateFrameStatistics(caerVisualizerState state, std::chrono::steady_clock::duration interval) {
+	float displayedFPS = (float) state->framesDisplayed
+		/ std::chrono::duration_cast<std::chrono::duration<float>>(interval).count();
+	state->framesDisplayed = 0;
+
+	snprintf(state->frameStatisticsString, 128, VISUALIZER_FRAME_STATISTICS_STRING, (double) displayedFPS,
+		U32T(state->maxFrameRate.load(std::memory_order_relaxed)), state->framesDropped);
+
+	union sshs_node_attr_value value;
+
+	value.ffloat = displayedFPS;
+	sshsNodeUpdateReadOnlyAttribute(state->statisticsNode, "displayedFPS", SSHS_FLOAT, value);
+
+	value.ilong = I64T(state->framesDropped);
+	sshsNodeUpdateReadOnlyAttribute(state->statisticsNode, "droppedFrames", SSHS_LONG, value);
+}
+
 static int renderThread(void *inModuleData) {
 	if (inModuleData == nullptr) {
 		return (thrd_error);
@@ -801,7 +969,7 @@ static int renderThread(void *inModuleData) {
 
 	// Ensure OpenGL context is active, whether it was created in this thread
 	// or on the main thread.
-	state->renderWindow->setActive(true);
+	setGraphicsActive(state, true);
 
 	// Initialize GLEW. glewInit() should be called after every context change,
 	// since we have one context per visualizer, always active only in this one
@@ -830,9 +998,15 @@ static int renderThread(void *inModuleData) {
 		}
 	}
 
+	// Renderer state is ready, mainloop thread can now accumulate data into it.
+	state->renderStateReady.store(true, std::memory_order_release);
+
 	// Initialize window by clearing it to all black.
-	state->renderWindow->clear(sf::Color::Black);
-	state->renderWindow->display();
+	state->renderTarget->clear(sf::Color::Black);
+	displayGraphics(state);
+
+	std::chrono::steady_clock::time_point nextFrameTime = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point statisticsTime = nextFrameTime;
 
 	while (state->running.load(std::memory_order_relaxed)) {
 #if VISUALIZER_HANDLE_EVENTS_MAIN == 0
@@ -840,9 +1014,48 @@ static int renderThread(void *inModuleData) {
 #endif
 
 		renderScreen(moduleData);
+
+		// Pace rendering to at most maxFrameRate passes per second, sleeping in between
+		// instead of spinning. Renderers accumulate everything that arrives meanwhile.
+		const std::chrono::steady_clock::duration framePeriod = std::chrono::duration_cast<
+			std::chrono::steady_clock::duration>(
+			std::chrono::nanoseconds(1000000000LL / state->maxFrameRate.load(std::memory_order_relaxed)));
+
+		nextFrameTime += framePeriod;
+
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+		if (now < nextFrameTime) {
+			std::this_thread::sleep_until(nextFrameTime);
+		}
+		else {
+			// Too slow: count the frame slots we missed entirely, then resynchronize
+			// to now, so we don't try to catch up with a burst of frames.
+			uint64_t missedFrames = U64T((now - nextFrameTime) / framePeriod);
+
+			if (state->headless && state->outputVideo) {
+				// Video must keep its constant frame rate: fill the missed slots by repeating
+				// the last frame. Only counted as dropped if even that can't keep up.
+				for (uint64_t i = 0; i < missedFrames; i++) {
+					headlessOutputFrame(moduleData, false);
+				}
+			}
+			else {
+				state->framesDropped += missedFrames;
+			}
+
+			nextFrameTime = now;
+		}
+
+		if ((now - statisticsTime) >= std::chrono::seconds(1)) {
+			updateFrameStatistics(state, now - statisticsTime);
+			statisticsTime = now;
+		}
 	}
 
-	// Destroy render state, if it exists.
+	// Destroy render state, if it exists. Module exit already stopped accumulation.
+	state->renderStateReady.store(false);
+
 	if ((state->renderer->stateExit != nullptr) && (state->renderState != nullptr)
 		&& (state->renderState != CAER_VISUALIZER_RENDER_INIT_NO_MEM)) {
 		(*state->renderer->stateExit)((caerVisualizerPublicState) state);
@@ -856,6 +1069,234 @@ static int renderThread(void *inModuleData) {
 	return (thrd_success);
 }
 
+static bool initHeadlessOutput(caerModuleData moduleData) {
+	caerVisualizerState state = (caerVisualizerState) moduleData->moduleState;
+
+	state->outputVideo = (sshsNodeGetStdString(moduleData->moduleNode, "headlessOutputFormat") == "Y4M");
+	state->outputPath = sshsNodeGetString(moduleData->moduleNode, "headlessOutputPath");
+	state->outputFrameNumber = 0;
+	state->outputVideoFile = nullptr;
+	state->outputVideoSize = sf::Vector2u(0, 0);
+
+	// Last displayed frame, repeated for video output when nothing new comes in.
+	state->outputLastFrame = new sf::Image();
+
+	// Initialize ring-buffer to transfer frames to output thread.
+	state->outputTransfer = caerRingBufferInit(16);
+	if (state->outputTransfer == nullptr) {
+		delete state->outputLastFrame;
+		free(state->outputPath);
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to initialize output ring-buffer.");
+		return (false);
+	}
+
+	state->outputLock = new std::mutex();
+	state->outputWake = new std::condition_variable();
+
+	// Encoding and writing files is slow, keep it off the rendering thread.
+	state->outputRunning.store(true);
+
+	try {
+		state->outputThread = new std::thread(&headlessOutputThread, moduleData);
+	}
+	catch (const std::system_error &ex) {
+		delete state->outputWake;
+		delete state->outputLock;
+		caerRingBufferFree(state->outputTransfer);
+		delete state->outputLastFrame;
+		free(state->outputPath);
+
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to start output thread. Error: '%s' (%d).", ex.what(),
+			ex.code().value());
+		return (false);
+	}
+
+	return (true);
+}
+
+static void exitHeadlessOutput(caerModuleData moduleData) {
+	caerVisualizerState state = (caerVisualizerState) moduleData->moduleState;
+
+	// Output thread writes out all remaining frames before exiting.
+	{
+		std::lock_guard<std::mutex> lock(*state->outputLock);
+		state->outputRunning.store(false);
+	}
+
+	state->outputWake->notify_one();
+
+	try {
+		state->outputThread->join();
+	}
+	catch (const std::system_error &ex) {
+		// This should never happen!
+		caerModuleLog(moduleData, CAER_LOG_CRITICAL, "Failed to join output thread. Error: '%s' (%d).", ex.what(),
+			ex.code().value());
+	}
+
+	delete state->outputThread;
+	delete state->outputWake;
+	delete state->outputLock;
+
+	visualizerHeadlessFrame frame;
+	while ((frame = (visualizerHeadlessFrame) caerRingBufferGet(state->outputTransfer)) != nullptr) {
+		delete frame;
+	}
+
+	caerRingBufferFree(state->outputTransfer);
+
+	delete state->outputLastFrame;
+	free(state->outputPath);
+}
+
+// Called once per frame slot (rendering pass or missed slot), so at a fixed rate of maxFrameRate.
+static void headlessOutputFrame(caerModuleData moduleData, bool newFrame) {
+	caerVisualizerState state = (caerVisualizerState) moduleData->moduleState;
+
+	uint64_t frameNumber = state->outputFrameNumber++;
+
+	// Nothing displayed yet.
+	if (state->outputLastFrame->getSize().x == 0) {
+		return;
+	}
+
+	// Images are only written when there is something new, frame numbers keep the timing.
+	// Video needs a constant frame rate, so the last frame is repeated.
+	if (!newFrame && !state->outputVideo) {
+		return;
+	}
+
+	if (caerRingBufferFull(state->outputTransfer)) {
+		// Output can't keep up, drop frame.
+		state->framesDropped++;
+		return;
+	}
+
+	visualizerHeadlessFrame frame = new visualizer_headless_frame();
+	frame->number = frameNumber;
+	frame->image = *state->outputLastFrame;
+
+	// Will always succeed because of full check above.
+	caerRingBufferPut(state->outputTransfer, frame);
+
+	// Taking the lock ensures the output thread either sees the frame or gets woken up.
+	{
+		std::lock_guard<std::mutex> lock(*state->outputLock);
+	}
+
+	state->outputWake->notify_one();
+}
+
+static void headlessWriteFrame(caerModuleData moduleData, visualizerHeadlessFrame frame) {
+	caerVisualizerState state = (caerVisualizerState) moduleData->moduleState;
+
+	if (!state->outputVideo) {
+		size_t fileNameLength = (size_t) snprintf(nullptr, 0, "%s-%08" PRIu64 ".png", state->outputPath,
+			frame->number);
+
+		char fileName[fileNameLength + 1];
+		snprintf(fileName, fileNameLength + 1, "%s-%08" PRIu64 ".png", state->outputPath, frame->number);
+		fileName[fileNameLength] = '\0';
+
+		if (!frame->image.saveToFile(fileName)) {
+			caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to write image '%s'.", fileName);
+		}
+
+		return;
+	}
+
+	const sf::Vector2u size = frame->image.getSize();
+
+	if (state->outputVideoFile == nullptr) {
+		size_t fileNameLength = (size_t) snprintf(nullptr, 0, "%s.y4m", state->outputPath);
+
+		char fileName[fileNameLength + 1];
+		snprintf(fileName, fileNameLength + 1, "%s.y4m", state->outputPath);
+		fileName[fileNameLength] = '\0';
+
+		state->outputVideoFile = fopen(fileName, "wb");
+		if (state->outputVideoFile == nullptr) {
+			caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to open video file '%s'. Error: %d.", fileName, errno);
+			return;
+		}
+
+		// Size and frame rate are fixed for the whole stream.
+		state->outputVideoSize = size;
+
+		fprintf(state->outputVideoFile, "YUV4MPEG2 W%" PRIu32 " H%" PRIu32 " F%" PRIu32 ":1 Ip A1:1 C444\n",
+			U32T(size.x), U32T(size.y), U32T(state->maxFrameRate.load(std::memory_order_relaxed)));
+	}
+
+	if (size != state->outputVideoSize) {
+		caerModuleLog(moduleData, CAER_LOG_WARNING,
+			"Frame size changed to %" PRIu32 "x%" PRIu32 ", video stream is fixed at %" PRIu32 "x%" PRIu32
+			", skipping.", U32T(size.x), U32T(size.y), U32T(state->outputVideoSize.x), U32T(state->outputVideoSize.y));
+		return;
+	}
+
+	// Convert RGBA to planar 4:4:4 YCbCr (BT.601, studio range), as Y4M expects.
+	size_t planeSize = (size_t) size.x * size.y;
+	std::vector<uint8_t> planes(planeSize * 3);
+	const uint8_t *pixels = frame->image.getPixelsPtr();
+
+	for (size_t i = 0; i < planeSize; i++) {
+		int32_t r = pixels[(i * 4)];
+		int32_t g = pixels[(i * 4) + 1];
+		int32_t b = pixels[(i * 4) + 2];
+
+		planes[i] = U8T(16 + ((66 * r + 129 * g + 25 * b + 128) >> 8));
+		planes[planeSize + i] = U8T(128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+		planes[(2 * planeSize) + i] = U8T(128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+	}
+
+	fputs("FRAME\n", state->outputVideoFile);
+	if (fwrite(planes.data(), 1, planes.size(), state->outputVideoFile) != planes.size()) {
+		caerModuleLog(moduleData, CAER_LOG_ERROR, "Failed to write video frame %" PRIu64 ".", frame->number);
+	}
+}
+
+static int headlessOutputThread(void *inModuleData) {
+	if (inModuleData == nullptr) {
+		return (thrd_error);
+	}
+
+	caerModuleData moduleData = (caerModuleData) inModuleData;
+	caerVisualizerState state = (caerVisualizerState) moduleData->moduleState;
+
+	// Set thread name.
+	thrd_set_name(moduleData->moduleSubSystemString);
+
+	while (true) {
+		visualizerHeadlessFrame frame = (visualizerHeadlessFrame) caerRingBufferGet(state->outputTransfer);
+
+		if (frame == nullptr) {
+			std::unique_lock<std::mutex> lock(*state->outputLock);
+
+			state->outputWake->wait(lock, [state, &frame]() {
+				frame = (visualizerHeadlessFrame) caerRingBufferGet(state->outputTransfer);
+				return (frame != nullptr || !state->outputRunning.load(std::memory_order_relaxed));
+			});
+
+			// Rendering thread is already stopped on exit, so once empty we're done.
+			if (frame == nullptr) {
+				break;
+			}
+		}
+
+		headlessWriteFrame(moduleData, frame);
+
+		delete frame;
+	}
+
+	if (state->outputVideoFile != nullptr) {
+		fclose(state->outputVideoFile);
+		state->outputVideoFile = nullptr;
+	}
+
+	return (thrd_success);
+}
+
 void caerVisualizerResetRenderSize(caerVisualizerPublicState pubState, uint32_t newX, uint32_t newY) {
 	caerVisualizerState state = (caerVisualizerState) pubState;
 
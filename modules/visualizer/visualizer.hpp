@@ -15,8 +15,10 @@ struct caer_visualizer_public_state {
 	uint32_t renderSizeX;
 	uint32_t renderSizeY;
 	std::atomic<float> renderZoomFactor;
+	std::atomic<float> accumulationDecay;
 	void *renderState; // Reserved for renderers to put their internal state into.
-	sf::RenderWindow *renderWindow;
+	sf::RenderWindow *renderWindow; // nullptr when headless.
+	sf::RenderTarget *renderTarget; // Renderers draw here: the window, or an offscreen texture when headless.
 	sf::Font *font;
 };
 
@@ -13,84 +13,286 @@
 #include <libcaercpp/devices/davis.hpp> // Only for constants.
 #include <libcaercpp/devices/dynapse.hpp> // Only for constants.
 
+#include <algorithm>
+#include <mutex>
+
 static void *caerVisualizerRendererPolarityEventsStateInit(caerVisualizerPublicState state);
-static bool caerVisualizerRendererPolarityEvents(caerVisualizerPublicState state, caerEventPacketContainer container);
+static void caerVisualizerRendererPolarityEventsStateExit(caerVisualizerPublicState state);
+static void caerVisualizerRendererPolarityEventsAccumulate(caerVisualizerPublicState state,
+	caerEventPacketContainer container);
+static bool caerVisualizerRendererPolarityEvents(caerVisualizerPublicState state);
 static const struct caer_visualizer_renderer_info rendererPolarityEvents("Polarity",
-	&caerVisualizerRendererPolarityEvents, false, &caerVisualizerRendererPolarityEventsStateInit, nullptr);
+	&caerVisualizerRendererPolarityEventsAccumulate, &caerVisualizerRendererPolarityEvents, false,
+	&caerVisualizerRendererPolarityEventsStateInit, &caerVisualizerRendererPolarityEventsStateExit);
 
 static void *caerVisualizerRendererFrameEventsStateInit(caerVisualizerPublicState state);
 static void caerVisualizerRendererFrameEventsStateExit(caerVisualizerPublicState state);
-static bool caerVisualizerRendererFrameEvents(caerVisualizerPublicState state, caerEventPacketContainer container);
-static const struct caer_visualizer_renderer_info rendererFrameEvents("Frame", &caerVisualizerRendererFrameEvents,
-	false, &caerVisualizerRendererFrameEventsStateInit, &caerVisualizerRendererFrameEventsStateExit);
-
-static bool caerVisualizerRendererIMU6Events(caerVisualizerPublicState state, caerEventPacketContainer container);
-static const struct caer_visualizer_renderer_info rendererIMU6Events("IMU_6-axes", &caerVisualizerRendererIMU6Events);
-
-static bool caerVisualizerRendererPoint2DEvents(caerVisualizerPublicState state, caerEventPacketContainer container);
+static void caerVisualizerRendererFrameEventsAccumulate(caerVisualizerPublicState state,
+	caerEventPacketContainer container);
+static bool caerVisualizerRendererFrameEvents(caerVisualizerPublicState state);
+static const struct caer_visualizer_renderer_info rendererFrameEvents("Frame",
+	&caerVisualizerRendererFrameEventsAccumulate, &caerVisualizerRendererFrameEvents, false,
+	&caerVisualizerRendererFrameEventsStateInit, &caerVisualizerRendererFrameEventsStateExit);
+
+static void *caerVisualizerRendererIMU6EventsStateInit(caerVisualizerPublicState state);
+static void caerVisualizerRendererIMU6EventsStateExit(caerVisualizerPublicState state);
+static void caerVisualizerRendererIMU6EventsAccumulate(caerVisualizerPublicState state,
+	caerEventPacketContainer container);
+static bool caerVisualizerRendererIMU6Events(caerVisualizerPublicState state);
+static const struct caer_visualizer_renderer_info rendererIMU6Events("IMU_6-axes",
+	&caerVisualizerRendererIMU6EventsAccumulate, &caerVisualizerRendererIMU6Events, false,
+	&caerVisualizerRendererIMU6EventsStateInit, &caerVisualizerRendererIMU6EventsStateExit);
+
+static void *caerVisualizerRendererPoint2DEventsStateInit(caerVisualizerPublicState state);
+static void caerVisualizerRendererPoint2DEventsStateExit(caerVisualizerPublicState state);
+static void caerVisualizerRendererPoint2DEventsAccumulate(caerVisualizerPublicState state,
+	caerEventPacketContainer container);
+static bool caerVisualizerRendererPoint2DEvents(caerVisualizerPublicState state);
 static const struct caer_visualizer_renderer_info rendererPoint2DEvents("2D_Points",
-	&caerVisualizerRendererPoint2DEvents);
+	&caerVisualizerRendererPoint2DEventsAccumulate, &caerVisualizerRendererPoint2DEvents, false,
+	&caerVisualizerRendererPoint2DEventsStateInit, &caerVisualizerRendererPoint2DEventsStateExit);
 
-static bool caerVisualizerRendererSpikeEvents(caerVisualizerPublicState state, caerEventPacketContainer container);
-static const struct caer_visualizer_renderer_info rendererSpikeEvents("Spikes", &caerVisualizerRendererSpikeEvents);
+static void *caerVisualizerRendererSpikeEventsStateInit(caerVisualizerPublicState state);
+static void caerVisualizerRendererSpikeEventsStateExit(caerVisualizerPublicState state);
+static void caerVisualizerRendererSpikeEventsAccumulate(caerVisualizerPublicState state,
+	caerEventPacketContainer container);
+static bool caerVisualizerRendererSpikeEvents(caerVisualizerPublicState state);
+static const struct caer_visualizer_renderer_info rendererSpikeEvents("Spikes",
+	&caerVisualizerRendererSpikeEventsAccumulate, &caerVisualizerRendererSpikeEvents, false,
+	&caerVisualizerRendererSpikeEventsStateInit, &caerVisualizerRendererSpikeEventsStateExit);
 
 static void *caerVisualizerRendererMatrix4x4EventsPoseStateInit(caerVisualizerPublicState state);
 static void caerVisualizerRendererMatrix4x4EventsPoseStateExit(caerVisualizerPublicState state);
-static bool caerVisualizerRendererMatrix4x4EventsPose(caerVisualizerPublicState state,
+static void caerVisualizerRendererMatrix4x4EventsPoseAccumulate(caerVisualizerPublicState state,
 	caerEventPacketContainer container);
+static bool caerVisualizerRendererMatrix4x4EventsPose(caerVisualizerPublicState state);
 static const struct caer_visualizer_renderer_info rendererMatrix4x4EventsPose("Camera_pose",
-	&caerVisualizerRendererMatrix4x4EventsPose, false, &caerVisualizerRendererMatrix4x4EventsPoseStateInit,
-	&caerVisualizerRendererMatrix4x4EventsPoseStateExit);
+	&caerVisualizerRendererMatrix4x4EventsPoseAccumulate, &caerVisualizerRendererMatrix4x4EventsPose, false,
+	&caerVisualizerRendererMatrix4x4EventsPoseStateInit, &caerVisualizerRendererMatrix4x4EventsPoseStateExit);
 
 static void *caerVisualizerRendererSpikeEventsRasterStateInit(caerVisualizerPublicState state);
-static bool caerVisualizerRendererSpikeEventsRaster(caerVisualizerPublicState state,
+static void caerVisualizerRendererSpikeEventsRasterStateExit(caerVisualizerPublicState state);
+static void caerVisualizerRendererSpikeEventsRasterAccumulate(caerVisualizerPublicState state,
 	caerEventPacketContainer container);
+static bool caerVisualizerRendererSpikeEventsRaster(caerVisualizerPublicState state);
 static const struct caer_visualizer_renderer_info rendererSpikeEventsRaster("Spikes_Raster_Plot",
-	&caerVisualizerRendererSpikeEventsRaster, false, &caerVisualizerRendererSpikeEventsRasterStateInit, nullptr);
+	&caerVisualizerRendererSpikeEventsRasterAccumulate, &caerVisualizerRendererSpikeEventsRaster, false,
+	&caerVisualizerRendererSpikeEventsRasterStateInit, &caerVisualizerRendererSpikeEventsRasterStateExit);
 
 static void *caerVisualizerRendererPolarityAndFrameEventsStateInit(caerVisualizerPublicState state);
 static void caerVisualizerRendererPolarityAndFrameEventsStateExit(caerVisualizerPublicState state);
-static bool caerVisualizerRendererPolarityAndFrameEvents(caerVisualizerPublicState state,
+static void caerVisualizerRendererPolarityAndFrameEventsAccumulate(caerVisualizerPublicState state,
 	caerEventPacketContainer container);
+static bool caerVisualizerRendererPolarityAndFrameEvents(caerVisualizerPublicState state);
 static const struct caer_visualizer_renderer_info rendererPolarityAndFrameEvents("Polarity_and_Frames",
-	&caerVisualizerRendererPolarityAndFrameEvents, false, &caerVisualizerRendererPolarityAndFrameEventsStateInit,
-	&caerVisualizerRendererPolarityAndFrameEventsStateExit);
+	&caerVisualizerRendererPolarityAndFrameEventsAccumulate, &caerVisualizerRendererPolarityAndFrameEvents, false,
+	&caerVisualizerRendererPolarityAndFrameEventsStateInit, &caerVisualizerRendererPolarityAndFrameEventsStateExit);
 
 const std::string caerVisualizerRendererListOptionsString =
 	"Polarity,Frame,IMU_6-axes,2D_Points,Spikes,Spikes_Raster_Plot,Polarity_and_Frames,Camera_pose";
 
-const struct caer_visualizer_renderer_info caerVisualizerRendererList[] = { { "None", nullptr }, rendererPolarityEvents,
-	rendererFrameEvents, rendererIMU6Events, rendererPoint2DEvents, rendererSpikeEvents, rendererSpikeEventsRaster,
-	rendererPolarityAndFrameEvents, rendererMatrix4x4EventsPose };
+const struct caer_visualizer_renderer_info caerVisualizerRendererList[] = { { "None", nullptr, nullptr },
+	rendererPolarityEvents, rendererFrameEvents, rendererIMU6Events, rendererPoint2DEvents, rendererSpikeEvents,
+	rendererSpikeEventsRaster, rendererPolarityAndFrameEvents, rendererMatrix4x4EventsPose };
 
 const size_t caerVisualizerRendererListLength = (sizeof(caerVisualizerRendererList)
 	/ sizeof(struct caer_visualizer_renderer_info));
 
-static void *caerVisualizerRendererPolarityEventsStateInit(caerVisualizerPublicState state) {
+// Pixel buffers for event renderers. Events are painted into the accumulated buffer on the
+// mainloop thread as they arrive. Once per displayed frame, the rendering thread swaps it for
+// an empty one, merges the new pixels into the persistent displayed buffer and uploads that
+// to a texture, which the GPU then scales to the zoomed window size.
+struct renderer_pixel_accumulation {
+	std::mutex lock;
+	uint32_t sizeX;
+	uint32_t sizeY;
+	bool updated; // Protected by lock.
+	bool cleared; // Protected by lock.
+	std::vector<uint8_t> accumulated; // Protected by lock. Alpha 0 where no pixel was set.
+	std::vector<uint8_t> taken; // Rendering thread only. All zero while not being merged.
+	std::vector<uint8_t> displayed; // Rendering thread only.
+	bool fading; // Rendering thread only.
+	sf::Texture texture; // Rendering thread only.
+	sf::Sprite sprite; // Rendering thread only.
+};
+
+typedef struct renderer_pixel_accumulation *rendererPixelAccumulation;
+
+static void pixelAccumulationInit(rendererPixelAccumulation accumulation, uint32_t sizeX, uint32_t sizeY) {
+	accumulation->sizeX = sizeX;
+	accumulation->sizeY = sizeY;
+	accumulation->updated = false;
+	accumulation->cleared = false;
+	accumulation->fading = false;
+
+	// 32-bit RGBA pixels (8-bit per channel), standard CG layout.
+	accumulation->accumulated.assign((size_t) sizeX * sizeY * 4, 0);
+	accumulation->taken.assign((size_t) sizeX * sizeY * 4, 0);
+	accumulation->displayed.assign((size_t) sizeX * sizeY * 4, 0);
+
+	// Create texture representing accumulated events, no smoothing to keep pixels sharp when zoomed.
+	accumulation->texture.create(sizeX, sizeY);
+	accumulation->texture.setSmooth(false);
+
+	// Assign texture to sprite.
+	accumulation->sprite.setTexture(accumulation->texture, true);
+}
+
+// Must be called with the accumulation lock held.
+static inline void pixelAccumulationSet(rendererPixelAccumulation accumulation, uint32_t x, uint32_t y,
+	const sf::Color &color) {
+	if (x >= accumulation->sizeX || y >= accumulation->sizeY) {
+		return;
+	}
+
+	size_t idx = ((size_t) y * accumulation->sizeX + x) * 4;
+
+	accumulation->accumulated[idx] = color.r;
+	accumulation->accumulated[idx + 1] = color.g;
+	accumulation->accumulated[idx + 2] = color.b;
+	accumulation->accumulated[idx + 3] = color.a;
+}
+
+// Must be called with the accumulation lock held.
+static inline void pixelAccumulationClear(rendererPixelAccumulation accumulation) {
+	std::fill(accumulation->accumulated.begin(), accumulation->accumulated.end(), 0);
+	accumulation->updated = true;
+	accumulation->cleared = true;
+}
+
+/**
+ * Fade the displayed pixels, then paint the ones accumulated since the last frame over
+ * them: decay is the fraction of intensity kept per displayed frame, 0 shows only what
+ * arrived since the last frame, 1 keeps everything until the renderer clears it.
+ * Only swapping the buffers needs the lock, the mainloop keeps accumulating meanwhile.
+ * Returns false if there is nothing new to display.
+ */
+static bool pixelAccumulationTake(rendererPixelAccumulation accumulation, float decay) {
+	bool updated;
+	bool cleared;
+
+	{
+		std::lock_guard<std::mutex> lock(accumulation->lock);
+
+		updated = accumulation->updated;
+		cleared = accumulation->cleared;
+
+		if (updated) {
+			accumulation->accumulated.swap(accumulation->taken);
+			accumulation->updated = false;
+			accumulation->cleared = false;
+		}
+	}
+
+	if (!updated && !accumulation->fading) {
+		return (false);
+	}
+
+	if (cleared || decay <= 0.0f) {
+		std::fill(accumulation->displayed.begin(), accumulation->displayed.end(), 0);
+		accumulation->fading = false;
+	}
+	else if (decay < 1.0f) {
+		// 8.8 fixed point, so the loop vectorizes. Always strictly decreasing, so pixels reach zero.
+		uint16_t scale = U16T(decay * 256.0f);
+		uint8_t remaining = 0;
+
+		for (auto &value : accumulation->displayed) {
+			value = U8T((value * scale) >> 8);
+			remaining |= value;
+		}
+
+		// Keep refreshing the display until everything has faded out.
+		accumulation->fading = (remaining != 0) || updated;
+	}
+	else {
+		accumulation->fading = false;
+	}
+
+	if (updated) {
+		uint8_t *displayed = accumulation->displayed.data();
+		const uint8_t *taken = accumulation->taken.data();
+
+		for (size_t idx = 0; idx < accumulation->taken.size(); idx += 4) {
+			if (taken[idx + 3] != 0) {
+				std::copy(&taken[idx], &taken[idx + 4], &displayed[idx]);
+			}
+		}
+
+		// Hand it back empty with the next swap.
+		std::fill(accumulation->taken.begin(), accumulation->taken.end(), 0);
+	}
+
+	return (true);
+}
+
+// Independent of the number of events: one texture upload and one textured quad.
+static void pixelAccumulationDraw(caerVisualizerPublicState state, rendererPixelAccumulation accumulation) {
+	float zoomFactor = state->renderZoomFactor.load(std::memory_order_relaxed);
+
+	accumulation->texture.update(accumulation->displayed.data());
+
+	accumulation->sprite.setScale(zoomFactor, zoomFactor);
+
+	state->renderTarget->draw(accumulation->sprite);
+}
+
+static bool pixelAccumulationRender(caerVisualizerPublicState state, rendererPixelAccumulation accumulation) {
+	if (!pixelAccumulationTake(accumulation, state->accumulationDecay.load(std::memory_order_relaxed))) {
+		return (false);
+	}
+
+	pixelAccumulationDraw(state, accumulation);
+
+	return (true);
+}
+
+static void *pixelAccumulationStateInit(caerVisualizerPublicState state) {
+	rendererPixelAccumulation accumulation = new renderer_pixel_accumulation();
+
+	pixelAccumulationInit(accumulation, state->renderSizeX, state->renderSizeY);
+
+	return (accumulation);
+}
+
+static void pixelAccumulationStateExit(caerVisualizerPublicState state) {
+	rendererPixelAccumulation accumulation = (rendererPixelAccumulation) state->renderState;
+
+	delete accumulation;
+}
+
+static void polarityEventsConfigInit(caerVisualizerPublicState state) {
 	sshsNodeCreateBool(state->visualizerConfigNode, "DoubleSpacedAddresses", false, SSHS_FLAGS_NORMAL,
 		"Space DVS addresses apart by doubling them, this is useful for the CDAVIS sensor to put them as they are in the pixel array.");
+}
 
-	return (CAER_VISUALIZER_RENDER_INIT_NO_MEM); // No allocated memory.
+static void *caerVisualizerRendererPolarityEventsStateInit(caerVisualizerPublicState state) {
+	polarityEventsConfigInit(state);
+
+	return (pixelAccumulationStateInit(state));
 }
 
-static bool caerVisualizerRendererPolarityEvents(caerVisualizerPublicState state, caerEventPacketContainer container) {
-	UNUSED_ARGUMENT(state);
+static void caerVisualizerRendererPolarityEventsStateExit(caerVisualizerPublicState state) {
+	pixelAccumulationStateExit(state);
+}
 
+static void polarityEventsAccumulate(caerVisualizerPublicState state, rendererPixelAccumulation accumulation,
+	caerEventPacketContainer container) {
 	caerEventPacketHeader polarityPacketHeader = caerEventPacketContainerFindEventPacketByType(container,
 		POLARITY_EVENT);
 
 	// No packet of requested type or empty packet (no valid events).
 	if (polarityPacketHeader == NULL || caerEventPacketHeaderGetEventValid(polarityPacketHeader) == 0) {
-		return (false);
+		return;
 	}
 
 	bool doubleSpacedAddresses = sshsNodeGetBool(state->visualizerConfigNode, "DoubleSpacedAddresses");
 
 	const libcaer::events::PolarityEventPacket polarityPacket(polarityPacketHeader, false);
 
-	std::vector<sf::Vertex> vertices((size_t) polarityPacket.getEventValid() * 4);
+	std::lock_guard<std::mutex> lock(accumulation->lock);
 
-	// Render all valid events.
+	// Accumulate all valid events.
 	for (const auto &polarityEvent : polarityPacket) {
 		if (!polarityEvent.isValid()) {
 			continue; // Skip invalid events.
@@ -105,31 +307,36 @@ static bool caerVisualizerRendererPolarityEvents(caerVisualizerPublicState state
 		}
 
 		// ON polarity (green), OFF polarity (red).
-		sfml::Helpers::addPixelVertices(vertices, x, y, state->renderZoomFactor.load(std::memory_order_relaxed),
-			(polarityEvent.getPolarity()) ? (sf::Color::Green) : (sf::Color::Red));
+		pixelAccumulationSet(accumulation, x, y, (polarityEvent.getPolarity()) ? (sf::Color::Green) : (sf::Color::Red));
 	}
 
-	state->renderWindow->draw(vertices.data(), vertices.size(), sf::Quads);
+	accumulation->updated = true;
+}
 
-	return (true);
+static void caerVisualizerRendererPolarityEventsAccumulate(caerVisualizerPublicState state,
+	caerEventPacketContainer container) {
+	polarityEventsAccumulate(state, (rendererPixelAccumulation) state->renderState, container);
+}
+
+static bool caerVisualizerRendererPolarityEvents(caerVisualizerPublicState state) {
+	return (pixelAccumulationRender(state, (rendererPixelAccumulation) state->renderState));
 }
 
 struct renderer_frame_events_state {
+	std::mutex lock;
+	// Last valid frame per ROI region, converted on the mainloop thread. Protected by lock.
+	bool updated[DAVIS_APS_ROI_REGIONS_MAX];
+	sf::IntRect position[DAVIS_APS_ROI_REGIONS_MAX];
+	std::vector<uint8_t> pixels[DAVIS_APS_ROI_REGIONS_MAX];
+	// Rendering thread only.
+	bool displayed[DAVIS_APS_ROI_REGIONS_MAX];
 	sf::Sprite sprite[DAVIS_APS_ROI_REGIONS_MAX];
 	sf::Texture texture[DAVIS_APS_ROI_REGIONS_MAX];
-	std::vector<uint8_t> pixels[DAVIS_APS_ROI_REGIONS_MAX];
 };
 
 typedef struct renderer_frame_events_state *rendererFrameEventsState;
 
-static void *caerVisualizerRendererFrameEventsStateInit(caerVisualizerPublicState state) {
-	// Add configuration for ROI region.
-	sshsNodeCreate(state->visualizerConfigNode, "ROIRegion", -1, -1, 7, SSHS_FLAGS_NORMAL,
-		"Selects which ROI region to display. '-1' disables this and renders all of [0,1,2,3].");
-
-	// Allocate memory via C++ for renderer state, since we use C++ objects directly.
-	rendererFrameEventsState renderState = new renderer_frame_events_state();
-
+static void frameEventsStateInit(caerVisualizerPublicState state, rendererFrameEventsState renderState) {
 	for (size_t i = 0; i < DAVIS_APS_ROI_REGIONS_MAX; i++) {
 		// Create texture representing frame, set smoothing.
 		renderState->texture[i].create(state->renderSizeX, state->renderSizeY);
@@ -139,8 +346,23 @@ static void *caerVisualizerRendererFrameEventsStateInit(caerVisualizerPublicStat
 		renderState->sprite[i].setTexture(renderState->texture[i]);
 
 		// 32-bit RGBA pixels (8-bit per channel), standard CG layout.
-		renderState->pixels[i].reserve(state->renderSizeX * state->renderSizeY * 4);
+		renderState->pixels[i].resize((size_t) state->renderSizeX * state->renderSizeY * 4);
 	}
+}
+
+static void frameEventsConfigInit(caerVisualizerPublicState state) {
+	// Add configuration for ROI region.
+	sshsNodeCreate(state->visualizerConfigNode, "ROIRegion", -1, -1, 7, SSHS_FLAGS_NORMAL,
+		"Selects which ROI region to display. '-1' disables this and renders all of [0,1,2,3].");
+}
+
+static void *caerVisualizerRendererFrameEventsStateInit(caerVisualizerPublicState state) {
+	frameEventsConfigInit(state);
+
+	// Allocate memory via C++ for renderer state, since we use C++ objects directly.
+	rendererFrameEventsState renderState = new renderer_frame_events_state();
+
+	frameEventsStateInit(state, renderState);
 
 	return (renderState);
 }
@@ -151,14 +373,13 @@ static void caerVisualizerRendererFrameEventsStateExit(caerVisualizerPublicState
 	delete renderState;
 }
 
-static bool caerVisualizerRendererFrameEvents(caerVisualizerPublicState state, caerEventPacketContainer container) {
-	rendererFrameEventsState renderState = (rendererFrameEventsState) state->renderState;
-
+static void frameEventsAccumulate(caerVisualizerPublicState state, rendererFrameEventsState renderState,
+	caerEventPacketContainer container) {
 	caerEventPacketHeader framePacketHeader = caerEventPacketContainerFindEventPacketByType(container, FRAME_EVENT);
 
 	// No packet of requested type or empty packet (no valid events).
 	if (framePacketHeader == NULL || caerEventPacketHeaderGetEventValid(framePacketHeader) == 0) {
-		return (false);
+		return;
 	}
 
 	int roiRegionSelect = sshsNodeGetInt(state->visualizerConfigNode, "ROIRegion");
@@ -183,7 +404,9 @@ static bool caerVisualizerRendererFrameEvents(caerVisualizerPublicState state, c
 		}
 	}
 
-	// Only operate on the last, valid frame for each ROI region. At least one must exist (see check above).
+	std::lock_guard<std::mutex> lock(renderState->lock);
+
+	// Only operate on the last, valid frame for each ROI region. Older ones would be overwritten anyway.
 	for (size_t i = 0; i < DAVIS_APS_ROI_REGIONS_MAX; i++) {
 		// Skip non existent ROI regions.
 		if (frames[i] == nullptr) {
@@ -224,22 +447,69 @@ static bool caerVisualizerRendererFrameEvents(caerVisualizerPublicState state, c
 			}
 		}
 
-		renderState->texture[i].update(renderState->pixels[i].data(), U32T(frames[i]->getLengthX()),
-			U32T(frames[i]->getLengthY()), U32T(frames[i]->getPositionX()), U32T(frames[i]->getPositionY()));
+		renderState->position[i] = sf::IntRect(frames[i]->getPositionX(), frames[i]->getPositionY(),
+			frames[i]->getLengthX(), frames[i]->getLengthY());
+		renderState->updated[i] = true;
+	}
+}
 
-		renderState->sprite[i].setTextureRect(
-			sf::IntRect(frames[i]->getPositionX(), frames[i]->getPositionY(), frames[i]->getLengthX(),
-				frames[i]->getLengthY()));
+// Upload newly accumulated frames to their textures. Returns true if any changed.
+static bool frameEventsUpdate(rendererFrameEventsState renderState) {
+	std::lock_guard<std::mutex> lock(renderState->lock);
 
-		float zoomFactor = state->renderZoomFactor.load(std::memory_order_relaxed);
+	bool updated = false;
 
-		renderState->sprite[i].setPosition((float) frames[i]->getPositionX() * zoomFactor,
-			(float) frames[i]->getPositionY() * zoomFactor);
+	for (size_t i = 0; i < DAVIS_APS_ROI_REGIONS_MAX; i++) {
+		if (!renderState->updated[i]) {
+			continue;
+		}
+
+		const sf::IntRect &position = renderState->position[i];
+
+		renderState->texture[i].update(renderState->pixels[i].data(), U32T(position.width), U32T(position.height),
+			U32T(position.left), U32T(position.top));
+
+		renderState->sprite[i].setTextureRect(position);
+
+		renderState->updated[i] = false;
+		renderState->displayed[i] = true;
+		updated = true;
+	}
+
+	return (updated);
+}
+
+static void frameEventsDraw(caerVisualizerPublicState state, rendererFrameEventsState renderState) {
+	float zoomFactor = state->renderZoomFactor.load(std::memory_order_relaxed);
+
+	for (size_t i = 0; i < DAVIS_APS_ROI_REGIONS_MAX; i++) {
+		if (!renderState->displayed[i]) {
+			continue;
+		}
+
+		const sf::IntRect &position = renderState->sprite[i].getTextureRect();
+
+		renderState->sprite[i].setPosition((float) position.left * zoomFactor, (float) position.top * zoomFactor);
 
 		renderState->sprite[i].setScale(zoomFactor, zoomFactor);
 
-		state->renderWindow->draw(renderState->sprite[i]);
+		state->renderTarget->draw(renderState->sprite[i]);
 	}
+}
+
+static void caerVisualizerRendererFrameEventsAccumulate(caerVisualizerPublicState state,
+	caerEventPacketContainer container) {
+	frameEventsAccumulate(state, (rendererFrameEventsState) state->renderState, container);
+}
+
+static bool caerVisualizerRendererFrameEvents(caerVisualizerPublicState state) {
+	rendererFrameEventsState renderState = (rendererFrameEventsState) state->renderState;
+
+	if (!frameEventsUpdate(renderState)) {
+		return (false);
+	}
+
+	frameEventsDraw(state, renderState);
 
 	return (true);
 }
@@ -247,15 +517,98 @@ static bool caerVisualizerRendererFrameEvents(caerVisualizerPublicState state, c
 #define RESET_LIMIT_POS(VAL, LIMIT) if ((VAL) > (LIMIT)) { (VAL) = (LIMIT); }
 #define RESET_LIMIT_NEG(VAL, LIMIT) if ((VAL) < (LIMIT)) { (VAL) = (LIMIT); }
 
-static bool caerVisualizerRendererIMU6Events(caerVisualizerPublicState state, caerEventPacketContainer container) {
+// Sums of all IMU samples since the last displayed frame, averaged on rendering.
+struct renderer_imu6_events_state {
+	std::mutex lock;
+	float accelX, accelY, accelZ;
+	float gyroX, gyroY, gyroZ;
+	float temp;
+	int32_t samples;
+};
+
+typedef struct renderer_imu6_events_state *rendererIMU6EventsState;
+
+static void *caerVisualizerRendererIMU6EventsStateInit(caerVisualizerPublicState state) {
+	UNUSED_ARGUMENT(state);
+
+	return (new renderer_imu6_events_state());
+}
+
+static void caerVisualizerRendererIMU6EventsStateExit(caerVisualizerPublicState state) {
+	rendererIMU6EventsState renderState = (rendererIMU6EventsState) state->renderState;
+
+	delete renderState;
+}
+
+static void caerVisualizerRendererIMU6EventsAccumulate(caerVisualizerPublicState state,
+	caerEventPacketContainer container) {
+	rendererIMU6EventsState renderState = (rendererIMU6EventsState) state->renderState;
+
 	caerEventPacketHeader imu6PacketHeader = caerEventPacketContainerFindEventPacketByType(container, IMU6_EVENT);
 
 	if (imu6PacketHeader == NULL || caerEventPacketHeaderGetEventValid(imu6PacketHeader) == 0) {
-		return (false);
+		return;
 	}
 
 	const libcaer::events::IMU6EventPacket imu6Packet(imu6PacketHeader, false);
 
+	std::lock_guard<std::mutex> lock(renderState->lock);
+
+	// Iterate over valid IMU events and sum them up, to average them
+	// on rendering. This somewhat smoothes out the rendering.
+	for (const auto &imu6Event : imu6Packet) {
+		if (!imu6Event.isValid()) {
+			continue; // Skip invalid events.
+		}
+
+		renderState->accelX += imu6Event.getAccelX();
+		renderState->accelY += imu6Event.getAccelY();
+		renderState->accelZ += imu6Event.getAccelZ();
+
+		renderState->gyroX += imu6Event.getGyroX();
+		renderState->gyroY += imu6Event.getGyroY();
+		renderState->gyroZ += imu6Event.getGyroZ();
+
+		renderState->temp += imu6Event.getTemp();
+
+		renderState->samples++;
+	}
+}
+
+static bool caerVisualizerRendererIMU6Events(caerVisualizerPublicState state) {
+	rendererIMU6EventsState renderState = (rendererIMU6EventsState) state->renderState;
+
+	float accelX, accelY, accelZ;
+	float gyroX, gyroY, gyroZ;
+	float temp;
+	int32_t validEvents;
+
+	{
+		std::lock_guard<std::mutex> lock(renderState->lock);
+
+		validEvents = renderState->samples;
+
+		if (validEvents == 0) {
+			return (false);
+		}
+
+		accelX = renderState->accelX;
+		accelY = renderState->accelY;
+		accelZ = renderState->accelZ;
+
+		gyroX = renderState->gyroX;
+		gyroY = renderState->gyroY;
+		gyroZ = renderState->gyroZ;
+
+		temp = renderState->temp;
+
+		// Start summing anew for next frame.
+		renderState->accelX = renderState->accelY = renderState->accelZ = 0;
+		renderState->gyroX = renderState->gyroY = renderState->gyroZ = 0;
+		renderState->temp = 0;
+		renderState->samples = 0;
+	}
+
 	float zoomFactor = state->renderZoomFactor.load(std::memory_order_relaxed);
 
 	float scaleFactorAccel = 30 * zoomFactor;
@@ -270,27 +623,7 @@ static bool caerVisualizerRendererIMU6Events(caerVisualizerPublicState state, ca
 	float centerPointX = maxSizeX / 2;
 	float centerPointY = maxSizeY / 2;
 
-	float accelX = 0, accelY = 0, accelZ = 0;
-	float gyroX = 0, gyroY = 0, gyroZ = 0;
-	float temp = 0;
-
-	// Iterate over valid IMU events and average them.
-	// This somewhat smoothes out the rendering.
-	for (const auto &imu6Event : imu6Packet) {
-		accelX += imu6Event.getAccelX();
-		accelY += imu6Event.getAccelY();
-		accelZ += imu6Event.getAccelZ();
-
-		gyroX += imu6Event.getGyroX();
-		gyroY += imu6Event.getGyroY();
-		gyroZ += imu6Event.getGyroZ();
-
-		temp += imu6Event.getTemp();
-	}
-
 	// Normalize values.
-	int32_t validEvents = imu6Packet.getEventValid();
-
 	accelX /= (float) validEvents;
 	accelY /= (float) validEvents;
 	accelZ /= (float) validEvents;
@@ -314,7 +647,7 @@ static bool caerVisualizerRendererIMU6Events(caerVisualizerPublicState state, ca
 
 	sfml::Line accelLine(sf::Vector2f(centerPointX, centerPointY), sf::Vector2f(accelXScaled, accelYScaled),
 		lineThickness, accelColor);
-	state->renderWindow->draw(accelLine);
+	state->renderTarget->draw(accelLine);
 
 	sf::CircleShape accelCircle(accelZScaled);
 	sfml::Helpers::setOriginToCenter(accelCircle);
@@ -323,7 +656,7 @@ static bool caerVisualizerRendererIMU6Events(caerVisualizerPublicState state, ca
 	accelCircle.setOutlineThickness(-lineThickness);
 	accelCircle.setPosition(sf::Vector2f(centerPointX, centerPointY));
 
-	state->renderWindow->draw(accelCircle);
+	state->renderTarget->draw(accelCircle);
 
 	// Gyroscope pitch(X), yaw(Y), roll(Z) as lines.
 	float gyroXScaled = centerPointY + gyroX * scaleFactorGyro;
@@ -338,11 +671,11 @@ static bool caerVisualizerRendererIMU6Events(caerVisualizerPublicState state, ca
 
 	sfml::Line gyroLine1(sf::Vector2f(centerPointX, centerPointY), sf::Vector2f(gyroYScaled, gyroXScaled),
 		lineThickness, gyroColor);
-	state->renderWindow->draw(gyroLine1);
+	state->renderTarget->draw(gyroLine1);
 
 	sfml::Line gyroLine2(sf::Vector2f(centerPointX, centerPointY - 20), sf::Vector2f(gyroZScaled, centerPointY - 20),
 		lineThickness, gyroColor);
-	state->renderWindow->draw(gyroLine2);
+	state->renderTarget->draw(gyroLine2);
 
 	// TODO: enhance IMU renderer with more text info.
 	if (state->font != nullptr) {
@@ -355,7 +688,7 @@ static bool caerVisualizerRendererIMU6Events(caerVisualizerPublicState state, ca
 		sfml::Helpers::setTextColor(accelText, accelColor);
 		accelText.setPosition(sf::Vector2f(accelXScaled, accelYScaled));
 
-		state->renderWindow->draw(accelText);
+		state->renderTarget->draw(accelText);
 
 		// Temperature.
 		snprintf(valStr, 128, "Temp: %.2f C", (double) temp);
@@ -364,39 +697,57 @@ static bool caerVisualizerRendererIMU6Events(caerVisualizerPublicState state, ca
 		sfml::Helpers::setTextColor(tempText, sf::Color::White);
 		tempText.setPosition(sf::Vector2f(0, 0));
 
-		state->renderWindow->draw(tempText);
+		state->renderTarget->draw(tempText);
 	}
 
 	return (true);
 }
 
-static bool caerVisualizerRendererPoint2DEvents(caerVisualizerPublicState state, caerEventPacketContainer container) {
-	UNUSED_ARGUMENT(state);
+static void *caerVisualizerRendererPoint2DEventsStateInit(caerVisualizerPublicState state) {
+	return (pixelAccumulationStateInit(state));
+}
+
+static void caerVisualizerRendererPoint2DEventsStateExit(caerVisualizerPublicState state) {
+	pixelAccumulationStateExit(state);
+}
+
+static void caerVisualizerRendererPoint2DEventsAccumulate(caerVisualizerPublicState state,
+	caerEventPacketContainer container) {
+	rendererPixelAccumulation accumulation = (rendererPixelAccumulation) state->renderState;
 
 	caerEventPacketHeader point2DPacketHeader = caerEventPacketContainerFindEventPacketByType(container, POINT2D_EVENT);
 
 	if (point2DPacketHeader == NULL || caerEventPacketHeaderGetEventValid(point2DPacketHeader) == 0) {
-		return (false);
+		return;
 	}
 
 	const libcaer::events::Point2DEventPacket point2DPacket(point2DPacketHeader, false);
 
-	std::vector<sf::Vertex> vertices((size_t) point2DPacket.getEventValid() * 4);
+	std::lock_guard<std::mutex> lock(accumulation->lock);
 
-	// Render all valid events.
+	// Accumulate all valid events.
 	for (const auto &point2DEvent : point2DPacket) {
 		if (!point2DEvent.isValid()) {
 			continue; // Skip invalid events.
 		}
 
+		float x = point2DEvent.getX();
+		float y = point2DEvent.getY();
+
+		// Points are arbitrary coordinates, only show those inside the render area.
+		if (x < 0 || y < 0) {
+			continue;
+		}
+
 		// Render points in color blue.
-		sfml::Helpers::addPixelVertices(vertices, point2DEvent.getX(), point2DEvent.getY(),
-			state->renderZoomFactor.load(std::memory_order_relaxed), sf::Color::Blue);
+		pixelAccumulationSet(accumulation, U32T(x), U32T(y), sf::Color::Blue);
 	}
 
-	state->renderWindow->draw(vertices.data(), vertices.size(), sf::Quads);
+	accumulation->updated = true;
+}
 
-	return (true);
+static bool caerVisualizerRendererPoint2DEvents(caerVisualizerPublicState state) {
+	return (pixelAccumulationRender(state, (rendererPixelAccumulation) state->renderState));
 }
 
 static inline sf::Color dynapseCoreIdToColor(uint8_t coreId) {
@@ -414,20 +765,29 @@ static inline sf::Color dynapseCoreIdToColor(uint8_t coreId) {
 	return (sf::Color::Green);
 }
 
-static bool caerVisualizerRendererSpikeEvents(caerVisualizerPublicState state, caerEventPacketContainer container) {
-	UNUSED_ARGUMENT(state);
+static void *caerVisualizerRendererSpikeEventsStateInit(caerVisualizerPublicState state) {
+	return (pixelAccumulationStateInit(state));
+}
+
+static void caerVisualizerRendererSpikeEventsStateExit(caerVisualizerPublicState state) {
+	pixelAccumulationStateExit(state);
+}
+
+static void caerVisualizerRendererSpikeEventsAccumulate(caerVisualizerPublicState state,
+	caerEventPacketContainer container) {
+	rendererPixelAccumulation accumulation = (rendererPixelAccumulation) state->renderState;
 
 	caerEventPacketHeader spikePacketHeader = caerEventPacketContainerFindEventPacketByType(container, SPIKE_EVENT);
 
 	if (spikePacketHeader == NULL || caerEventPacketHeaderGetEventValid(spikePacketHeader) == 0) {
-		return (false);
+		return;
 	}
 
 	const libcaer::events::SpikeEventPacket spikePacket(spikePacketHeader, false);
 
-	std::vector<sf::Vertex> vertices((size_t) spikePacket.getEventValid() * 4);
+	std::lock_guard<std::mutex> lock(accumulation->lock);
 
-	// Render all valid events.
+	// Accumulate all valid events.
 	for (const auto &spikeEvent : spikePacket) {
 		if (!spikeEvent.isValid()) {
 			continue; // Skip invalid events.
@@ -435,14 +795,15 @@ static bool caerVisualizerRendererSpikeEvents(caerVisualizerPublicState state, c
 
 		// Render spikes with different colors based on core ID.
 		uint8_t coreId = spikeEvent.getSourceCoreID();
-		sfml::Helpers::addPixelVertices(vertices, libcaer::devices::dynapse::spikeEventGetX(spikeEvent),
-			libcaer::devices::dynapse::spikeEventGetY(spikeEvent),
-			state->renderZoomFactor.load(std::memory_order_relaxed), dynapseCoreIdToColor(coreId));
+		pixelAccumulationSet(accumulation, libcaer::devices::dynapse::spikeEventGetX(spikeEvent),
+			libcaer::devices::dynapse::spikeEventGetY(spikeEvent), dynapseCoreIdToColor(coreId));
 	}
 
-	state->renderWindow->draw(vertices.data(), vertices.size(), sf::Quads);
+	accumulation->updated = true;
+}
 
-	return (true);
+static bool caerVisualizerRendererSpikeEvents(caerVisualizerPublicState state) {
+	return (pixelAccumulationRender(state, (rendererPixelAccumulation) state->renderState));
 }
 
 // Matrix4x4
@@ -454,10 +815,11 @@ static bool caerVisualizerRendererSpikeEvents(caerVisualizerPublicState state, c
 #define NUMPACKETS 30000
 
 struct caer_visualizer_pose_matrix {
+	std::mutex lock;
 	caerMatrix4x4EventPacket mem;
-	int currentCounter;
 	int worldXPosition;
 	int32_t firstTs;
+	bool updated;
 };
 
 typedef struct caer_visualizer_pose_matrix *caerVisualizerPoseMatrix;
@@ -468,31 +830,37 @@ static void *caerVisualizerRendererMatrix4x4EventsPoseStateInit(caerVisualizerPu
 
 	caerVisualizerPoseMatrix mem = new caer_visualizer_pose_matrix();
 
-	return (mem); // No allocated memory.
+	return (mem);
 }
 
 static void caerVisualizerRendererMatrix4x4EventsPoseStateExit(caerVisualizerPublicState state) {
 	caerVisualizerPoseMatrix mem = (caerVisualizerPoseMatrix) state->renderState;
 
+	free(mem->mem);
+
 	delete mem;
 }
 
-static bool caerVisualizerRendererMatrix4x4EventsPose(caerVisualizerPublicState state,
+static void caerVisualizerRendererMatrix4x4EventsPoseAccumulate(caerVisualizerPublicState state,
 	caerEventPacketContainer container) {
-	UNUSED_ARGUMENT(state);
-
 	caerMatrix4x4EventPacket pkg = (caerMatrix4x4EventPacket) caerEventPacketContainerFindEventPacketByType(container,
 		MATRIX4x4_EVENT);
 	caerEventPacketHeader matrix4x4PacketHeader = &pkg->packetHeader;
 
 	if (matrix4x4PacketHeader == NULL || caerEventPacketHeaderGetEventValid(matrix4x4PacketHeader) == 0) {
-		return (false);
+		return;
 	}
 
 	caerVisualizerPoseMatrix memInt = (caerVisualizerPoseMatrix) state->renderState;
+
+	std::lock_guard<std::mutex> lock(memInt->lock);
+
 	if (memInt->mem == nullptr) {
 		memInt->mem = (caerMatrix4x4EventPacket) caerMatrix4x4EventPacketAllocate(NUMPACKETS, 0,
 			caerEventPacketHeaderGetEventTSOverflow(&pkg->packetHeader));
+		if (memInt->mem == nullptr) {
+			return;
+		}
 		memInt->firstTs = INT32_MAX; // max it will be fixed to its real value at first step
 	}
 
@@ -520,16 +888,6 @@ static bool caerVisualizerRendererMatrix4x4EventsPose(caerVisualizerPublicState
 		}
 	}
 
-	// Get render sizes, subtract 2px for middle borders.
-	float zoomFactor = state->renderZoomFactor.load(std::memory_order_relaxed);
-
-	float sizeX = (float) (state->renderSizeX - 2) * zoomFactor;
-	float sizeY = (float) (state->renderSizeY - 2) * zoomFactor;
-
-	// Two plots in each of X and Y directions.
-	float scaleX = (sizeX) / (float) TIMETOT;
-	float scaleY = (sizeY / 2.0f) / (float) WORLD_Y;
-
 	for (const auto &matrixEvent : matrix4x4Packet) {
 
 		// only show valid events
@@ -540,9 +898,6 @@ static bool caerVisualizerRendererMatrix4x4EventsPose(caerVisualizerPublicState
 		int32_t ts = matrixEvent.getTimestamp();
 		ts = ts - memInt->firstTs;
 
-		// X is based on time.
-		int32_t plotX = (int) floorf((float) ts * scaleX);
-
 		float m00 = matrixEvent.getM00();
 		float m01 = matrixEvent.getM01();
 		float m02 = matrixEvent.getM02();
@@ -563,12 +918,6 @@ static bool caerVisualizerRendererMatrix4x4EventsPose(caerVisualizerPublicState
 		float m32 = matrixEvent.getM32();
 		float m33 = matrixEvent.getM33();
 
-		// what x position to update
-		memInt->currentCounter += 1;
-		if (memInt->currentCounter == (int) sizeX) {
-			memInt->currentCounter = 0;
-		}
-
 		// x position
 		if (memInt->worldXPosition == NUMPACKETS) {
 			memInt->worldXPosition = 0;
@@ -592,8 +941,8 @@ static bool caerVisualizerRendererMatrix4x4EventsPose(caerVisualizerPublicState
 		caerMatrix4x4EventSetM32(thisEvent, m32);
 		caerMatrix4x4EventSetM33(thisEvent, m33);
 
-		// set timestamp accordingly
-		caerMatrix4x4EventSetTimestamp(thisEvent, plotX);
+		// set timestamp accordingly, X position is based on it on rendering
+		caerMatrix4x4EventSetTimestamp(thisEvent, ts);
 
 		// validate event
 		caerMatrix4x4EventValidate(thisEvent, memInt->mem);
@@ -603,8 +952,33 @@ static bool caerVisualizerRendererMatrix4x4EventsPose(caerVisualizerPublicState
 
 	}
 
+	memInt->updated = true;
+}
+
+static bool caerVisualizerRendererMatrix4x4EventsPose(caerVisualizerPublicState state) {
+	caerVisualizerPoseMatrix memInt = (caerVisualizerPoseMatrix) state->renderState;
+
+	std::unique_lock<std::mutex> lock(memInt->lock);
+
+	if (!memInt->updated) {
+		return (false);
+	}
+
+	memInt->updated = false;
+
+	// Get render sizes, subtract 2px for middle borders.
+	float zoomFactor = state->renderZoomFactor.load(std::memory_order_relaxed);
+
+	float sizeX = (float) (state->renderSizeX - 2) * zoomFactor;
+	float sizeY = (float) (state->renderSizeY - 2) * zoomFactor;
+
+	// Two plots in each of X and Y directions.
+	float scaleX = (sizeX) / (float) TIMETOT;
+	float scaleY = (sizeY / 2.0f) / (float) WORLD_Y;
+
 	// init vertices
-	std::vector<sf::Vertex> vertices((size_t) matrix4x4Packet.getEventNumber() * 4);
+	std::vector<sf::Vertex> vertices;
+	vertices.reserve((size_t) memInt->worldXPosition * 12 * 4);
 
 	// draw all points
 	for (int i = 0; i < memInt->worldXPosition; i++) {
@@ -632,7 +1006,7 @@ static bool caerVisualizerRendererMatrix4x4EventsPose(caerVisualizerPublicState
 			float mm33 = caerMatrix4x4EventGetM33(thisEvent);
 
 			// set timestamp, i.e. position on X
-			float plotX = caerMatrix4x4EventGetTimestamp(thisEvent);
+			float plotX = floorf((float) caerMatrix4x4EventGetTimestamp(thisEvent) * scaleX);
 
 			if (mm00 >= 0) {
 				sfml::Helpers::addPixelVertices(vertices, plotX, ((mm00) * (WORLD_Y) + (WORLD_Y / 2)) * scaleY,
@@ -755,7 +1129,10 @@ static bool caerVisualizerRendererMatrix4x4EventsPose(caerVisualizerPublicState
 			 }*/
 		}	// only valid events
 	}
-	state->renderWindow->draw(vertices.data(), vertices.size(), sf::Quads);
+
+	lock.unlock();
+
+	state->renderTarget->draw(vertices.data(), vertices.size(), sf::Quads);
 
 	return (true);
 }
@@ -764,55 +1141,80 @@ static bool caerVisualizerRendererMatrix4x4EventsPose(caerVisualizerPublicState
 #define SPIKE_RASTER_PLOT_TIMESTEPS 500
 #define SPIKE_RASTER_PLOT_NEURONS 256
 
+// Spikes are plotted over a fixed time window, which is cleared when it's full.
+struct renderer_spike_events_raster_state {
+	struct renderer_pixel_accumulation accumulation;
+	int32_t windowStart; // Protected by accumulation lock.
+	bool windowValid; // Protected by accumulation lock.
+};
+
+typedef struct renderer_spike_events_raster_state *rendererSpikeEventsRasterState;
+
 static void *caerVisualizerRendererSpikeEventsRasterStateInit(caerVisualizerPublicState state) {
+	sshsNodeCreateInt(state->visualizerConfigNode, "RasterPlotTimeWindow", 1000000, 1000, 60000000,
+		SSHS_FLAGS_NORMAL, "Time window in µs shown on the X axis of the spikes raster plot.");
+
 	// Reset render size to allow for more neurons and timesteps to be displayed.
 	// This results in less scaling on the X and Y axes.
 	// Also add 2 pixels on X/Y to compensate for the middle separation bars.
 	caerVisualizerResetRenderSize(state, (SPIKE_RASTER_PLOT_TIMESTEPS * 2) + 2, (SPIKE_RASTER_PLOT_NEURONS * 2) + 2);
 
-	return (CAER_VISUALIZER_RENDER_INIT_NO_MEM); // No allocated memory.
+	rendererSpikeEventsRasterState renderState = new renderer_spike_events_raster_state();
+
+	pixelAccumulationInit(&renderState->accumulation, state->renderSizeX, state->renderSizeY);
+
+	return (renderState);
+}
+
+static void caerVisualizerRendererSpikeEventsRasterStateExit(caerVisualizerPublicState state) {
+	rendererSpikeEventsRasterState renderState = (rendererSpikeEventsRasterState) state->renderState;
+
+	delete renderState;
 }
 
-static bool caerVisualizerRendererSpikeEventsRaster(caerVisualizerPublicState state,
+static void caerVisualizerRendererSpikeEventsRasterAccumulate(caerVisualizerPublicState state,
 	caerEventPacketContainer container) {
-	UNUSED_ARGUMENT(state);
+	rendererSpikeEventsRasterState renderState = (rendererSpikeEventsRasterState) state->renderState;
+	rendererPixelAccumulation accumulation = &renderState->accumulation;
 
 	caerEventPacketHeader spikePacketHeader = caerEventPacketContainerFindEventPacketByType(container, SPIKE_EVENT);
 
 	if (spikePacketHeader == NULL || caerEventPacketHeaderGetEventValid(spikePacketHeader) == 0) {
-		return (false);
+		return;
 	}
 
 	const libcaer::events::SpikeEventPacket spikePacket(spikePacketHeader, false);
 
-	// find max and min TS, event packets MUST be ordered by time, that's
-	// an invariant property, so we can just select first and last event.
-	// Also time is always positive, so we can use unsigned ints.
-	uint32_t minTimestamp = U32T(spikePacket[0].getTimestamp());
-	uint32_t maxTimestamp = U32T(spikePacket[-1].getTimestamp());
+	int32_t timeWindow = sshsNodeGetInt(state->visualizerConfigNode, "RasterPlotTimeWindow");
 
-	// time span, +1 to divide space correctly in scaleX.
-	uint32_t timeSpan = maxTimestamp - minTimestamp + 1;
+	// Plot sizes, subtract 2px for middle borders. Two plots in each of X and Y directions.
+	uint32_t plotSizeX = (accumulation->sizeX - 2) / 2;
+	uint32_t plotSizeY = (accumulation->sizeY - 2) / 2;
 
-	// Get render sizes, subtract 2px for middle borders.
-	float zoomFactor = state->renderZoomFactor.load(std::memory_order_relaxed);
+	float scaleX = (float) plotSizeX / (float) timeWindow;
+	float scaleY = (float) plotSizeY / (float) DYNAPSE_CONFIG_NUMNEURONS;
 
-	float sizeX = (float) (state->renderSizeX - 2) * zoomFactor;
-	float sizeY = (float) (state->renderSizeY - 2) * zoomFactor;
+	std::lock_guard<std::mutex> lock(accumulation->lock);
 
-	// Two plots in each of X and Y directions.
-	float scaleX = (sizeX / 2.0f) / (float) timeSpan;
-	float scaleY = (sizeY / 2.0f) / (float) DYNAPSE_CONFIG_NUMNEURONS;
+	// Accumulate all valid spikes.
+	for (const auto &spikeEvent : spikePacket) {
+		if (!spikeEvent.isValid()) {
+			continue; // Skip invalid events.
+		}
 
-	std::vector<sf::Vertex> vertices((size_t) spikePacket.getEventNumber() * 4);
+		int32_t ts = spikeEvent.getTimestamp();
 
-	// Render all spikes.
-	for (const auto &spikeEvent : spikePacket) {
-		uint32_t ts = U32T(spikeEvent.getTimestamp());
-		ts = ts - minTimestamp;
+		// Start a new, empty time window when the current one is full, or time went backwards.
+		if (!renderState->windowValid || ts < renderState->windowStart
+			|| (ts - renderState->windowStart) >= timeWindow) {
+			pixelAccumulationClear(accumulation);
+
+			renderState->windowStart = ts;
+			renderState->windowValid = true;
+		}
 
 		// X is based on time.
-		uint32_t plotX = U32T(floorf((float ) ts * scaleX));
+		uint32_t plotX = U32T(floorf((float) (ts - renderState->windowStart) * scaleX));
 
 		uint8_t coreId = spikeEvent.getSourceCoreID();
 
@@ -820,57 +1222,111 @@ static bool caerVisualizerRendererSpikeEventsRaster(caerVisualizerPublicState st
 		linearIndex += (coreId * DYNAPSE_CONFIG_NUMNEURONS_CORE);
 
 		// Y is based on all neurons.
-		uint32_t plotY = U32T(floorf((float ) linearIndex * scaleY));
+		uint32_t plotY = U32T(floorf((float) linearIndex * scaleY));
 
 		// Move plot X/Y based on chip ID, to get four quadrants with four chips.
 		uint8_t chipId = spikeEvent.getChipID();
 
 		if (chipId == DYNAPSE_CONFIG_DYNAPSE_U3) {
-			plotX += (sizeX / 2) + 2; // +2 for middle border!
-			plotY += (sizeY / 2) + 2; // +2 for middle border!
+			plotX += plotSizeX + 2; // +2 for middle border!
+			plotY += plotSizeY + 2; // +2 for middle border!
 		}
 		else if (chipId == DYNAPSE_CONFIG_DYNAPSE_U2) {
-			plotY += (sizeY / 2) + 2; // +2 for middle border!
+			plotY += plotSizeY + 2; // +2 for middle border!
 		}
 		else if (chipId == DYNAPSE_CONFIG_DYNAPSE_U1) {
-			plotX += (sizeX / 2) + 2; // +2 for middle border!
+			plotX += plotSizeX + 2; // +2 for middle border!
 		}
 		// DYNAPSE_CONFIG_DYNAPSE_U0 no changes.
 
 		// Draw pixels of raster plot (some neurons might be merged due to aliasing).
-		sfml::Helpers::addPixelVertices(vertices, plotX, plotY, zoomFactor, dynapseCoreIdToColor(coreId), false);
+		pixelAccumulationSet(accumulation, plotX, plotY, dynapseCoreIdToColor(coreId));
 	}
 
-	state->renderWindow->draw(vertices.data(), vertices.size(), sf::Quads);
+	accumulation->updated = true;
+}
+
+static bool caerVisualizerRendererSpikeEventsRaster(caerVisualizerPublicState state) {
+	rendererSpikeEventsRasterState renderState = (rendererSpikeEventsRasterState) state->renderState;
+
+	// The time window clears the plot, no decay.
+	if (!pixelAccumulationTake(&renderState->accumulation, 1.0f)) {
+		return (false);
+	}
+
+	pixelAccumulationDraw(state, &renderState->accumulation);
+
+	float zoomFactor = state->renderZoomFactor.load(std::memory_order_relaxed);
 
 	// Draw middle borders, only once!
 	sfml::Line horizontalBorderLine(sf::Vector2f(0, (state->renderSizeY * zoomFactor) / 2),
 		sf::Vector2f((state->renderSizeX * zoomFactor), (state->renderSizeY * zoomFactor) / 2), 2 * zoomFactor,
 		sf::Color::White);
-	state->renderWindow->draw(horizontalBorderLine);
+	state->renderTarget->draw(horizontalBorderLine);
 
 	sfml::Line verticalBorderLine(sf::Vector2f((state->renderSizeX * zoomFactor) / 2, 0),
 		sf::Vector2f((state->renderSizeX * zoomFactor) / 2, (state->renderSizeY * zoomFactor)), 2 * zoomFactor,
 		sf::Color::White);
-	state->renderWindow->draw(verticalBorderLine);
+	state->renderTarget->draw(verticalBorderLine);
 
 	return (true);
 }
 
+struct renderer_polarity_and_frame_events_state {
+	struct renderer_pixel_accumulation polarity;
+	struct renderer_frame_events_state frame;
+};
+
+typedef struct renderer_polarity_and_frame_events_state *rendererPolarityAndFrameEventsState;
+
 static void *caerVisualizerRendererPolarityAndFrameEventsStateInit(caerVisualizerPublicState state) {
-	caerVisualizerRendererPolarityEventsStateInit(state);
-	return (caerVisualizerRendererFrameEventsStateInit(state));
+	polarityEventsConfigInit(state);
+	frameEventsConfigInit(state);
+
+	rendererPolarityAndFrameEventsState renderState = new renderer_polarity_and_frame_events_state();
+
+	pixelAccumulationInit(&renderState->polarity, state->renderSizeX, state->renderSizeY);
+	frameEventsStateInit(state, &renderState->frame);
+
+	return (renderState);
 }
 
 static void caerVisualizerRendererPolarityAndFrameEventsStateExit(caerVisualizerPublicState state) {
-	caerVisualizerRendererFrameEventsStateExit(state);
+	rendererPolarityAndFrameEventsState renderState = (rendererPolarityAndFrameEventsState) state->renderState;
+
+	delete renderState;
 }
 
-static bool caerVisualizerRendererPolarityAndFrameEvents(caerVisualizerPublicState state,
+static void caerVisualizerRendererPolarityAndFrameEventsAccumulate(caerVisualizerPublicState state,
 	caerEventPacketContainer container) {
-	bool drewFrameEvents = caerVisualizerRendererFrameEvents(state, container);
+	rendererPolarityAndFrameEventsState renderState = (rendererPolarityAndFrameEventsState) state->renderState;
+
+	frameEventsAccumulate(state, &renderState->frame, container);
+
+	polarityEventsAccumulate(state, &renderState->polarity, container);
+}
+
+static bool caerVisualizerRendererPolarityAndFrameEvents(caerVisualizerPublicState state) {
+	rendererPolarityAndFrameEventsState renderState = (rendererPolarityAndFrameEventsState) state->renderState;
 
-	bool drewPolarityEvents = caerVisualizerRendererPolarityEvents(state, container);
+	bool newFrameEvents = frameEventsUpdate(&renderState->frame);
 
-	return (drewFrameEvents || drewPolarityEvents);
+	float decay = state->accumulationDecay.load(std::memory_order_relaxed);
+
+	bool newPolarityEvents = pixelAccumulationTake(&renderState->polarity, decay);
+
+	if (!newFrameEvents && !newPolarityEvents) {
+		return (false);
+	}
+
+	// Frames stay as background, events are drawn on top of them.
+	frameEventsDraw(state, &renderState->frame);
+
+	// Only a persistent accumulation (no decay) still shows the previous events when just a new frame
+	// arrived, otherwise they were already displayed once and must not reappear.
+	if (newPolarityEvents || decay >= 1.0f) {
+		pixelAccumulationDraw(state, &renderState->polarity);
+	}
+
+	return (true);
 }
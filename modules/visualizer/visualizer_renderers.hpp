@@ -3,21 +3,28 @@
 
 #include "visualizer.hpp"
 
-typedef bool (*caerVisualizerRenderer)(caerVisualizerPublicState state, caerEventPacketContainer container);
+// Called on the mainloop thread for every container: renderers copy what they need into their
+// render state, to then display all of it on the next render pass. Never holds on to the container.
+typedef void (*caerVisualizerRendererAccumulate)(caerVisualizerPublicState state, caerEventPacketContainer container);
+// Called on the rendering thread. Returns true if something new was drawn.
+typedef bool (*caerVisualizerRenderer)(caerVisualizerPublicState state);
 
 typedef void *(*caerVisualizerRendererStateInit)(caerVisualizerPublicState state);
 typedef void (*caerVisualizerRendererStateExit)(caerVisualizerPublicState state);
 
 struct caer_visualizer_renderer_info {
 	const std::string name;
+	caerVisualizerRendererAccumulate accumulate;
 	caerVisualizerRenderer renderer;
 	bool needsOpenGL3;
 	caerVisualizerRendererStateInit stateInit;
 	caerVisualizerRendererStateExit stateExit;
 
-	caer_visualizer_renderer_info(const std::string &n, caerVisualizerRenderer r, bool opengl3 = false,
-		caerVisualizerRendererStateInit stInit = nullptr, caerVisualizerRendererStateExit stExit = nullptr) :
+	caer_visualizer_renderer_info(const std::string &n, caerVisualizerRendererAccumulate a, caerVisualizerRenderer r,
+		bool opengl3 = false, caerVisualizerRendererStateInit stInit = nullptr,
+		caerVisualizerRendererStateExit stExit = nullptr) :
 			name(n),
+			accumulate(a),
 			renderer(r),
 			needsOpenGL3(opengl3),
 			stateInit(stInit),
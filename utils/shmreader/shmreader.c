@@ -0,0 +1,250 @@
+#include "shmreader.h"
+#include "modules/misc/shm_ring.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct caer_shm_reader {
+	int shmFd;
+	size_t shmSize;
+	void *shmMapping;
+	const struct caer_shm_ring_header *ring;
+	const uint8_t *data;
+	uint64_t dataSize;
+	uint64_t dataMask;
+	uint64_t sessionID;
+	uint64_t readPosition;
+	uint64_t pendingPosition;
+	uint64_t overruns;
+	uint64_t bytesLost;
+};
+
+static void skipToLatest(caerShmReader reader);
+static bool wasOverwritten(caerShmReader reader, uint64_t position);
+
+caerShmReader caerShmReaderOpen(const char *shmName) {
+	caerShmReader reader = calloc(1, sizeof(*reader));
+	if (reader == NULL) {
+		return (NULL);
+	}
+
+	// Readers only ever read, this way they cannot damage the ring for others.
+	reader->shmFd = shm_open(shmName, O_RDONLY, 0);
+	if (reader->shmFd < 0) {
+		free(reader);
+		return (NULL);
+	}
+
+	struct stat shmStat;
+	if (fstat(reader->shmFd, &shmStat) != 0 || (size_t) shmStat.st_size <= CAER_SHM_RING_HEADER_SIZE) {
+		close(reader->shmFd);
+		free(reader);
+
+		errno = EINVAL;
+		return (NULL);
+	}
+
+	reader->shmSize = (size_t) shmStat.st_size;
+
+	void *mapping = mmap(NULL, reader->shmSize, PROT_READ, MAP_SHARED, reader->shmFd, 0);
+	if (mapping == MAP_FAILED) {
+		close(reader->shmFd);
+		free(reader);
+		return (NULL);
+	}
+
+	reader->shmMapping = mapping;
+	reader->ring = mapping;
+
+	// Header fields are only valid once the writer published them.
+	if (atomic_load_explicit(&reader->ring->writerActive, memory_order_acquire) == 0
+		|| reader->ring->magic != CAER_SHM_RING_MAGIC || reader->ring->version != CAER_SHM_RING_VERSION
+		|| (CAER_SHM_RING_HEADER_SIZE + reader->ring->dataSize) != reader->shmSize) {
+		caerShmReaderClose(reader);
+
+		errno = EINVAL;
+		return (NULL);
+	}
+
+	reader->data = caerShmRingData((struct caer_shm_ring_header *) mapping);
+	reader->dataSize = reader->ring->dataSize;
+	reader->dataMask = reader->dataSize - 1;
+	reader->sessionID = reader->ring->sessionID;
+
+	// Start at the most recent data.
+	reader->readPosition = atomic_load_explicit(&reader->ring->writeCommit, memory_order_acquire);
+	reader->pendingPosition = reader->readPosition;
+
+	return (reader);
+}
+
+void caerShmReaderClose(caerShmReader reader) {
+	if (reader == NULL) {
+		return;
+	}
+
+	munmap(reader->shmMapping, reader->shmSize);
+	close(reader->shmFd);
+
+	free(reader);
+}
+
+enum caer_shm_reader_status caerShmReaderNext(caerShmReader reader, const void **packet, size_t *packetSize,
+	uint32_t *flags) {
+	if (reader->pendingPosition != reader->readPosition && !caerShmReaderRelease(reader)) {
+		return (CAER_SHM_READER_OVERRUN);
+	}
+
+	while (true) {
+		if (atomic_load_explicit(&reader->ring->writerActive, memory_order_acquire) == 0
+			|| reader->ring->sessionID != reader->sessionID) {
+			return (CAER_SHM_READER_WRITER_GONE);
+		}
+
+		uint64_t commit = atomic_load_explicit(&reader->ring->writeCommit, memory_order_acquire);
+
+		if (commit == reader->readPosition) {
+			return (CAER_SHM_READER_NO_DATA);
+		}
+
+		if ((commit - reader->readPosition) > reader->dataSize) {
+			skipToLatest(reader);
+			return (CAER_SHM_READER_OVERRUN);
+		}
+
+		// Copy record header, then verify it wasn't being overwritten while doing so.
+		struct caer_shm_ring_record record;
+		memcpy(&record, reader->data + (reader->readPosition & reader->dataMask), sizeof(record));
+
+		if (wasOverwritten(reader, reader->readPosition)) {
+			skipToLatest(reader);
+			return (CAER_SHM_READER_OVERRUN);
+		}
+
+		uint64_t recordSpace = caerShmRingRecordSpace(record.size);
+
+		if (recordSpace > (commit - reader->readPosition)) {
+			skipToLatest(reader);
+			return (CAER_SHM_READER_CORRUPTED);
+		}
+
+		if (record.flags & CAER_SHM_RING_RECORD_PADDING) {
+			// Skip to start of ring.
+			reader->readPosition += recordSpace;
+			reader->pendingPosition = reader->readPosition;
+			continue;
+		}
+
+		*packet = reader->data + (reader->readPosition & reader->dataMask) + sizeof(struct caer_shm_ring_record);
+		*packetSize = record.size;
+		if (flags != NULL) {
+			*flags = record.flags;
+		}
+
+		reader->pendingPosition = reader->readPosition + recordSpace;
+
+		return (CAER_SHM_READER_OK);
+	}
+}
+
+bool caerShmReaderRelease(caerShmReader reader) {
+	if (wasOverwritten(reader, reader->readPosition)) {
+		skipToLatest(reader);
+		return (false);
+	}
+
+	reader->readPosition = reader->pendingPosition;
+
+	return (true);
+}
+
+enum caer_shm_reader_status caerShmReaderRead(caerShmReader reader, void *buffer, size_t bufferSize,
+	size_t *packetSize, uint32_t *flags) {
+	const void *packet;
+
+	enum caer_shm_reader_status status = caerShmReaderNext(reader, &packet, packetSize, flags);
+	if (status != CAER_SHM_READER_OK) {
+		return (status);
+	}
+
+	if (*packetSize > bufferSize) {
+		// Don't consume the packet, so it can be retried with a bigger buffer.
+		reader->pendingPosition = reader->readPosition;
+		return (CAER_SHM_READER_BUFFER_TOO_SMALL);
+	}
+
+	memcpy(buffer, packet, *packetSize);
+
+	if (!caerShmReaderRelease(reader)) {
+		return (CAER_SHM_READER_OVERRUN);
+	}
+
+	return (CAER_SHM_READER_OK);
+}
+
+bool caerShmReaderWait(caerShmReader reader, uint64_t timeoutUs, uint32_t pollIntervalUs) {
+	struct timespec pollSleep = { .tv_sec = pollIntervalUs / 1000000, .tv_nsec = (pollIntervalUs % 1000000) * 1000 };
+	uint64_t waited = 0;
+
+	while (true) {
+		if (atomic_load_explicit(&reader->ring->writerActive, memory_order_acquire) == 0
+			|| reader->ring->sessionID != reader->sessionID) {
+			return (false);
+		}
+
+		if (atomic_load_explicit(&reader->ring->writeCommit, memory_order_acquire) != reader->pendingPosition) {
+			return (true);
+		}
+
+		if (waited >= timeoutUs) {
+			return (false);
+		}
+
+		nanosleep(&pollSleep, NULL);
+		waited += (pollIntervalUs == 0) ? (1) : (pollIntervalUs);
+	}
+}
+
+int16_t caerShmReaderGetSourceID(caerShmReader reader) {
+	return (reader->ring->sourceID);
+}
+
+uint64_t caerShmReaderGetOverruns(caerShmReader reader) {
+	return (reader->overruns);
+}
+
+uint64_t caerShmReaderGetBytesLost(caerShmReader reader) {
+	return (reader->bytesLost);
+}
+
+uint64_t caerShmReaderGetLag(caerShmReader reader) {
+	return (atomic_load_explicit(&reader->ring->writeCommit, memory_order_relaxed) - reader->readPosition);
+}
+
+static void skipToLatest(caerShmReader reader) {
+	uint64_t commit = atomic_load_explicit(&reader->ring->writeCommit, memory_order_acquire);
+
+	reader->overruns++;
+	reader->bytesLost += commit - reader->readPosition;
+
+	reader->readPosition = commit;
+	reader->pendingPosition = commit;
+}
+
+/**
+ * Check if the writer reserved (and so possibly overwrote) the memory holding
+ * data at the given position. Must be called after reading that data.
+ */
+static bool wasOverwritten(caerShmReader reader, uint64_t position) {
+	// Order the data reads before the reservation check (seqlock-style).
+	atomic_thread_fence(memory_order_acquire);
+
+	uint64_t reserve = atomic_load_explicit(&reader->ring->writeReserve, memory_order_relaxed);
+
+	return ((reserve - position) > reader->dataSize);
+}
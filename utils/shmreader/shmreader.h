@@ -0,0 +1,126 @@
+#ifndef SHMREADER_H_
+#define SHMREADER_H_
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Reader library for the shared memory ring published by the cAER
+ * SharedMemoryOutput module. Any number of readers can attach to the same
+ * ring, each one keeps its own read position and never slows down the
+ * writer. A reader that falls too far behind is overrun: it loses the data
+ * that was overwritten and resumes at the most recent packet.
+ *
+ * Each record is one complete event packet, laid out exactly like a libcaer
+ * event packet in memory (eventCapacity equals eventNumber), so it can be
+ * used directly with the libcaer event packet accessors.
+ */
+typedef struct caer_shm_reader *caerShmReader;
+
+enum caer_shm_reader_status {
+	CAER_SHM_READER_OK = 0,
+	CAER_SHM_READER_NO_DATA = 1,
+	CAER_SHM_READER_OVERRUN = 2,
+	CAER_SHM_READER_BUFFER_TOO_SMALL = 3,
+	CAER_SHM_READER_WRITER_GONE = -1,
+	CAER_SHM_READER_CORRUPTED = -2,
+};
+
+// Set on the last packet of each packet container (mainloop run).
+#define CAER_SHM_READER_CONTAINER_END 0x02
+
+/**
+ * Attach to a shared memory ring. Reading starts at the most recent data.
+ *
+ * @param shmName name of the shared memory object, as configured in the
+ *                SharedMemoryOutput module ('shmName' option).
+ *
+ * @return a new reader, or NULL on error (errno is set).
+ */
+caerShmReader caerShmReaderOpen(const char *shmName);
+
+/**
+ * Detach from the shared memory ring and free the reader.
+ *
+ * @param reader the reader to close. Can be NULL.
+ */
+void caerShmReaderClose(caerShmReader reader);
+
+/**
+ * Get the next event packet, without copying it. The packet memory stays
+ * owned by the writer: once done with it, call caerShmReaderRelease() to
+ * verify it was not overwritten in the meantime, and only trust the results
+ * computed from it if that succeeds.
+ * A packet not yet released is released implicitly by the next call.
+ *
+ * @param reader the reader.
+ * @param packet pointer to the event packet in shared memory.
+ * @param packetSize size of the event packet in bytes.
+ * @param flags record flags (CAER_SHM_READER_CONTAINER_END). Can be NULL.
+ *
+ * @return CAER_SHM_READER_OK if a packet was returned, NO_DATA if there is
+ *         nothing new, OVERRUN if data was lost (the reader already moved
+ *         to the most recent data, simply call again), WRITER_GONE if the
+ *         writer exited (close and reopen to attach to a new one), or
+ *         CORRUPTED on invalid ring content.
+ */
+enum caer_shm_reader_status caerShmReaderNext(caerShmReader reader, const void **packet, size_t *packetSize,
+	uint32_t *flags);
+
+/**
+ * Release the packet returned by the last caerShmReaderNext() call.
+ *
+ * @param reader the reader.
+ *
+ * @return true if the packet was intact the whole time, false if the writer
+ *         overwrote it (overrun, the reader moved to the most recent data).
+ */
+bool caerShmReaderRelease(caerShmReader reader);
+
+/**
+ * Copy the next event packet into a buffer. Equivalent to Next(), memcpy()
+ * and Release(), so the copy is guaranteed to be consistent.
+ *
+ * @param reader the reader.
+ * @param buffer memory to copy the event packet into.
+ * @param bufferSize size of buffer in bytes.
+ * @param packetSize size of the event packet in bytes. On BUFFER_TOO_SMALL,
+ *                   the size needed (the packet is not consumed).
+ * @param flags record flags (CAER_SHM_READER_CONTAINER_END). Can be NULL.
+ *
+ * @return same as caerShmReaderNext(), plus BUFFER_TOO_SMALL.
+ */
+enum caer_shm_reader_status caerShmReaderRead(caerShmReader reader, void *buffer, size_t bufferSize,
+	size_t *packetSize, uint32_t *flags);
+
+/**
+ * Wait until new data is available, polling with the given interval.
+ *
+ * @param reader the reader.
+ * @param timeoutUs maximum time to wait, in µs.
+ * @param pollIntervalUs time to sleep between checks, in µs.
+ *
+ * @return true if new data is available, false on timeout or if the writer exited.
+ */
+bool caerShmReaderWait(caerShmReader reader, uint64_t timeoutUs, uint32_t pollIntervalUs);
+
+// Source ID of the data in the ring, -1 if no data was written yet.
+int16_t caerShmReaderGetSourceID(caerShmReader reader);
+
+// Number of times this reader was overrun, and total bytes lost because of it.
+uint64_t caerShmReaderGetOverruns(caerShmReader reader);
+uint64_t caerShmReaderGetBytesLost(caerShmReader reader);
+
+// How many bytes of data this reader is behind the writer.
+uint64_t caerShmReaderGetLag(caerShmReader reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHMREADER_H_ */
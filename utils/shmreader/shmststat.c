@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include "shmreader.h"
+
+#include <libcaer/events/common.h>
+
+#include <signal.h>
+#include <stdatomic.h>
+
+static atomic_bool globalShutdown = ATOMIC_VAR_INIT(false);
+
+static void globalShutdownSignalHandler(int signal) {
+	// Simply set the running flag to false on SIGTERM and SIGINT (CTRL+C) for global shutdown.
+	if (signal == SIGTERM || signal == SIGINT) {
+		atomic_store(&globalShutdown, true);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	// Install signal handler for global shutdown.
+	struct sigaction shutdownAction;
+
+	shutdownAction.sa_handler = &globalShutdownSignalHandler;
+	shutdownAction.sa_flags = 0;
+	sigemptyset(&shutdownAction.sa_mask);
+	sigaddset(&shutdownAction.sa_mask, SIGTERM);
+	sigaddset(&shutdownAction.sa_mask, SIGINT);
+
+	if (sigaction(SIGTERM, &shutdownAction, NULL) == -1) {
+		caerLog(CAER_LOG_CRITICAL, "ShutdownAction", "Failed to set signal handler for SIGTERM. Error: %d.", errno);
+		return (EXIT_FAILURE);
+	}
+
+	if (sigaction(SIGINT, &shutdownAction, NULL) == -1) {
+		caerLog(CAER_LOG_CRITICAL, "ShutdownAction", "Failed to set signal handler for SIGINT. Error: %d.", errno);
+		return (EXIT_FAILURE);
+	}
+
+	// First of all, parse the shared memory name we need to attach to.
+	// That is the only parameter permitted at the moment.
+	// If none passed, attempt to attach to default name.
+	const char *shmName = "/caer-events";
+
+	if (argc != 1 && argc != 2) {
+		fprintf(stderr, "Incorrect argument number. Either pass none for default shared memory"
+			"name of /caer-events, or pass the name of the shared memory object.\n");
+		return (EXIT_FAILURE);
+	}
+
+	// If explicitly passed, parse arguments.
+	if (argc == 2) {
+		shmName = argv[1];
+	}
+
+	caerShmReader reader = caerShmReaderOpen(shmName);
+	if (reader == NULL) {
+		fprintf(stderr, "Failed to attach to shared memory '%s'. Error: %d.\n", shmName, errno);
+		return (EXIT_FAILURE);
+	}
+
+	printf("Source ID: %" PRIi16 "\n", caerShmReaderGetSourceID(reader));
+
+	while (!atomic_load_explicit(&globalShutdown, memory_order_relaxed)) {
+		const void *packet;
+		size_t packetSize;
+		uint32_t flags;
+
+		enum caer_shm_reader_status status = caerShmReaderNext(reader, &packet, &packetSize, &flags);
+
+		if (status == CAER_SHM_READER_NO_DATA) {
+			// Wait up to 100 ms for data, checking every 100 µs.
+			caerShmReaderWait(reader, 100000, 100);
+			continue;
+		}
+
+		if (status == CAER_SHM_READER_OVERRUN) {
+			printf("Reader overrun, total lost: %" PRIu64 " bytes in %" PRIu64 " overruns.\n",
+				caerShmReaderGetBytesLost(reader), caerShmReaderGetOverruns(reader));
+			continue;
+		}
+
+		if (status != CAER_SHM_READER_OK) {
+			caerShmReaderClose(reader);
+
+			fprintf(stderr, "Shared memory reader stopped: %s.\n",
+				(status == CAER_SHM_READER_WRITER_GONE) ? ("writer exited") : ("corrupted data"));
+			return (EXIT_FAILURE);
+		}
+
+		// Decode packet header, directly from shared memory.
+		caerEventPacketHeaderConst header = packet;
+
+		int16_t eventType = caerEventPacketHeaderGetEventType(header);
+		int16_t eventSource = caerEventPacketHeaderGetEventSource(header);
+		int32_t eventSize = caerEventPacketHeaderGetEventSize(header);
+		int32_t eventNumber = caerEventPacketHeaderGetEventNumber(header);
+		int32_t eventValid = caerEventPacketHeaderGetEventValid(header);
+
+		int32_t firstTS = 0, lastTS = 0;
+		if (eventNumber > 0) {
+			firstTS = caerGenericEventGetTimestamp(caerGenericEventGetEvent(header, 0), header);
+			lastTS = caerGenericEventGetTimestamp(caerGenericEventGetEvent(header, eventNumber - 1), header);
+		}
+
+		// Only trust what was read if the writer didn't overwrite it meanwhile.
+		if (!caerShmReaderRelease(reader)) {
+			printf("Packet overwritten while reading, skipping.\n");
+			continue;
+		}
+
+		printf(
+			"type = %" PRIi16 ", source = %" PRIi16 ", size = %" PRIi32 ", number = %" PRIi32 ", valid = %" PRIi32 ", bytes = %zu, lag = %" PRIu64 ".\n",
+			eventType, eventSource, eventSize, eventNumber, eventValid, packetSize, caerShmReaderGetLag(reader));
+		printf("Time difference in packet: %" PRIi32 " (first = %" PRIi32 ", last = %" PRIi32 ").\n",
+			lastTS - firstTS, firstTS, lastTS);
+
+		if (flags & CAER_SHM_READER_CONTAINER_END) {
+			printf("\n\n");
+		}
+	}
+
+	caerShmReaderClose(reader);
+
+	return (EXIT_SUCCESS);
+}